@@ -0,0 +1,72 @@
+#include <forpy/compiledforest.h>
+#include <forpy/forest.h>
+#include <forpy/tree.h>
+#include "./conversion.h"
+#include "./macros.h"
+
+namespace py = pybind11;
+
+namespace forpy {
+
+void export_compiled(py::module &m) {
+  FORPY_EXPCLASS(CompiledTree, ct);
+  ct.def(py::init<const Tree &>(), py::arg("tree"));
+  ct.def("predict", &CompiledTree::predict, py::arg("data").noconvert(),
+         py::arg("predict_proba") = false,
+         py::call_guard<py::gil_scoped_release>());
+  ct.def("predict_proba",
+         [](const CompiledTree &self, const Data<MatCRef> &data) {
+           return self.predict(data, true);
+         },
+         py::arg("data").noconvert(),
+         py::call_guard<py::gil_scoped_release>());
+  ct.def("predict_one",
+         [](const CompiledTree &self,
+            const Eigen::Ref<const Vec<float>> &features,
+            Eigen::Ref<Vec<float>> out, const bool &predict_proba) {
+           if (static_cast<size_t>(features.rows()) !=
+               self.get_input_data_dimensions())
+             throw ForpyException("Wrong number of features!");
+           if (static_cast<size_t>(out.rows()) <
+               self.get_result_columns(predict_proba))
+             throw ForpyException("The output array is too small!");
+           self.predict_one(features.data(), out.data(), predict_proba);
+         },
+         py::arg("features").noconvert(), py::arg("out").noconvert(),
+         py::arg("predict_proba") = false,
+         py::call_guard<py::gil_scoped_release>());
+  ct.def_property_readonly("n_leafs", &CompiledTree::get_n_leafs);
+  ct.def_property_readonly("memory_size", &CompiledTree::get_memory_size);
+  FORPY_EXPFUNC(ct, CompiledTree, get_input_data_dimensions);
+
+  FORPY_EXPCLASS(CompiledForest, cf);
+  cf.def(py::init<const Forest &>(), py::arg("forest"));
+  cf.def("predict", &CompiledForest::predict, py::arg("data").noconvert(),
+         py::arg("predict_proba") = false,
+         py::call_guard<py::gil_scoped_release>());
+  cf.def("predict_proba",
+         [](const CompiledForest &self, const Data<MatCRef> &data) {
+           return self.predict(data, true);
+         },
+         py::arg("data").noconvert(),
+         py::call_guard<py::gil_scoped_release>());
+  cf.def("predict_one",
+         [](const CompiledForest &self,
+            const Eigen::Ref<const Vec<float>> &features,
+            Eigen::Ref<Vec<float>> out, const bool &predict_proba) {
+           if (static_cast<size_t>(features.rows()) !=
+               self.get_input_data_dimensions())
+             throw ForpyException("Wrong number of features!");
+           if (static_cast<size_t>(out.rows()) <
+               self.get_result_columns(predict_proba))
+             throw ForpyException("The output array is too small!");
+           self.predict_one(features.data(), out.data(), predict_proba);
+         },
+         py::arg("features").noconvert(), py::arg("out").noconvert(),
+         py::arg("predict_proba") = false,
+         py::call_guard<py::gil_scoped_release>());
+  cf.def_property_readonly("n_trees", &CompiledForest::get_n_trees);
+  cf.def_property_readonly("memory_size", &CompiledForest::get_memory_size);
+  FORPY_EXPFUNC(cf, CompiledForest, get_input_data_dimensions);
+}
+}  // namespace forpy
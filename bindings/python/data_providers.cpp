@@ -33,6 +33,9 @@ void export_data_providers(py::module &m) {
     return ret;
   });
   idp.def("get_weights", &IDataProvider::get_weights);
+  idp.def_property_readonly("uses_histograms", [](const IDataProvider &self) {
+    return self.get_feature_bins() != nullptr;
+  });
   idp.def_property_readonly("feat_vec_dim", &IDataProvider::get_feat_vec_dim);
   idp.def_property_readonly("annot_vec_dim", &IDataProvider::get_annot_vec_dim);
   idp.def(
@@ -51,14 +54,71 @@ void export_data_providers(py::module &m) {
   FORPY_EXPCLASS_PARENT(FastDProv, fdp, idp);
   fdp.def("__init__",
           [](FastDProv &self, Data<MatCRef> &data, Data<MatCRef> &annot,
-             std::vector<float> &weights) {
-            new (&self) FastDProv(
-                data, annot, std::make_shared<std::vector<float>>(weights));
+             std::vector<float> &weights, const size_t &n_bins) {
+            new (&self) FastDProv(data, annot,
+                                  std::make_shared<std::vector<float>>(weights),
+                                  n_bins);
           },
           py::arg("data").noconvert(), py::arg("annotations").noconvert(),
-          py::arg("weights") = std::vector<float>(), py::keep_alive<1, 2>(),
+          py::arg("weights") = std::vector<float>(), py::arg("n_bins") = 0,
+          py::keep_alive<1, 2>(),
           py::keep_alive<1, 3>());
   FORPY_DEFAULT_REPR(fdp, FastDProv);
+
+#ifndef _WIN32
+  FORPY_EXPCLASS_PARENT(MMapDProv, mdp, idp);
+  mdp.def("__init__",
+          [](MMapDProv &self, const std::string &filename,
+             Data<MatCRef> &annot, std::vector<float> &weights,
+             const size_t &n_bins) {
+            new (&self) MMapDProv(
+                filename, annot, std::make_shared<std::vector<float>>(weights),
+                n_bins);
+          },
+          py::arg("filename"), py::arg("annotations").noconvert(),
+          py::arg("weights") = std::vector<float>(), py::arg("n_bins") = 0,
+          py::keep_alive<1, 3>());
+  mdp.def("__init__",
+          [](MMapDProv &self, const std::string &filename,
+             const std::string &dtype, const size_t &n_features,
+             Data<MatCRef> &annot, std::vector<float> &weights,
+             const size_t &n_bins, const size_t &offset) {
+            new (&self) MMapDProv(
+                filename, dtype, n_features, annot,
+                std::make_shared<std::vector<float>>(weights), n_bins, offset);
+          },
+          py::arg("filename"), py::arg("dtype"), py::arg("n_features"),
+          py::arg("annotations").noconvert(),
+          py::arg("weights") = std::vector<float>(), py::arg("n_bins") = 0,
+          py::arg("offset") = 0, py::keep_alive<1, 5>());
+  mdp.def("advise", &MMapDProv::advise, py::arg("pattern"),
+          py::arg("feat_idx") = -1);
+  mdp.def_property_readonly("filename", &MMapDProv::get_filename);
+  FORPY_DEFAULT_REPR(mdp, MMapDProv);
+#endif
+
+  // The arrays of `scipy.sparse.csc_matrix` or `csr_matrix`.
+  FORPY_EXPCLASS(SparseMat, smat);
+  smat.def(py::init<std::vector<size_t>, std::vector<id_t>,
+                    std::vector<float>, const size_t &>(),
+           py::arg("indptr"), py::arg("indices"), py::arg("data"),
+           py::arg("n_inner"));
+  FORPY_EXPFUNC(smat, SparseMat, transpose);
+  smat.def_property_readonly("n_outer", &SparseMat::get_n_outer);
+  smat.def_property_readonly("n_inner", &SparseMat::get_n_inner);
+  smat.def_property_readonly("nnz", &SparseMat::get_nnz);
+  FORPY_DEFAULT_REPR(smat, SparseMat);
+
+  FORPY_EXPCLASS_PARENT(SparseDProv, sdp, idp);
+  sdp.def("__init__",
+          [](SparseDProv &self, const std::shared_ptr<SparseMat> &features,
+             Data<MatCRef> &annot, std::vector<float> &weights) {
+            new (&self) SparseDProv(
+                features, annot, std::make_shared<std::vector<float>>(weights));
+          },
+          py::arg("features"), py::arg("annotations").noconvert(),
+          py::arg("weights") = std::vector<float>(), py::keep_alive<1, 3>());
+  FORPY_DEFAULT_REPR(sdp, SparseDProv);
 };
 
 }  // namespace forpy
@@ -19,10 +19,17 @@ void export_deciders(py::module &m) {
   });
 
   FORPY_EXPCLASS_PARENT(FastDecider, fd, id);
-  fd.def(py::init<std::shared_ptr<IThreshOpt>, size_t, bool>(),
+  fd.def(py::init<std::shared_ptr<IThreshOpt>, size_t, bool, bool, size_t,
+                  size_t>(),
          py::arg("threshold_optimizer") = nullptr,
          py::arg("n_valid_features_to_use") = 0,
-         py::arg("autoscale_valid_features") = false);
+         py::arg("autoscale_valid_features") = false,
+         py::arg("presort") = false, py::arg("subsample_min_samples") = 0,
+         py::arg("subsample_size") = 10000);
+  fd.def_property_readonly("presort", &FastDecider::get_presort);
+  fd.def_property_readonly("subsample_min_samples",
+                           &FastDecider::get_subsample_min_samples);
+  fd.def_property_readonly("subsample_size", &FastDecider::get_subsample_size);
   FORPY_EXPFUNC(fd, FastDecider, get_maps);
   FORPY_DEFAULT_REPR(fd, FastDecider);
 };
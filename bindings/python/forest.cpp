@@ -23,6 +23,8 @@ void export_forest(py::module &m) {
   f.def_property_readonly("depths", &Forest::get_depths);
   f.def_property("tree_weights", &Forest::get_tree_weights,
                  &Forest::set_tree_weights);
+  f.def_property("local_copy_samples", &Forest::get_local_copy_samples,
+                 &Forest::set_local_copy_samples);
   f.def_property_readonly("trees", &Forest::get_trees);
   FORPY_EXPFUNC(f, Forest, get_input_data_dimensions);
   FORPY_EXPFUNC(f, Forest, get_decider);
@@ -44,9 +46,36 @@ void export_forest(py::module &m) {
         py::arg("num_threads") = 1,
         py::arg("use_fast_prediction_if_available") = true,
         py::call_guard<py::gil_scoped_release>());
-  f.def("enable_fast_prediction", &Forest::enable_fast_prediction);
+  f.def("predict_sparse", &Forest::predict_sparse, py::arg("data"),
+        py::arg("num_threads") = 1, py::arg("predict_proba") = false,
+        py::call_guard<py::gil_scoped_release>());
+  f.def("predict_one",
+        [](const Forest &self, const Eigen::Ref<const Vec<float>> &features,
+           Eigen::Ref<Vec<float>> out, const bool &predict_proba) {
+          if (static_cast<size_t>(features.rows()) !=
+              self.get_input_data_dimensions())
+            throw ForpyException("Wrong number of features!");
+          if (static_cast<size_t>(out.rows()) <
+              self.get_leaf_manager()->get_result_columns(
+                  self.get_trees().size(), predict_proba, false))
+            throw ForpyException("The output array is too small!");
+          self.predict_one(features.data(), out.data(), predict_proba);
+        },
+        py::arg("features").noconvert(), py::arg("out").noconvert(),
+        py::arg("predict_proba") = false);
+  f.def("apply", &Forest::apply, py::arg("data").noconvert(),
+        py::arg("num_threads") = 1, py::call_guard<py::gil_scoped_release>());
+  f.def("apply_csr", &Forest::apply_csr, py::arg("data").noconvert(),
+        py::arg("num_threads") = 1, py::call_guard<py::gil_scoped_release>());
+  f.def("enable_fast_prediction", &Forest::enable_fast_prediction,
+        py::arg("engine") = "tree");
   f.def("disable_fast_prediction", &Forest::disable_fast_prediction);
+  f.def("relayout", &Forest::relayout,
+        py::arg("layout") = ENodeLayout::SubtreeBlocked,
+        py::arg("bfs_levels") = 4, py::arg("block_depth") = 3);
   FORPY_EXPFUNC(f, Forest, save);
+  f.def("export_cpp", &Forest::export_cpp, py::arg("filename"),
+        py::arg("mode") = ECodegenMode::IfElse, py::arg("name") = "forpy_forest");
   FORPY_DEFAULT_REPR(f, Forest);
 
   FORPY_EXPCLASS_PARENT(ClassificationForest, ct, f);
@@ -113,6 +142,75 @@ void export_forest(py::module &m) {
     return self->set_params(params);
   });
   FORPY_DEFAULT_REPR(rt, RegressionForest);
+
+  FORPY_EXPCLASS_PARENT(ExtraTreesClassifier, etc, f);
+  etc.def(py::init<size_t, uint, uint, uint, uint, bool, uint, size_t, float>(),
+          py::arg("n_trees") = 10,
+          py::arg("max_depth") = std::numeric_limits<uint>::max(),
+          py::arg("min_samples_at_leaf") = 1,
+          py::arg("min_samples_at_node") = 2,
+          py::arg("n_valid_features_to_use") = 0,
+          py::arg("autoscale_valid_features") = true,
+          py::arg("random_seed") = 1,
+          py::arg("n_thresholds") = 1, py::arg("gain_threshold") = 1E-7f);
+  etc.def(py::init<std::string>(), py::arg("filename"));
+  FORPY_DEFAULT_PICKLE(ExtraTreesClassifier, etc);
+  etc.def("get_params", &ExtraTreesClassifier::get_params,
+          py::arg("deep") = false);
+  etc.def("set_params", [](const std::shared_ptr<ExtraTreesClassifier> &self,
+                           py::kwargs kwargs) {
+    std::unordered_map<std::string, mu::variant<uint, size_t, float, bool>>
+        params;
+    if (kwargs) {
+      for (auto item : kwargs) {
+        auto key = std::string(py::str(item.first));
+        if (key == "gain_threshold")
+          params[key] = item.second.cast<py::float_>();
+        else if (key == "autoscale_valid_features")
+          params[key] = static_cast<bool>(item.second.cast<py::bool_>());
+        else
+          params[key] = static_cast<uint>(item.second.cast<py::int_>());
+      }
+    }
+    return self->set_params(params);
+  });
+  FORPY_DEFAULT_REPR(etc, ExtraTreesClassifier);
+
+  FORPY_EXPCLASS_PARENT(ExtraTreesRegressor, etr, f);
+  etr.def(py::init<size_t, uint, uint, uint, uint, bool, uint, size_t, float,
+                   bool, bool>(),
+          py::arg("n_trees") = 10,
+          py::arg("max_depth") = std::numeric_limits<uint>::max(),
+          py::arg("min_samples_at_leaf") = 1,
+          py::arg("min_samples_at_node") = 2,
+          py::arg("n_valid_features_to_use") = 0,
+          py::arg("autoscale_valid_features") = false,
+          py::arg("random_seed") = 1, py::arg("n_thresholds") = 1,
+          py::arg("gain_threshold") = 1E-7f, py::arg("store_variance") = false,
+          py::arg("summarize") = false);
+  etr.def(py::init<std::string>(), py::arg("filename"));
+  FORPY_DEFAULT_PICKLE(ExtraTreesRegressor, etr);
+  etr.def("get_params", &ExtraTreesRegressor::get_params,
+          py::arg("deep") = false);
+  etr.def("set_params", [](const std::shared_ptr<ExtraTreesRegressor> &self,
+                           py::kwargs kwargs) {
+    std::unordered_map<std::string, mu::variant<uint, size_t, float, bool>>
+        params;
+    if (kwargs) {
+      for (auto item : kwargs) {
+        auto key = std::string(py::str(item.first));
+        if (key == "gain_threshold")
+          params[key] = item.second.cast<py::float_>();
+        else if (key == "store_variance" || key == "summarize" ||
+                 key == "autoscale_valid_features")
+          params[key] = static_cast<bool>(item.second.cast<py::bool_>());
+        else
+          params[key] = static_cast<uint>(item.second.cast<py::int_>());
+      }
+    }
+    return self->set_params(params);
+  });
+  FORPY_DEFAULT_REPR(etr, ExtraTreesRegressor);
 };
 
 }  // namespace forpy
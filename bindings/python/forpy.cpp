@@ -19,6 +19,7 @@ PYBIND11_MODULE(forpy, m) {
   export_deciders(m);
   export_tree(m);
   export_forest(m);
+  export_compiled(m);
 
   forpy::init();
 }
@@ -15,4 +15,5 @@ void export_leafs(py::module &m);
 void export_deciders(py::module &m);
 void export_tree(py::module &m);
 void export_forest(py::module &m);
+void export_compiled(py::module &m);
 }  // namespace forpy
@@ -51,9 +51,11 @@ void export_threshold_optimizers(py::module &m) {
         desk.d.node_id = 0;
         desk.d.start_id = 0;
         desk.d.end_id = sample_ids.size();
+        desk.d.bins = dprov->get_feature_bins();
+        desk.d.feat_idx = feature_id;
         self->full_entropy(*dprov, &desk);
         desk.d.best_res_v = SplitOptRes<float>{
-            0, std::numeric_limits<float>::lowest(), 0.f, false};
+            0, std::numeric_limits<float>::lowest(), 0.f, false, {}};
         desk.d.opt_res_v.match([](auto &opt_res) {
           opt_res.gain = 0.f;
           opt_res.valid = false;
@@ -91,5 +93,15 @@ void export_threshold_optimizers(py::module &m) {
   fco.def(py::init<size_t, float>(), py::arg("n_thresholds") = 0,
           py::arg("gain_threshold") = 1E-7f);
   FORPY_DEFAULT_REPR(fco, FastClassOpt);
+
+  FORPY_EXPCLASS_PARENT(ExtraClassOpt, eco, fco);
+  eco.def(py::init<size_t, float>(), py::arg("n_thresholds") = 1,
+          py::arg("gain_threshold") = 1E-7f);
+  FORPY_DEFAULT_REPR(eco, ExtraClassOpt);
+
+  FORPY_EXPCLASS_PARENT(ExtraRegOpt, ero, ro);
+  ero.def(py::init<size_t, float>(), py::arg("n_thresholds") = 1,
+          py::arg("gain_threshold") = 1E-7f);
+  FORPY_DEFAULT_REPR(ero, ExtraRegOpt);
 };
 }  // namespace forpy
@@ -25,6 +25,8 @@ void export_tree(py::module &m) {
   t.def_property_readonly("initialized", &Tree::is_initialized);
   t.def_property_readonly("n_nodes", &Tree::get_n_nodes);
   t.def_property("weight", &Tree::get_weight, &Tree::set_weight);
+  t.def_property("local_copy_samples", &Tree::get_local_copy_samples,
+                 &Tree::set_local_copy_samples);
   t.def_property_readonly("n_samples_stored", &Tree::get_samples_stored);
   FORPY_EXPFUNC(t, Tree, get_input_data_dimensions);
   FORPY_EXPFUNC(t, Tree, get_decider);
@@ -34,12 +36,17 @@ void export_tree(py::module &m) {
         py::arg("annotations").noconvert(), py::arg("n_threads") = 0,
         py::arg("complete_dfs") = true,
         py::arg("weights") = std::vector<float>(),
+        py::arg("search_type") = ESearchType::DFS,
         py::call_guard<py::gil_scoped_release>(),
         py::return_value_policy::reference_internal);
   t.def("fit_dprov", &Tree::fit_dprov, py::arg("data_provider"),
         py::arg("complete_dfs") = true,
+        py::arg("search_type") = ESearchType::DFS,
         py::call_guard<py::gil_scoped_release>(),
         py::return_value_policy::reference_internal);
+  t.def("BFS", &Tree::BFS, py::arg("completion") = ECompletionLevel::Level,
+        py::call_guard<py::gil_scoped_release>());
+  t.def_property_readonly("bfs_depth", &Tree::get_bfs_depth);
   t.def("predict", &Tree::predict, py::arg("data").noconvert(),
         py::arg("num_threads") = 1,
         py::arg("use_fast_prediction_if_available") = true,
@@ -49,9 +56,50 @@ void export_tree(py::module &m) {
         py::arg("num_threads") = 1,
         py::arg("use_fast_prediction_if_available") = true,
         py::call_guard<py::gil_scoped_release>());
+  t.def("predict_sparse", &Tree::predict_sparse, py::arg("data"),
+        py::arg("num_threads") = 1, py::arg("predict_proba") = false,
+        py::call_guard<py::gil_scoped_release>());
+  t.def("predict_one",
+        [](const Tree &self, const Eigen::Ref<const Vec<float>> &features,
+           Eigen::Ref<Vec<float>> out, const bool &predict_proba) {
+          if (static_cast<size_t>(features.rows()) !=
+              self.get_input_data_dimensions())
+            throw ForpyException("Wrong number of features!");
+          if (static_cast<size_t>(out.rows()) <
+              self.get_leaf_manager()->get_result_columns(
+                  1, predict_proba, false))
+            throw ForpyException("The output array is too small!");
+          self.predict_one(features.data(), out.data(), predict_proba);
+        },
+        py::arg("features").noconvert(), py::arg("out").noconvert(),
+        py::arg("predict_proba") = false);
+  t.def("apply", &Tree::apply, py::arg("data").noconvert(),
+        py::arg("num_threads") = 1, py::call_guard<py::gil_scoped_release>());
   FORPY_EXPFUNC(t, Tree, enable_fast_prediction);
   FORPY_EXPFUNC(t, Tree, disable_fast_prediction);
+  t.def("relayout", &Tree::relayout,
+        py::arg("layout") = ENodeLayout::SubtreeBlocked,
+        py::arg("bfs_levels") = 4, py::arg("block_depth") = 3);
+  t.def_property_readonly("layout", &Tree::get_layout);
+  t.def_property_readonly("task_stats", [](const Tree &self) {
+    py::list tasks;
+    for (const auto &stats : self.get_task_stats()) {
+      py::dict task;
+      task["node_id"] = stats.node_id;
+      task["depth"] = stats.depth;
+      task["n_samples"] = stats.n_samples;
+      task["thread_id"] = stats.thread_id;
+      task["n_nodes"] = stats.n_nodes;
+      task["n_spawned"] = stats.n_spawned;
+      task["estimated_s"] = stats.estimated_s;
+      task["actual_s"] = stats.actual_s;
+      tasks.append(task);
+    }
+    return tasks;
+  });
   FORPY_EXPFUNC(t, Tree, save);
+  t.def("export_cpp", &Tree::export_cpp, py::arg("filename"),
+        py::arg("mode") = ECodegenMode::IfElse, py::arg("name") = "forpy_tree");
   FORPY_DEFAULT_REPR(t, Tree);
 
   FORPY_EXPCLASS_PARENT(ClassificationTree, ct, t);
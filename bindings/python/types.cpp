@@ -15,6 +15,20 @@ void export_types(py::module &m) {
       .value("DFS", ESearchType::DFS)
       .value("BFS", ESearchType::BFS);
 
+  py::enum_<EAccessPattern>(m, "EAccessPattern")
+      .value("Normal", EAccessPattern::Normal)
+      .value("Sequential", EAccessPattern::Sequential)
+      .value("Random", EAccessPattern::Random)
+      .value("WillNeed", EAccessPattern::WillNeed);
+
+  py::enum_<ENodeLayout>(m, "ENodeLayout")
+      .value("Training", ENodeLayout::Training)
+      .value("BreadthFirst", ENodeLayout::BreadthFirst)
+      .value("SubtreeBlocked", ENodeLayout::SubtreeBlocked);
+  py::enum_<ECodegenMode>(m, "ECodegenMode")
+      .value("IfElse", ECodegenMode::IfElse)
+      .value("Branchless", ECodegenMode::Branchless);
+
   py::class_<SplitOptRes<float>> sorf(m, "SplitOptRes_f");
   sorf.def_readwrite("split_idx", &SplitOptRes<float>::split_idx)
       .def_readwrite("thresh", &SplitOptRes<float>::thresh)
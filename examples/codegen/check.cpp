@@ -0,0 +1,62 @@
+/* Author: Christoph Lassner. */
+/**
+ * Compares the exported forests with the results of Forest::predict and
+ * reports the single row latency. Only uses the generated headers.
+ */
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+#include "./classification_branchless.h"
+#include "./classification_ifelse.h"
+#include "./reference.h"
+#include "./regression_branchless.h"
+#include "./regression_ifelse.h"
+
+namespace {
+/** Checks all samples and returns the number of mismatches. */
+template <typename RT, typename PF>
+int check(const std::string &name, const RT *expected, const PF &predict,
+          const float &tolerance) {
+  int n_wrong = 0;
+  RT checksum = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < reference::n_samples; ++i) {
+    const RT result = predict(reference::data + i * 6);
+    checksum += result;
+    if (std::abs(static_cast<float>(result) - static_cast<float>(expected[i])) >
+        tolerance * (1.f + std::abs(static_cast<float>(expected[i])))) {
+      if (n_wrong == 0)
+        std::cerr << name << ": sample " << i << " predicted " << result
+                  << ", expected " << expected[i] << std::endl;
+      n_wrong++;
+    }
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << name << ": " << n_wrong << " mismatches, "
+            << std::chrono::duration<double, std::nano>(elapsed).count() /
+                   reference::n_samples
+            << "ns per row (checksum " << checksum << ")." << std::endl;
+  return n_wrong;
+};
+}  // namespace
+
+int main() {
+  static_assert(classification_ifelse::n_features == 6, "Wrong dimension.");
+  int n_wrong = 0;
+  n_wrong += check(
+      "classification_ifelse", reference::classes,
+      [](const float *x) { return classification_ifelse::predict(x); }, 0.f);
+  n_wrong += check(
+      "classification_branchless", reference::classes,
+      [](const float *x) { return classification_branchless::predict(x); },
+      0.f);
+  n_wrong += check(
+      "regression_ifelse", reference::values,
+      [](const float *x) { return regression_ifelse::predict(x); }, 1E-5f);
+  n_wrong += check(
+      "regression_branchless", reference::values,
+      [](const float *x) { return regression_branchless::predict(x); }, 1E-5f);
+  return n_wrong == 0 ? 0 : 1;
+};
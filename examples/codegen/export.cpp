@@ -0,0 +1,95 @@
+/* Author: Christoph Lassner. */
+/**
+ * Trains a classification and a regression forest on synthetic data and
+ * exports them as C++ headers in both code generation modes. Also writes
+ * `reference.h` with test samples and the results of Forest::predict, which
+ * `codegen_check` compares to the generated code.
+ *
+ * Usage: codegen_export OUTPUT_DIRECTORY
+ */
+#include <forpy/codegen.h>
+#include <forpy/forest.h>
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace forpy;
+
+namespace {
+const size_t N_FEATURES = 6;
+const size_t N_TRAIN = 2000;
+const size_t N_TEST = 500;
+
+/** Synthetic samples (one per row) with class and regression targets. */
+void make_data(const size_t &n_samples, const unsigned int &seed,
+               Mat<float> *data, Mat<uint> *classes, Mat<float> *values) {
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> dist(0.f, 1.f);
+  std::normal_distribution<float> noise(0.f, 0.1f);
+  *data = Mat<float>(n_samples, N_FEATURES);
+  *classes = Mat<uint>(n_samples, 1);
+  *values = Mat<float>(n_samples, 1);
+  for (size_t i = 0; i < n_samples; ++i) {
+    for (size_t j = 0; j < N_FEATURES; ++j) (*data)(i, j) = dist(gen);
+    const float score = (*data)(i, 0) + 0.5f * (*data)(i, 1) -
+                        (*data)(i, 2) * (*data)(i, 3) + noise(gen);
+    (*classes)(i, 0) = score < 0.2f ? 0 : (score < 0.7f ? 3 : 7);
+    (*values)(i, 0) = std::sin(6.f * (*data)(i, 4)) + (*data)(i, 5) +
+                      noise(gen);
+  }
+};
+
+template <typename RT>
+void write_array(std::ofstream &out, const std::string &type,
+                 const std::string &name, const Mat<RT> &values) {
+  out << "const " << type << " " << name << "[] = {\n";
+  for (Eigen::Index i = 0; i < values.size(); ++i)
+    out << "    " << cpp_literal(values.data()[i]) << ",\n";
+  out << "};\n";
+};
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " OUTPUT_DIRECTORY" << std::endl;
+    return 1;
+  }
+  const std::string out_dir(argv[1]);
+  Mat<float> train_data, test_data, train_values, test_values;
+  Mat<uint> train_classes, test_classes;
+  make_data(N_TRAIN, 1, &train_data, &train_classes, &train_values);
+  make_data(N_TEST, 2, &test_data, &test_classes, &test_values);
+  // The data providers expect one sample per column.
+  const Mat<float> train_data_t = train_data.transpose();
+
+  ClassificationForest cls_forest(20, 10);
+  cls_forest.fit(MatCRef<float>(train_data_t), MatCRef<uint>(train_classes));
+  RegressionForest reg_forest(20, 10);
+  reg_forest.fit(MatCRef<float>(train_data_t), MatCRef<float>(train_values));
+
+  cls_forest.export_cpp(out_dir + "/classification_ifelse.h",
+                        ECodegenMode::IfElse, "classification_ifelse");
+  cls_forest.export_cpp(out_dir + "/classification_branchless.h",
+                        ECodegenMode::Branchless, "classification_branchless");
+  reg_forest.export_cpp(out_dir + "/regression_ifelse.h", ECodegenMode::IfElse,
+                        "regression_ifelse");
+  reg_forest.export_cpp(out_dir + "/regression_branchless.h",
+                        ECodegenMode::Branchless, "regression_branchless");
+
+  const Data<MatCRef> test_v = MatCRef<float>(test_data);
+  const auto cls_result = cls_forest.predict(test_v);
+  const auto reg_result = reg_forest.predict(test_v);
+  std::ofstream ref(out_dir + "/reference.h");
+  ref << "// Generated by codegen_export. Do not edit.\n"
+      << "#pragma once\n"
+      << "namespace reference {\n"
+      << "const unsigned int n_samples = " << N_TEST << "u;\n";
+  write_array(ref, "float", "data", test_data);
+  write_array(ref, "unsigned int", "classes", cls_result.get<Mat<uint>>());
+  write_array(ref, "float", "values", reg_result.get<Mat<float>>());
+  ref << "}  // namespace reference\n";
+  return 0;
+};
@@ -0,0 +1,228 @@
+/* Author: Christoph Lassner. */
+#pragma once
+#ifndef FORPY_BITVECTORFOREST_H_
+#define FORPY_BITVECTORFOREST_H_
+
+#include "./global.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "./fasttree.h"
+#include "./types.h"
+
+namespace forpy {
+/** \brief The maximum number of leafs of a tree in a \ref BitvectorForest. */
+const size_t BITVECTOR_MAX_LEAFS = 64;
+
+/** \brief Position of the lowest set bit of a non-zero bitvector. */
+inline uint32_t lowest_set_bit(const uint64_t &bitvector) {
+#ifdef _MSC_VER
+  unsigned long pos;
+  _BitScanForward64(&pos, bitvector);
+  return static_cast<uint32_t>(pos);
+#else
+  return static_cast<uint32_t>(__builtin_ctzll(bitvector));
+#endif
+};
+
+/**
+ * \brief Forest evaluation engine in the style of QuickScorer.
+ *
+ * The leafs of every tree are numbered from left to right and every tree
+ * state is a 64 bit vector of leafs that may still be reached. For every
+ * inner node, a mask removes the leafs of the left subtree, which are
+ * unreachable if the node test `x[feature] <= threshold` fails. The nodes
+ * of all trees are grouped by feature and sorted by threshold, so that a
+ * sample is evaluated by scanning the thresholds of each feature up to the
+ * first successful test and applying the masks. The leftmost remaining leaf
+ * of each tree is the exit leaf. No branch depends on the tree structure.
+ *
+ * Trees with more than \ref BITVECTOR_MAX_LEAFS leafs are evaluated with a
+ * \ref FastTree instead.
+ */
+template <typename T>
+class BitvectorForest {
+ public:
+  /**
+   * \param n_features size_t
+   *   The data dimension.
+   */
+  inline explicit BitvectorForest(const size_t &n_features)
+      : n_trees(0),
+        n_features(n_features),
+        feature_offsets(),
+        thresholds(),
+        node_trees(),
+        masks(),
+        bv_tree_ids(),
+        leaf_offsets(1, 0),
+        leaf_ids(),
+        fallback_trees(),
+        building_nodes(){};
+
+  /**
+   * \brief Adds a tree. All trees must be added before calling \ref finalize.
+   *
+   * \param tree The tree structure (pairs of child ids; (0, 0) for leafs).
+   * \param feature_map The feature ids for every node id.
+   * \param threshold_map The thresholds for every node id.
+   */
+  template <typename FM, typename TM>
+  void add_tree(const std::vector<std::pair<id_t, id_t>> &tree,
+                const FM &feature_map, const TM &threshold_map) {
+    const uint32_t tree_idx = static_cast<uint32_t>(n_trees++);
+    // Number the leafs in order, left to right.
+    std::vector<id_t> tree_leafs;
+    std::vector<std::pair<id_t, bool>> stack{{0, false}};
+    while (!stack.empty() && tree_leafs.size() <= BITVECTOR_MAX_LEAFS) {
+      const id_t node_id = stack.back().first;
+      stack.pop_back();
+      if (tree[node_id].first == 0 || tree[node_id].second == 0) {
+        tree_leafs.push_back(node_id);
+      } else {
+        stack.emplace_back(tree[node_id].second, false);
+        stack.emplace_back(tree[node_id].first, false);
+      }
+    }
+    if (tree_leafs.size() > BITVECTOR_MAX_LEAFS) {
+      fallback_trees.emplace_back(
+          tree_idx, FastTree<T>(tree, feature_map, threshold_map));
+      return;
+    }
+    const uint32_t bv_idx = static_cast<uint32_t>(bv_tree_ids.size());
+    bv_tree_ids.push_back(tree_idx);
+    for (const auto &leaf_id : tree_leafs)
+      leaf_ids.push_back(static_cast<uint32_t>(leaf_id));
+    leaf_offsets.push_back(static_cast<uint32_t>(leaf_ids.size()));
+    // Find the leaf range of every subtree by a post-order traversal.
+    std::vector<std::pair<uint32_t, uint32_t>> ranges(tree.size(), {0, 0});
+    uint32_t next_leaf = 0;
+    stack.assign({{0, false}});
+    while (!stack.empty()) {
+      const id_t node_id = stack.back().first;
+      const bool children_done = stack.back().second;
+      stack.pop_back();
+      const auto &children = tree[node_id];
+      if (children.first == 0 || children.second == 0) {
+        ranges[node_id] = {next_leaf, next_leaf + 1};
+        next_leaf++;
+      } else if (!children_done) {
+        stack.emplace_back(node_id, true);
+        stack.emplace_back(children.second, false);
+        stack.emplace_back(children.first, false);
+      } else {
+        ranges[node_id] = {ranges[children.first].first,
+                           ranges[children.second].second};
+        // If the test fails, the left subtree can not be reached.
+        const auto &left_range = ranges[children.first];
+        uint64_t mask = 0;
+        for (uint32_t leaf = left_range.first; leaf < left_range.second;
+             ++leaf)
+          mask |= uint64_t(1) << leaf;
+        building_nodes.emplace_back(
+            static_cast<uint32_t>(feature_map.at(node_id)),
+            threshold_map.at(node_id), bv_idx, ~mask);
+      }
+    }
+  };
+
+  /** \brief Sorts the nodes by feature and threshold. */
+  void finalize() {
+    std::sort(building_nodes.begin(), building_nodes.end(),
+              [](const auto &lhs, const auto &rhs) {
+                return std::get<0>(lhs) < std::get<0>(rhs) ||
+                       (std::get<0>(lhs) == std::get<0>(rhs) &&
+                        std::get<1>(lhs) < std::get<1>(rhs));
+              });
+    feature_offsets.assign(n_features + 1, 0);
+    thresholds.resize(building_nodes.size());
+    node_trees.resize(building_nodes.size());
+    masks.resize(building_nodes.size());
+    for (size_t node_idx = 0; node_idx < building_nodes.size(); ++node_idx) {
+      const auto &node = building_nodes[node_idx];
+      if (std::get<0>(node) >= n_features)
+        throw ForpyException("Invalid feature id in bitvector forest!");
+      feature_offsets[std::get<0>(node) + 1]++;
+      thresholds[node_idx] = std::get<1>(node);
+      node_trees[node_idx] = std::get<2>(node);
+      masks[node_idx] = std::get<3>(node);
+    }
+    for (size_t feat_idx = 0; feat_idx < n_features; ++feat_idx)
+      feature_offsets[feat_idx + 1] += feature_offsets[feat_idx];
+    building_nodes.clear();
+    building_nodes.shrink_to_fit();
+  };
+
+  /**
+   * \brief Get the leaf ids of all trees for one sample.
+   *
+   * \param row Pointer to the contiguous features of the sample.
+   * \param bitvectors Scratch space for \ref get_n_bitvectors elements.
+   * \param tree_leaf_ids Storage for the leaf id of every tree.
+   */
+  template <typename IT>
+  inline void predict_leaf_ids(const IT *row, uint64_t *bitvectors,
+                               id_t *tree_leaf_ids) const {
+    const size_t n_bv = bv_tree_ids.size();
+    std::fill(bitvectors, bitvectors + n_bv, ~uint64_t(0));
+    const T *thresh_p = thresholds.data();
+    for (size_t feat_idx = 0; feat_idx < n_features; ++feat_idx) {
+      const IT &value = row[feat_idx];
+      const size_t first = feature_offsets[feat_idx];
+      size_t last = feature_offsets[feat_idx + 1];
+      // All tests fail up to the first threshold >= value (NaNs fail all).
+      if (value == value)
+        last = static_cast<size_t>(
+            std::lower_bound(
+                thresh_p + first, thresh_p + last, value,
+                [](const T &thresh, const IT &val) { return thresh < val; }) -
+            thresh_p);
+      for (size_t node_idx = first; node_idx < last; ++node_idx)
+        bitvectors[node_trees[node_idx]] &= masks[node_idx];
+    }
+    for (size_t bv_idx = 0; bv_idx < n_bv; ++bv_idx)
+      tree_leaf_ids[bv_tree_ids[bv_idx]] =
+          leaf_ids[leaf_offsets[bv_idx] + lowest_set_bit(bitvectors[bv_idx])];
+    for (const auto &fallback : fallback_trees)
+      tree_leaf_ids[fallback.first] = fallback.second.predict_leaf(row);
+  };
+
+  /** \brief The number of trees. */
+  inline size_t get_n_trees() const { return n_trees; };
+
+  /** \brief The number of bitvectors required for scratch space. */
+  inline size_t get_n_bitvectors() const { return bv_tree_ids.size(); };
+
+  /** \brief The number of trees that are evaluated with a \ref FastTree. */
+  inline size_t get_n_fallback_trees() const { return fallback_trees.size(); };
+
+ private:
+  size_t n_trees;
+  size_t n_features;
+  /** Start of the nodes of each feature in the node arrays. */
+  std::vector<size_t> feature_offsets;
+  std::vector<T> thresholds;
+  std::vector<uint32_t> node_trees;
+  std::vector<uint64_t> masks;
+  /** The forest tree index for every bitvector tree. */
+  std::vector<uint32_t> bv_tree_ids;
+  /** Start of the leafs of each bitvector tree in leaf_ids. */
+  std::vector<uint32_t> leaf_offsets;
+  /** Node ids of the leafs, left to right. */
+  std::vector<uint32_t> leaf_ids;
+  std::vector<std::pair<uint32_t, FastTree<T>>> fallback_trees;
+  std::vector<std::tuple<uint32_t, T, uint32_t, uint64_t>> building_nodes;
+};
+typedef mu::variant<BitvectorForest<float>, BitvectorForest<double>,
+                    BitvectorForest<uint>, BitvectorForest<uint8_t>>
+    BitvectorForestV;
+
+}  // namespace forpy
+#endif  // FORPY_BITVECTORFOREST_H_
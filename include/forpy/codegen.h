@@ -0,0 +1,104 @@
+/* Author: Christoph Lassner. */
+#pragma once
+#ifndef FORPY_CODEGEN_H_
+#define FORPY_CODEGEN_H_
+
+#include "./global.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "./types.h"
+
+namespace forpy {
+class Tree;
+
+/** \brief The C++ type name for a threshold type of exported code. */
+template <typename T>
+inline std::string cpp_type_name();
+template <>
+inline std::string cpp_type_name<float>() {
+  return "float";
+};
+template <>
+inline std::string cpp_type_name<double>() {
+  return "double";
+};
+template <>
+inline std::string cpp_type_name<uint32_t>() {
+  return "unsigned int";
+};
+template <>
+inline std::string cpp_type_name<uint8_t>() {
+  return "unsigned char";
+};
+
+/**
+ * \brief A C++ literal that represents the value exactly.
+ *
+ * Floating point values are written with enough digits to round trip.
+ */
+inline std::string cpp_literal(const float &value) {
+  if (std::isnan(value)) return "std::numeric_limits<float>::quiet_NaN()";
+  if (std::isinf(value))
+    return std::string(value < 0.f ? "-" : "") +
+           "std::numeric_limits<float>::infinity()";
+  std::stringstream ss;
+  ss << std::setprecision(std::numeric_limits<float>::max_digits10) << value;
+  std::string lit = ss.str();
+  if (lit.find_first_of(".e") == std::string::npos) lit += ".";
+  return lit + "f";
+};
+inline std::string cpp_literal(const double &value) {
+  if (std::isnan(value)) return "std::numeric_limits<double>::quiet_NaN()";
+  if (std::isinf(value))
+    return std::string(value < 0. ? "-" : "") +
+           "std::numeric_limits<double>::infinity()";
+  std::stringstream ss;
+  ss << std::setprecision(std::numeric_limits<double>::max_digits10) << value;
+  std::string lit = ss.str();
+  if (lit.find_first_of(".e") == std::string::npos) lit += ".";
+  return lit;
+};
+inline std::string cpp_literal(const uint32_t &value) {
+  return std::to_string(value) + "u";
+};
+inline std::string cpp_literal(const uint8_t &value) {
+  return std::to_string(static_cast<uint32_t>(value)) + "u";
+};
+
+/**
+ * \brief Generates a self-contained C++ header that evaluates the trees.
+ *
+ * The header only depends on the standard library. It defines the namespace
+ * `name` with
+ *
+ *   - `input_t` and `result_t`, the feature and result element types,
+ *   - `n_features` and `n_outputs`,
+ *   - `void predict(const input_t *x, result_t *out)`, writing the
+ *     `n_outputs` result values of one sample, and
+ *   - `result_t predict(const input_t *x)`, returning the first one.
+ *
+ * The results are the same as the ones of Forest::predict for the
+ * respective trees. All trees must use a FastDecider with the same threshold
+ * type, which is used as `input_t`.
+ *
+ * \param trees The trees.
+ * \param weights The tree weights. If empty, every tree has weight 1.
+ * \param mode The code structure.
+ * \param name The namespace of the generated code (a valid identifier).
+ */
+std::string generate_cpp(const std::vector<const Tree *> &trees,
+                         const Vec<float> &weights, const ECodegenMode &mode,
+                         const std::string &name);
+
+}  // namespace forpy
+#endif  // FORPY_CODEGEN_H_
@@ -0,0 +1,229 @@
+/* Author: Christoph Lassner. */
+#pragma once
+#ifndef FORPY_COMPILEDFOREST_H_
+#define FORPY_COMPILEDFOREST_H_
+
+#include "./global.h"
+
+#include <memory>
+#include <vector>
+
+#include "./fasttree.h"
+#include "./leafs/ileaf.h"
+#include "./types.h"
+
+namespace forpy {
+class Forest;
+class Tree;
+
+/**
+ * \brief Immutable compiled tree for concurrent inference.
+ *
+ * Owns the packed nodes of a trained tree (see \ref FastTree) and a dense
+ * table with the accumulator contribution of every leaf, so that prediction
+ * does not touch the decider or the leaf storage of the original tree. All
+ * prediction methods are const and reentrant: any number of threads can
+ * predict with the same object at the same time without locking. The
+ * compiled tree finalizes the results with its own copy of the leaf
+ * manager settings (see ILeaf::create_finalizer), so later changes to the
+ * original tree do not affect it.
+ */
+class CompiledTree {
+ public:
+  /**
+   * \param tree Tree
+   *   A trained tree with a threshold decider.
+   */
+  explicit CompiledTree(const Tree &tree);
+
+  /**
+   * \brief Get the leaf index of a sample.
+   *
+   * The leaf indices are dense and number the leafs in node order.
+   *
+   * \param row Pointer to the contiguous features of the sample.
+   */
+  template <typename IT>
+  inline id_t predict_leaf(const IT *row) const {
+    return nodes.match(
+        [&](const auto &ftree) { return ftree.predict_leaf(row); });
+  };
+
+  /**
+   * \brief Get the leaf indices of several samples.
+   *
+   * \param data Pointer to the first feature of the first sample.
+   * \param stride The number of elements between two samples.
+   * \param n_rows The number of samples.
+   * \param leaf_ids Storage for n_rows leaf indices.
+   */
+  template <typename IT>
+  inline void predict_leaf_ids(const IT *data, const size_t &stride,
+                               const size_t &n_rows, id_t *leaf_ids) const {
+    nodes.match([&](const auto &ftree) {
+      ftree.predict_leaf_ids(data, stride, n_rows, leaf_ids);
+    });
+  };
+
+  /**
+   * \brief Adds the contribution of a leaf to an accumulator row.
+   *
+   * \param leaf_idx The leaf index from \ref predict_leaf.
+   * \param predict_proba Whether the accumulator is for distributions.
+   * \param acc_row The accumulator row (see ILeaf::accumulate_result).
+   */
+  inline void accumulate(const id_t &leaf_idx, const bool &predict_proba,
+                         float *acc_row) const {
+    const LeafTable &table = leaf_tables[predict_proba ? 1 : 0];
+    const size_t width = static_cast<size_t>(table.values.cols());
+    const float *values = table.values.data() + leaf_idx * width;
+    float *target = acc_row + table.offset;
+    for (size_t col = 0; col < width; ++col) target[col] += values[col];
+  };
+
+  /**
+   * \brief Predicts a single sample without allocating memory.
+   *
+   * \param features Pointer to the contiguous features of the sample.
+   * \param out Storage for the result columns of \ref predict (class labels
+   *   are written as float).
+   * \param predict_proba Whether to provide the distribution of results.
+   */
+  template <typename IT>
+  void predict_one(const IT *features, float *out,
+                   const bool &predict_proba = false) const {
+    float *acc = get_thread_scratch<float>(
+        leaf_manager->get_accumulator_columns(1, predict_proba));
+    accumulate(predict_leaf(features), predict_proba, acc);
+    leaf_manager->finalize_one(acc, 1, 1.f, predict_proba, out);
+  };
+
+  /**
+   * \brief Predicts new data points, with the same results as Tree::predict.
+   *
+   * \param data_v Data to predict with one sample per row.
+   * \param predict_proba Whether to provide the distribution of results.
+   */
+  Data<Mat> predict(const Data<MatCRef> &data_v,
+                    const bool &predict_proba = false) const;
+
+  /** \brief The number of features of a sample. */
+  inline size_t get_input_data_dimensions() const { return data_dim; };
+
+  /** \brief The number of leafs. */
+  inline size_t get_n_leafs() const {
+    return static_cast<size_t>(leaf_tables[0].values.rows());
+  };
+
+  /** \brief The number of result columns of \ref predict. */
+  inline size_t get_result_columns(const bool &predict_proba = false) const {
+    return leaf_manager->get_result_columns(1, predict_proba, false);
+  };
+
+  /** \brief The leaf manager that finalizes the results. */
+  inline std::shared_ptr<const ILeaf> get_leaf_manager() const {
+    return leaf_manager;
+  };
+
+  /** \brief The approximate memory used by nodes and leaf tables in bytes. */
+  size_t get_memory_size() const;
+
+ private:
+  friend class CompiledForest;
+  /**
+   * \param tree The trained tree.
+   * \param tree_idx The position of the tree in its forest.
+   * \param n_trees The number of trees of the forest.
+   * \param weight The weight of the tree.
+   */
+  CompiledTree(const Tree &tree, const size_t &tree_idx, const size_t &n_trees,
+               const float &weight);
+
+  /** The accumulator columns [offset, offset + values.cols()) per leaf. */
+  struct LeafTable {
+    size_t offset;
+    Mat<float> values;
+  };
+
+  /** The packed nodes. The leaf table maps positions to leaf indices. */
+  FastTreeV nodes;
+  /** The leaf contributions without and with predict_proba. */
+  LeafTable leaf_tables[2];
+  std::shared_ptr<const ILeaf> leaf_manager;
+  size_t data_dim;
+};
+
+/**
+ * \brief Immutable compiled forest for concurrent inference.
+ *
+ * Consists of one \ref CompiledTree per tree of a trained forest, with the
+ * tree weights applied to the leaf tables. Like the compiled tree, all
+ * prediction methods are const and reentrant, so that many threads can share
+ * one model without locks or copies.
+ */
+class CompiledForest {
+ public:
+  /**
+   * \param forest Forest
+   *   A trained forest with threshold deciders.
+   */
+  explicit CompiledForest(const Forest &forest);
+
+  /**
+   * \brief Predicts a single sample without allocating memory.
+   *
+   * \param features Pointer to the contiguous features of the sample.
+   * \param out Storage for the result columns of \ref predict (class labels
+   *   are written as float).
+   * \param predict_proba Whether to provide the distribution of results.
+   */
+  template <typename IT>
+  void predict_one(const IT *features, float *out,
+                   const bool &predict_proba = false) const {
+    float *acc = get_thread_scratch<float>(
+        leaf_manager->get_accumulator_columns(trees.size(), predict_proba));
+    for (const auto &tree : trees)
+      tree.accumulate(tree.predict_leaf(features), predict_proba, acc);
+    leaf_manager->finalize_one(acc, trees.size(), weight_sum, predict_proba,
+                               out);
+  };
+
+  /**
+   * \brief Predicts new data points, with the same results as
+   * Forest::predict.
+   *
+   * \param data_v Data to predict with one sample per row.
+   * \param predict_proba Whether to provide the distribution of results.
+   */
+  Data<Mat> predict(const Data<MatCRef> &data_v,
+                    const bool &predict_proba = false) const;
+
+  /** \brief The number of trees. */
+  inline size_t get_n_trees() const { return trees.size(); };
+
+  /** \brief The compiled trees (with the tree weights applied). */
+  inline const std::vector<CompiledTree> &get_trees() const { return trees; };
+
+  /** \brief The number of features of a sample. */
+  inline size_t get_input_data_dimensions() const {
+    return trees[0].get_input_data_dimensions();
+  };
+
+  /** \brief The number of result columns of \ref predict. */
+  inline size_t get_result_columns(const bool &predict_proba = false) const {
+    return leaf_manager->get_result_columns(trees.size(), predict_proba,
+                                            false);
+  };
+
+  /** \brief The approximate memory used by nodes and leaf tables in bytes. */
+  size_t get_memory_size() const;
+
+ private:
+  std::vector<CompiledTree> trees;
+  Vec<float> weights;
+  float weight_sum;
+  std::shared_ptr<const ILeaf> leaf_manager;
+};
+
+}  // namespace forpy
+#endif  // FORPY_COMPILEDFOREST_H_
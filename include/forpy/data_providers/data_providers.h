@@ -1,2 +1,8 @@
 #include "./fastdprov.h"
+#include "./featurebins.h"
 #include "./idataprovider.h"
+#ifndef _WIN32
+#include "./mmapdprov.h"
+#endif
+#include "./sparsedprov.h"
+#include "./sparsemat.h"
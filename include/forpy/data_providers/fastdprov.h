@@ -28,9 +28,15 @@ class FastDProv : public IDataProvider {
    *    n_annots).
    * \param weights_store
    *    Storage for sample weights. If nullptr, weights are ignored.
+   * \param n_bins
+   *    If > 0, every feature is quantized into at most n_bins (<= 256) bins
+   *    and the threshold optimizers find the splits on histograms instead of
+   *    sorting the samples of every node (see \ref FeatureBins). The
+   *    thresholds are then restricted to the bin edges.
    */
   FastDProv(const DataStore<Mat> &data, const DataStore<Mat> &annotations,
-            const std::shared_ptr<std::vector<float> const> &weights_store);
+            const std::shared_ptr<std::vector<float> const> &weights_store,
+            const size_t &n_bins = 0);
 
   /**
    * \brief Non-ownership requiring constructor.
@@ -44,9 +50,24 @@ class FastDProv : public IDataProvider {
    *    n_annots).
    * \param weights_store Vector with shape (n_samples) with positive weights
    *    for each sample.
+   * \param n_bins If > 0, use histogram split optimization with at most
+   *    n_bins bins per feature.
+   */
+  FastDProv(const Data<MatCRef> &data, const Data<MatCRef> &annotations,
+            const std::shared_ptr<std::vector<float> const> &weights_store,
+            const size_t &n_bins = 0);
+
+  /**
+   * \brief Non-ownership requiring constructor with quantized features.
+   *
+   * Used for node-local copies of the data (see
+   * Tree::set_local_copy_samples).
+   *
+   * \param bins The quantized features of exactly these samples or nullptr.
    */
   FastDProv(const Data<MatCRef> &data, const Data<MatCRef> &annotations,
-            const std::shared_ptr<std::vector<float> const> &weights_store);
+            const std::shared_ptr<std::vector<float> const> &weights_store,
+            const std::shared_ptr<const FeatureBins> &bins);
 
   //@{
   /// forpy::IDataProvider function implementation.
@@ -68,6 +89,8 @@ class FastDProv : public IDataProvider {
     return weights_store;
   }
 
+  inline const FeatureBins *get_feature_bins() const { return bins.get(); };
+
   std::vector<std::shared_ptr<IDataProvider>> create_tree_providers(
       usage_map_t &usage_map);
   //@}
@@ -92,7 +115,8 @@ class FastDProv : public IDataProvider {
    */
   FastDProv(const Data<MatCRef> &data, const Data<MatCRef> &annotations,
             const std::shared_ptr<std::vector<float> const> &weights_store,
-            std::shared_ptr<std::vector<id_t>> &training_ids);
+            std::shared_ptr<std::vector<id_t>> &training_ids,
+            const std::shared_ptr<const FeatureBins> &bins);
 
   /** \brief Perform all necessary checks before constructing an instance. */
   void checks(const Data<MatCRef> &data,
@@ -115,6 +139,8 @@ class FastDProv : public IDataProvider {
   Data<MatCRef> annotations;
   /// Weight storage.
   std::shared_ptr<std::vector<float> const> weights_store;
+  /// The quantized features for histogram split optimization (optional).
+  std::shared_ptr<const FeatureBins> bins;
   /// A vector of the annotation indices that should be used out of the full
   /// data.
   std::shared_ptr<std::vector<id_t>> training_ids;
@@ -0,0 +1,104 @@
+/* Author: Christoph Lassner. */
+#pragma once
+#ifndef FORPY_DATA_PROVIDERS_FEATUREBINS_H_
+#define FORPY_DATA_PROVIDERS_FEATUREBINS_H_
+
+#include "../global.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "../types.h"
+
+namespace forpy {
+/** \brief The maximum number of histogram bins per feature. */
+const size_t FEATURE_BINS_MAX = 256;
+
+/**
+ * \brief The maximum number of samples used to determine the bin edges.
+ *
+ * For larger datasets, the quantiles are estimated from evenly spaced
+ * samples. All samples are binned.
+ */
+const size_t FEATURE_BINS_EDGE_SAMPLES = 1 << 18;
+
+/**
+ * \brief Nodes with fewer samples per bin are optimized exactly.
+ *
+ * Sorting a few samples is cheaper than building and scanning a histogram.
+ */
+const size_t FEATURE_BINS_MIN_SAMPLES_PER_BIN = 4;
+
+/**
+ * \brief Marks the samples that are skipped when the histograms of many
+ * nodes are filled in one pass (see IThreshOpt::fill_histograms).
+ */
+const uint32_t FEATURE_BINS_NO_SLOT = std::numeric_limits<uint32_t>::max();
+
+/**
+ * \brief Quantized features for histogram based split optimization.
+ *
+ * Every feature is quantized into at most \ref FEATURE_BINS_MAX bins with
+ * (approximately) equal sample counts. The bin edges are feature values, and
+ * bin `b` contains the values `edge[b - 1] < x <= edge[b]`, so that the split
+ * `x <= edge[b]` sends exactly the bins `<= b` to the left.
+ *
+ * \ingroup forpydata_providersGroup
+ */
+class FeatureBins {
+ public:
+  /**
+   * \param data Data with one feature per row and one sample per column, as
+   *   used by the data providers.
+   * \param n_bins size_t in [2, 256]
+   *   The maximum number of bins per feature.
+   */
+  FeatureBins(const Data<MatCRef> &data, const size_t &n_bins);
+
+  /** \brief Empty bins, see \ref assign_subset. */
+  inline FeatureBins() : n_samples(0), max_bins(0){};
+
+  /**
+   * \brief Take over the edges of other bins and the codes of some of their
+   * samples, in the given order (see Tree::set_local_copy_samples).
+   */
+  void assign_subset(const FeatureBins &other, const id_t *ids,
+                     const size_t &n);
+
+  /** \brief The bin codes of one feature for all samples. */
+  inline const uint8_t *get_codes(const size_t &feat_idx) const {
+    return &codes[feat_idx * n_samples];
+  };
+
+  /** \brief The number of bins of a feature. */
+  inline size_t get_n_bins(const size_t &feat_idx) const {
+    return edges[feat_idx].size() + 1;
+  };
+
+  /** \brief The upper edge of a bin (all but the last bin have one). */
+  inline double get_edge(const size_t &feat_idx, const size_t &bin) const {
+    return edges[feat_idx][bin];
+  };
+
+  /** \brief Whether to optimize a node of this size with a histogram. */
+  inline bool use_histogram(const size_t &feat_idx,
+                            const size_t &n_samples) const {
+    return n_samples >= FEATURE_BINS_MIN_SAMPLES_PER_BIN * get_n_bins(feat_idx);
+  };
+
+  /** \brief The maximum number of bins per feature. */
+  inline size_t get_max_bins() const { return max_bins; };
+
+  /** \brief The number of samples (columns) of the quantized data. */
+  inline size_t get_n_samples() const { return n_samples; };
+
+ private:
+  size_t n_samples;
+  size_t max_bins;
+  /** The codes, feature by feature. */
+  std::vector<uint8_t> codes;
+  std::vector<std::vector<double>> edges;
+};
+}  // namespace forpy
+#endif  // FORPY_DATA_PROVIDERS_FEATUREBINS_H_
@@ -11,6 +11,8 @@
 
 #include "../types.h"
 #include "../util/storage.h"
+#include "./featurebins.h"
+#include "./sparsemat.h"
 
 namespace forpy {
 
@@ -71,6 +73,22 @@ class IDataProvider {
   virtual std::shared_ptr<const std::vector<float>> get_weights() const
       VIRTUAL_PTR;
 
+  /**
+   * \brief Get the quantized features for histogram split optimization.
+   *
+   * Can be a nullptr, in that case the thresholds are optimized exactly.
+   */
+  virtual const FeatureBins *get_feature_bins() const { return nullptr; };
+
+  /**
+   * \brief Get the features as a CSC matrix (one slice per feature).
+   *
+   * Can be a nullptr, in that case the features are dense and available
+   * through \ref get_feature. Otherwise, \ref get_feature is not available
+   * and the threshold optimizers only visit the nonzero values.
+   */
+  virtual const SparseMat *get_sparse_features() const { return nullptr; };
+
   /**
    * \brief Get the feature vector dimension.
    */
@@ -0,0 +1,162 @@
+/* Author: Christoph Lassner. */
+#pragma once
+#ifndef FORPY_DATA_PROVIDERS_MMAPDPROV_H_
+#define FORPY_DATA_PROVIDERS_MMAPDPROV_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "../global.h"
+#include "../types.h"
+#include "../util/checks.h"
+#include "../util/mmap.h"
+#include "./idataprovider.h"
+
+namespace forpy {
+/**
+ * \brief Use memory mapped data from a file throughout the training.
+ *
+ * The features are read from a feature-major `.npy` or raw binary file, so
+ * that every feature is contiguous in the file. They are not loaded or
+ * copied: the features are views on the mapping and the operating system
+ * pages them in on access. This allows to start training immediately and to
+ * train on data that is larger than the main memory. The annotations and
+ * weights are kept in memory.
+ *
+ * Like \ref MappedFile, it is only available on POSIX systems and is left
+ * out of Windows builds.
+ *
+ * \ingroup forpydata_providersGroup
+ */
+class MMapDProv : public IDataProvider {
+ public:
+  /**
+   * \brief Maps a `.npy` file.
+   *
+   * It's your job to keep the annotations alive as long as this object
+   * exists.
+   *
+   * \param filename The `.npy` file with float32, float64, uint32 or uint8
+   *    values. A C-ordered array must have the shape (n_features x
+   *    n_samples), a Fortran-ordered one (n_samples x n_features). A
+   *    one-dimensional array is used as a single feature.
+   * \param annotations Matrix in row major order with shape (n_samples x
+   *    n_annots).
+   * \param weights_store Vector with shape (n_samples) with positive weights
+   *    for each sample. If nullptr, weights are ignored.
+   * \param n_bins If > 0, use histogram split optimization with at most
+   *    n_bins bins per feature (see \ref FeatureBins).
+   */
+  MMapDProv(const std::string &filename, const Data<MatCRef> &annotations,
+            const std::shared_ptr<std::vector<float> const> &weights_store,
+            const size_t &n_bins = 0);
+
+  /**
+   * \brief Maps a raw binary file.
+   *
+   * \param filename The file with the values of one feature after the other.
+   * \param dtype The value type: "float32", "float64", "uint32" or "uint8".
+   *    The values must be stored in the byte order of this machine.
+   * \param n_features The number of features. The number of samples is
+   *    determined from the file size.
+   * \param offset The number of bytes to skip at the beginning of the file.
+   *    Must be a multiple of the value size.
+   */
+  MMapDProv(const std::string &filename, const std::string &dtype,
+            const size_t &n_features, const Data<MatCRef> &annotations,
+            const std::shared_ptr<std::vector<float> const> &weights_store,
+            const size_t &n_bins = 0, const size_t &offset = 0);
+
+  /**
+   * \brief Tells the operating system how the features will be accessed.
+   *
+   * The histograms are built with sequential passes. The training sorts the
+   * features of large nodes with mostly sequential reads, while small nodes
+   * deep in the trees access random samples. EAccessPattern::WillNeed starts
+   * loading the file in the background, which is useful if it fits into the
+   * main memory.
+   *
+   * \param pattern The access pattern.
+   * \param feat_idx The feature to advise for, or all features if negative.
+   */
+  void advise(const EAccessPattern &pattern, const int &feat_idx = -1) const;
+
+  /** \brief The name of the mapped file. */
+  inline const std::string &get_filename() const {
+    return file->get_filename();
+  };
+
+  //@{
+  /// forpy::IDataProvider function implementation.
+  inline std::vector<id_t> &get_initial_sample_list() { return *training_ids; };
+
+  inline size_t get_n_samples() const { return training_ids->size(); };
+
+  Data<VecCMap> get_feature(const size_t & /*feat_idx*/) const;
+
+  inline Data<MatCRef> get_annotations() const { return annotations; };
+
+  inline void set_annotations(const DataStore<Mat> &new_annotation_store) {
+    annotation_store = new_annotation_store;
+    annotation_store.match(
+        [&](const auto &new_annotations) { annotations = *new_annotations; });
+  };
+
+  inline std::shared_ptr<const std::vector<float>> get_weights() const {
+    return weights_store;
+  }
+
+  inline const FeatureBins *get_feature_bins() const { return bins.get(); };
+
+  std::vector<std::shared_ptr<IDataProvider>> create_tree_providers(
+      usage_map_t &usage_map);
+  //@}
+
+  inline friend std::ostream &operator<<(std::ostream &stream,
+                                         const MMapDProv &self) {
+    stream << "forpy::MMapDProv[`" << self.get_filename() << "`, "
+           << self.get_n_samples() << " samples, " << self.get_feat_vec_dim()
+           << " -> " << self.get_annot_vec_dim() << "]";
+    return stream;
+  };
+  bool operator==(const IDataProvider &rhs) const;
+
+ private:
+  /**
+   * \brief Constructor for creating a 'proxy' data provider for trees.
+   *
+   * This shares the mapping of an existing data provider.
+   */
+  MMapDProv(const std::shared_ptr<const MappedFile> &file,
+            const Data<MatCRef> &data, const Data<MatCRef> &annotations,
+            const std::shared_ptr<std::vector<float> const> &weights_store,
+            std::shared_ptr<std::vector<id_t>> &training_ids,
+            const std::shared_ptr<const FeatureBins> &bins);
+
+  /**
+   * \brief Creates the views on the mapped values, checks the annotations
+   * and weights and builds the bins.
+   */
+  void init_from_file(const std::string &dtype, const size_t &n_features,
+                      const size_t &offset, const size_t &n_bins);
+
+  using IDataProvider::annot_vec_dim;
+  using IDataProvider::feat_vec_dim;
+  /// The mapping of the feature file, shared with the tree providers.
+  std::shared_ptr<const MappedFile> file;
+  /// Annotation storage, if the annotations have been replaced.
+  DataStore<Mat> annotation_store;
+  /// A view on the mapped features.
+  Data<MatCRef> data;
+  /// A reference to the annotations.
+  Data<MatCRef> annotations;
+  /// Weight storage.
+  std::shared_ptr<std::vector<float> const> weights_store;
+  /// The quantized features for histogram split optimization (optional).
+  std::shared_ptr<const FeatureBins> bins;
+  /// A vector of the annotation indices that should be used out of the full
+  /// data.
+  std::shared_ptr<std::vector<id_t>> training_ids;
+};
+}  // namespace forpy
+#endif  // FORPY_DATA_PROVIDERS_MMAPDPROV_H_
@@ -0,0 +1,104 @@
+/* Author: Christoph Lassner. */
+#pragma once
+#ifndef FORPY_DATA_PROVIDERS_SPARSEDPROV_H_
+#define FORPY_DATA_PROVIDERS_SPARSEDPROV_H_
+
+#include <memory>
+#include <vector>
+#include "../global.h"
+#include "../types.h"
+#include "../util/checks.h"
+#include "./idataprovider.h"
+#include "./sparsemat.h"
+
+namespace forpy {
+/**
+ * \brief Use sparse features in CSC format throughout the training.
+ *
+ * The features are never expanded: for every node and feature, only the
+ * nonzero values of the node samples are sorted, and all implicit zeros are
+ * handled as one block (see FastClassOpt). This makes the cost of a node
+ * proportional to its nonzeros instead of its samples. The features
+ * are float values and the trees should be used with float data or
+ * Tree::predict_sparse.
+ *
+ * Requires a threshold optimizer with a sparse mode (see
+ * IThreshOpt::supports_sparse).
+ *
+ * \ingroup forpydata_providersGroup
+ */
+class SparseDProv : public IDataProvider {
+ public:
+  /**
+   * \param features The features in CSC format with shape (n_samples x
+   *   n_features), i.e., one slice per feature. Shared with the tree providers.
+   * \param annotations Matrix in row major order with shape (n_samples x
+   *   n_annots). It's your job to keep them alive as long as this object
+   *   exists.
+   * \param weights_store Vector with shape (n_samples) with positive weights
+   *   for each sample. If nullptr, weights are ignored.
+   */
+  SparseDProv(const std::shared_ptr<const SparseMat> &features,
+              const Data<MatCRef> &annotations,
+              const std::shared_ptr<std::vector<float> const> &weights_store);
+
+  //@{
+  /// forpy::IDataProvider function implementation.
+  inline std::vector<id_t> &get_initial_sample_list() { return *training_ids; };
+
+  inline size_t get_n_samples() const { return training_ids->size(); };
+
+  inline Data<MatCRef> get_annotations() const { return annotations; };
+
+  inline void set_annotations(const DataStore<Mat> &new_annotation_store) {
+    annotation_store = new_annotation_store;
+    annotation_store.match(
+        [&](const auto &new_annotations) { annotations = *new_annotations; });
+  };
+
+  inline std::shared_ptr<const std::vector<float>> get_weights() const {
+    return weights_store;
+  }
+
+  inline const SparseMat *get_sparse_features() const {
+    return features.get();
+  };
+
+  std::vector<std::shared_ptr<IDataProvider>> create_tree_providers(
+      usage_map_t &usage_map);
+  //@}
+
+  inline friend std::ostream &operator<<(std::ostream &stream,
+                                         const SparseDProv &self) {
+    stream << "forpy::SparseDProv[" << self.get_n_samples() << " samples, "
+           << self.get_feat_vec_dim() << " -> " << self.get_annot_vec_dim()
+           << ", " << self.features->get_nnz() << " nonzeros]";
+    return stream;
+  };
+  bool operator==(const IDataProvider &rhs) const;
+
+ private:
+  /**
+   * \brief Constructor for creating a 'proxy' data provider for trees.
+   */
+  SparseDProv(const std::shared_ptr<const SparseMat> &features,
+              const Data<MatCRef> &annotations,
+              const std::shared_ptr<std::vector<float> const> &weights_store,
+              std::shared_ptr<std::vector<id_t>> &training_ids);
+
+  using IDataProvider::annot_vec_dim;
+  using IDataProvider::feat_vec_dim;
+  /// The CSC features, shared with the tree providers.
+  std::shared_ptr<const SparseMat> features;
+  /// Annotation storage, if the annotations have been replaced.
+  DataStore<Mat> annotation_store;
+  /// A reference to the annotations.
+  Data<MatCRef> annotations;
+  /// Weight storage.
+  std::shared_ptr<std::vector<float> const> weights_store;
+  /// A vector of the annotation indices that should be used out of the full
+  /// data.
+  std::shared_ptr<std::vector<id_t>> training_ids;
+};
+}  // namespace forpy
+#endif  // FORPY_DATA_PROVIDERS_SPARSEDPROV_H_
@@ -0,0 +1,142 @@
+/* Author: Christoph Lassner. */
+#pragma once
+#ifndef FORPY_DATA_PROVIDERS_SPARSEMAT_H_
+#define FORPY_DATA_PROVIDERS_SPARSEMAT_H_
+
+#include "../global.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../types.h"
+
+namespace forpy {
+/**
+ * \brief The maximum number of values of the dense blocks that sparse
+ * matrices are expanded to for prediction (64MB).
+ */
+const size_t SPARSE_PREDICT_MAX_VALUES = 1 << 24;
+
+/**
+ * \brief A compressed sparse matrix with float values.
+ *
+ * The matrix is stored slice by slice: the values of the outer slice `o` are
+ * `values[indptr[o]:indptr[o + 1]]` and their inner indices are stored at the
+ * same positions in `indices`. This is the CSC format (one slice per column)
+ * if the outer dimension are the features and the CSR format (one slice per
+ * row) if it are the samples, exactly as the `indptr`, `indices` and `data`
+ * arrays of `scipy.sparse.csc_matrix` and `csr_matrix`. The inner indices of
+ * every slice are sorted during construction.
+ *
+ * \ingroup forpydata_providersGroup
+ */
+class SparseMat {
+ public:
+  /**
+   * \param indptr The n_outer + 1 slice offsets.
+   * \param indices The inner index of every value.
+   * \param values The stored values.
+   * \param n_inner The inner dimension.
+   */
+  SparseMat(std::vector<size_t> indptr, std::vector<id_t> indices,
+            std::vector<float> values, const size_t &n_inner);
+
+  /** \brief Builds the same matrix in the other format (CSC <-> CSR). */
+  SparseMat transpose() const;
+
+  inline size_t get_n_outer() const { return indptr.size() - 1; };
+  inline size_t get_n_inner() const { return n_inner; };
+  inline size_t get_nnz() const { return values.size(); };
+  inline const std::vector<size_t> &get_indptr() const { return indptr; };
+  inline const std::vector<id_t> &get_indices() const { return indices; };
+  inline const std::vector<float> &get_values() const { return values; };
+
+  /**
+   * \brief Calls `f(value, inner_idx)` for the values of an outer slice whose
+   * inner index is one of `ids`, in the order of the slice.
+   *
+   * Either scans the slice and tests `marks[inner_idx] == mark`, or searches
+   * every id in the slice, whichever is cheaper. The ids must be marked
+   * accordingly (see DeciderDesk::mark_sparse_samples).
+   */
+  template <typename F>
+  inline void for_each_marked(const size_t &outer, const id_t *ids,
+                              const size_t &n_ids, const uint32_t *marks,
+                              const uint32_t &mark, const F &f) const {
+    const size_t begin = indptr[outer], end = indptr[outer + 1];
+    const size_t nnz = end - begin;
+    if (nnz == 0) return;
+    const id_t *idx_p = &indices[begin];
+    const float *val_p = &values[begin];
+    if (static_cast<double>(n_ids) *
+            std::ceil(std::log2(static_cast<double>(nnz) + 1.)) <
+        static_cast<double>(nnz)) {
+      for (size_t i = 0; i < n_ids; ++i) {
+        const id_t *found = std::lower_bound(idx_p, idx_p + nnz, ids[i]);
+        if (found != idx_p + nnz && *found == ids[i])
+          f(val_p[found - idx_p], ids[i]);
+      }
+    } else {
+      for (size_t k = 0; k < nnz; ++k)
+        if (marks[idx_p[k]] == mark) f(val_p[k], idx_p[k]);
+    }
+  };
+
+  /**
+   * \brief Writes the outer slices [start, end) as dense rows with n_inner
+   * values each to a zeroed row-major buffer.
+   */
+  void scatter_rows(const size_t &start, const size_t &end, float *out) const;
+
+  bool operator==(const SparseMat &rhs) const;
+
+  inline friend std::ostream &operator<<(std::ostream &stream,
+                                         const SparseMat &self) {
+    stream << "forpy::SparseMat[" << self.get_n_outer() << " x "
+           << self.get_n_inner() << ", " << self.get_nnz() << " values]";
+    return stream;
+  };
+
+ private:
+  std::vector<size_t> indptr;
+  std::vector<id_t> indices;
+  std::vector<float> values;
+  size_t n_inner;
+};
+
+/**
+ * \brief Predicts the rows of a CSR matrix by expanding blocks of at most
+ * \ref SPARSE_PREDICT_MAX_VALUES values and predicting them densely.
+ *
+ * \param predict Returns the dense prediction result for a block.
+ */
+template <typename F>
+Data<Mat> predict_sparse_rows(const SparseMat &csr, const F &predict) {
+  const size_t n_rows = csr.get_n_outer(), n_cols = csr.get_n_inner();
+  if (n_rows == 0 || n_cols == 0)
+    throw ForpyException("Tried to predict an empty sparse matrix!");
+  const size_t block_rows =
+      std::max<size_t>(1, SPARSE_PREDICT_MAX_VALUES / n_cols);
+  Mat<float> block(std::min(block_rows, n_rows), n_cols);
+  Data<Mat> result_v;
+  for (size_t start = 0; start < n_rows; start += block_rows) {
+    const size_t end = std::min(n_rows, start + block_rows);
+    block.setZero();
+    csr.scatter_rows(start, end, block.data());
+    const Data<Mat> block_res_v = predict(
+        Data<MatCRef>(MatCRef<float>(block.topRows(end - start))));
+    block_res_v.match(
+        [&](const auto &block_res) {
+          typedef typename get_core<decltype(block_res.data())>::type RT;
+          if (start == 0) result_v.set<Mat<RT>>(n_rows, block_res.cols());
+          result_v.get_unchecked<Mat<RT>>().middleRows(start, end - start) =
+              block_res;
+        },
+        [](const Empty &) { throw EmptyException(); });
+  }
+  return result_v;
+};
+}  // namespace forpy
+#endif  // FORPY_DATA_PROVIDERS_SPARSEMAT_H_
@@ -26,6 +26,12 @@ const size_t LOG_FD_NID = 12043;
 const bool LOG_FD_ALLN = true;
 #pragma clang diagnostic pop
 
+/**
+ * \brief The minimum number of samples times candidate features of a node to
+ * evaluate its features on multiple threads.
+ */
+const size_t FASTDECIDER_PARALLEL_MIN_WORK = 1 << 20;
+
 /**
  * \brief A classifier manager for weak classifiers with a filter function,
  * a feature calculation function and a thresholding.
@@ -60,10 +66,30 @@ class FastDecider : public IDecider {
    * \param autoscale_valid_features bool
    *   If set to true, automatically scale to sqrt(number of features) of the
    *   input data.
+   * \param presort bool
+   *   If set to true, every feature is sorted once at the root and the
+   *   sorted sample lists are partitioned stably at every split (SLIQ), so
+   *   that the threshold optimizers never sort. This trades memory for
+   *   speed: during training, the lists take n_features * n_samples *
+   *   sizeof(id_t) bytes per tree in addition to one byte per sample.
+   *   Default: false.
+   * \param subsample_min_samples size_t
+   *   If > 0, nodes with at least this many samples rank the candidate
+   *   features on a random subsample of `subsample_size` of their samples.
+   *   Only the threshold of the best feature is then optimized on all
+   *   samples of the node, which also sorts them for the partition. Not used
+   *   with presorting, histograms or sparse data. Default: 0.
+   * \param subsample_size size_t>0
+   *   The number of samples used to rank the features of large nodes. Larger
+   *   subsamples choose the feature more reliably, smaller ones are faster.
+   *   Default: 10000.
    */
   FastDecider(const std::shared_ptr<IThreshOpt> &threshold_optimizer = nullptr,
               const size_t &n_valid_features_to_use = 0,
-              const bool &autoscale_valid_features = false);
+              const bool &autoscale_valid_features = false,
+              const bool &presort = false,
+              const size_t &subsample_min_samples = 0,
+              const size_t &subsample_size = 10000);
 
   virtual std::shared_ptr<IDecider> create_duplicate(
       const uint &random_seed) const {
@@ -72,7 +98,8 @@ class FastDecider : public IDecider {
         n_valids_to_use != data_dim && !autoscale_valid_features
             ? n_valids_to_use
             : 0,
-        autoscale_valid_features);
+        autoscale_valid_features, presort, subsample_min_samples,
+        subsample_size);
   }
 
   inline bool is_compatible_with(const IDataProvider &dprov) {
@@ -93,6 +120,14 @@ class FastDecider : public IDecider {
 
     if (dprov.get_feat_vec_dim() != data_dim)
       throw ForpyException("Incompatible data provider detected!");
+    if (dprov.get_sparse_features() != nullptr) {
+      if (presort)
+        throw ForpyException("Presorting is not supported for sparse data!");
+      if (!threshold_optimizer->supports_sparse())
+        throw ForpyException(
+            "The threshold optimizer does not support sparse data! Use a "
+            "FastClassOpt with n_thresholds=0.");
+    }
     return true;
   }
 
@@ -115,7 +150,18 @@ class FastDecider : public IDecider {
     node_to_thresh_v.match([&n_samples](auto &vec) { vec.resize(n_samples); });
   };
 
-  inline void finalize_capacity(const size_t &size) { ensure_capacity(size); };
+  inline void finalize_capacity(const size_t &size) {
+    ensure_capacity(size);
+    // The sorted sample lists are only needed during training.
+    std::vector<std::vector<id_t>>().swap(presorted_ids);
+    std::vector<uint8_t>().swap(goes_left);
+  };
+
+  inline void permute_nodes(const std::vector<id_t> &new_ids) {
+    permute_ids(&node_to_featsel, new_ids);
+    node_to_thresh_v.match(
+        [&new_ids](auto &vec) { permute_ids(&vec, new_ids); });
+  };
 
   void make_node(const TodoMark &todo_info, const uint &min_samples_at_leaf,
                  const IDataProvider &data_provider, Desk *d) const;
@@ -132,10 +178,31 @@ class FastDecider : public IDecider {
 
   bool operator==(const IDecider &rhs) const;
 
+  NodeWork estimate_work(const size_t &n_samples,
+                         const IDataProvider &dprov) const;
+
+  inline bool evaluates_all_features() const {
+    return n_valids_to_use == data_dim;
+  };
+
+  /** The presorted sample lists hold the ids of all samples. */
+  inline bool uses_global_sample_ids() const { return presort; };
+
+  /** \brief Whether the sorted sample lists are reused through the tree. */
+  inline bool get_presort() const { return presort; };
+
+  /** \brief The minimum node size for ranking features on a subsample. */
+  inline size_t get_subsample_min_samples() const {
+    return subsample_min_samples;
+  };
+
+  /** \brief The number of samples used to rank the features. */
+  inline size_t get_subsample_size() const { return subsample_size; };
+
   inline friend std::ostream &operator<<(std::ostream &stream,
                                          const FastDecider &self) {
     stream << "forpy::FastDecider[" << self.node_to_featsel.size()
-           << " stored]";
+           << " stored" << (self.presort ? ", presorted" : "") << "]";
     return stream;
   };
   std::pair<const std::vector<size_t> *,
@@ -146,11 +213,14 @@ class FastDecider : public IDecider {
  private:
   friend class cereal::access;
   template <class Archive>
-  void serialize(Archive &ar, const uint &) {
+  void serialize(Archive &ar, const uint &version) {
     ar(cereal::make_nvp("base", cereal::base_class<IDecider>(this)),
        CEREAL_NVP(threshold_optimizer), CEREAL_NVP(n_valids_to_use),
        CEREAL_NVP(autoscale_valid_features), CEREAL_NVP(node_to_featsel),
        CEREAL_NVP(node_to_thresh_v), CEREAL_NVP(data_dim));
+    if (version > 0) ar(CEREAL_NVP(presort));
+    if (version > 1)
+      ar(CEREAL_NVP(subsample_min_samples), CEREAL_NVP(subsample_size));
   }
 
   ///////// Utility functions.
@@ -160,8 +230,41 @@ class FastDecider : public IDecider {
 
   void _make_node__opt(const IDataProvider &dprov, Desk *d) const;
 
+  /**
+   * Moves a random subsample of a large node to the front of its samples and
+   * restricts the desk to it. Returns whether the node is subsampled.
+   */
+  bool _make_node__subsample(Desk *d) const;
+
   void _make_node__postprocess(const IDataProvider &dprov, Desk *d) const;
 
+  /** Sorts the samples of the root by every feature. */
+  void _make_node__presort(const IDataProvider &dprov, Desk *d) const;
+
+  /** Stably partitions the sorted lists of a split node for its children. */
+  void _make_node__partition_presorted(Desk *d) const;
+
+  /** Partitions the samples of a node by a threshold on sparse features. */
+  template <typename IT>
+  void _make_node__partition_sparse(const IT &thresh, const id_t &pivot_id,
+                                    Desk *d) const;
+
+  /**
+   * Optimizes the threshold for one feature, starting from the sample order
+   * in `node_ids`. The result does not depend on the desk.
+   */
+  void _make_node__eval_feature(const IDataProvider &dprov,
+                                const size_t &feat_idx, const id_t *node_ids,
+                                Desk *d) const;
+
+  /**
+   * Evaluates the candidate features of a large node with the help of the
+   * idle pool threads. Returns the optimization results in candidate order.
+   */
+  std::vector<OptSplitV> _make_node__eval_parallel(
+      const IDataProvider &dprov, const std::vector<size_t> &candidates,
+      Desk *d) const;
+
   // Fields.
   std::shared_ptr<IThreshOpt> threshold_optimizer;
   size_t n_valids_to_use;
@@ -171,8 +274,18 @@ class FastDecider : public IDecider {
               std::vector<uint8_t>>
       node_to_thresh_v;
   size_t data_dim;
+  bool presort;
+  size_t subsample_min_samples;
+  size_t subsample_size;
+  /// The sample ids sorted by each feature. The samples of a node occupy the
+  /// same interval as in the tree's sample id list. Since multiple threads
+  /// never work on the same interval, concurrent writes can be performed.
+  mutable std::vector<std::vector<id_t>> presorted_ids;
+  /// Marks the samples that go left at the current split (by sample id).
+  mutable std::vector<uint8_t> goes_left;
 };
 };  // namespace forpy
 
 CEREAL_REGISTER_TYPE(forpy::FastDecider);
+CEREAL_CLASS_VERSION(forpy::FastDecider, 2);
 #endif  // FORPY_DECIDERS_FASTDECIDER_H_
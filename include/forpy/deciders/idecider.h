@@ -14,6 +14,7 @@
 #include "../data_providers/idataprovider.h"
 #include "../threshold_optimizers/ithreshopt.h"
 #include "../types.h"
+#include "../util/costmodel.h"
 #include "../util/desk.h"
 
 namespace forpy {
@@ -63,6 +64,13 @@ class IDecider {
 
   virtual void finalize_capacity(const size_t &size) VIRTUAL_VOID;
 
+  /**
+   * \brief Renumbers the stored node parameters.
+   *
+   * \param new_ids The new node id for every current node id.
+   */
+  virtual void permute_nodes(const std::vector<id_t> &new_ids) VIRTUAL_VOID;
+
   /**
    * \brief Makes a decision for a node with already optimized parameters.
    *
@@ -94,6 +102,32 @@ class IDecider {
 
   virtual bool operator==(const IDecider &rhs) const VIRTUAL(bool);
 
+  /**
+   * \brief Estimates the work of make_node for a node with `n_samples`
+   * samples.
+   *
+   * The default assumes that every feature is sorted once and scanned once.
+   */
+  virtual NodeWork estimate_work(const size_t &n_samples,
+                                 const IDataProvider &data_provider) const;
+
+  /**
+   * \brief Whether make_node evaluates every feature at every node.
+   *
+   * If so, histograms of all features may be prepared for the nodes of a
+   * level (see Tree::BFS). By default, return false.
+   */
+  inline virtual bool evaluates_all_features() const { return false; };
+
+  /**
+   * \brief Whether make_node relies on the sample ids of the full data
+   * provider beyond the node.
+   *
+   * If not, subtrees may be trained on node-local copies of the data (see
+   * Tree::set_local_copy_samples). By default, return false.
+   */
+  inline virtual bool uses_global_sample_ids() const { return false; };
+
   std::pair<const std::vector<size_t> *,
             const mu::variant<std::vector<float>, std::vector<double>,
                               std::vector<uint32_t>, std::vector<uint8_t>>
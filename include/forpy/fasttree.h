@@ -0,0 +1,216 @@
+/* Author: Christoph Lassner. */
+#pragma once
+#ifndef FORPY_FASTTREE_H_
+#define FORPY_FASTTREE_H_
+
+#include "./global.h"
+
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "./types.h"
+
+namespace forpy {
+/** \brief Bit in \ref FastNode::child that marks a leaf. */
+const uint32_t FAST_LEAF_FLAG = 0x80000000u;
+
+/**
+ * \brief A packed node of a \ref FastTree.
+ *
+ * For inner nodes, `child` is the position of the left child in the node
+ * array. The right child is always stored directly behind it. For leafs,
+ * `child` has \ref FAST_LEAF_FLAG set and the remaining bits are the position
+ * in the dense leaf table. This makes the node 12 bytes for all threshold
+ * types but `double` (16 bytes), so that several nodes share a cache line.
+ */
+template <typename T>
+struct FastNode {
+  uint32_t feature;
+  uint32_t child;
+  T threshold;
+
+  inline bool is_leaf() const { return (child & FAST_LEAF_FLAG) != 0; };
+
+  bool operator==(FastNode<T> const &rhs) const {
+    return feature == rhs.feature && child == rhs.child &&
+           threshold == rhs.threshold;
+  }
+};
+
+/**
+ * \brief The number of rows that are advanced in lockstep by
+ * FastTree::predict_leaf_ids.
+ */
+const size_t FAST_BATCH_ROWS = 8;
+
+/**
+ * \brief Compact tree representation for fast predictions.
+ *
+ * Built from the decider maps by Tree::enable_fast_prediction. The root is at
+ * position 0 and siblings are stored next to each other.
+ */
+template <typename T>
+struct FastTree {
+  /** The packed nodes. */
+  std::vector<FastNode<T>> nodes;
+  /** The dense leaf table, mapping leaf positions to tree node ids. */
+  std::vector<uint32_t> leaf_ids;
+
+  inline FastTree() : nodes(), leaf_ids(){};
+
+  /**
+   * \brief Pack a tree.
+   *
+   * \param tree The tree structure (pairs of child ids; (0, 0) for leafs).
+   * \param feature_map The feature ids for every node id.
+   * \param threshold_map The thresholds for every node id.
+   * \param keep_ids If true and all siblings have adjacent ids, the node ids
+   *   are used as positions (see Tree::relayout). Otherwise, the positions
+   *   are assigned breadth first.
+   */
+  template <typename FM, typename TM>
+  FastTree(const std::vector<std::pair<id_t, id_t>> &tree,
+           const FM &feature_map, const TM &threshold_map,
+           const bool &keep_ids = false)
+      : nodes(), leaf_ids() {
+    if (tree.size() == 0) return;
+    if (tree.size() >= static_cast<size_t>(FAST_LEAF_FLAG))
+      throw ForpyException("Too many nodes for a fast tree!");
+    nodes.reserve(tree.size());
+    bool ids_usable = keep_ids;
+    for (size_t node_id = 0; node_id < tree.size() && ids_usable; ++node_id)
+      if (tree[node_id].first != 0 && tree[node_id].second != 0 &&
+          tree[node_id].second != tree[node_id].first + 1)
+        ids_usable = false;
+    if (ids_usable) {
+      nodes.resize(tree.size());
+      for (size_t node_id = 0; node_id < tree.size(); ++node_id)
+        set_node(static_cast<uint32_t>(node_id), node_id, tree, feature_map,
+                 threshold_map, static_cast<uint32_t>(tree[node_id].first));
+      return;
+    }
+    // Assign the positions breadth first so that siblings are adjacent.
+    std::deque<std::pair<id_t, uint32_t>> todo{{0, 0}};
+    nodes.emplace_back();
+    while (!todo.empty()) {
+      const id_t node_id = todo.front().first;
+      const uint32_t pos = todo.front().second;
+      todo.pop_front();
+      const uint32_t child = static_cast<uint32_t>(nodes.size());
+      if (set_node(pos, node_id, tree, feature_map, threshold_map, child)) {
+        nodes.emplace_back();
+        nodes.emplace_back();
+        todo.emplace_back(tree[node_id].first, child);
+        todo.emplace_back(tree[node_id].second, child + 1);
+      }
+    }
+  };
+
+  /**
+   * \brief Get the leaf id for a sample.
+   *
+   * \param row Pointer to the contiguous features of the sample.
+   */
+  template <typename IT>
+  inline id_t predict_leaf(const IT *row) const {
+    const FastNode<T> *nodes_p = nodes.data();
+    uint32_t pos = 0;
+    while (!nodes_p[pos].is_leaf()) {
+      const FastNode<T> &node = nodes_p[pos];
+      pos = node.child +
+            static_cast<uint32_t>(!(row[node.feature] <= node.threshold));
+    }
+    return leaf_ids[nodes_p[pos].child & ~FAST_LEAF_FLAG];
+  };
+
+  /**
+   * \brief Get the leaf ids for consecutive samples.
+   *
+   * Blocks of \ref FAST_BATCH_ROWS rows are advanced through the tree in
+   * lockstep, one level per step. The rows are interleaved in a branchless
+   * scalar loop, so that the node loads of different rows overlap. Remaining
+   * rows use \ref predict_leaf.
+   *
+   * \param data Pointer to the features of the first sample.
+   * \param stride The distance between two samples in elements.
+   * \param n_rows The number of samples.
+   * \param out Storage for n_rows leaf ids.
+   */
+  template <typename IT>
+  void predict_leaf_ids(const IT *data, const size_t &stride,
+                        const size_t &n_rows, id_t *out) const {
+    if (nodes.empty()) return;
+    uint32_t pos[FAST_BATCH_ROWS];
+    size_t row_idx = 0;
+    for (; row_idx + FAST_BATCH_ROWS <= n_rows; row_idx += FAST_BATCH_ROWS) {
+      lockstep_batch(data + row_idx * stride, stride, pos);
+      for (size_t lane = 0; lane < FAST_BATCH_ROWS; ++lane)
+        out[row_idx + lane] =
+            leaf_ids[nodes[pos[lane]].child & ~FAST_LEAF_FLAG];
+    }
+    for (; row_idx < n_rows; ++row_idx)
+      out[row_idx] = predict_leaf(data + row_idx * stride);
+  };
+
+  /** \brief The memory used by nodes and leaf table in bytes. */
+  inline size_t get_memory_size() const {
+    return nodes.size() * sizeof(FastNode<T>) +
+           leaf_ids.size() * sizeof(uint32_t);
+  };
+
+  bool operator==(FastTree<T> const &rhs) const {
+    return nodes == rhs.nodes && leaf_ids == rhs.leaf_ids;
+  }
+
+ private:
+  /** Lockstep traversal of one batch. */
+  template <typename IT>
+  inline void lockstep_batch(const IT *data, const size_t &stride,
+                             uint32_t *pos) const {
+    const FastNode<T> *nodes_p = nodes.data();
+    for (size_t lane = 0; lane < FAST_BATCH_ROWS; ++lane) pos[lane] = 0;
+    bool done = false;
+    while (!done) {
+      done = true;
+      for (size_t lane = 0; lane < FAST_BATCH_ROWS; ++lane) {
+        // Leafs have feature 0, so the value load is always valid.
+        const FastNode<T> &node = nodes_p[pos[lane]];
+        const IT &value = data[lane * stride + node.feature];
+        const uint32_t next =
+            node.child + static_cast<uint32_t>(!(value <= node.threshold));
+        const bool is_leaf = node.is_leaf();
+        pos[lane] = is_leaf ? pos[lane] : next;
+        done &= is_leaf;
+      }
+    }
+  };
+
+  /** Fills the node at pos; returns whether it is an inner node. */
+  template <typename FM, typename TM>
+  inline bool set_node(const uint32_t &pos, const id_t &node_id,
+                       const std::vector<std::pair<id_t, id_t>> &tree,
+                       const FM &feature_map, const TM &threshold_map,
+                       const uint32_t &child) {
+    const auto &node_id_pair = tree[node_id];
+    if (node_id_pair.first == 0 || node_id_pair.second == 0) {
+      nodes[pos].feature = 0;
+      nodes[pos].child =
+          static_cast<uint32_t>(leaf_ids.size()) | FAST_LEAF_FLAG;
+      nodes[pos].threshold = static_cast<T>(0);
+      leaf_ids.push_back(static_cast<uint32_t>(node_id));
+      return false;
+    }
+    nodes[pos].feature = static_cast<uint32_t>(feature_map.at(node_id));
+    nodes[pos].child = child;
+    nodes[pos].threshold = threshold_map.at(node_id);
+    return true;
+  };
+};
+typedef mu::variant<FastTree<float>, FastTree<double>, FastTree<uint>,
+                    FastTree<uint8_t>>
+    FastTreeV;
+
+}  // namespace forpy
+#endif  // FORPY_FASTTREE_H_
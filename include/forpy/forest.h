@@ -11,8 +11,10 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <vector>
 
+#include "./bitvectorforest.h"
 #include "./data_providers/idataprovider.h"
 #include "./deciders/fastdecider.h"
 #include "./leafs/classificationleaf.h"
@@ -22,6 +24,14 @@
 #include "./util/threading/ctpl.h"
 
 namespace forpy {
+/**
+ * \brief The maximum number of rows per tile for forest predictions.
+ *
+ * The rows of one tile are propagated through all trees of its tree group
+ * while they are in cache.
+ */
+const size_t FOREST_PREDICT_BLOCK_ROWS = 256;
+
 /**
  * Standard forest class of the library.
  */
@@ -122,10 +132,12 @@ class Forest {
    *   The data predict with one sample per row.
    *
    * \param num_threads int>=0
-   *   The number of threads to use for prediction. The number of
-   *   samples should be at least three times larger than the number
-   *   of threads to observe very good parallelization behaviour. If 0, then all
-   *   available hardware threads are used.
+   *   The number of threads to use for prediction. The work is tiled over
+   *   blocks of rows and groups of trees; the tree results are directly added
+   *   to one accumulator per tree group and fused once at the end. Tree groups
+   *   are only used if there are not enough row blocks to use all threads.
+   *   The tiles run on the prediction thread pool, so the training pool is
+   *   never resized. If 0, then all available hardware threads are used.
    *   Default: 1.
    *
    * \param use_fast_prediction_if_available bool
@@ -139,20 +151,7 @@ class Forest {
    */
   Data<Mat> predict(const Data<MatCRef> &data_v, const int &num_threads = 1,
                     const bool &use_fast_prediction_if_available = true,
-                    const bool &predict_proba = false) {
-    if (num_threads == 0)
-      throw ForpyException("The number of threads must be >0!");
-    if (num_threads != 1) throw ForpyException("Unimplemented!");
-    std::vector<Data<Mat>> results(0);
-    Vec<float> tree_weights(Vec<float>::Zero(trees.size()));
-    results.reserve(trees.size());
-    for (size_t i = 0; i < trees.size(); ++i) {
-      results.push_back(trees[i]->predict(
-          data_v, 1, use_fast_prediction_if_available, predict_proba, true));
-      tree_weights(i) = trees[i]->get_weight();
-    }
-    return trees[0]->combine_leaf_results(results, tree_weights, predict_proba);
-  };
+                    const bool &predict_proba = false);
 
   /** Predict the distribution of results. */
   Data<Mat> predict_proba(const Data<MatCRef> &data_v,
@@ -161,6 +160,108 @@ class Forest {
     return predict(data_v, num_threads, use_fast_prediction_if_available, true);
   };
 
+  /**
+   * \brief Predicts the rows of a CSR matrix with shape (n_samples x
+   * n_features).
+   *
+   * The rows are expanded to dense float blocks of bounded size that are
+   * predicted with \ref predict (see forpy::predict_sparse_rows). The
+   * thresholds must be float, e.g., from training with a SparseDProv.
+   */
+  Data<Mat> predict_sparse(const SparseMat &data, const int &num_threads = 1,
+                           const bool &predict_proba = false);
+
+  /**
+   * Predicts a single sample with the fast prediction engine.
+   *
+   * Does not allocate memory in steady state and does not construct
+   * variants, so it is suitable for low latency serving. Requires a previous
+   * call to \ref enable_fast_prediction. Thread safe.
+   *
+   * \param features Pointer to the contiguous features of the sample.
+   * \param out Storage for the result columns of \ref predict (class labels
+   *   are written as float).
+   * \param predict_proba Whether to provide the distribution of results.
+   */
+  template <typename IT>
+  void predict_one(const IT *features, float *out,
+                   const bool &predict_proba = false) const {
+    const size_t n_trees = trees.size();
+    const ILeaf *lm = trees[0]->leaf_manager.get();
+    float *acc =
+        get_thread_scratch<float>(lm->get_accumulator_columns(n_trees,
+                                                              predict_proba));
+    float weight_sum = 0.f;
+    if (bitvector_forest.get() != nullptr) {
+      bitvector_forest->match([&](const auto &bvf) {
+        // id_t may be uint64_t, so the buffers need their own slots.
+        uint64_t *bitvectors =
+            get_thread_scratch<uint64_t, 1>(bvf.get_n_bitvectors());
+        id_t *leaf_ids = get_thread_scratch<id_t, 2>(n_trees);
+        bvf.predict_leaf_ids(features, bitvectors, leaf_ids);
+        for (size_t tree_idx = 0; tree_idx < n_trees; ++tree_idx) {
+          const Tree *tree = trees[tree_idx].get();
+          const float &weight = tree->get_weight();
+          tree->leaf_manager->accumulate_result(
+              leaf_ids[tree_idx], tree_idx, weight, acc, predict_proba);
+          weight_sum += weight;
+        }
+      });
+    } else {
+      for (size_t tree_idx = 0; tree_idx < n_trees; ++tree_idx) {
+        const Tree *tree = trees[tree_idx].get();
+        if (tree->fast_tree.get() == nullptr)
+          throw ForpyException(
+              "predict_one requires fast prediction; call "
+              "`enable_fast_prediction` first!");
+        const id_t leaf_id = tree->fast_tree->match(
+            [&](const auto &ftree) { return ftree.predict_leaf(features); });
+        const float &weight = tree->get_weight();
+        tree->leaf_manager->accumulate_result(leaf_id, tree_idx, weight, acc,
+                                              predict_proba);
+        weight_sum += weight;
+      }
+    }
+    lm->finalize_one(acc, n_trees, weight_sum, predict_proba, out);
+  };
+
+  /**
+   * Get the leaf ids of all trees for new data points.
+   *
+   * Uses the fast prediction engines and releases the GIL in Python.
+   *
+   * \param data_v Variant of 2D array, row-major contiguous
+   *   The data with one sample per row.
+   *
+   * \param num_threads int>=0
+   *   The number of threads to use. The rows are processed in blocks. If 0,
+   *   then all available hardware threads are used. Default: 1.
+   *
+   * \returns A matrix with the leaf node id of every tree (columns) for every
+   *   sample (rows).
+   */
+  Mat<uint> apply(const Data<MatCRef> &data_v, const int &num_threads = 1);
+
+  /**
+   * Get the one-hot leaf embedding of new data points as sparse CSR matrix.
+   *
+   * The leafs of every tree are numbered in the order of their node ids and
+   * the trees are concatenated. Every row has exactly one non-zero (1) entry
+   * per tree. With scipy, use
+   * `scipy.sparse.csr_matrix((np.ones(len(indices)), indices, indptr),
+   * shape=(n_samples, n_columns))`.
+   *
+   * \param data_v Variant of 2D array, row-major contiguous
+   *   The data with one sample per row.
+   *
+   * \param num_threads int>=0
+   *   See \ref apply.
+   *
+   * \returns The column indices, the row pointers and the number of columns.
+   */
+  std::tuple<Vec<uint>, Vec<size_t>, size_t> apply_csr(
+      const Data<MatCRef> &data_v, const int &num_threads = 1);
+
   /** Get the required input data dimension. */
   inline size_t get_input_data_dimensions() const {
     return trees[0]->get_input_data_dimensions();
@@ -174,16 +275,47 @@ class Forest {
   /** Get the tree vector. */
   inline std::vector<std::shared_ptr<Tree>> get_trees() const { return trees; }
 
-  /** Enable fast prediction for all trees. */
-  inline void enable_fast_prediction() {
-    for (auto &tree : trees) tree->enable_fast_prediction();
-  };
+  /**
+   * \brief Enable fast prediction for all trees.
+   *
+   * Batches are always predicted with a \ref FastTree for every tree (see
+   * Tree::enable_fast_prediction).
+   *
+   * \param engine string
+   *   "tree": \ref predict_one uses the fast trees, too. "bitvector":
+   *   \ref predict_one evaluates all trees at once with a
+   *   \ref BitvectorForest. This only pays off for the latency of single
+   *   samples with large forests of shallow trees (around 1000 trees with at
+   *   most 64 leafs each); the fast trees are faster for batches and for
+   *   small forests. Default: "tree".
+   */
+  void enable_fast_prediction(const std::string &engine = "tree");
 
   /** Disable fast prediction for all trees. */
   inline void disable_fast_prediction() {
+    bitvector_forest.reset();
     for (auto &tree : trees) tree->disable_fast_prediction();
   };
 
+  /** Relayout the nodes of all trees (see Tree::relayout). */
+  inline void relayout(const ENodeLayout &layout = ENodeLayout::SubtreeBlocked,
+                       const size_t &bfs_levels = 4,
+                       const size_t &block_depth = 3) {
+    for (auto &tree : trees) tree->relayout(layout, bfs_levels, block_depth);
+    if (bitvector_forest.get() != nullptr) enable_fast_prediction("bitvector");
+  };
+
+  /** Set the node-local copy size of all trees (see
+   * Tree::set_local_copy_samples). */
+  inline void set_local_copy_samples(const size_t &n_samples) {
+    for (auto &tree : trees) tree->set_local_copy_samples(n_samples);
+  };
+
+  /** Get the node-local copy size of the first tree. */
+  inline size_t get_local_copy_samples() const {
+    return trees[0]->get_local_copy_samples();
+  };
+
   /** Gets the leaf manager of the first tree. */
   inline std::shared_ptr<const ILeaf> get_leaf_manager() const {
     return trees[0]->get_leaf_manager();
@@ -216,6 +348,20 @@ class Forest {
    */
   void save(const std::string &filename) const;
 
+  /**
+   * Export the forest as self-contained C++ header (see generate_cpp).
+   *
+   * \param filename string
+   *   The header file to write.
+   * \param mode ECodegenMode
+   *   The code structure.
+   * \param name string
+   *   The namespace of the generated code.
+   */
+  void export_cpp(const std::string &filename,
+                  const ECodegenMode &mode = ECodegenMode::IfElse,
+                  const std::string &name = "forpy_forest") const;
+
   inline bool operator==(const Forest &rhs) const {
     if (trees.size() != rhs.trees.size()) return false;
     for (size_t i = 0; i < trees.size(); ++i) {
@@ -243,6 +389,8 @@ class Forest {
 
   std::vector<std::shared_ptr<Tree>> trees;
   uint random_seed;
+  /** The bitvector prediction engine, if enabled. */
+  std::unique_ptr<BitvectorForestV> bitvector_forest;
   DISALLOW_COPY_AND_ASSIGN(Forest);
 };  // class Forest
 
@@ -357,5 +505,128 @@ class RegressionForest : public Forest {
   DISALLOW_COPY_AND_ASSIGN(RegressionForest);
 };
 
+/**
+ * \brief A forest of Extremely Randomized Trees (Geurts et al., 2006) for
+ * classification.
+ *
+ * Like forpy::ClassificationForest, but the thresholds are drawn at random
+ * and scored without sorting the node samples (see forpy::ExtraClassOpt).
+ */
+class ExtraTreesClassifier : public Forest {
+ public:
+  inline ExtraTreesClassifier(const std::string &filename) : Forest(filename){};
+  ExtraTreesClassifier(const size_t &n_trees = 10,
+                       const uint &max_depth = std::numeric_limits<uint>::max(),
+                       const uint &min_samples_at_leaf = 1,
+                       const uint &min_samples_at_node = 2,
+                       const uint &n_valid_features_to_use = 0,
+                       const bool &autoscale_valid_features = true,
+                       const uint &random_seed = 1,
+                       const size_t &n_thresholds = 1,
+                       const float &gain_threshold = 1E-7f);
+
+  inline std::unordered_map<std::string, mu::variant<uint, size_t, float, bool>>
+  get_params(const bool & /*deep*/ = false) const {
+    return params;
+  }
+
+  inline std::shared_ptr<ExtraTreesClassifier> set_params(
+      const std::unordered_map<
+          std::string, mu::variant<uint, size_t, float, bool>> &params) {
+    return std::make_shared<ExtraTreesClassifier>(
+        GetWithDefVar<size_t>(params, "n_trees", 10),
+        GetWithDefVar<uint>(params, "max_depth",
+                            std::numeric_limits<uint>::max()),
+        GetWithDefVar<uint>(params, "min_samples_at_leaf", 1),
+        GetWithDefVar<uint>(params, "min_samples_at_node", 2),
+        GetWithDefVar<uint>(params, "n_valid_features_to_use", 0),
+        GetWithDefVar<bool>(params, "autoscale_valid_features", true),
+        GetWithDefVar<uint>(params, "random_seed", 1),
+        GetWithDefVar<size_t>(params, "n_thresholds", 1),
+        GetWithDefVar<float>(params, "gain_threshold", 1E-7f));
+  }
+
+  inline friend std::ostream &operator<<(std::ostream &stream,
+                                         const ExtraTreesClassifier &self) {
+    stream << "forpy::ExtraTreesClassifier["
+           << mu::static_variant_cast<size_t>(self.params.at("n_trees"))
+           << " trees]";
+    return stream;
+  };
+
+ private:
+  std::unordered_map<std::string, mu::variant<uint, size_t, float, bool>>
+      params;
+  friend class cereal::access;
+  template <class Archive>
+  void serialize(Archive &ar, const uint &) {
+    ar(cereal::make_nvp("base", cereal::base_class<Forest>(this)),
+       CEREAL_NVP(params));
+  }
+  DISALLOW_COPY_AND_ASSIGN(ExtraTreesClassifier);
+};
+
+/**
+ * \brief A forest of Extremely Randomized Trees for regression (see
+ * forpy::ExtraTreesClassifier and forpy::ExtraRegOpt).
+ */
+class ExtraTreesRegressor : public Forest {
+ public:
+  inline ExtraTreesRegressor(const std::string &filename) : Forest(filename){};
+  ExtraTreesRegressor(const size_t &n_trees = 10,
+                      const uint &max_depth = std::numeric_limits<uint>::max(),
+                      const uint &min_samples_at_leaf = 1,
+                      const uint &min_samples_at_node = 2,
+                      const uint &n_valid_features_to_use = 0,
+                      const bool &autoscale_valid_features = false,
+                      const uint &random_seed = 1,
+                      const size_t &n_thresholds = 1,
+                      const float &gain_threshold = 1E-7f,
+                      const bool &store_variance = false,
+                      const bool &summarize = false);
+
+  inline std::unordered_map<std::string, mu::variant<uint, size_t, float, bool>>
+  get_params(const bool & /*deep*/ = false) const {
+    return params;
+  }
+
+  inline std::shared_ptr<ExtraTreesRegressor> set_params(
+      const std::unordered_map<
+          std::string, mu::variant<uint, size_t, float, bool>> &params) {
+    return std::make_shared<ExtraTreesRegressor>(
+        GetWithDefVar<size_t>(params, "n_trees", 10),
+        GetWithDefVar<uint>(params, "max_depth",
+                            std::numeric_limits<uint>::max()),
+        GetWithDefVar<uint>(params, "min_samples_at_leaf", 1),
+        GetWithDefVar<uint>(params, "min_samples_at_node", 2),
+        GetWithDefVar<uint>(params, "n_valid_features_to_use", 0),
+        GetWithDefVar<bool>(params, "autoscale_valid_features", false),
+        GetWithDefVar<uint>(params, "random_seed", 1),
+        GetWithDefVar<size_t>(params, "n_thresholds", 1),
+        GetWithDefVar<float>(params, "gain_threshold", 1E-7f),
+        GetWithDefVar<bool>(params, "store_variance", false),
+        GetWithDefVar<bool>(params, "summarize", false));
+  }
+
+  inline friend std::ostream &operator<<(std::ostream &stream,
+                                         const ExtraTreesRegressor &self) {
+    stream << "forpy::ExtraTreesRegressor["
+           << mu::static_variant_cast<size_t>(self.params.at("n_trees"))
+           << " trees]";
+    return stream;
+  };
+
+ private:
+  std::unordered_map<std::string, mu::variant<uint, size_t, float, bool>>
+      params;
+  friend class cereal::access;
+  template <class Archive>
+  void serialize(Archive &ar, const uint &) {
+    ar(cereal::make_nvp("base", cereal::base_class<Forest>(this)),
+       CEREAL_NVP(params));
+  }
+  DISALLOW_COPY_AND_ASSIGN(ExtraTreesRegressor);
+};
+
 };      // namespace forpy
 #endif  // FORPY_FOREST_H_
@@ -51,6 +51,8 @@
 /// const-ness can be used as an automatic checker for memory access.
 #include "./util/desk.h"
 
+#include "./codegen.h"
+#include "./compiledforest.h"
 #include "./forest.h"
 #include "./tree.h"
 
@@ -124,6 +124,13 @@ class EmptyException : public ForpyException {
 #define FASSERT(condition)
 #endif
 
+// Software prefetching (for reading) of random accesses.
+#if defined(__GNUC__) || defined(__clang__)
+#define FPREFETCH(address) __builtin_prefetch(address)
+#else
+#define FPREFETCH(address)
+#endif
+
 // Library exports.
 #if !defined(_MSC_VER)
 #define DllExport
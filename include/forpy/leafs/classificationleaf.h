@@ -40,6 +40,14 @@ class ClassificationLeaf : public ILeaf {
   inline std::shared_ptr<ILeaf> create_duplicate() const {
     return std::make_shared<ClassificationLeaf>(n_classes);
   };
+  inline std::shared_ptr<ILeaf> create_finalizer() const {
+    auto finalizer = std::make_shared<ClassificationLeaf>(n_classes);
+    if (class_transl_ptr != nullptr)
+      finalizer->class_transl_ptr =
+          std::make_shared<std::vector<uint>>(*class_transl_ptr);
+    finalizer->true_max_class = true_max_class;
+    return finalizer;
+  };
   inline bool is_compatible_with(const IDataProvider & /*data_provider*/) {
     return true;
   }
@@ -69,10 +77,27 @@ class ClassificationLeaf : public ILeaf {
                   Data<MatRef> &target_v,
                   const Vec<float> &weights = Vec<float>(),
                   const bool &predict_proba = false) const;
+  size_t get_accumulator_columns(const size_t &n_trees,
+                                 const bool &predict_proba) const;
+  void accumulate_result(const id_t &node_id, const size_t &tree_idx,
+                         const float &weight, float *acc_row,
+                         const bool &predict_proba) const;
+  void finalize_result(const MatCRef<float> &accumulator,
+                       Data<MatRef> &target_v, const size_t &n_trees,
+                       const Vec<float> &weights = Vec<float>(),
+                       const bool &predict_proba = false) const;
+  void finalize_one(const float *acc, const size_t &n_trees,
+                    const float &weight_sum, const bool &predict_proba,
+                    float *out) const;
+  std::string get_export_finalizer(const size_t &n_trees,
+                                   const Vec<float> &weights) const;
   inline void ensure_capacity(const size_t &n) {
     stored_distributions.resize(n);
   };
   inline void finalize_capacity(const size_t &n) { ensure_capacity(n); };
+  inline void permute_nodes(const std::vector<id_t> &new_ids) {
+    permute_ids(&stored_distributions, new_ids);
+  };
   //@}
 
   bool operator==(const ILeaf &rhs) const;
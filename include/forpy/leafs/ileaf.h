@@ -7,6 +7,7 @@
 
 #include "../util/serialization/basics.h"
 
+#include <string>
 #include <vector>
 
 #include "../data_providers/idataprovider.h"
@@ -26,6 +27,12 @@ class ILeaf {
   /** Create a similar, but empty, leaf. */
   virtual std::shared_ptr<ILeaf> create_duplicate() const VIRTUAL_PTR;
 
+  /**
+   * Create a leaf without stored leafs that combines and finalizes results
+   * like this one (see \ref finalize_result and \ref finalize_one).
+   */
+  virtual std::shared_ptr<ILeaf> create_finalizer() const VIRTUAL_PTR;
+
   /**
    * \brief Checks compatibility with a certain \ref IDataProvider.
    *
@@ -119,12 +126,80 @@ class ILeaf {
       const Vec<float> &weights = Vec<float>(),
       const bool &predict_proba = false) const VIRTUAL_VOID;
 
+  /**
+   * \brief The number of accumulator columns per sample for combining the
+   * results of n_trees trees without storing the individual tree results.
+   */
+  virtual size_t get_accumulator_columns(const size_t &n_trees,
+                                         const bool &predict_proba) const
+      VIRTUAL(size_t);
+
+  /**
+   * \brief Add the weighted result of the leaf with the given id to one
+   * accumulator row.
+   *
+   * \param node_id The leaf id of tree tree_idx.
+   * \param tree_idx The index of the tree in the forest.
+   * \param weight The tree weight.
+   * \param acc_row Pointer to the accumulator row with
+   *   \ref get_accumulator_columns elements.
+   * \param predict_proba Whether the distribution of results is requested.
+   */
+  virtual void accumulate_result(const id_t &node_id, const size_t &tree_idx,
+                                 const float &weight, float *acc_row,
+                                 const bool &predict_proba) const VIRTUAL_VOID;
+
+  /**
+   * \brief Get the fused forest result from the summed accumulators.
+   *
+   * Must produce the same result as the overload of \ref get_result for
+   * leaf result vectors.
+   */
+  virtual void finalize_result(const MatCRef<float> &accumulator,
+                               Data<MatRef> &target_v, const size_t &n_trees,
+                               const Vec<float> &weights = Vec<float>(),
+                               const bool &predict_proba = false) const
+      VIRTUAL_VOID;
+
+  /**
+   * \brief Like \ref finalize_result for one sample, but without variants or
+   * allocations.
+   *
+   * \param acc The summed accumulators of the sample.
+   * \param n_trees The number of trees.
+   * \param weight_sum The sum of the tree weights.
+   * \param predict_proba Whether the distribution of results is requested.
+   * \param out Storage for the \ref get_result_columns result values. Class
+   *   labels are written as float.
+   */
+  virtual void finalize_one(const float *acc, const size_t &n_trees,
+                            const float &weight_sum, const bool &predict_proba,
+                            float *out) const VIRTUAL_VOID;
+
+  /**
+   * \brief Get C++ code for exported models (see generate_cpp) that computes
+   * the result of \ref finalize_result for one sample without probabilities.
+   *
+   * The code reads the summed accumulators from `const float *acc` and
+   * writes the result columns to `result_t *out`.
+   */
+  virtual std::string get_export_finalizer(const size_t &n_trees,
+                                           const Vec<float> &weights) const
+      VIRTUAL(std::string);
+
   /** \brief Ensure that storage is available for at least n leafs. */
   virtual void ensure_capacity(const size_t &n) VIRTUAL_VOID;
 
   /** \brief Cut down capacity to exactly n leafs. */
   virtual void finalize_capacity(const size_t &n) VIRTUAL_VOID;
 
+  /**
+   * \brief Renumbers the stored leafs.
+   *
+   * \param new_ids The new node id for every current node id.
+   */
+  virtual void permute_nodes(const std::vector<id_t> &new_ids) VIRTUAL_VOID;
+
   /** \brief Get all leafs. */
   virtual const std::vector<Mat<float>> *get_map() const = 0;
 
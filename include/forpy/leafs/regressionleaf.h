@@ -37,6 +37,12 @@ class RegressionLeaf : public ILeaf {
   inline std::shared_ptr<ILeaf> create_duplicate() const {
     return std::make_shared<RegressionLeaf>(store_variance);
   }
+  inline std::shared_ptr<ILeaf> create_finalizer() const {
+    auto finalizer =
+        std::make_shared<RegressionLeaf>(store_variance, summarize);
+    finalizer->annot_dim = annot_dim;
+    return finalizer;
+  }
 
   inline bool is_compatible_with(const IDataProvider &data_provider) {
     this->annot_dim = data_provider.get_annot_vec_dim();
@@ -98,10 +104,29 @@ class RegressionLeaf : public ILeaf {
                   Data<MatRef> &target_v,
                   const Vec<float> &weights = Vec<float>(),
                   const bool &predict_proba = false) const;
+  inline size_t get_accumulator_columns(const size_t &n_trees,
+                                        const bool &predict_proba) const {
+    return get_result_columns(n_trees, predict_proba, false);
+  };
+  void accumulate_result(const id_t &node_id, const size_t &tree_idx,
+                         const float &weight, float *acc_row,
+                         const bool &predict_proba) const;
+  void finalize_result(const MatCRef<float> &accumulator,
+                       Data<MatRef> &target_v, const size_t &n_trees,
+                       const Vec<float> &weights = Vec<float>(),
+                       const bool &predict_proba = false) const;
+  void finalize_one(const float *acc, const size_t &n_trees,
+                    const float &weight_sum, const bool &predict_proba,
+                    float *out) const;
+  std::string get_export_finalizer(const size_t &n_trees,
+                                   const Vec<float> &weights) const;
   inline void ensure_capacity(const size_t &n) {
     leaf_regression_map.resize(n);
   };
   inline void finalize_capacity(const size_t &n) { ensure_capacity(n); };
+  inline void permute_nodes(const std::vector<id_t> &new_ids) {
+    permute_ids(&leaf_regression_map, new_ids);
+  };
   //@}
 
   bool operator==(const ILeaf &rhs) const;
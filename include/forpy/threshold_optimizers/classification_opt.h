@@ -90,6 +90,11 @@ class ClassificationOpt : public IThreshOpt {
   float get_gain_threshold_for(const size_t & /*node_id*/) {
     return gain_threshold;
   };
+  inline bool uses_random_engine() const { return n_thresholds > 0; };
+  /** Every threshold candidate is scored on all class counts. */
+  inline float get_sample_cost(const IDataProvider & /*dprov*/) const {
+    return 1.f + .5f * static_cast<float>(n_classes);
+  };
   //@}
 
   /** \brief Get the determined number of classes. */
@@ -0,0 +1,80 @@
+/* Author: Christoph Lassner. */
+#pragma once
+#ifndef FORPY_THRESHOLD_OPTIMIZERS_EXTRACLASSOPT_H_
+#define FORPY_THRESHOLD_OPTIMIZERS_EXTRACLASSOPT_H_
+
+#include "../global.h"
+#include "../util/serialization/basics.h"
+
+#include "../types.h"
+#include "../util/desk.h"
+#include "./fastclassopt.h"
+#include "./ithreshopt.h"
+
+namespace forpy {
+
+/**
+ * \brief Optimize split thresholds for classification as in Extremely
+ * Randomized Trees (Geurts et al., 2006).
+ *
+ * This threshold optimizer draws `n_thresholds` random values between the
+ * minimum and maximum feature value of the node and returns the best one,
+ * like forpy::FastClassOpt with `n_thresholds > 0`. It does not sort the node
+ * samples: one pass gathers the feature values and finds their range, and a
+ * second pass adds the class weights of every sample to the interval between
+ * two consecutive thresholds it falls into. The thresholds are then scored
+ * from the cumulative interval sums. A node costs O(n log(n_thresholds))
+ * instead of O(n log n) per feature, and the decider partitions the samples
+ * only for the best split (see IThreshOpt::sorts_samples).
+ *
+ * The histogram and sparse modes of forpy::FastClassOpt are not used.
+ *
+ * \ingroup forpythreshold_optimizersGroup
+ */
+class ExtraClassOpt : public FastClassOpt {
+ public:
+  /**
+   * \param n_thresholds size_t>0
+   *   Number of randomly drawn threshold values that are assessed. Default: 1.
+   * \param gain_threshold float >=0.f
+   *   The minimum information gain a split has to achieve. Default: 1E-7f.
+   */
+  ExtraClassOpt(const size_t &n_thresholds = 1,
+                const float &gain_threshold = 1E-7f);
+
+  //@{
+  /// Interface implementation.
+  std::shared_ptr<IThreshOpt> create_duplicate(
+      const uint & /*random_seed*/) const {
+    return std::make_shared<ExtraClassOpt>(n_thresholds, gain_threshold);
+  }
+  void optimize(Desk *) const;
+  inline bool supports_sparse() const { return false; };
+  inline bool sorts_samples() const { return false; };
+  inline size_t get_histogram_stride(const IDataProvider & /*dprov*/) const {
+    return 0;
+  };
+  //@}
+
+  inline friend std::ostream &operator<<(std::ostream &stream,
+                                         const ExtraClassOpt & /*self*/) {
+    stream << "forpy::ExtraClassOpt";
+    return stream;
+  };
+  bool operator==(const IThreshOpt &rhs) const;
+
+ private:
+  template <typename IT>
+  inline void optimize__extra(Desk *desk) const;
+  friend class cereal::access;
+  template <class Archive>
+  void serialize(Archive &ar, const uint &) {
+    ar(cereal::make_nvp("base", cereal::base_class<FastClassOpt>(this)));
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(ExtraClassOpt);
+};
+}  // namespace forpy
+
+CEREAL_REGISTER_TYPE(forpy::ExtraClassOpt);
+#endif  // FORPY_THRESHOLD_OPTIMIZERS_EXTRACLASSOPT_H_
@@ -0,0 +1,70 @@
+/* Author: Christoph Lassner. */
+#pragma once
+#ifndef FORPY_THRESHOLD_OPTIMIZERS_EXTRAREGOPT_H_
+#define FORPY_THRESHOLD_OPTIMIZERS_EXTRAREGOPT_H_
+
+#include "../global.h"
+#include "../util/serialization/basics.h"
+
+#include "../types.h"
+#include "../util/desk.h"
+#include "./ithreshopt.h"
+#include "./regression_opt.h"
+
+namespace forpy {
+
+/**
+ * \brief Optimize split thresholds for regression (MSE) as in Extremely
+ * Randomized Trees (Geurts et al., 2006).
+ *
+ * The sort-free counterpart of forpy::RegressionOpt with `n_thresholds > 0`
+ * (see forpy::ExtraClassOpt). Per interval between two consecutive random
+ * thresholds, the weighted annotation sums and the weight are accumulated in
+ * one pass over the node samples.
+ *
+ * \ingroup forpythreshold_optimizersGroup
+ */
+class ExtraRegOpt : public RegressionOpt {
+ public:
+  /**
+   * \param n_thresholds size_t>0
+   *   Number of randomly drawn threshold values that are assessed. Default: 1.
+   * \param gain_threshold float >=0.f
+   *   The minimum information gain a split has to achieve. Default: 1E-7f.
+   */
+  ExtraRegOpt(const size_t &n_thresholds = 1,
+              const float &gain_threshold = 1E-7f);
+
+  //@{
+  /// Interface implementation.
+  std::shared_ptr<IThreshOpt> create_duplicate(
+      const uint & /*random_seed*/) const {
+    return std::make_shared<ExtraRegOpt>(n_thresholds, gain_threshold);
+  }
+  void optimize(Desk *) const;
+  inline bool sorts_samples() const { return false; };
+  inline size_t get_histogram_stride(const IDataProvider & /*dprov*/) const {
+    return 0;
+  };
+  //@}
+
+  inline friend std::ostream &operator<<(std::ostream &stream,
+                                         const ExtraRegOpt & /*self*/) {
+    stream << "forpy::ExtraRegOpt";
+    return stream;
+  };
+  bool operator==(const IThreshOpt &rhs) const;
+
+ private:
+  friend class cereal::access;
+  template <class Archive>
+  void serialize(Archive &ar, const uint &) {
+    ar(cereal::make_nvp("base", cereal::base_class<RegressionOpt>(this)));
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(ExtraRegOpt);
+};
+}  // namespace forpy
+
+CEREAL_REGISTER_TYPE(forpy::ExtraRegOpt);
+#endif  // FORPY_THRESHOLD_OPTIMIZERS_EXTRAREGOPT_H_
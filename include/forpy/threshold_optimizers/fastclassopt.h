@@ -35,6 +35,39 @@ const bool LOG_FCOPT_ALLN = true;
  * extent. It is important that the least noticable difference is larger than
  * 1E-7 (forpy::CLASSOPT_EPS).
  *
+ * The samples of a node are sorted with a counting sort in O(n + 256) for
+ * uint8_t features (see forpy::sort_ids_by_feature) and with a radix sort
+ * otherwise.
+ *
+ * If the data provider quantizes the features (see forpy::FeatureBins), the
+ * best split between bins is found from a histogram of the class weights in
+ * one pass over the samples without sorting. `n_thresholds` is ignored in
+ * this mode.
+ *
+ * For sparse features (see forpy::SparseDProv), only the nonzero values of
+ * the node are sorted. All implicit zeros form one block whose class weights
+ * are the node totals minus the nonzero weights, and this block is inserted
+ * at its rank between the negative and positive values. This mode always
+ * finds the perfect split and requires `n_thresholds == 0`.
+ *
+ * For weighted samples and for nodes with 5000 samples or more, the sums of
+ * squared class weights of both sides are tracked incrementally in double
+ * precision and recomputed every forpy::IMPURITY_RESYNC_INTERVAL updates, so
+ * that a candidate threshold costs O(1) for any number of classes. Without
+ * weights, these sums are exact and the results are identical to a
+ * recomputation at every candidate. With weights, they agree up to double
+ * rounding (relative 1E-12 between resyncs), which can only break exact ties
+ * of the float gains differently.
+ *
+ * The sorted scan is compiled separately for 2, 3, 4 and 8 classes and any
+ * other number of classes, each with and without weights, and the kernel is
+ * selected once per node.
+ *
+ * The class weights of the children of a split are passed on to them (see
+ * child_stats). They are taken from the split scan where it sums them exactly
+ * (without weights, histograms and sparse features) and otherwise from one
+ * pass over the smaller child.
+ *
  * \ingroup forpythreshold_optimizersGroup
  */
 class FastClassOpt : public ClassificationOpt {
@@ -57,6 +90,15 @@ class FastClassOpt : public ClassificationOpt {
   }
   void full_entropy(const IDataProvider &dprov, Desk *) const;
   void optimize(Desk *) const;
+  void child_stats(const std::vector<double> &split_left_stats,
+                   Desk *desk) const;
+  inline bool supports_sparse() const { return n_thresholds == 0; };
+  /** Per bin: the class weights and the sample count. */
+  inline size_t get_histogram_stride(const IDataProvider & /*dprov*/) const {
+    return n_classes + 1;
+  };
+  void fill_histograms(const IDataProvider &dprov, const size_t &feat_idx,
+                       const uint32_t *slots, double *const *hists) const;
   //@}
 
   inline friend std::ostream &operator<<(std::ostream &stream,
@@ -73,17 +115,38 @@ class FastClassOpt : public ClassificationOpt {
   inline void optimize__sort(DeciderDesk &d) const;
   template <typename IT>
   inline std::unique_ptr<std::vector<IT>> optimize__thresholds(Desk *d) const;
+  template <typename IT>
+  inline void optimize__histogram(DeciderDesk &d) const;
+  inline void optimize__sparse(DeciderDesk &d) const;
+  /**
+   * \brief The sorted scan over the node samples.
+   *
+   * Instantiated for a fixed number of classes `NC` (0 for any) and with or
+   * without weights (see optimize__dispatch).
+   */
+  template <typename IT, size_t NC, bool WEIGHTED>
+  inline void optimize__scan(DeciderDesk &d, IT *feat_p,
+                             SplitOptRes<IT> &ret_res,
+                             const std::vector<IT> *thresholds) const;
+  /** \brief Selects the scan kernel for the number of classes. */
+  template <typename IT, bool WEIGHTED>
+  inline void optimize__dispatch(DeciderDesk &d, IT *feat_p,
+                                 SplitOptRes<IT> &ret_res,
+                                 const std::vector<IT> *thresholds) const;
   friend class cereal::access;
   template <class Archive>
   void serialize(Archive &ar, const uint &) {
     ar(cereal::make_nvp("base", cereal::base_class<ClassificationOpt>(this)));
   }
 
+ protected:
   using ClassificationOpt::class_transl_ptr;
   using ClassificationOpt::gain_threshold;
   using ClassificationOpt::n_classes;
   using ClassificationOpt::n_thresholds;
   using ClassificationOpt::true_max;
+
+ private:
   DISALLOW_COPY_AND_ASSIGN(FastClassOpt);
 };
 }  // namespace forpy
@@ -12,6 +12,15 @@
 
 namespace forpy {
 
+/**
+ * \brief The number of incremental updates of tracked sums of squares after
+ * which the threshold optimizers recompute them exactly.
+ *
+ * The interval is at least the number of classes or annotation dimensions, so
+ * that the recomputation costs amortized O(1) per update.
+ */
+const size_t IMPURITY_RESYNC_INTERVAL = 1024;
+
 /**
  * \brief Find an optimal threshold.
  *
@@ -33,6 +42,71 @@ class IThreshOpt {
    */
   inline virtual bool supports_weights() const { return false; };
 
+  /**
+   * \brief Whether IThreshOpt::optimize draws from the random engine of the
+   * desk.
+   *
+   * If not, the result for a feature only depends on the node and deciders
+   * may evaluate several features concurrently on different desks. By
+   * default, return true.
+   */
+  inline virtual bool uses_random_engine() const { return true; };
+
+  /**
+   * \brief Whether IThreshOpt::optimize leaves the node samples sorted by the
+   * optimized feature (see DeciderDesk::need_sort).
+   *
+   * If not, the decider partitions the samples by the threshold of the best
+   * split. By default, return true.
+   */
+  inline virtual bool sorts_samples() const { return true; };
+
+  /**
+   * \brief Whether IThreshOpt::optimize can work on sparse features (see
+   * IDataProvider::get_sparse_features and DeciderDesk::sparse).
+   *
+   * By default, return false.
+   */
+  inline virtual bool supports_sparse() const { return false; };
+
+  /**
+   * \brief The relative cost of processing one sample in a linear pass.
+   *
+   * Used by the node cost model (see IDecider::estimate_work). By default,
+   * return 1.
+   */
+  inline virtual float get_sample_cost(const IDataProvider & /*dprov*/) const {
+    return 1.f;
+  };
+
+  /**
+   * \brief The number of values per histogram bin, or 0 if the optimizer
+   * does not support histogram mode. By default, return 0.
+   */
+  inline virtual size_t get_histogram_stride(
+      const IDataProvider & /*dprov*/) const {
+    return 0;
+  };
+
+  /**
+   * \brief Accumulates the histograms of one feature for many nodes in one
+   * sequential pass over all samples.
+   *
+   * The histograms are the ones that the optimizer would build for each node
+   * (see HistogramCache::put).
+   *
+   * \param slots For every sample the index of its histogram or
+   *   FEATURE_BINS_NO_SLOT.
+   * \param hists Zeroed histograms with get_n_bins(feat_idx) *
+   *   get_histogram_stride() values each.
+   */
+  virtual void fill_histograms(const IDataProvider & /*dprov*/,
+                               const size_t & /*feat_idx*/,
+                               const uint32_t * /*slots*/,
+                               double *const * /*hists*/) const {
+    throw ForpyException("This threshold optimizer has no histogram mode!");
+  };
+
   /** \brief Validate annotations for usability with this optimizer. */
   virtual void check_annotations(IDataProvider *dprov) VIRTUAL_VOID;
 
@@ -51,6 +125,22 @@ class IThreshOpt {
   /** \brief Optimize for one node. */
   virtual void optimize(Desk *) const VIRTUAL_VOID;
 
+  /**
+   * \brief Computes the statistics of the children of a split node (see
+   * TodoMark::stats), so that full_entropy and the leafs need not scan their
+   * samples again.
+   *
+   * Called by the decider after the node samples have been partitioned (the
+   * left samples first, see DeciderDesk::left_int) with the statistics
+   * tracked for the best split (see SplitOptRes::left_stats). By default, no
+   * statistics are provided.
+   */
+  virtual void child_stats(const std::vector<double> & /*split_left_stats*/,
+                           Desk *desk) const {
+    desk->d.left_stats.clear();
+    desk->d.right_stats.clear();
+  };
+
   /** \brief Get the gain threshold to use for this node. */
   virtual float get_gain_threshold_for(const size_t &node_id) VIRTUAL(float);
 
@@ -35,6 +35,10 @@ const float REGOPT_EPS = 1E-7;
 #else
 const float REGOPT_EPS = 1E-7f;
 #endif
+
+/// \brief The minimum number of annotation dimensions for which the
+/// impurities are tracked incrementally (see forpy::RegressionOpt).
+const size_t REGOPT_INCREMENTAL_MIN_DIM = 5;
 #pragma clang diagnostic pop
 
 /**
@@ -49,6 +53,32 @@ const float REGOPT_EPS = 1E-7f;
  * extent. It is important that the least noticable difference is larger than
  * 1E-7 (forpy::REGOPT_EPS).
  *
+ * If the data provider quantizes the features (see forpy::FeatureBins), the
+ * best split between bins is found from a histogram of the weighted
+ * annotation sums in one pass over the samples without sorting.
+ * `n_thresholds` is ignored in this mode.
+ *
+ * With forpy::REGOPT_INCREMENTAL_MIN_DIM or more annotation dimensions, the
+ * squared norms of the left and right annotation sums are tracked
+ * incrementally in double precision instead of being recomputed over all
+ * dimensions at every candidate threshold. The updates only need the dot
+ * product of the left sums with the annotation that moves, because its dot
+ * product with the node sums and its squared norm are computed once per node.
+ * This halves the work per sample and dimension. The tracked norms are
+ * recomputed every forpy::IMPURITY_RESYNC_INTERVAL updates. The gains are
+ * more accurate than the float recomputation used for fewer dimensions, and
+ * differ from it by the float rounding (relative 1E-6), so near ties may be
+ * broken differently.
+ *
+ * The sorted scan is compiled separately for 1 to 4 annotation dimensions and
+ * any other dimension, each with and without weights, and the kernel is
+ * selected once per node.
+ *
+ * The statistics of the children of a split (see child_stats) are computed in
+ * one pass over the smaller child and the other one is derived from the node
+ * statistics. They are accumulated in double precision, since the derived
+ * statistics are passed on over many levels.
+ *
  * \ingroup forpythreshold_optimizersGroup
  */
 class RegressionOpt : public IThreshOpt {
@@ -76,9 +106,22 @@ class RegressionOpt : public IThreshOpt {
   };
   void full_entropy(const IDataProvider &dprov, Desk *) const;
   void optimize(Desk *) const;
+  void child_stats(const std::vector<double> &split_left_stats,
+                   Desk *desk) const;
   float get_gain_threshold_for(const size_t & /*node_id*/) {
     return gain_threshold;
   };
+  inline bool uses_random_engine() const { return n_thresholds > 0; };
+  /** The sums are updated for every annotation dimension. */
+  inline float get_sample_cost(const IDataProvider &dprov) const {
+    return 1.f + static_cast<float>(dprov.get_annot_vec_dim());
+  };
+  /** Per bin: the weighted annotation sums, the weight and the count. */
+  inline size_t get_histogram_stride(const IDataProvider &dprov) const {
+    return dprov.get_annot_vec_dim() + 2;
+  };
+  void fill_histograms(const IDataProvider &dprov, const size_t &feat_idx,
+                       const uint32_t *slots, double *const *hists) const;
   //@}
 
   inline friend std::ostream &operator<<(std::ostream &stream,
@@ -93,6 +136,20 @@ class RegressionOpt : public IThreshOpt {
   inline void optimize__sort(DeciderDesk &d) const;
   inline std::unique_ptr<std::vector<float>> optimize__thresholds(
       Desk *d) const;
+  inline void optimize__histogram(DeciderDesk &d) const;
+  /**
+   * \brief The sorted scan over the node samples.
+   *
+   * Instantiated for a fixed annotation dimension `AD` (0 for any) and with
+   * or without weights (see optimize__dispatch).
+   */
+  template <size_t AD, bool WEIGHTED>
+  inline void optimize__scan(DeciderDesk &d, SplitOptRes<float> &ret_res,
+                             const std::vector<float> *thresholds) const;
+  /** \brief Selects the scan kernel for the annotation dimension. */
+  template <bool WEIGHTED>
+  inline void optimize__dispatch(DeciderDesk &d, SplitOptRes<float> &ret_res,
+                                 const std::vector<float> *thresholds) const;
   friend class cereal::access;
   template <class Archive>
   void serialize(Archive &ar, const uint &) {
@@ -100,9 +157,12 @@ class RegressionOpt : public IThreshOpt {
        CEREAL_NVP(n_thresholds), CEREAL_NVP(gain_threshold));
   }
 
+ protected:
   size_t n_thresholds;
   float gain_threshold;
 
+ private:
+
   DISALLOW_COPY_AND_ASSIGN(RegressionOpt);
 };
 }  // namespace forpy
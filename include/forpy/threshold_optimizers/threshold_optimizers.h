@@ -3,6 +3,8 @@
 #define FORPY_THRESHOLD_OPTIMIZERS_H_
 
 #include "./classification_opt.h"
+#include "./extraclassopt.h"
+#include "./extraregopt.h"
 #include "./fastclassopt.h"
 #include "./ithreshopt.h"
 #include "./regression_opt.h"
@@ -20,6 +20,7 @@
 #include "./data_providers/fastdprov.h"
 #include "./data_providers/idataprovider.h"
 #include "./deciders/idecider.h"
+#include "./fasttree.h"
 #include "./leafs/ileaf.h"
 #include "./types.h"
 #include "./util/desk.h"
@@ -27,6 +28,40 @@
 namespace forpy {
 class Forest;
 
+/**
+ * \brief Number of row chunks per thread for multithreaded prediction.
+ *
+ * Using more chunks than threads balances rows with differing path lengths.
+ */
+const size_t PREDICT_CHUNKS_PER_THREAD = 4;
+
+/**
+ * \brief The maximum number of histogram values that are prepared at once
+ * for the nodes of a level during breadth first training (1GB).
+ */
+const size_t TREE_BFS_MAX_HISTOGRAM_VALUES = 1 << 27;
+
+/**
+ * \brief Statistics of one thread pool task of the tree training.
+ *
+ * A task trains the subtree below a node, except for the children that it
+ * spawns as tasks of their own. The estimate is the one of the node cost
+ * model (see NodeCostModel) for the nodes that the task processed itself.
+ */
+struct TaskStats {
+  /// The node the task started with.
+  id_t node_id;
+  size_t depth, n_samples;
+  /// The thread that ran the task.
+  int thread_id;
+  /// The number of nodes processed by the task.
+  size_t n_nodes;
+  /// The number of children spawned as tasks.
+  size_t n_spawned;
+  /// The estimated and the measured duration in seconds.
+  double estimated_s, actual_s;
+};
+
 /**
  * \brief The main tree class for the forpy framework.
  *
@@ -108,6 +143,33 @@ class Tree {
   void DFS_and_store(Desk *d, TodoMark &mark, const IDataProvider *dprov,
                      const ECompletionLevel &comp);
 
+  /**
+   * \brief The thread pool tasks of the last training run.
+   *
+   * Children are spawned as tasks if the cost model estimates that their
+   * subtree amortizes the task overhead. This allows to check the load
+   * balance of a training run.
+   */
+  inline const std::vector<TaskStats> &get_task_stats() const {
+    return task_stats;
+  };
+
+  /**
+   * \brief Train the subtrees of small nodes on node-local data copies.
+   *
+   * Once a node has at most this many samples, its feature values,
+   * annotations and weights are copied into contiguous buffers of the desk
+   * and its entire subtree is trained on them. This replaces the random
+   * accesses to the full data by accesses to cache resident data. 0 disables
+   * the copies (default). Deciders that require the global sample ids (see
+   * IDecider::uses_global_sample_ids) and sparse data providers always train
+   * on the full data.
+   */
+  inline void set_local_copy_samples(const size_t &n_samples) {
+    local_copy_samples = n_samples;
+  };
+  inline size_t get_local_copy_samples() const { return local_copy_samples; };
+
   /**
    * Get the tree depth.
    *
@@ -139,10 +201,14 @@ class Tree {
    *   is just set up, and \ref make_node must be called. Default: true.
    * \param weights vector<float>
    *   A vector with positive weights for each sample or an empty vector.
+   * \param search_type ESearchType
+   *   Whether to train depth first or level by level (see \ref BFS).
+   *   Default: DFS.
    */
   Tree *fit(const Data<MatCRef> &data_v, const Data<MatCRef> &annotation_v,
             const size_t &n_threads, const bool &complete_dfs = true,
-            const std::vector<float> &weights = std::vector<float>());
+            const std::vector<float> &weights = std::vector<float>(),
+            const ESearchType &search_type = ESearchType::DFS);
 
   /**
    * \brief The fitting function for a single tree.
@@ -153,13 +219,50 @@ class Tree {
    * may be performed step-by-step by calling the \ref BFS or \ref DFS
    * functions.
    *
+   * Every node draws from a random engine seeded by its position in the
+   * tree, so that the result does not depend on the number of threads or
+   * on the scheduling. Histogram splits with more than one thread are the
+   * exception (see \ref HistogramCache).
+   *
    * \param data_provider shared(IDataProvider)
    *   The data provider for the fitting process.
    * \param complete_dfs bool
    *   If true, complete the fitting process.
+   * \param search_type ESearchType
+   *   Whether to train depth first or level by level (see \ref BFS).
+   *   Default: DFS.
    */
   Tree *fit_dprov(std::shared_ptr<IDataProvider> data_provider,
-                  const bool &complete_dfs = true);
+                  const bool &complete_dfs = true,
+                  const ESearchType &search_type = ESearchType::DFS);
+
+  /**
+   * \brief Continue a breadth first training.
+   *
+   * All open nodes of one depth are processed together by the thread pool.
+   * If the decider evaluates all features at every node and the data
+   * provider has feature bins, the histograms of all large nodes of the
+   * level are accumulated first with one sequential pass over the bin codes
+   * per feature, instead of one gather per node and feature. The histograms
+   * of up to \ref TREE_BFS_MAX_HISTOGRAM_VALUES values are prepared at once.
+   *
+   * The data provider given to \ref fit_dprov must stay valid until the
+   * training is complete.
+   *
+   * Releases the GIL in Python!
+   *
+   * \param completion ECompletionLevel
+   *   Train the next open node, finish the current level, or complete the
+   *   tree.
+   * \return Whether the training is complete.
+   */
+  bool BFS(const ECompletionLevel &completion = ECompletionLevel::Level);
+
+  /** \brief The depth of the open nodes of a breadth first training. */
+  inline size_t get_bfs_depth() const {
+    return bfs_marks.empty() ? (bfs_next.empty() ? 0 : bfs_next[0].depth)
+                             : bfs_marks[0].depth;
+  };
 
   /**
    * \brief Get the leaf id of the leaf where the given data will arrive.
@@ -172,6 +275,20 @@ class Tree {
   id_t predict_leaf(const Data<MatCRef> &data, const id_t &start_node = 0,
                     const std::function<void(void *)> &dptf = nullptr) const;
 
+  /**
+   * \brief Get the leaf ids for a contiguous range of data rows.
+   *
+   * Uses the fast tree if it has been enabled. Does not allocate and may be
+   * called concurrently.
+   *
+   * \param data_v Variant of 2D data, row-major contiguous.
+   * \param start The first row to process.
+   * \param end The row after the last row to process.
+   * \param leaf_ids Pointer to storage for end - start leaf ids.
+   */
+  void predict_leaf_ids(const Data<MatCRef> &data_v, const size_t &start,
+                        const size_t &end, id_t *leaf_ids) const;
+
   /**
    * Predicts new data points.
    *
@@ -181,9 +298,13 @@ class Tree {
    *   The data predict with one sample per row.
    *
    * \param num_threads int>0
-   *   The number of threads to use for prediction. The number of
-   *   samples should be at least three times larger than the number
-   *   of threads to observe good parallelization behavior. Currently disabled.
+   *   The number of threads to use for prediction. The rows are split into
+   *   contiguous chunks that are processed by the prediction thread pool
+   *   and written directly into the result. The training thread pool is not
+   *   touched, so predictions may run concurrently with each other and with
+   *   training. The number of samples should be at least
+   *   three times larger than the number of threads to observe good
+   *   parallelization behavior.
    *
    * \param use_fast_prediction_if_available bool If set to true (default), this
    *   will create a compressed version of the tree that has particularly
@@ -212,6 +333,59 @@ class Tree {
                           const int &num_threads = 1,
                           const bool &use_fast_prediction_if_available = true);
 
+  /**
+   * \brief Predicts the rows of a CSR matrix with shape (n_samples x
+   * n_features).
+   *
+   * The rows are expanded to dense float blocks of bounded size that are
+   * predicted with \ref predict (see forpy::predict_sparse_rows). The
+   * thresholds must be float, e.g., from training with a SparseDProv.
+   */
+  Data<Mat> predict_sparse(const SparseMat &data, const int &num_threads = 1,
+                           const bool &predict_proba = false);
+
+  /**
+   * \brief Predicts a single sample with the fast tree.
+   *
+   * Does not allocate memory in steady state and does not construct
+   * variants, so it is suitable for low latency serving. Requires a
+   * previous call to \ref enable_fast_prediction. Thread safe.
+   *
+   * \param features Pointer to the contiguous features of the sample.
+   * \param out Storage for the result columns of \ref predict (class labels
+   *   are written as float).
+   * \param predict_proba Whether to provide the distribution of results.
+   */
+  template <typename IT>
+  void predict_one(const IT *features, float *out,
+                   const bool &predict_proba = false) const {
+    if (fast_tree.get() == nullptr)
+      throw ForpyException(
+          "predict_one requires a fast tree; call `enable_fast_prediction` "
+          "first!");
+    const id_t leaf_id = fast_tree->match(
+        [&](const auto &ftree) { return ftree.predict_leaf(features); });
+    float *acc = get_thread_scratch<float>(
+        leaf_manager->get_accumulator_columns(1, predict_proba));
+    leaf_manager->accumulate_result(leaf_id, 0, 1.f, acc, predict_proba);
+    leaf_manager->finalize_one(acc, 1, 1.f, predict_proba, out);
+  };
+
+  /**
+   * \brief Get the leaf ids for new data points.
+   *
+   * Releases the GIL in Python!
+   *
+   * \param data_v Variant of 2D data, row-major contiguous
+   *   The data with one sample per row.
+   *
+   * \param num_threads int>0
+   *   The number of threads to use (see \ref predict).
+   *
+   * \returns A matrix with one column and the leaf node id for every sample.
+   */
+  Mat<uint> apply(const Data<MatCRef> &data_v, const int &num_threads = 1);
+
   /**
    * \brief Get the data prediction result for the given data.
    */
@@ -291,6 +465,36 @@ class Tree {
    */
   void enable_fast_prediction();
 
+  /**
+   * \brief Packs the tree for fast predictions without storing the result.
+   *
+   * Has the same requirements as \ref enable_fast_prediction.
+   */
+  std::unique_ptr<FastTreeV> make_fast_tree() const;
+
+  /**
+   * \brief Renumbers the nodes for a cache friendly memory layout.
+   *
+   * Siblings are always stored next to each other. The decider and the leaf
+   * manager are permuted consistently, so the tree can be stored and
+   * predicted with as usual. An enabled fast tree is rebuilt with the new
+   * layout.
+   *
+   * \param layout ENodeLayout
+   *   The layout to use. The training order can not be restored.
+   * \param bfs_levels size_t
+   *   For ENodeLayout::SubtreeBlocked: the number of top levels to store in
+   *   breadth first order.
+   * \param block_depth size_t>0
+   *   For ENodeLayout::SubtreeBlocked: the depth of each block of subtrees
+   *   below.
+   */
+  void relayout(const ENodeLayout &layout = ENodeLayout::SubtreeBlocked,
+                const size_t &bfs_levels = 4, const size_t &block_depth = 3);
+
+  /** \brief The current node layout. */
+  inline ENodeLayout get_layout() const { return layout; };
+
   /**
    * Frees the memory from the unpacked trees for fast predictions.
    */
@@ -309,6 +513,20 @@ class Tree {
    */
   void save(const std::string &filename) const;
 
+  /**
+   * \brief Export the tree as self-contained C++ header (see generate_cpp).
+   *
+   * \param filename string
+   *   The header file to write.
+   * \param mode ECodegenMode
+   *   The code structure.
+   * \param name string
+   *   The namespace of the generated code.
+   */
+  void export_cpp(const std::string &filename,
+                  const ECodegenMode &mode = ECodegenMode::IfElse,
+                  const std::string &name = "forpy_tree") const;
+
   inline friend std::ostream &operator<<(std::ostream &stream,
                                          const Tree &self) {
     stream << "forpy::Tree[depth " << self.get_depth() << "]";
@@ -319,14 +537,64 @@ class Tree {
   friend class forpy::Forest;
   friend class cereal::access;
   template <class Archive>
-  void serialize(Archive &ar, const uint &) {
+  void serialize(Archive &ar, const uint &version) {
     ar(CEREAL_NVP(max_depth), CEREAL_NVP(is_initialized_for_training),
        CEREAL_NVP(min_samples_at_node), CEREAL_NVP(min_samples_at_leaf),
        CEREAL_NVP(weight), CEREAL_NVP(decider), CEREAL_NVP(leaf_manager),
        CEREAL_NVP(tree), CEREAL_NVP(stored_in_leafs), CEREAL_NVP(next_id),
        CEREAL_NVP(random_seed));
+    if (version > 0) ar(CEREAL_NVP(layout));
   };
 
+  /**
+   * Estimates the training time of the subtree below a node in seconds,
+   * assuming balanced splits.
+   */
+  double estimate_subtree(const size_t &n_samples, const size_t &depth,
+                          const IDataProvider &dprov) const;
+
+  /**
+   * Copies the samples of `mark` to the desk, trains its subtree on the
+   * copies and restores the order of the global sample ids.
+   */
+  void make_subtree_local(const TodoMark &mark, const IDataProvider &dprov,
+                          Desk *desk);
+
+  /** Points the desk to the storage of this tree. */
+  void setup_desk(Desk *d);
+
+  /**
+   * Resets the desk state that the split of a node depends on, so that every
+   * node starts from the same one, no matter which desk processes it.
+   */
+  void setup_node(const TodoMark &mark, Desk *d) const;
+
+  /** Sizes the node storage for a training run on the data provider. */
+  void reserve_nodes(const IDataProvider &dprov);
+
+  /** Shrinks the node storage to the trained nodes. */
+  void finalize_nodes();
+
+  /** Processes all open nodes of the current level. */
+  void BFS_level();
+
+  /**
+   * Accumulates the histograms of the large nodes of `level`, starting at
+   * `start`, with one pass per feature. Stops at `*end` before exceeding
+   * TREE_BFS_MAX_HISTOGRAM_VALUES and returns the histograms by node (from
+   * `start`) and feature. They are empty if they can not be prepared.
+   */
+  std::vector<std::vector<std::vector<double>>> BFS_histograms(
+      const std::vector<TodoMark> &level, const size_t &start, size_t *end);
+
+  /**
+   * Processes the nodes [start, end) of `level` with the thread pool and
+   * appends their children to `bfs_next`, in order.
+   */
+  void BFS_nodes(std::vector<TodoMark> *level, const size_t &start,
+                 const size_t &end,
+                 std::vector<std::vector<std::vector<double>>> *hists);
+
   /**
    * The maximum depth of the tree. Non-const for serialization purposes
    * only.
@@ -351,22 +619,30 @@ class Tree {
   std::shared_ptr<ILeaf> leaf_manager;
   /** Holds the entire tree structure. */
   std::vector<std::pair<id_t, id_t>> tree;
-  /** Pointer to a structure that can be used for fast predictions.
-
-      Vector ids are node ids. The first value in the tuple is the threshold
-      value at that node. If the first and second tuple elements are the same,
-      they contain a leaf ID.
-   */
-  std::unique_ptr<
-      mu::variant<std::vector<std::tuple<size_t, float, size_t, size_t>>,
-                  std::vector<std::tuple<size_t, double, size_t, size_t>>,
-                  std::vector<std::tuple<size_t, uint32_t, size_t, size_t>>,
-                  std::vector<std::tuple<size_t, uint8_t, size_t, size_t>>>>
-      fast_tree;
+  /** Pointer to a packed version of the tree for fast predictions (see
+      \ref FastTree). */
+  std::unique_ptr<FastTreeV> fast_tree;
   std::vector<std::future<void>> futures;
   std::mutex fut_mtx;
   std::atomic<id_t> next_id;
+  /** Guarded by fut_mtx. */
+  std::vector<TaskStats> task_stats;
+  /** The open nodes of the current level and the next level of a breadth
+   * first training. */
+  std::vector<TodoMark> bfs_marks, bfs_next;
+  /** The data provider of a breadth first training. */
+  std::shared_ptr<IDataProvider> bfs_dprov;
+  /** A unique id of the current training run (see HistogramCache::claim). */
+  size_t training_run = 0;
+  /** See \ref set_local_copy_samples. Not serialized. */
+  size_t local_copy_samples = 0;
+  /** The number of samples of the current training run, to number the node
+   * positions (see setup_node). Not serialized. */
+  size_t n_positions = 0;
   uint random_seed;
+  /** The node layout; the fast tree keeps it if it is not the training
+   * order. */
+  ENodeLayout layout;
   // If any, a deep copy must be made of a tree to guarantee consistency
   // between the tree layout and the saved features, classifiers and leafs.
   // This is disallowed for the first.
@@ -477,4 +753,6 @@ class RegressionTree : public Tree {
 };
 
 };      // namespace forpy
+
+CEREAL_CLASS_VERSION(forpy::Tree, 1);
 #endif  // FORPY_TREE_H_
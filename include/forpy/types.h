@@ -4,6 +4,7 @@
 #define FORPY_TYPES_H_
 
 #include <Eigen/Dense>
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <numeric>
@@ -121,6 +122,9 @@ struct SplitOptRes {
   FT thresh;
   float gain;
   bool valid;
+  /// The annotation statistics of the samples left of the split (see
+  /// TodoMark::stats), if the optimizer tracked them exactly. Otherwise empty.
+  std::vector<double> left_stats = {};
 
   inline friend std::ostream &operator<<(std::ostream &stream,
                                          const SplitOptRes<FT> &self) {
@@ -148,6 +152,7 @@ typedef std::pair<id_t, id_t> interv_t;
  *  -# interval of the list to work with,
  *  -# A node id (\ref id_t).
  *  -# The node's depth (uint).
+ *  -# Optionally the annotation statistics of the node samples.
  */
 struct TodoMark {
   inline TodoMark() : node_id(0), depth(0){};
@@ -162,6 +167,21 @@ struct TodoMark {
   interv_t interv;
   id_t node_id;
   uint depth;
+  /**
+   * The annotation statistics of the node samples, if they are known from the
+   * split of the parent node (see IThreshOpt::child_stats). Otherwise empty.
+   * The layout is defined by the threshold optimizer: the class weights for
+   * FastClassOpt and the weighted annotation sums, the weight and the
+   * weighted sum of squared annotations for RegressionOpt. They are a cache
+   * and neither compared nor serialized.
+   */
+  std::vector<double> stats;
+  /**
+   * The features that are constant on the node samples, if they are known
+   * from the optimization of the parent node, in ascending order. Like the
+   * statistics, they are a cache and neither compared nor serialized.
+   */
+  std::vector<id_t> invalid_features;
   inline bool operator==(TodoMark const &rhs) const {
     return node_id == rhs.node_id && depth == rhs.depth &&
            interv == rhs.interv && *sample_ids == *(rhs.sample_ids);
@@ -204,6 +224,74 @@ typedef std::pair<std::shared_ptr<std::vector<id_t>>, id_t> include_pair_t;
 /** Specifies the type of tree search. */
 enum class ESearchType { DFS, BFS };
 
+/**
+ * \brief Specifies the expected access pattern of memory mapped data (see
+ * MMapDProv::advise).
+ */
+enum class EAccessPattern {
+  /** No special treatment. */
+  Normal,
+  /** Read ahead aggressively, pages are dropped early after use. */
+  Sequential,
+  /** No read ahead, for the random sample accesses deep in the trees. */
+  Random,
+  /** Load the data into the page cache in the background. */
+  WillNeed
+};
+
+/**
+ * \brief Specifies the memory layout of the tree nodes.
+ */
+enum class ENodeLayout {
+  /** Node ids in the order they were created during training. */
+  Training,
+  /** Breadth first order. */
+  BreadthFirst,
+  /** Breadth first for the top levels, then blocks of subtrees that are
+   * stored contiguously. */
+  SubtreeBlocked
+};
+
+/**
+ * \brief Specifies the structure of exported C++ code (see generate_cpp).
+ */
+enum class ECodegenMode {
+  /** Nested if-else statements for every tree. */
+  IfElse,
+  /** Node arrays that are traversed for a fixed number of levels. */
+  Branchless
+};
+
+/**
+ * \brief Moves the element at position i of a vector to new_ids[i].
+ *
+ * new_ids must be a permutation of the positions of vec.
+ */
+template <typename T>
+inline void permute_ids(std::vector<T> *vec, const std::vector<id_t> &new_ids) {
+  std::vector<T> permuted(vec->size());
+  for (size_t idx = 0; idx < new_ids.size(); ++idx)
+    permuted[new_ids[idx]] = std::move((*vec)[idx]);
+  vec->swap(permuted);
+};
+
+/**
+ * \brief Zeroed scratch memory of the calling thread.
+ *
+ * The memory is only reallocated if more elements are requested than
+ * before, so that repeated calls with the same size do not allocate. The
+ * memory is valid until the next call from the same thread with the same
+ * type and slot; use different slots for buffers that are used at the same
+ * time.
+ */
+template <typename T, size_t SLOT = 0>
+inline T *get_thread_scratch(const size_t &size) {
+  thread_local std::vector<T> scratch;
+  if (scratch.size() < size) scratch.resize(size);
+  std::fill_n(scratch.data(), size, T(0));
+  return scratch.data();
+};
+
 /** \brief The type of a set of dimension selections. */
 typedef std::unordered_set<std::vector<size_t>, vector_hasher> proposal_set_t;
 
@@ -0,0 +1,77 @@
+/* Author: Christoph Lassner. */
+#pragma once
+#ifndef FORPY_UTIL_COSTMODEL_H_
+#define FORPY_UTIL_COSTMODEL_H_
+
+#include "../global.h"
+
+#include <cstddef>
+
+#include "../types.h"
+
+namespace forpy {
+
+/**
+ * \brief A subtree is only trained as a thread pool task if its estimated
+ * cost is at least this many times the overhead of a task.
+ */
+const float COSTMODEL_MIN_TASK_RATIO = 50.f;
+
+/**
+ * \brief The work to optimize one node, in machine independent units.
+ *
+ * See IDecider::estimate_work.
+ */
+struct NodeWork {
+  /// Comparisons for sorting, counted as n log2(n) per sorted sample list.
+  double compares;
+  /// Sample visits of linear passes, weighted with the relative cost of the
+  /// threshold optimizer per sample.
+  double scans;
+};
+
+/**
+ * \brief Estimates the time to train nodes and subtrees.
+ *
+ * The model converts the NodeWork of a node to seconds with per-machine
+ * constants, which are measured once per process with a few milliseconds of
+ * micro benchmarks, and compares it to the overhead of one thread pool task.
+ * Tree::make_node uses it to decide which children are offered to other
+ * threads.
+ */
+class NodeCostModel {
+ public:
+  NodeCostModel(const double &s_per_compare, const double &s_per_scan,
+                const double &s_per_task);
+
+  /**
+   * \brief The model for this machine.
+   *
+   * Calibrated on the first call (thread safe, may be called from within a
+   * pool task).
+   */
+  static const NodeCostModel &get();
+
+  /** \brief Runs the micro benchmarks. */
+  static NodeCostModel calibrate();
+
+  /** \brief The estimated time in seconds for the given work. */
+  inline double seconds(const NodeWork &work) const {
+    return work.compares * s_per_compare + work.scans * s_per_scan;
+  };
+
+  /** \brief Whether work of this duration amortizes a thread pool task. */
+  inline bool worth_task(const double &seconds) const {
+    return seconds >= COSTMODEL_MIN_TASK_RATIO * s_per_task;
+  };
+
+  inline double get_s_per_compare() const { return s_per_compare; };
+  inline double get_s_per_scan() const { return s_per_scan; };
+  inline double get_s_per_task() const { return s_per_task; };
+
+ private:
+  double s_per_compare, s_per_scan, s_per_task;
+};
+
+}  // namespace forpy
+#endif  // FORPY_UTIL_COSTMODEL_H_
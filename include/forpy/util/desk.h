@@ -4,9 +4,218 @@
 #define FORPY_UTIL_DESK_H_
 
 #include "../global.h"
+
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "../types.h"
 
 namespace forpy {
+class FeatureBins;
+class SparseMat;
+
+/**
+ * \brief The maximum number of histogram values kept per thread (32MB).
+ *
+ * If more are needed, the histograms of finished nodes are dropped first,
+ * then the oldest ones.
+ */
+const size_t HISTOGRAM_CACHE_MAX_VALUES = 1 << 22;
+
+/**
+ * \brief Histograms of recently optimized nodes for sibling subtraction.
+ *
+ * The histogram of a node over a feature is the sum of the histograms of its
+ * children. So if the parent and one child have been evaluated for a feature,
+ * the histogram of the other child is their difference and no pass over its
+ * samples is necessary.
+ *
+ * Since the trees are built depth first, the subtree of the first child of a
+ * node is complete before the second child is reached. The histograms of a
+ * node are hence kept until both its children are built and, if it is the
+ * first of two siblings, until its sibling is built.
+ *
+ * With more than one thread, a child may be built by another thread than
+ * its parent, and its histograms are then computed instead of derived. The
+ * two only differ by rounding. Weighted sample counts are exact as long as
+ * the weights are integers, so classification trees without weights do not
+ * depend on the scheduling. Otherwise, splits of nearly equal quality may.
+ *
+ * @ingroup forpydeskGroup
+ */
+struct HistogramCache {
+  struct Entry {
+    size_t n_samples;
+    std::unordered_map<size_t, std::vector<double>> hists;
+    /// The features with histograms that have been filled by put.
+    std::unordered_set<size_t> given;
+    /// The order in which the nodes were created.
+    size_t stamp = 0;
+    /// The node is split and its second child has not been built yet.
+    bool children_pending = false;
+    /// The node is the first of two siblings, the other is not built yet.
+    bool sibling_pending = false;
+    /// The histograms of the node will not be used anymore.
+    inline bool finished() const {
+      return !children_pending && !sibling_pending;
+    };
+  };
+  /// The cached histograms by node id and feature.
+  std::unordered_map<id_t, Entry> entries;
+  /// Maps a child node id to the ids of its parent and sibling.
+  std::unordered_map<id_t, std::pair<id_t, id_t>> family;
+  /// The number of values in all cached histograms.
+  size_t n_values = 0;
+  /// The number of histograms that were derived by subtraction.
+  size_t n_derived = 0;
+  /// Identifies the training run that the node ids belong to.
+  size_t owner = 0;
+
+  /**
+   * \brief Get storage for the histogram of a node over a feature.
+   *
+   * \param node_id The id of the node.
+   * \param n_samples The number of samples at the node.
+   * \param feat_idx The feature index.
+   * \param size The number of histogram values.
+   * \param derived Is set to true if the histogram could be derived from the
+   *   parent and sibling histograms. Otherwise the returned storage is zeroed
+   *   and must be filled by the caller.
+   */
+  inline double *get(const id_t &node_id, const size_t &n_samples,
+                     const size_t &feat_idx, const size_t &size,
+                     bool *derived) {
+    while (n_values + size > HISTOGRAM_CACHE_MAX_VALUES && evict(node_id)) {
+    }
+    Entry &entry = touch(node_id, n_samples);
+    auto &hist = entry.hists[feat_idx];
+    if (entry.given.erase(feat_idx) > 0 && hist.size() == size) {
+      *derived = true;
+      return &hist[0];
+    }
+    n_values -= hist.size();
+    hist.assign(size, 0.);
+    n_values += size;
+    *derived = false;
+    const auto fam_it = family.find(node_id);
+    if (fam_it == family.end()) return &hist[0];
+    const auto parent_it = entries.find(fam_it->second.first);
+    const auto sibling_it = entries.find(fam_it->second.second);
+    if (parent_it == entries.end() || sibling_it == entries.end())
+      return &hist[0];
+    const auto p_hist_it = parent_it->second.hists.find(feat_idx);
+    const auto s_hist_it = sibling_it->second.hists.find(feat_idx);
+    if (p_hist_it == parent_it->second.hists.end() ||
+        s_hist_it == sibling_it->second.hists.end() ||
+        p_hist_it->second.size() != size || s_hist_it->second.size() != size)
+      return &hist[0];
+    const double *parent_p = &p_hist_it->second[0];
+    const double *sibling_p = &s_hist_it->second[0];
+    for (size_t i = 0; i < size; ++i) hist[i] = parent_p[i] - sibling_p[i];
+    *derived = true;
+    ++n_derived;
+    // The sibling subtree is complete. The parent is still needed if its own
+    // sibling has not been built yet.
+    if (sibling_it->second.finished()) {
+      n_values -= size;
+      sibling_it->second.hists.erase(s_hist_it);
+    }
+    if (parent_it->second.finished()) {
+      n_values -= size;
+      parent_it->second.hists.erase(p_hist_it);
+    }
+    return &hist[0];
+  };
+
+  /**
+   * \brief Provide a complete histogram of a node over a feature.
+   *
+   * The next call to get for this node and feature returns it as derived.
+   */
+  inline void put(const id_t &node_id, const size_t &n_samples,
+                  const size_t &feat_idx, std::vector<double> &&hist) {
+    Entry &entry = touch(node_id, n_samples);
+    auto &stored = entry.hists[feat_idx];
+    n_values -= stored.size();
+    stored = std::move(hist);
+    n_values += stored.size();
+    entry.given.insert(feat_idx);
+  };
+
+  /** \brief Register the children of a split node. */
+  inline void add_children(const id_t &parent_id, const id_t &left_id,
+                           const id_t &right_id) {
+    family[left_id] = std::make_pair(parent_id, right_id);
+    family[right_id] = std::make_pair(parent_id, left_id);
+    const auto parent_it = entries.find(parent_id);
+    if (parent_it != entries.end()) parent_it->second.children_pending = true;
+  };
+
+  inline void clear() {
+    entries.clear();
+    family.clear();
+    n_values = 0;
+    stamp = 0;
+  };
+
+  /**
+   * \brief Keep the histograms only if they stem from the same training run.
+   *
+   * The cache outlives a task, so that a child node that has been pushed to
+   * the thread pool and is then processed by the same thread can still be
+   * derived.
+   */
+  inline void claim(const size_t &training_run) {
+    if (training_run == owner) return;
+    clear();
+    owner = training_run;
+  };
+
+ private:
+  /// The stamp of the last created node.
+  size_t stamp = 0;
+
+  /** Finds or creates the entry of a node and updates its family. */
+  inline Entry &touch(const id_t &node_id, const size_t &n_samples) {
+    const auto inserted = entries.emplace(node_id, Entry());
+    Entry &entry = inserted.first->second;
+    entry.n_samples = n_samples;
+    if (!inserted.second) return entry;
+    entry.stamp = ++stamp;
+    const auto fam_it = family.find(node_id);
+    if (fam_it == family.end()) return entry;
+    const auto parent_it = entries.find(fam_it->second.first);
+    if (parent_it != entries.end()) {
+      // Unless the sibling is built, this is the first child.
+      const auto sibling_it = entries.find(fam_it->second.second);
+      if (sibling_it == entries.end()) {
+        entry.sibling_pending = true;
+      } else {
+        sibling_it->second.sibling_pending = false;
+        parent_it->second.children_pending = false;
+      }
+    }
+    return entry;
+  };
+
+  /** Drops the oldest finished node other than keep_id, or the oldest one. */
+  inline bool evict(const id_t &keep_id) {
+    auto victim = entries.end();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+      if (it->first == keep_id) continue;
+      if (victim == entries.end() ||
+          (it->second.finished() && !victim->second.finished()) ||
+          (it->second.finished() == victim->second.finished() &&
+           it->second.stamp < victim->second.stamp))
+        victim = it;
+    }
+    if (victim == entries.end()) return false;
+    for (const auto &hist : victim->second.hists) n_values -= hist.second.size();
+    entries.erase(victim);
+    return true;
+  };
+};
 
 /**
  * \brief Desk for tree training.
@@ -29,6 +238,26 @@ struct TreeDesk {
   /** A vector representation of the tree. Usually points to forpy::Tree::tree.
    */
   std::vector<std::pair<id_t, id_t>> *tree_p;
+  /** The estimated duration of the nodes processed by the current task. */
+  double task_estimate = 0.;
+  /** Nodes processed and children spawned by the current task. */
+  size_t task_nodes = 0, task_spawned = 0;
+  /** Whether children may be spawned as tasks. Otherwise they are marked. */
+  bool may_spawn = true;
+
+  //@{
+  /// Node-local copies of the data of the subtree that is trained (see
+  /// Tree::set_local_copy_samples). The buffers keep their capacity.
+  bool is_local = false;
+  Data<Mat> local_data, local_annotations;
+  std::shared_ptr<std::vector<float>> local_weights;
+  std::shared_ptr<FeatureBins> local_bins;
+  /// The local sample ids and the global ids they stand for.
+  std::shared_ptr<std::vector<id_t>> local_ids;
+  std::vector<id_t> global_ids;
+  /// The position of the first local sample in the global sample ids.
+  size_t local_offset = 0;
+  //@}
 
   /**
    * \brief Set up all the internal pointers.
@@ -47,6 +276,11 @@ struct TreeDesk {
     stored_in_leafs = nullptr;
     next_id_p = nullptr;
     tree_p = nullptr;
+    task_estimate = 0.;
+    task_nodes = 0;
+    task_spawned = 0;
+    may_spawn = true;
+    is_local = false;
   }
 };
 
@@ -68,14 +302,41 @@ struct DeciderDesk {
   /// pointer points to element 1.
   id_t *elem_id_p;
   id_t start_id, end_id, node_id;
+  /// The statistics of the node samples from TodoMark::stats or nullptr if
+  /// they are unknown.
+  const std::vector<double> *node_stats = nullptr;
   //@}
 
   //@{
   /// Variables used during the threshold optimization.
   OptSplitV best_res_v, opt_res_v;
-  id_t best_feat_idx;
+  id_t best_feat_idx = 0;
   bool presorted, need_sort;
   std::vector<id_t> feature_indices;
+  /// The feature that IThreshOpt::optimize evaluates.
+  size_t feat_idx = 0;
+  /// The quantized features of the data provider or nullptr. If set, the
+  /// threshold optimizers use histograms instead of sorting.
+  const FeatureBins *bins = nullptr;
+  HistogramCache hist_cache;
+  std::vector<double> hist_sums;
+  /// Buffer for partitioning presorted sample lists.
+  std::vector<id_t> partition_buf;
+  /// The sample order of a node before its features are evaluated
+  /// concurrently, and the copy that one feature evaluation sorts.
+  std::vector<id_t> node_ids, eval_ids;
+  /// Whether the gathers from the full feature columns prefetch. Not for
+  /// node-local copies of the data, which are cache resident.
+  bool prefetch = true;
+  /// The sparse features of the data provider or nullptr. If set, the
+  /// threshold optimizers only visit the nonzero values of the node.
+  const SparseMat *sparse = nullptr;
+  /// The samples of the current node have the mark sparse_mark in
+  /// sparse_marks (see mark_sparse_samples).
+  std::vector<uint32_t> sparse_marks;
+  uint32_t sparse_mark = 0;
+  /// The nonzero values of the node for one feature and their sample ids.
+  std::vector<std::pair<float, id_t>> sparse_values;
   //@}
 
   //@{
@@ -97,6 +358,13 @@ struct DeciderDesk {
   DataV class_feat_values;
   std::vector<float> left_sum_vec;
   float *left_sum_p;
+  /// The statistics of the node samples in the layout of TodoMark::stats.
+  std::vector<double> full_stats;
+  /// Per sample id: the dot product of the annotation with the node
+  /// annotation sums and its squared norm (see RegressionOpt).
+  std::vector<double> annot_dots;
+  /// The left annotation sums in double precision.
+  std::vector<double> left_dsum_vec;
   //@}
 
   /// Must be initialized before calling IThreshOpt::optimize. Points to the
@@ -112,14 +380,19 @@ struct DeciderDesk {
   // These only contain valid values if `make_to_leaf` is false.
   interv_t left_int, right_int;
   id_t left_id, right_id;
+  /// The statistics of the children for TodoMark::stats. Empty if unknown.
+  std::vector<double> left_stats, right_stats;
+  /// The features that are constant on the node samples and hence on the
+  /// children, for TodoMark::invalid_features.
+  std::vector<id_t> child_invalid;
   //@}
 
-  /// Stores the number of elements in a vector of feature IDs that have been
-  /// determined as invalid (e.g., because they are constant). For these values
-  /// to work correctly, only DFS may be used (otherwise, the vector of features
-  /// may be re-sorted and counts may become invalid before the node
-  /// optimization reaches relevant nodes).
-  std::vector<size_t> invalid_counts;
+  /// The features of the node that are known to be constant from its parent
+  /// (TodoMark::invalid_features) or nullptr.
+  const std::vector<id_t> *known_invalid = nullptr;
+  /// The number of features at the front of feature_indices that have been
+  /// determined as invalid (e.g., because they are constant).
+  size_t invalid_count = 0;
 
   /// Pointer to a shared vector of a mapping node_id->feature. Since multiple
   /// threads never write to the same node and the vector is guaranteed to be
@@ -137,8 +410,26 @@ struct DeciderDesk {
                   std::vector<uint32_t>, std::vector<uint8_t>> *nttp) {
     node_to_featsel_p = ntfp;
     node_to_thresh_v_p = nttp;
-    if (ntfp != nullptr) invalid_counts.resize(ntfp->size());
   }
+  /**
+   * \brief Advances sparse_mark and sets it for `n` samples.
+   *
+   * The marks are only reset when the counter would wrap around, so that
+   * marking the samples of a node costs O(n) and not O(n_total). One more
+   * mark can always be taken with `++sparse_mark`.
+   */
+  inline void mark_sparse_samples(const id_t *ids, const size_t &n,
+                                  const size_t &n_total) {
+    if (sparse_marks.size() < n_total) sparse_marks.resize(n_total, 0);
+    if (sparse_mark >= std::numeric_limits<uint32_t>::max() - 1) {
+      std::fill(sparse_marks.begin(), sparse_marks.end(), 0);
+      sparse_mark = 0;
+    }
+    ++sparse_mark;
+    uint32_t *marks_p = &sparse_marks[0];
+    for (size_t i = 0; i < n; ++i) marks_p[ids[i]] = sparse_mark;
+  };
+
   inline void reset() {
     n_samples = input_dim = annot_dim = 0;
     min_samples_at_leaf = 0;
@@ -146,9 +437,15 @@ struct DeciderDesk {
     weights_p = nullptr;
     full_w = 0.f;
     start_id = end_id = node_id = 0;
+    node_stats = nullptr;
     node_to_featsel_p = nullptr;
     node_to_thresh_v_p = nullptr;
-    invalid_counts.clear();
+    known_invalid = nullptr;
+    invalid_count = 0;
+    bins = nullptr;
+    sparse = nullptr;
+    prefetch = true;
+    // hist_cache is kept, see HistogramCache::claim.
   }
 };
 
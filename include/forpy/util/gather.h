@@ -0,0 +1,42 @@
+/* Author: Christoph Lassner. */
+#pragma once
+#ifndef FORPY_UTIL_GATHER_H_
+#define FORPY_UTIL_GATHER_H_
+
+#include "../global.h"
+
+#include <cstddef>
+
+#include "../types.h"
+
+namespace forpy {
+
+/**
+ * \brief How many elements ahead a gather prefetches.
+ *
+ * Large enough to hide the latency of a main memory access behind the copies
+ * in between, small enough that the prefetched lines are not evicted again.
+ */
+const size_t GATHER_PREFETCH_DISTANCE = 16;
+
+/**
+ * \brief Copies `src[ids[i]]` to `dst[i]` for `i < n`.
+ *
+ * \param prefetch Whether to prefetch the sources ahead. Only worth it if
+ *   they are unlikely to be cached, e.g., for large nodes of large data.
+ */
+template <typename T>
+inline void gather(const T *src, const id_t *ids, const size_t &n, T *dst,
+                   const bool &prefetch) {
+  size_t i = 0;
+  if (prefetch && n > GATHER_PREFETCH_DISTANCE) {
+    for (; i < n - GATHER_PREFETCH_DISTANCE; ++i) {
+      FPREFETCH(src + ids[i + GATHER_PREFETCH_DISTANCE]);
+      dst[i] = src[ids[i]];
+    }
+  }
+  for (; i < n; ++i) dst[i] = src[ids[i]];
+};
+
+}  // namespace forpy
+#endif  // FORPY_UTIL_GATHER_H_
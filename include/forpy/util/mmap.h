@@ -0,0 +1,47 @@
+/* Author: Christoph Lassner. */
+#pragma once
+#ifndef FORPY_UTIL_MMAP_H_
+#define FORPY_UTIL_MMAP_H_
+
+#include "../global.h"
+
+#include <cstddef>
+#include <string>
+
+#include "../types.h"
+
+namespace forpy {
+
+/**
+ * \brief A read-only memory mapping of an entire file.
+ *
+ * The pages are loaded by the operating system on access and may be evicted
+ * again under memory pressure, so files larger than the main memory can be
+ * used. Uses `mmap` and is only available on POSIX systems.
+ */
+class MappedFile {
+ public:
+  /** \brief Maps the file. Throws if it can not be opened or is empty. */
+  explicit MappedFile(const std::string &filename);
+  ~MappedFile();
+
+  inline const char *data() const { return data_p; };
+  inline size_t size() const { return length; };
+  inline const std::string &get_filename() const { return filename; };
+
+  /**
+   * \brief Gives the operating system a hint how the bytes [offset, offset +
+   * n_bytes) will be accessed.
+   */
+  void advise(const EAccessPattern &pattern, const size_t &offset,
+              const size_t &n_bytes) const;
+
+ private:
+  std::string filename;
+  const char *data_p;
+  size_t length;
+  DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+}  // namespace forpy
+#endif  // FORPY_UTIL_MMAP_H_
@@ -0,0 +1,70 @@
+/* Author: Christoph Lassner. */
+#pragma once
+#ifndef FORPY_UTIL_SORT_IDS_H_
+#define FORPY_UTIL_SORT_IDS_H_
+
+#include "../global.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <skasort.hpp>
+
+#include "../types.h"
+
+namespace forpy {
+
+/**
+ * \brief Sorts the samples of a node by their feature values.
+ *
+ * \param feat_p The feature values of the samples `elem_id_p`. Sorted in
+ *   place.
+ * \param elem_id_p The sample ids. Sorted in place.
+ * \param full_feat_p The feature values of all samples.
+ * \param sort_perm_p A permutation of 0, ..., n - 1 used as scratch space.
+ * \param buffer_p Scratch space for n ids.
+ */
+template <typename IT>
+inline void sort_ids_by_feature(IT *feat_p, id_t *elem_id_p, const size_t &n,
+                                const IT *full_feat_p, size_t *sort_perm_p,
+                                id_t *buffer_p) {
+  ska_sort(sort_perm_p, sort_perm_p + n,
+           [&](const size_t &i1) { return feat_p[i1]; });
+  for (size_t w_idx = 0; w_idx < n; ++w_idx) {
+    const id_t sample_id = elem_id_p[sort_perm_p[w_idx]];
+    buffer_p[w_idx] = sample_id;
+    feat_p[w_idx] = full_feat_p[sample_id];
+  }
+  std::copy(buffer_p, buffer_p + n, elem_id_p);
+};
+
+/**
+ * \brief Sorts by a stable counting sort in O(n + 256) for byte features.
+ *
+ * The feature values need not be gathered again, since they are known from
+ * the buckets.
+ */
+template <>
+inline void sort_ids_by_feature<uint8_t>(uint8_t *feat_p, id_t *elem_id_p,
+                                         const size_t &n,
+                                         const uint8_t * /*full_feat_p*/,
+                                         size_t * /*sort_perm_p*/,
+                                         id_t *buffer_p) {
+  std::array<size_t, 257> offsets;
+  offsets.fill(0);
+  for (size_t i = 0; i < n; ++i) ++offsets[feat_p[i] + 1];
+  for (size_t val = 1; val < offsets.size(); ++val)
+    offsets[val] += offsets[val - 1];
+  for (size_t i = 0; i < n; ++i) buffer_p[offsets[feat_p[i]]++] = elem_id_p[i];
+  // Now offsets[val] is the end of the bucket of val.
+  std::copy(buffer_p, buffer_p + n, elem_id_p);
+  size_t start = 0;
+  for (size_t val = 0; val < 256 && start < n; ++val) {
+    std::fill(feat_p + start, feat_p + offsets[val], static_cast<uint8_t>(val));
+    start = offsets[val];
+  }
+};
+
+}  // namespace forpy
+#endif  // FORPY_UTIL_SORT_IDS_H_
@@ -26,6 +26,7 @@
 
 #include "../../global.h"
 
+#include <algorithm>
 #include <atomic>
 #include <exception>
 #include <functional>
@@ -297,6 +298,11 @@ class thread_pool {
 };
 }  // namespace threading
 
+/**
+ * \brief The thread pool used for training.
+ *
+ * Uses the threading::thread_pool with its shared task queue.
+ */
 class ThreadControl {
  private:
   inline ThreadControl() : ttp() {
@@ -376,6 +382,75 @@ class ThreadControl {
   }
 };
 
+/**
+ * \brief The thread pool used for prediction.
+ *
+ * Kept separate from the ThreadControl pool, so that a prediction never
+ * resizes the pool of a running training. The pool only grows and does so
+ * under a lock, hence concurrent predictions with different numbers of
+ * threads can share it.
+ */
+class PredictionPool {
+ private:
+  inline PredictionPool() : tp(0) {}
+  DISALLOW_COPY_AND_ASSIGN(PredictionPool);
+  std::mutex mtx;
+  threading::thread_pool tp;
+
+ public:
+  inline static PredictionPool &getInstance() {
+    static PredictionPool instance;
+    return instance;
+  }
+
+  /**
+   * \brief Calls fn(chunk_idx) for every chunk in [0, n_chunks) on at most
+   * n_threads threads, including the calling one.
+   *
+   * The chunks are handed out dynamically. Blocks until all of them are
+   * processed and rethrows the first exception that occurred.
+   */
+  template <typename F>
+  void run(const size_t &n_threads, const size_t &n_chunks, const F &fn) {
+    const size_t n_workers = std::min(n_threads, n_chunks);
+    if (n_workers <= 1) {
+      for (size_t chunk_idx = 0; chunk_idx < n_chunks; ++chunk_idx)
+        fn(chunk_idx);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (static_cast<size_t>(tp.size()) < n_workers - 1)
+        tp.resize(static_cast<int>(n_workers - 1));
+    }
+    std::atomic<size_t> next_chunk(0);
+    auto work = [&next_chunk, &n_chunks, &fn](Desk *) {
+      for (size_t chunk_idx = next_chunk++; chunk_idx < n_chunks;
+           chunk_idx = next_chunk++)
+        fn(chunk_idx);
+    };
+    std::vector<std::future<void>> futures;
+    futures.reserve(n_workers - 1);
+    for (size_t worker = 1; worker < n_workers; ++worker)
+      futures.emplace_back(tp.push(work));
+    std::exception_ptr error;
+    try {
+      work(nullptr);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    // All workers reference this frame, so wait for every one of them.
+    for (auto &fut : futures) {
+      try {
+        fut.get();
+      } catch (...) {
+        if (!error) error = std::current_exception();
+      }
+    }
+    if (error) std::rethrow_exception(error);
+  }
+};
+
 }  // namespace forpy
 
 #endif  // FORPY_UTIL_THREADING_CTPL_H_
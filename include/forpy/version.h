@@ -0,0 +1,7 @@
+// The library version information.
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-function"
+static unsigned int FORPY_LIB_VERSION() { return 205U; }
+#pragma clang diagnostic pop
+// OpenCV availability information.
+/* #undef WITH_OPENCV */
@@ -0,0 +1,197 @@
+#include <forpy/codegen.h>
+#include <forpy/deciders/fastdecider.h>
+#include <forpy/fasttree.h>
+#include <forpy/tree.h>
+
+namespace forpy {
+namespace {
+/** Writes the nested tests of the subtree at pos. */
+template <typename T>
+void write_ifelse(std::stringstream &ss, const FastTree<T> &ftree,
+                  const uint32_t &pos, const Mat<float> &leaf_values,
+                  const size_t &indent) {
+  const std::string ind(indent, ' ');
+  const FastNode<T> &node = ftree.nodes[pos];
+  if (node.is_leaf()) {
+    const auto leaf_idx = node.child & ~FAST_LEAF_FLAG;
+    for (size_t col = 0; col < static_cast<size_t>(leaf_values.cols());
+         ++col)
+      if (leaf_values(leaf_idx, col) != 0.f)
+        ss << ind << "acc[" << col
+           << "] += " << cpp_literal(leaf_values(leaf_idx, col)) << ";\n";
+    return;
+  }
+  ss << ind << "if (x[" << node.feature
+     << "] <= " << cpp_literal(node.threshold) << ") {\n";
+  write_ifelse(ss, ftree, node.child, leaf_values, indent + 2);
+  ss << ind << "} else {\n";
+  write_ifelse(ss, ftree, node.child + 1, leaf_values, indent + 2);
+  ss << ind << "}\n";
+};
+
+/** The number of tests on the longest path from the root. */
+template <typename T>
+size_t get_fast_depth(const FastTree<T> &ftree, const uint32_t &pos) {
+  const FastNode<T> &node = ftree.nodes[pos];
+  if (node.is_leaf()) return 0;
+  return 1 + std::max(get_fast_depth(ftree, node.child),
+                      get_fast_depth(ftree, node.child + 1));
+};
+
+template <typename T>
+void write_branchless(std::stringstream &ss, const FastTree<T> &ftree,
+                      const size_t &tree_idx, const Mat<float> &leaf_values) {
+  const std::string prefix = "tree_" + std::to_string(tree_idx);
+  ss << "const node_t " << prefix << "_nodes[] = {\n";
+  for (const auto &node : ftree.nodes) {
+    if (node.is_leaf())
+      ss << "    {0u, " << (node.child & ~FAST_LEAF_FLAG) << "u, "
+         << cpp_literal(static_cast<T>(0)) << ", 0u},\n";
+    else
+      ss << "    {" << node.feature << "u, " << node.child << "u, "
+         << cpp_literal(node.threshold) << ", 1u},\n";
+  }
+  ss << "};\n";
+  ss << "const float " << prefix << "_leafs[] = {\n";
+  for (size_t leaf_idx = 0; leaf_idx < static_cast<size_t>(leaf_values.rows());
+       ++leaf_idx) {
+    ss << "   ";
+    for (size_t col = 0; col < static_cast<size_t>(leaf_values.cols()); ++col)
+      ss << " " << cpp_literal(leaf_values(leaf_idx, col)) << ",";
+    ss << "\n";
+  }
+  ss << "};\n";
+  ss << "inline void " << prefix << "(const input_t *x, float *acc) {\n"
+     << "  unsigned int pos = 0;\n"
+     << "  for (unsigned int level = 0; level < "
+     << get_fast_depth(ftree, 0) << "u; ++level) {\n"
+     << "    const node_t &node = " << prefix << "_nodes[pos];\n"
+     << "    const unsigned int next = node.child + static_cast<unsigned "
+        "int>(!(x[node.feature] <= node.threshold));\n"
+     << "    pos = node.inner ? next : pos;\n"
+     << "  }\n"
+     << "  const float *leaf = " << prefix << "_leafs + " << prefix
+     << "_nodes[pos].child * n_acc;\n"
+     << "  for (unsigned int col = 0; col < n_acc; ++col) acc[col] += "
+        "leaf[col];\n"
+     << "}\n";
+};
+}  // namespace
+
+std::string generate_cpp(const std::vector<const Tree *> &trees,
+                         const Vec<float> &weights, const ECodegenMode &mode,
+                         const std::string &name) {
+  if (trees.empty()) throw ForpyException("No trees to export!");
+  if (weights.rows() != 0 &&
+      static_cast<size_t>(weights.rows()) != trees.size())
+    throw ForpyException("Invalid number of weights provided!");
+  if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0])) ||
+      name.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVW"
+                             "XYZ0123456789_") != std::string::npos)
+    throw ForpyException("The name must be a valid C++ identifier: " + name);
+  const size_t n_trees = trees.size();
+  const ILeaf *lm = trees[0]->get_leaf_manager().get();
+  const size_t n_acc = lm->get_accumulator_columns(n_trees, false);
+  const size_t n_outputs = lm->get_result_columns(n_trees, false, false);
+  std::string result_type;
+  lm->get_result_type(false, false)
+      .match(
+          [&](const auto &restype) {
+            typedef typename get_core<decltype(restype.data())>::type RT;
+            result_type = cpp_type_name<RT>();
+          },
+          [](const Empty &) { throw EmptyException(); });
+  std::vector<const FastDecider *> deciders;
+  for (const auto &tree : trees) {
+    const auto *dec =
+        dynamic_cast<FastDecider const *>(tree->get_decider().get());
+    if (dec == nullptr)
+      throw ForpyException(
+          "Only trees with threshold deciders can be exported to C++.");
+    deciders.push_back(dec);
+  }
+  std::stringstream ss;
+  deciders[0]->get_maps().second->match(
+      [&](const auto &threshold_map0) {
+        typedef typename std::remove_const<typename std::remove_reference<
+            decltype(*threshold_map0.data())>::type>::type thresh_t;
+        std::string guard = "FORPY_GENERATED_" + name + "_H_";
+        std::transform(guard.begin(), guard.end(), guard.begin(), ::toupper);
+        ss << "// Generated by forpy " << FORPY_LIB_VERSION() / 100 << "."
+           << std::setw(2) << std::setfill('0') << FORPY_LIB_VERSION() % 100
+           << " ("
+           << (mode == ECodegenMode::IfElse ? "if-else" : "branchless")
+           << " mode, " << n_trees << " trees). Do not edit.\n"
+           << "#pragma once\n"
+           << "#ifndef " << guard << "\n"
+           << "#define " << guard << "\n\n"
+           << "#include <limits>\n\n"
+           << "namespace " << name << " {\n"
+           << "typedef " << cpp_type_name<thresh_t>() << " input_t;\n"
+           << "typedef " << result_type << " result_t;\n"
+           << "/** The number of features of a sample. */\n"
+           << "const unsigned int n_features = "
+           << deciders[0]->get_data_dim() << "u;\n"
+           << "/** The number of result values per sample. */\n"
+           << "const unsigned int n_outputs = " << n_outputs << "u;\n\n"
+           << "namespace detail {\n"
+           << "const unsigned int n_acc = " << n_acc << "u;\n";
+        if (mode == ECodegenMode::Branchless)
+          ss << "struct node_t {\n"
+             << "  unsigned int feature;\n"
+             << "  /** Left child position (inner nodes) or leaf index. */\n"
+             << "  unsigned int child;\n"
+             << "  input_t threshold;\n"
+             << "  unsigned int inner;\n"
+             << "};\n";
+        for (size_t tree_idx = 0; tree_idx < n_trees; ++tree_idx) {
+          const Tree *tree = trees[tree_idx];
+          auto maps = deciders[tree_idx]->get_maps();
+          if (!maps.second->template is<std::vector<thresh_t>>())
+            throw ForpyException(
+                "All trees must use the same threshold type for export!");
+          const FastTree<thresh_t> ftree(
+              tree->get_tree(), *(maps.first),
+              maps.second->template get_unchecked<std::vector<thresh_t>>());
+          // The accumulator contribution of every leaf.
+          Mat<float> leaf_values(
+              Mat<float>::Zero(ftree.leaf_ids.size(), n_acc));
+          const float weight =
+              weights.rows() == 0 ? 1.f : weights(tree_idx);
+          for (size_t leaf_idx = 0; leaf_idx < ftree.leaf_ids.size();
+               ++leaf_idx)
+            tree->get_leaf_manager()->accumulate_result(
+                ftree.leaf_ids[leaf_idx], tree_idx, weight,
+                leaf_values.data() + leaf_idx * n_acc, false);
+          if (mode == ECodegenMode::IfElse) {
+            ss << "inline void tree_" << tree_idx
+               << "(const input_t *x, float *acc) {\n";
+            write_ifelse(ss, ftree, 0, leaf_values, 2);
+            ss << "}\n";
+          } else {
+            write_branchless(ss, ftree, tree_idx, leaf_values);
+          }
+        }
+        ss << "}  // namespace detail\n\n"
+           << "/** Computes the n_outputs result values for sample x. */\n"
+           << "inline void predict(const input_t *x, result_t *out) {\n"
+           << "  float acc[detail::n_acc] = {};\n";
+        for (size_t tree_idx = 0; tree_idx < n_trees; ++tree_idx)
+          ss << "  detail::tree_" << tree_idx << "(x, acc);\n";
+        ss << lm->get_export_finalizer(n_trees, weights) << "}\n\n"
+           << "/** Computes the first result value for sample x. */\n"
+           << "inline result_t predict(const input_t *x) {\n"
+           << "  result_t out[n_outputs];\n"
+           << "  predict(x, out);\n"
+           << "  return out[0];\n"
+           << "}\n"
+           << "}  // namespace " << name << "\n"
+           << "#endif  // " << guard << "\n";
+      },
+      [](const Empty &) {
+        throw ForpyException("Received empty threshold map!");
+      });
+  return ss.str();
+};
+
+}  // namespace forpy
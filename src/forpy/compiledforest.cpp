@@ -0,0 +1,166 @@
+#include <forpy/compiledforest.h>
+#include <forpy/forest.h>
+#include <forpy/tree.h>
+
+namespace forpy {
+namespace {
+/** Predicts with n_trees contiguous compiled trees and finalizes. */
+Data<Mat> predict_compiled(const CompiledTree *trees, const size_t &n_trees,
+                           const Vec<float> &weights, const ILeaf *lm,
+                           const Data<MatCRef> &data_v,
+                           const bool &predict_proba) {
+  Data<Mat> result_v;
+  data_v.match(
+      [&](const auto &data) {
+        if (static_cast<size_t>(data.cols()) !=
+            trees[0].get_input_data_dimensions())
+          throw ForpyException(
+              "Wrong array shape! Expecting " +
+              std::to_string(trees[0].get_input_data_dimensions()) +
+              " columns!");
+        const size_t n_rows = static_cast<size_t>(data.rows());
+        const size_t stride = static_cast<size_t>(data.outerStride());
+        const size_t acc_cols =
+            lm->get_accumulator_columns(n_trees, predict_proba);
+        Mat<float> accumulator(Mat<float>::Zero(n_rows, acc_cols));
+        id_t leaf_ids[FAST_BATCH_ROWS];
+        // The rows of one block are propagated through all trees while they
+        // are in cache.
+        for (size_t start = 0; start < n_rows;
+             start += FOREST_PREDICT_BLOCK_ROWS) {
+          const size_t end =
+              std::min<size_t>(n_rows, start + FOREST_PREDICT_BLOCK_ROWS);
+          for (size_t tree_idx = 0; tree_idx < n_trees; ++tree_idx) {
+            const CompiledTree &tree = trees[tree_idx];
+            for (size_t i = start; i < end; i += FAST_BATCH_ROWS) {
+              const size_t n_batch =
+                  std::min<size_t>(FAST_BATCH_ROWS, end - i);
+              tree.predict_leaf_ids(data.data() + i * stride, stride,
+                                    n_batch, leaf_ids);
+              for (size_t j = 0; j < n_batch; ++j)
+                tree.accumulate(leaf_ids[j], predict_proba,
+                                accumulator.data() + (i + j) * acc_cols);
+            }
+          }
+        }
+        lm->get_result_type(predict_proba, false)
+            .match(
+                [&](const auto &restype) {
+                  typedef
+                      typename get_core<decltype(restype.data())>::type RT;
+                  result_v.set<Mat<RT>>(Mat<RT>::Zero(
+                      n_rows, lm->get_result_columns(n_trees, predict_proba,
+                                                     false)));
+                  Data<MatRef> dref =
+                      MatRef<RT>(result_v.get_unchecked<Mat<RT>>());
+                  lm->finalize_result(accumulator, dref, n_trees, weights,
+                                      predict_proba);
+                },
+                [](const Empty &) { throw EmptyException(); });
+      },
+      [](const Empty &) { throw EmptyException(); });
+  return result_v;
+};
+}  // namespace
+
+CompiledTree::CompiledTree(const Tree &tree)
+    : CompiledTree(tree, 0, 1, 1.f){};
+
+CompiledTree::CompiledTree(const Tree &tree, const size_t &tree_idx,
+                           const size_t &n_trees, const float &weight)
+    : nodes(std::move(*tree.make_fast_tree())),
+      leaf_tables(),
+      leaf_manager(tree.get_leaf_manager()->create_finalizer()),
+      data_dim(tree.get_input_data_dimensions()) {
+  // The leaf storage is only read here, to fill the leaf tables.
+  const ILeaf *lm = tree.get_leaf_manager().get();
+  nodes.match([&](auto &ftree) {
+    const size_t n_leafs = ftree.leaf_ids.size();
+    for (const bool predict_proba : {false, true}) {
+      LeafTable &table = leaf_tables[predict_proba ? 1 : 0];
+      table.offset = 0;
+      size_t acc_cols;
+      try {
+        acc_cols = lm->get_accumulator_columns(n_trees, predict_proba);
+      } catch (const ForpyException &) {
+        // The leaf does not support distributions (e.g., regression without
+        // variances). Predictions raise the same error, so the table is not
+        // needed.
+        continue;
+      }
+      std::vector<float> acc_row(acc_cols);
+      auto leaf_row = [&](const size_t &leaf_idx) {
+        std::fill(acc_row.begin(), acc_row.end(), 0.f);
+        lm->accumulate_result(ftree.leaf_ids[leaf_idx], tree_idx, weight,
+                              acc_row.data(), predict_proba);
+      };
+      // Only store the accumulator columns that any leaf contributes to.
+      size_t begin = acc_cols, end = 0;
+      for (size_t leaf_idx = 0; leaf_idx < n_leafs; ++leaf_idx) {
+        leaf_row(leaf_idx);
+        for (size_t col = 0; col < acc_cols; ++col) {
+          if (acc_row[col] != 0.f) {
+            begin = std::min(begin, col);
+            end = std::max(end, col + 1);
+          }
+        }
+      }
+      if (begin >= end) begin = end = 0;
+      table.offset = begin;
+      table.values.resize(n_leafs, end - begin);
+      for (size_t leaf_idx = 0; leaf_idx < n_leafs; ++leaf_idx) {
+        leaf_row(leaf_idx);
+        std::copy(acc_row.begin() + begin, acc_row.begin() + end,
+                  table.values.data() + leaf_idx * (end - begin));
+      }
+    }
+    // The leaf positions now directly index the leaf tables.
+    std::iota(ftree.leaf_ids.begin(), ftree.leaf_ids.end(), 0u);
+  });
+};
+
+Data<Mat> CompiledTree::predict(const Data<MatCRef> &data_v,
+                                const bool &predict_proba) const {
+  return predict_compiled(this, 1, Vec<float>::Ones(1), leaf_manager.get(),
+                          data_v, predict_proba);
+};
+
+size_t CompiledTree::get_memory_size() const {
+  size_t size = sizeof(*this);
+  nodes.match([&](const auto &ftree) { size += ftree.get_memory_size(); });
+  for (const auto &table : leaf_tables)
+    size += static_cast<size_t>(table.values.size()) * sizeof(float);
+  return size;
+};
+
+CompiledForest::CompiledForest(const Forest &forest)
+    : trees(),
+      weights(forest.get_trees().size()),
+      weight_sum(0.f),
+      leaf_manager(forest.get_leaf_manager()->create_finalizer()) {
+  const auto forest_trees = forest.get_trees();
+  const size_t n_trees = forest_trees.size();
+  if (n_trees == 0) throw ForpyException("The forest has no trees!");
+  trees.reserve(n_trees);
+  for (size_t tree_idx = 0; tree_idx < n_trees; ++tree_idx) {
+    const float weight = forest_trees[tree_idx]->get_weight();
+    trees.push_back(
+        CompiledTree(*forest_trees[tree_idx], tree_idx, n_trees, weight));
+    weights(tree_idx) = weight;
+    weight_sum += weight;
+  }
+};
+
+Data<Mat> CompiledForest::predict(const Data<MatCRef> &data_v,
+                                  const bool &predict_proba) const {
+  return predict_compiled(trees.data(), trees.size(), weights,
+                          leaf_manager.get(), data_v, predict_proba);
+};
+
+size_t CompiledForest::get_memory_size() const {
+  size_t size = sizeof(*this);
+  for (const auto &tree : trees) size += tree.get_memory_size();
+  return size;
+};
+
+}  // namespace forpy
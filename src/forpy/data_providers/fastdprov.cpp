@@ -4,7 +4,8 @@ namespace forpy {
 
 FastDProv::FastDProv(
     const DataStore<Mat> &data_store, const DataStore<Mat> &annotation_store,
-    const std::shared_ptr<std::vector<float> const> &weights_store)
+    const std::shared_ptr<std::vector<float> const> &weights_store,
+    const size_t &n_bins)
     : data_store(data_store),
       annotation_store(annotation_store),
       weights_store(weights_store) {
@@ -21,25 +22,44 @@ FastDProv::FastDProv(
                            this->init_from_arrays();
                          });
                    });
+  if (n_bins > 0) bins = std::make_shared<FeatureBins>(data, n_bins);
 };
 
 FastDProv::FastDProv(
     const Data<MatCRef> &data, const Data<MatCRef> &annotations,
-    const std::shared_ptr<std::vector<float> const> &weights_store)
+    const std::shared_ptr<std::vector<float> const> &weights_store,
+    const size_t &n_bins)
     : data(data), annotations(annotations), weights_store(weights_store) {
   if (weights_store != nullptr && weights_store->size() == 0)
     this->weights_store = nullptr;
   checks(data, annotations);
   init_from_arrays();
+  if (n_bins > 0) bins = std::make_shared<FeatureBins>(data, n_bins);
+};
+
+FastDProv::FastDProv(
+    const Data<MatCRef> &data, const Data<MatCRef> &annotations,
+    const std::shared_ptr<std::vector<float> const> &weights_store,
+    const std::shared_ptr<const FeatureBins> &bins)
+    : data(data),
+      annotations(annotations),
+      weights_store(weights_store),
+      bins(bins) {
+  if (weights_store != nullptr && weights_store->size() == 0)
+    this->weights_store = nullptr;
+  checks(data, annotations);
+  init_from_arrays();
 };
 
 FastDProv::FastDProv(
     const Data<MatCRef> &data, const Data<MatCRef> &annotations,
     const std::shared_ptr<std::vector<float> const> &weights_store,
-    std::shared_ptr<std::vector<id_t>> &training_ids)
+    std::shared_ptr<std::vector<id_t>> &training_ids,
+    const std::shared_ptr<const FeatureBins> &bins)
     : data(data),
       annotations(annotations),
       weights_store(weights_store),
+      bins(bins),
       training_ids(training_ids) {
   if (weights_store != nullptr && weights_store->size() == 0)
     this->weights_store = nullptr;
@@ -141,7 +161,7 @@ std::vector<std::shared_ptr<IDataProvider>> FastDProv::create_tree_providers(
           "ID!");
     }
     retvec.emplace_back(new FastDProv(data, annotations, usage_map[i].second,
-                                      usage_map[i].first));
+                                      usage_map[i].first, bins));
   }
   return retvec;
 }
@@ -0,0 +1,60 @@
+#include <forpy/data_providers/featurebins.h>
+#include <forpy/util/gather.h>
+
+namespace forpy {
+
+FeatureBins::FeatureBins(const Data<MatCRef> &data_v, const size_t &n_bins)
+    : n_samples(0), max_bins(n_bins), codes(), edges() {
+  if (n_bins < 2 || n_bins > FEATURE_BINS_MAX)
+    throw ForpyException("The number of bins must be in [2, " +
+                         std::to_string(FEATURE_BINS_MAX) + "]!");
+  data_v.match(
+      [&](const auto &data) {
+        n_samples = static_cast<size_t>(data.cols());
+        const size_t n_features = static_cast<size_t>(data.rows());
+        codes.resize(n_features * n_samples);
+        edges.resize(n_features);
+        const size_t n_edge_samples =
+            std::min<size_t>(n_samples, FEATURE_BINS_EDGE_SAMPLES);
+        std::vector<double> sorted;
+        sorted.reserve(n_edge_samples);
+        for (size_t feat_idx = 0; feat_idx < n_features; ++feat_idx) {
+          const auto *feat_p = data.data() + feat_idx * data.outerStride();
+          sorted.clear();
+          for (size_t i = 0; i < n_edge_samples; ++i)
+            sorted.push_back(
+                static_cast<double>(feat_p[i * n_samples / n_edge_samples]));
+          std::sort(sorted.begin(), sorted.end());
+          // The upper edges of equally populated bins, without duplicates.
+          // The maximum is no edge, since all remaining values are above.
+          auto &feat_edges = edges[feat_idx];
+          for (size_t bin = 1; bin < n_bins; ++bin) {
+            const double edge = sorted[bin * sorted.size() / n_bins];
+            if (edge < sorted.back() &&
+                (feat_edges.empty() || edge > feat_edges.back()))
+              feat_edges.push_back(edge);
+          }
+          uint8_t *code_p = &codes[feat_idx * n_samples];
+          for (size_t i = 0; i < n_samples; ++i)
+            code_p[i] = static_cast<uint8_t>(
+                std::lower_bound(feat_edges.begin(), feat_edges.end(),
+                                 static_cast<double>(feat_p[i])) -
+                feat_edges.begin());
+        }
+      },
+      [](const Empty &) { throw EmptyException(); });
+  VLOG(22) << "Quantized " << edges.size() << " features of " << n_samples
+           << " samples into at most " << n_bins << " bins.";
+};
+
+void FeatureBins::assign_subset(const FeatureBins &other, const id_t *ids,
+                                const size_t &n) {
+  n_samples = n;
+  max_bins = other.max_bins;
+  edges = other.edges;
+  codes.resize(edges.size() * n);
+  for (size_t feat_idx = 0; feat_idx < edges.size(); ++feat_idx)
+    gather(other.get_codes(feat_idx), ids, n, &codes[feat_idx * n], true);
+};
+
+}  // namespace forpy
@@ -0,0 +1,294 @@
+#include <forpy/data_providers/mmapdprov.h>
+
+#include <cstring>
+#include <numeric>
+#include <regex>
+
+namespace forpy {
+
+namespace {
+/** The `.npy` magic string. */
+const char NPY_MAGIC[] = "\x93NUMPY";
+
+/** Maps a numpy type description to one of the supported value types. */
+std::string npy_dtype(const std::string &descr) {
+  if (descr.size() != 3 || descr[0] == '>')
+    throw ForpyException("Unsupported `.npy` value type `" + descr +
+                         "`. Use little endian float32, float64, uint32 or "
+                         "uint8 values.");
+  const std::string type = descr.substr(1);
+  if (type == "f4") return "float32";
+  if (type == "f8") return "float64";
+  if (type == "u4") return "uint32";
+  if (type == "u1") return "uint8";
+  throw ForpyException("Unsupported `.npy` value type `" + descr +
+                       "`. Use float32, float64, uint32 or uint8 values.");
+};
+
+/**
+ * Parses the header of a `.npy` file and returns the value type, the number
+ * of features and samples and the offset of the values.
+ */
+void parse_npy_header(const MappedFile &file, std::string *dtype,
+                      size_t *n_features, size_t *n_samples, size_t *offset) {
+  const char *p = file.data();
+  const size_t magic_len = sizeof(NPY_MAGIC) - 1;
+  if (file.size() < magic_len + 4 || std::memcmp(p, NPY_MAGIC, magic_len) != 0)
+    throw ForpyException("`" + file.get_filename() + "` is no `.npy` file!");
+  const auto byte = [&](const size_t &idx) {
+    return static_cast<size_t>(static_cast<unsigned char>(p[idx]));
+  };
+  size_t header_len, header_start;
+  if (byte(6) == 1) {
+    header_len = byte(8) | byte(9) << 8;
+    header_start = 10;
+  } else {
+    if (file.size() < 12)
+      throw ForpyException("`" + file.get_filename() + "` is truncated!");
+    header_len = byte(8) | byte(9) << 8 | byte(10) << 16 | byte(11) << 24;
+    header_start = 12;
+  }
+  *offset = header_start + header_len;
+  if (*offset > file.size())
+    throw ForpyException("`" + file.get_filename() + "` is truncated!");
+  const std::string header(p + header_start, header_len);
+  std::smatch match;
+  if (!std::regex_search(header, match,
+                         std::regex("'descr'\\s*:\\s*'([^']*)'")))
+    throw ForpyException("No value type in the `.npy` header!");
+  *dtype = npy_dtype(match[1]);
+  if (!std::regex_search(header, match,
+                         std::regex("'fortran_order'\\s*:\\s*(True|False)")))
+    throw ForpyException("No memory order in the `.npy` header!");
+  const bool fortran_order = match[1] == "True";
+  if (!std::regex_search(header, match,
+                         std::regex("'shape'\\s*:\\s*\\(([^)]*)\\)")))
+    throw ForpyException("No shape in the `.npy` header!");
+  std::vector<size_t> shape;
+  const std::string shape_str = match[1];
+  const std::regex dim_regex("\\d+");
+  for (auto it = std::sregex_iterator(shape_str.begin(), shape_str.end(),
+                                      dim_regex);
+       it != std::sregex_iterator(); ++it)
+    shape.push_back(std::stoul(it->str()));
+  if (shape.size() == 1) {
+    *n_features = 1;
+    *n_samples = shape[0];
+  } else if (shape.size() == 2) {
+    // The features must be contiguous.
+    *n_features = fortran_order ? shape[1] : shape[0];
+    *n_samples = fortran_order ? shape[0] : shape[1];
+  } else {
+    throw ForpyException("The `.npy` array must have one or two dimensions!");
+  }
+}
+
+size_t value_size(const std::string &dtype) {
+  if (dtype == "float32") return sizeof(float);
+  if (dtype == "float64") return sizeof(double);
+  if (dtype == "uint32") return sizeof(uint);
+  if (dtype == "uint8") return sizeof(uint8_t);
+  throw ForpyException("Unsupported value type `" + dtype +
+                       "`. Use float32, float64, uint32 or uint8.");
+}
+
+template <typename IT>
+Data<MatCRef> map_values(const MappedFile &file, const size_t &offset,
+                         const size_t &n_features, const size_t &n_samples) {
+  const IT *values_p = reinterpret_cast<const IT *>(file.data() + offset);
+  return MatCRef<IT>(
+      Eigen::Map<const Mat<IT>>(values_p, n_features, n_samples));
+}
+}  // namespace
+
+MMapDProv::MMapDProv(
+    const std::string &filename, const Data<MatCRef> &annotations,
+    const std::shared_ptr<std::vector<float> const> &weights_store,
+    const size_t &n_bins)
+    : file(std::make_shared<const MappedFile>(filename)),
+      annotations(annotations),
+      weights_store(weights_store) {
+  std::string dtype;
+  size_t n_features, n_samples, offset;
+  parse_npy_header(*file, &dtype, &n_features, &n_samples, &offset);
+  // A truncated or padded file would otherwise change the sample count.
+  const size_t n_bytes = n_features * n_samples * value_size(dtype);
+  if (n_bytes != file->size() - offset)
+    throw ForpyException("The `.npy` header of `" + filename + "` requires " +
+                         std::to_string(n_bytes) + " bytes of values, but " +
+                         std::to_string(file->size() - offset) +
+                         " bytes follow it!");
+  init_from_file(dtype, n_features, offset, n_bins);
+};
+
+MMapDProv::MMapDProv(
+    const std::string &filename, const std::string &dtype,
+    const size_t &n_features, const Data<MatCRef> &annotations,
+    const std::shared_ptr<std::vector<float> const> &weights_store,
+    const size_t &n_bins, const size_t &offset)
+    : file(std::make_shared<const MappedFile>(filename)),
+      annotations(annotations),
+      weights_store(weights_store) {
+  init_from_file(dtype, n_features, offset, n_bins);
+};
+
+MMapDProv::MMapDProv(
+    const std::shared_ptr<const MappedFile> &file, const Data<MatCRef> &data,
+    const Data<MatCRef> &annotations,
+    const std::shared_ptr<std::vector<float> const> &weights_store,
+    std::shared_ptr<std::vector<id_t>> &training_ids,
+    const std::shared_ptr<const FeatureBins> &bins)
+    : file(file),
+      data(data),
+      annotations(annotations),
+      weights_store(weights_store),
+      bins(bins),
+      training_ids(training_ids) {
+  if (weights_store != nullptr && weights_store->size() == 0)
+    this->weights_store = nullptr;
+  data.match(
+      [&, this](const auto &data) {
+        this->feat_vec_dim = data.rows();
+        annotations.match(
+            [&, this](const auto &annotations) {
+              this->annot_vec_dim = annotations.cols();
+            },
+            [](const Empty &) { throw EmptyException(); });
+      },
+      [](const Empty &) { throw EmptyException(); });
+}
+
+void MMapDProv::init_from_file(const std::string &dtype,
+                               const size_t &n_features, const size_t &offset,
+                               const size_t &n_bins) {
+  if (weights_store != nullptr && weights_store->size() == 0)
+    this->weights_store = nullptr;
+  const size_t size = value_size(dtype);
+  if (n_features == 0)
+    throw ForpyException(
+        "Tried to create a data provider for feature dimension 0.");
+  if (offset % size != 0 || offset >= file->size() ||
+      (file->size() - offset) % size != 0)
+    throw ForpyException("Invalid offset " + std::to_string(offset) +
+                         " for values of " + std::to_string(size) +
+                         " bytes in a file of " +
+                         std::to_string(file->size()) + " bytes!");
+  const size_t n_values = (file->size() - offset) / size;
+  if (n_values % n_features != 0)
+    throw ForpyException(std::to_string(n_values) +
+                         " values can not be split into " +
+                         std::to_string(n_features) + " features!");
+  const size_t n_samples = n_values / n_features;
+  if (dtype == "float32")
+    data = map_values<float>(*file, offset, n_features, n_samples);
+  else if (dtype == "float64")
+    data = map_values<double>(*file, offset, n_features, n_samples);
+  else if (dtype == "uint32")
+    data = map_values<uint>(*file, offset, n_features, n_samples);
+  else
+    data = map_values<uint8_t>(*file, offset, n_features, n_samples);
+  annotations.match(
+      [](const Empty &) { throw EmptyException(); },
+      [&](const auto &annotations) {
+        if (n_samples != static_cast<size_t>(annotations.rows()))
+          throw ForpyException("Data and annotation counts don't match (" +
+                               std::to_string(n_samples) + " samples and " +
+                               std::to_string(annotations.rows()) +
+                               " annotations)!");
+        if (annotations.cols() == 0)
+          throw ForpyException(
+              "Tried to create a data provider for annotation dimension 0!");
+        if (annotations.innerStride() != 1)
+          throw ForpyException(
+              "The annotation array has an inner stride != 1 (" +
+              std::to_string(annotations.innerStride()) +
+              ")! A stride of 1 is required!");
+        annot_vec_dim = annotations.cols();
+      });
+  if (weights_store != nullptr) {
+    if (weights_store->size() != n_samples)
+      throw ForpyException("Non-matching number of weights (" +
+                           std::to_string(n_samples) + " samples and " +
+                           std::to_string(weights_store->size()) +
+                           " weights).");
+    for (const auto &weight : *weights_store)
+      if (weight < 0.f)
+        throw ForpyException("Negative weight detected (" +
+                             std::to_string(weight) + ")!");
+  }
+  feat_vec_dim = n_features;
+  training_ids = std::make_shared<std::vector<id_t>>(n_samples);
+  std::iota(training_ids->begin(), training_ids->end(), 0);
+  if (n_bins > 0) {
+    // The edges and codes are computed feature by feature.
+    advise(EAccessPattern::Sequential);
+    bins = std::make_shared<FeatureBins>(data, n_bins);
+    advise(EAccessPattern::Normal);
+  }
+  VLOG(22) << "Created MMapDProv for `" << file->get_filename() << "` with "
+           << n_samples << " samples, " << feat_vec_dim << " features ("
+           << dtype << ") and " << annot_vec_dim << " annotations.";
+}
+
+void MMapDProv::advise(const EAccessPattern &pattern,
+                       const int &feat_idx) const {
+  if (feat_idx >= static_cast<int>(feat_vec_dim))
+    throw ForpyException("Invalid feature index " + std::to_string(feat_idx) +
+                         "!");
+  data.match(
+      [&](const auto &data) {
+        const size_t feat_bytes = data.cols() * sizeof(data.data()[0]);
+        const size_t offset =
+            reinterpret_cast<const char *>(data.data()) - file->data();
+        if (feat_idx < 0)
+          file->advise(pattern, offset, feat_bytes * data.rows());
+        else
+          file->advise(pattern, offset + feat_idx * feat_bytes, feat_bytes);
+      },
+      [](const Empty &) { throw EmptyException(); });
+}
+
+std::vector<std::shared_ptr<IDataProvider>> MMapDProv::create_tree_providers(
+    usage_map_t &usage_map) {
+  std::vector<std::shared_ptr<IDataProvider>> retvec;
+  for (size_t i = 0; i < usage_map.size(); ++i) {
+    if (!check_elem_ids_ok(get_n_samples(), *usage_map[i].first)) {
+      throw ForpyException(
+          "Wrong sample usage map with a too high element "
+          "ID!");
+    }
+    retvec.emplace_back(new MMapDProv(file, data, annotations,
+                                      usage_map[i].second, usage_map[i].first,
+                                      bins));
+  }
+  return retvec;
+}
+
+Data<VecCMap> MMapDProv::get_feature(const size_t &feat_idx) const {
+  Data<VecCMap> ret_dta;
+  data.match(
+      [&, this](const auto &data) {
+        typedef typename get_core<decltype(data.data())>::type IT;
+        ret_dta.set<VecCMap<IT>>(data.data() + feat_idx * data.outerStride(),
+                                 data.cols(),
+                                 Eigen::InnerStride<Eigen::Dynamic>(1));
+      },
+      [](const Empty &) { throw EmptyException(); });
+  return ret_dta;
+}
+
+bool MMapDProv::operator==(const IDataProvider &rhs) const {
+  const auto *rhs_c = dynamic_cast<MMapDProv const *>(&rhs);
+  if (rhs_c == nullptr) {
+    return false;
+  } else {
+    bool eq_fvd = feat_vec_dim == rhs_c->feat_vec_dim;
+    bool eq_avd = annot_vec_dim == rhs_c->annot_vec_dim;
+    bool eq_data = mu::apply_visitor(MatEqVis(), data, rhs_c->data);
+    bool eq_annotations =
+        mu::apply_visitor(MatEqVis(), annotations, rhs_c->annotations);
+    bool eq_ids = *training_ids == *rhs_c->training_ids;
+    return eq_fvd && eq_avd && eq_data && eq_annotations && eq_ids;
+  }
+}
+}  // namespace forpy
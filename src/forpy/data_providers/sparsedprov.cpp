@@ -0,0 +1,107 @@
+#include <forpy/data_providers/sparsedprov.h>
+
+#include <numeric>
+
+namespace forpy {
+
+SparseDProv::SparseDProv(
+    const std::shared_ptr<const SparseMat> &features,
+    const Data<MatCRef> &annotations,
+    const std::shared_ptr<std::vector<float> const> &weights_store)
+    : features(features),
+      annotations(annotations),
+      weights_store(weights_store) {
+  if (features == nullptr) throw EmptyException();
+  if (this->weights_store != nullptr && this->weights_store->size() == 0)
+    this->weights_store = nullptr;
+  const size_t n_samples = features->get_n_inner();
+  if (features->get_n_outer() == 0)
+    throw ForpyException(
+        "Tried to create a data provider for feature dimension 0.");
+  annotations.match(
+      [](const Empty &) { throw EmptyException(); },
+      [&](const auto &annotations) {
+        if (n_samples != static_cast<size_t>(annotations.rows()))
+          throw ForpyException("Data and annotation counts don't match (" +
+                               std::to_string(n_samples) + " samples and " +
+                               std::to_string(annotations.rows()) +
+                               " annotations)!");
+        if (annotations.cols() == 0)
+          throw ForpyException(
+              "Tried to create a data provider for annotation dimension 0!");
+        if (annotations.innerStride() != 1)
+          throw ForpyException(
+              "The annotation array has an inner stride != 1 (" +
+              std::to_string(annotations.innerStride()) +
+              ")! A stride of 1 is required!");
+        annot_vec_dim = annotations.cols();
+      });
+  if (this->weights_store != nullptr) {
+    if (this->weights_store->size() != n_samples)
+      throw ForpyException("Non-matching number of weights (" +
+                           std::to_string(n_samples) + " samples and " +
+                           std::to_string(this->weights_store->size()) +
+                           " weights).");
+    for (const auto &weight : *this->weights_store)
+      if (weight < 0.f)
+        throw ForpyException("Negative weight detected (" +
+                             std::to_string(weight) + ")!");
+  }
+  feat_vec_dim = features->get_n_outer();
+  training_ids = std::make_shared<std::vector<id_t>>(n_samples);
+  std::iota(training_ids->begin(), training_ids->end(), 0);
+  VLOG(22) << "Created SparseDProv with " << n_samples << " samples, "
+           << feat_vec_dim << " features and " << features->get_nnz()
+           << " nonzeros.";
+};
+
+SparseDProv::SparseDProv(
+    const std::shared_ptr<const SparseMat> &features,
+    const Data<MatCRef> &annotations,
+    const std::shared_ptr<std::vector<float> const> &weights_store,
+    std::shared_ptr<std::vector<id_t>> &training_ids)
+    : features(features),
+      annotations(annotations),
+      weights_store(weights_store),
+      training_ids(training_ids) {
+  if (weights_store != nullptr && weights_store->size() == 0)
+    this->weights_store = nullptr;
+  feat_vec_dim = features->get_n_outer();
+  annotations.match(
+      [&, this](const auto &annotations) {
+        this->annot_vec_dim = annotations.cols();
+      },
+      [](const Empty &) { throw EmptyException(); });
+}
+
+std::vector<std::shared_ptr<IDataProvider>> SparseDProv::create_tree_providers(
+    usage_map_t &usage_map) {
+  std::vector<std::shared_ptr<IDataProvider>> retvec;
+  for (size_t i = 0; i < usage_map.size(); ++i) {
+    if (!check_elem_ids_ok(features->get_n_inner(), *usage_map[i].first)) {
+      throw ForpyException(
+          "Wrong sample usage map with a too high element "
+          "ID!");
+    }
+    retvec.emplace_back(new SparseDProv(features, annotations,
+                                        usage_map[i].second,
+                                        usage_map[i].first));
+  }
+  return retvec;
+}
+
+bool SparseDProv::operator==(const IDataProvider &rhs) const {
+  const auto *rhs_c = dynamic_cast<SparseDProv const *>(&rhs);
+  if (rhs_c == nullptr) {
+    return false;
+  } else {
+    bool eq_fvd = feat_vec_dim == rhs_c->feat_vec_dim;
+    bool eq_avd = annot_vec_dim == rhs_c->annot_vec_dim;
+    bool eq_features = *features == *rhs_c->features;
+    bool eq_annotations =
+        mu::apply_visitor(MatEqVis(), annotations, rhs_c->annotations);
+    bool eq_ids = *training_ids == *rhs_c->training_ids;
+    return eq_fvd && eq_avd && eq_features && eq_annotations && eq_ids;
+  }
+}
+}  // namespace forpy
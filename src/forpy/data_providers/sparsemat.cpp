@@ -0,0 +1,88 @@
+#include <forpy/data_providers/sparsemat.h>
+
+#include <numeric>
+
+namespace forpy {
+
+SparseMat::SparseMat(std::vector<size_t> indptr, std::vector<id_t> indices,
+                     std::vector<float> values, const size_t &n_inner)
+    : indptr(std::move(indptr)),
+      indices(std::move(indices)),
+      values(std::move(values)),
+      n_inner(n_inner) {
+  if (this->indptr.size() < 2)
+    throw ForpyException("The sparse matrix must have an outer dimension >0!");
+  if (this->indices.size() != this->values.size())
+    throw ForpyException("Non-matching number of sparse indices (" +
+                         std::to_string(this->indices.size()) +
+                         ") and values (" +
+                         std::to_string(this->values.size()) + ")!");
+  if (this->indptr.front() != 0 || this->indptr.back() != this->values.size())
+    throw ForpyException(
+        "The sparse slice offsets must start at 0 and end at the number of "
+        "values!");
+  std::vector<std::pair<id_t, float>> slice;
+  for (size_t outer = 0; outer < get_n_outer(); ++outer) {
+    const size_t begin = this->indptr[outer], end = this->indptr[outer + 1];
+    if (end < begin)
+      throw ForpyException("The sparse slice offsets must not decrease!");
+    bool sorted = true;
+    for (size_t k = begin; k < end; ++k) {
+      if (this->indices[k] >= n_inner)
+        throw ForpyException("Sparse index " +
+                             std::to_string(this->indices[k]) +
+                             " out of range for inner dimension " +
+                             std::to_string(n_inner) + "!");
+      if (!std::isfinite(this->values[k]))
+        throw ForpyException("Non-finite sparse value detected!");
+      if (k > begin && this->indices[k] <= this->indices[k - 1]) sorted = false;
+    }
+    if (sorted) continue;
+    slice.clear();
+    for (size_t k = begin; k < end; ++k)
+      slice.emplace_back(this->indices[k], this->values[k]);
+    std::sort(slice.begin(), slice.end());
+    for (size_t k = begin; k < end; ++k) {
+      if (k > begin && slice[k - begin].first == slice[k - begin - 1].first)
+        throw ForpyException("Duplicate sparse index " +
+                             std::to_string(slice[k - begin].first) + "!");
+      this->indices[k] = slice[k - begin].first;
+      this->values[k] = slice[k - begin].second;
+    }
+  }
+}
+
+SparseMat SparseMat::transpose() const {
+  std::vector<size_t> t_indptr(n_inner + 1, 0);
+  for (const auto &inner : indices) t_indptr[inner + 1]++;
+  std::partial_sum(t_indptr.begin(), t_indptr.end(), t_indptr.begin());
+  std::vector<id_t> t_indices(get_nnz());
+  std::vector<float> t_values(get_nnz());
+  std::vector<size_t> pos(t_indptr.begin(), t_indptr.end() - 1);
+  // Visiting the outer slices in order keeps the new slices sorted.
+  for (size_t outer = 0; outer < get_n_outer(); ++outer) {
+    for (size_t k = indptr[outer]; k < indptr[outer + 1]; ++k) {
+      const size_t dest = pos[indices[k]]++;
+      t_indices[dest] = outer;
+      t_values[dest] = values[k];
+    }
+  }
+  return SparseMat(std::move(t_indptr), std::move(t_indices),
+                   std::move(t_values), get_n_outer());
+}
+
+void SparseMat::scatter_rows(const size_t &start, const size_t &end,
+                             float *out) const {
+  FASSERT(end <= get_n_outer());
+  for (size_t outer = start; outer < end; ++outer) {
+    float *row_p = out + (outer - start) * n_inner;
+    for (size_t k = indptr[outer]; k < indptr[outer + 1]; ++k)
+      row_p[indices[k]] = values[k];
+  }
+}
+
+bool SparseMat::operator==(const SparseMat &rhs) const {
+  return n_inner == rhs.n_inner && indptr == rhs.indptr &&
+         indices == rhs.indices && values == rhs.values;
+}
+}  // namespace forpy
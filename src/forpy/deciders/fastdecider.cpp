@@ -1,24 +1,37 @@
 #include <forpy/deciders/fastdecider.h>
 #include <forpy/threshold_optimizers/fastclassopt.h>
 #include <forpy/threshold_optimizers/ithreshopt.h>
+#include <forpy/util/threading/ctpl.h>
+
+#include <skasort.hpp>
 
 namespace forpy {
 
 FastDecider::FastDecider(const std::shared_ptr<IThreshOpt> &threshold_optimizer,
                          const size_t &n_valid_features_to_use,
-                         const bool &autoscale_valid_features)
+                         const bool &autoscale_valid_features,
+                         const bool &presort,
+                         const size_t &subsample_min_samples,
+                         const size_t &subsample_size)
     : threshold_optimizer(threshold_optimizer),
       n_valids_to_use(n_valid_features_to_use),
       autoscale_valid_features(autoscale_valid_features),
       node_to_featsel(),
       node_to_thresh_v(),
-      data_dim(0) {
+      data_dim(0),
+      presort(presort),
+      subsample_min_samples(subsample_min_samples),
+      subsample_size(subsample_size),
+      presorted_ids(),
+      goes_left() {
   if (threshold_optimizer == nullptr)
     this->threshold_optimizer = std::make_shared<FastClassOpt>();
   if (autoscale_valid_features && n_valid_features_to_use != 0)
     throw ForpyException(
         "If autoscaling of valid features is used, "
         "n_valid_features must be set to 0!");
+  if (subsample_min_samples > 0 && subsample_size == 0)
+    throw ForpyException("The subsample size must be > 0!");
 };
 
 void FastDecider::_make_node__checks(const TodoMark &todo_info,
@@ -43,18 +56,35 @@ void FastDecider::_make_node__checks(const TodoMark &todo_info,
   d.node_id = todo_info.node_id;
   d.start_id = todo_info.interv.first;
   d.end_id = todo_info.interv.second;
+  d.node_stats = todo_info.stats.empty() ? nullptr : &todo_info.stats;
+  d.known_invalid = &todo_info.invalid_features;
+  d.bins = data_provider.get_feature_bins();
+  d.sparse = data_provider.get_sparse_features();
+  if (d.sparse != nullptr)
+    d.mark_sparse_samples(d.elem_id_p, d.n_samples, d.sparse->get_n_inner());
 }
 
 /**
  * It would be possible to always start the optimization with the feature that
  * the samples are currently sorted by. However, this would bring in a bias
  * towards features and due to the guidelines I favor correctness before speed.
+ *
+ * For large nodes, the candidate features are drawn in batches of the number
+ * of valid features still required (this is exactly what the serial loop
+ * would draw at least) and evaluated concurrently. Every evaluation starts
+ * from the original sample order of the node, and the results are reduced in
+ * drawing order, so the split does not depend on the number of threads.
+ *
+ * If the node is subsampled, the features are ranked on the subsample and
+ * only the best one is optimized again on the full node. Features that are
+ * constant on the subsample are not recorded as invalid for the children,
+ * since they need not be constant on the node.
  */
 void FastDecider::_make_node__opt(const IDataProvider &dprov,
                                   Desk *desk) const {
   auto &d = desk->d;
-  d.best_res_v =
-      SplitOptRes<float>{0, std::numeric_limits<float>::lowest(), 0.f, false};
+  d.best_res_v = SplitOptRes<float>{
+      0, std::numeric_limits<float>::lowest(), 0.f, false, {}};
   d.opt_res_v.match([](auto &opt_res) {
     opt_res.gain = 0.f;
     opt_res.valid = false;
@@ -63,35 +93,59 @@ void FastDecider::_make_node__opt(const IDataProvider &dprov,
   uint valids_tried = 0;
   size_t feat_idx;
   float best_gain = 0.f;
-  d.presorted = (d.input_dim == 1 && d.node_id > 0);
-  id_t draw_idx = d.invalid_counts[d.node_id];
-  id_t invalid_count = draw_idx;
-  if (d.feature_indices.size() != d.input_dim) {
-    VLOG(23) << "Initializing feature index list.";
-    d.feature_indices.resize(d.input_dim);
-    std::iota(d.feature_indices.begin(), d.feature_indices.end(), 0);
+  bool found_split = false;
+  d.presorted = (d.input_dim == 1 && d.node_id > 0) || presort;
+  id_t *node_elem_id_p = d.elem_id_p;
+  // Every node draws from the same initial order, so that the drawn features
+  // do not depend on the nodes that this desk has optimized before. The
+  // features known to be constant come first and are not drawn.
+  const size_t n_known = d.known_invalid->size();
+  d.feature_indices.resize(d.input_dim);
+  id_t *other_p = &d.feature_indices[0] + n_known;
+  for (id_t feat = 0, known_idx = 0; feat < d.input_dim; ++feat) {
+    if (known_idx < n_known && (*d.known_invalid)[known_idx] == feat)
+      d.feature_indices[known_idx++] = feat;
+    else
+      *other_p++ = feat;
   }
+  id_t draw_idx = n_known;
+  id_t invalid_count = draw_idx;
+  d.invalid_count = n_known;
   threshold_optimizer->full_entropy(dprov, desk);
   if (d.fullentropy <= 1E-7) return;
-  for (; valids_tried < n_valids_to_use && draw_idx < d.input_dim; ++draw_idx) {
+  const size_t node_n_samples = d.n_samples;
+  const id_t node_end_id = d.end_id;
+  const std::vector<double> *node_stats = d.node_stats;
+  const auto restore_node = [&]() {
+    d.n_samples = node_n_samples;
+    d.end_id = node_end_id;
+    d.node_stats = node_stats;
+    threshold_optimizer->full_entropy(dprov, desk);
+  };
+  bool subsampled = _make_node__subsample(desk);
+  if (subsampled) {
+    threshold_optimizer->full_entropy(dprov, desk);
+    // A pure subsample does not rank the features.
+    if (d.fullentropy <= 1E-7) {
+      restore_node();
+      subsampled = false;
+    }
+  }
+  const auto draw_feature = [&]() {
     id_t offset = std::uniform_int_distribution<>(
         0, d.input_dim - draw_idx - 1)(desk->r.random_engine);
     std::swap(d.feature_indices[draw_idx],
               d.feature_indices[draw_idx + offset]);
-    feat_idx = d.feature_indices[draw_idx];
-    DLOG_IF(INFO, DLOG_FD_V >= 1 && (d.node_id == LOG_FD_NID || LOG_FD_ALLN))
-        << "Evaluating feature " << feat_idx << ". This is feature "
-        << valids_tried << " of " << n_valids_to_use << " to use and "
-        << d.input_dim << " dimensions";
-    dprov.get_feature(feat_idx).match(
-        [&](const auto &feat_dta) { d.full_feat_p_v = feat_dta.data(); });
-    threshold_optimizer->optimize(desk);
-    d.opt_res_v.match([&](const auto &opt_res) {
+    return d.feature_indices[draw_idx];
+  };
+  const auto reduce = [&](const OptSplitV &opt_res_v, const id_t &drawn_at,
+                          const size_t &feat_idx) {
+    opt_res_v.match([&](const auto &opt_res) {
       if (!opt_res.valid) {
         DLOG_IF(INFO,
                 DLOG_FD_V >= 1 && (d.node_id == LOG_FD_NID || LOG_FD_ALLN))
             << "Received invalid flag.";
-        std::swap(d.feature_indices[draw_idx],
+        std::swap(d.feature_indices[drawn_at],
                   d.feature_indices[invalid_count++]);
       } else {
         valids_tried += 1;
@@ -103,12 +157,282 @@ void FastDecider::_make_node__opt(const IDataProvider &dprov,
           best_gain = opt_res.gain;
           d.best_res_v = opt_res;
           d.best_feat_idx = feat_idx;
+          found_split = true;
         }
       }
     });
+  };
+  const auto search = [&]() {
+    if (d.bins == nullptr && d.sparse == nullptr &&
+        !threshold_optimizer->uses_random_engine() &&
+        d.n_samples * n_valids_to_use >= FASTDECIDER_PARALLEL_MIN_WORK) {
+      d.node_ids.assign(d.elem_id_p, d.elem_id_p + d.n_samples);
+      std::vector<size_t> candidates;
+      while (valids_tried < n_valids_to_use && draw_idx < d.input_dim) {
+        const id_t batch_start = draw_idx;
+        candidates.clear();
+        for (; candidates.size() < n_valids_to_use - valids_tried &&
+               draw_idx < d.input_dim;
+             ++draw_idx)
+          candidates.push_back(draw_feature());
+        DLOG_IF(INFO,
+                DLOG_FD_V >= 1 && (d.node_id == LOG_FD_NID || LOG_FD_ALLN))
+            << "Evaluating " << candidates.size() << " features concurrently.";
+        const auto results = _make_node__eval_parallel(dprov, candidates, desk);
+        for (size_t i = 0; i < candidates.size(); ++i)
+          reduce(results[i], batch_start + i, candidates[i]);
+      }
+      d.elem_id_p = node_elem_id_p;
+      // The samples are still in their original order.
+      d.need_sort = true;
+      return;
+    }
+    for (; valids_tried < n_valids_to_use && draw_idx < d.input_dim;
+         ++draw_idx) {
+      feat_idx = draw_feature();
+      DLOG_IF(INFO, DLOG_FD_V >= 1 && (d.node_id == LOG_FD_NID || LOG_FD_ALLN))
+          << "Evaluating feature " << feat_idx << ". This is feature "
+          << valids_tried << " of " << n_valids_to_use << " to use and "
+          << d.input_dim << " dimensions";
+      if (d.sparse == nullptr)
+        dprov.get_feature(feat_idx).match(
+            [&](const auto &feat_dta) { d.full_feat_p_v = feat_dta.data(); });
+      d.feat_idx = feat_idx;
+      if (presort) d.elem_id_p = &presorted_ids[feat_idx][d.start_id];
+      threshold_optimizer->optimize(desk);
+      reduce(d.opt_res_v, draw_idx, feat_idx);
+    }
+    d.elem_id_p = node_elem_id_p;
+    // The histogram, sparse and presorted optimizations do not sort the
+    // samples.
+    d.need_sort = feat_idx != d.best_feat_idx || d.bins != nullptr ||
+                  d.sparse != nullptr || presort ||
+                  !threshold_optimizer->sorts_samples();
+  };
+  search();
+  if (subsampled) {
+    restore_node();
+    if (found_split) {
+      DLOG_IF(INFO, DLOG_FD_V >= 1 && (d.node_id == LOG_FD_NID || LOG_FD_ALLN))
+          << "Refining feature " << d.best_feat_idx << " on all "
+          << d.n_samples << " samples.";
+      dprov.get_feature(d.best_feat_idx).match(
+          [&](const auto &feat_dta) { d.full_feat_p_v = feat_dta.data(); });
+      d.feat_idx = d.best_feat_idx;
+      d.best_res_v = SplitOptRes<float>{
+          0, std::numeric_limits<float>::lowest(), 0.f, false, {}};
+      d.opt_res_v.match([](auto &opt_res) {
+        opt_res.gain = 0.f;
+        opt_res.valid = false;
+      });
+      threshold_optimizer->optimize(desk);
+      d.opt_res_v.match([&](const auto &opt_res) {
+        if (opt_res.valid) d.best_res_v = opt_res;
+      });
+      // This pass sorts the node samples by the best feature.
+      d.need_sort = !threshold_optimizer->sorts_samples();
+      return;
+    }
+    // No drawn feature splits the subsample with a gain, e.g. because they
+    // are all constant on it. Search on the full node instead.
+    draw_idx = invalid_count = n_known;
+    valids_tried = 0;
+    search();
+  }
+  d.invalid_count = invalid_count;
+};
+
+bool FastDecider::_make_node__subsample(Desk *desk) const {
+  auto &d = desk->d;
+  if (subsample_min_samples == 0 || d.n_samples < subsample_min_samples ||
+      d.n_samples <= subsample_size || d.bins != nullptr ||
+      d.sparse != nullptr || presort)
+    return false;
+  // A partial Fisher-Yates shuffle draws the subsample without replacement.
+  // The order of the node samples is arbitrary, since they are sorted or
+  // partitioned for the split anyway.
+  for (size_t i = 0; i < subsample_size; ++i) {
+    const size_t j = std::uniform_int_distribution<size_t>(
+        i, d.n_samples - 1)(desk->r.random_engine);
+    std::swap(d.elem_id_p[i], d.elem_id_p[j]);
+  }
+  // With a single feature, the parent's partition leaves the samples sorted,
+  // which the shuffle destroyed.
+  d.presorted = false;
+  DLOG_IF(INFO, DLOG_FD_V >= 1 && (d.node_id == LOG_FD_NID || LOG_FD_ALLN))
+      << "Ranking the features on " << subsample_size << " of " << d.n_samples
+      << " samples.";
+  d.n_samples = subsample_size;
+  d.end_id = d.start_id + subsample_size;
+  // The node statistics do not describe the subsample.
+  d.node_stats = nullptr;
+  return true;
+};
+
+void FastDecider::_make_node__eval_feature(const IDataProvider &dprov,
+                                           const size_t &feat_idx,
+                                           const id_t *node_ids,
+                                           Desk *desk) const {
+  auto &d = desk->d;
+  dprov.get_feature(feat_idx).match(
+      [&](const auto &feat_dta) { d.full_feat_p_v = feat_dta.data(); });
+  d.feat_idx = feat_idx;
+  if (presort) {
+    d.elem_id_p = &presorted_ids[feat_idx][d.start_id];
+  } else {
+    d.eval_ids.assign(node_ids, node_ids + d.n_samples);
+    d.elem_id_p = &d.eval_ids[0];
+    // The order of ties after sorting depends on the initial permutation.
+    std::iota(d.sort_perm.begin(), d.sort_perm.end(), 0);
+  }
+  // The optimizers only report improvements over the gain stored in the desk,
+  // which may stem from another node.
+  d.opt_res_v.match([](auto &opt_res) {
+    opt_res.gain = 0.f;
+    opt_res.valid = false;
+  });
+  threshold_optimizer->optimize(desk);
+};
+
+std::vector<OptSplitV> FastDecider::_make_node__eval_parallel(
+    const IDataProvider &dprov, const std::vector<size_t> &candidates,
+    Desk *desk) const {
+  const auto &d = desk->d;
+  // Shared with the helper tasks, which may only start once the batch is
+  // complete. They then find no candidate left and touch nothing else.
+  struct Batch {
+    std::vector<size_t> candidates;
+    std::vector<OptSplitV> results;
+    std::atomic<size_t> next{0};
+    size_t done = 0;
+    std::exception_ptr error;
+    std::mutex mtx;
+    std::condition_variable cv;
+  };
+  auto batch = std::make_shared<Batch>();
+  batch->candidates = candidates;
+  batch->results.resize(candidates.size());
+  const auto work = [this, &dprov, &d, batch](Desk *wdesk, bool set_up) {
+    for (size_t i = batch->next++; i < batch->candidates.size();
+         i = batch->next++) {
+      try {
+        if (!set_up) {
+          auto &w = wdesk->d;
+          w.n_samples = d.n_samples;
+          w.input_dim = d.input_dim;
+          w.annot_dim = d.annot_dim;
+          w.min_samples_at_leaf = d.min_samples_at_leaf;
+          w.node_id = d.node_id;
+          w.start_id = d.start_id;
+          w.end_id = d.end_id;
+          w.node_stats = d.node_stats;
+          w.presorted = d.presorted;
+          w.bins = nullptr;
+          w.elem_id_p = const_cast<id_t *>(&d.node_ids[0]);
+          threshold_optimizer->full_entropy(dprov, wdesk);
+          set_up = true;
+        }
+        _make_node__eval_feature(dprov, batch->candidates[i], &d.node_ids[0],
+                                 wdesk);
+        batch->results[i] = wdesk->d.opt_res_v;
+      } catch (...) {
+        std::unique_lock<std::mutex> lck(batch->mtx);
+        batch->error = std::current_exception();
+      }
+      std::unique_lock<std::mutex> lck(batch->mtx);
+      if (++batch->done == batch->candidates.size()) batch->cv.notify_all();
+    }
+  };
+  auto &tc = ThreadControl::getInstance();
+  const size_t n_helpers =
+      std::min<size_t>(tc.get_idle(), candidates.size() - 1);
+  for (size_t i = 0; i < n_helpers; ++i)
+    tc.push([work](Desk *wdesk) { work(wdesk, false); });
+  // The calling thread takes part with its desk that is already set up. It
+  // must not wait for the helper tasks themselves, since they may be queued
+  // behind tasks that are waiting as well.
+  work(desk, true);
+  std::unique_lock<std::mutex> lck(batch->mtx);
+  batch->cv.wait(lck,
+                 [&batch]() { return batch->done == batch->candidates.size(); });
+  if (batch->error) std::rethrow_exception(batch->error);
+  return std::move(batch->results);
+};
+
+void FastDecider::_make_node__presort(const IDataProvider &dprov,
+                                      Desk *desk) const {
+  auto &d = desk->d;
+  VLOG(22) << "Presorting " << d.n_samples << " samples for " << d.input_dim
+           << " features.";
+  presorted_ids.resize(d.input_dim);
+  id_t max_id = 0;
+  for (size_t i = 0; i < d.n_samples; ++i)
+    max_id = std::max(max_id, d.elem_id_p[i]);
+  goes_left.assign(max_id + 1, 0);
+  for (size_t feat_idx = 0; feat_idx < d.input_dim; ++feat_idx) {
+    auto &ids = presorted_ids[feat_idx];
+    ids.assign(d.elem_id_p, d.elem_id_p + d.n_samples);
+    dprov.get_feature(feat_idx).match([&](const auto &feat_dta) {
+      const auto *feat_p = feat_dta.data();
+      ska_sort(ids.begin(), ids.end(),
+               [feat_p](const id_t &id) { return feat_p[id]; });
+    });
+  }
+};
+
+void FastDecider::_make_node__partition_presorted(Desk *desk) const {
+  auto &d = desk->d;
+  const size_t n_left = d.left_int.second - d.left_int.first;
+  uint8_t *goes_left_p = &goes_left[0];
+  for (size_t i = 0; i < d.n_samples; ++i)
+    goes_left_p[d.elem_id_p[i]] = i < n_left;
+  // One more element, since the branch-free loop writes past the end of the
+  // right side once it is complete.
+  if (d.partition_buf.size() < d.n_samples - n_left + 1)
+    d.partition_buf.resize(d.n_samples - n_left + 1);
+  id_t *right_p = &d.partition_buf[0];
+  for (auto &ids : presorted_ids) {
+    id_t *ids_p = &ids[d.start_id];
+    size_t left_idx = 0, right_idx = 0;
+    // Branch-free stable partition: write to both sides, advance one.
+    for (size_t i = 0; i < d.n_samples; ++i) {
+      const id_t id = ids_p[i];
+      const size_t left = goes_left_p[id];
+      ids_p[left_idx] = id;
+      right_p[right_idx] = id;
+      left_idx += left;
+      right_idx += 1 - left;
+    }
+    FASSERT(left_idx == n_left);
+    std::copy(right_p, right_p + right_idx, ids_p + left_idx);
+  }
+};
+
+/**
+ * Only the nonzero values are visited. The samples on the side of the
+ * threshold without the zeros are marked and moved to their side.
+ */
+template <typename IT>
+void FastDecider::_make_node__partition_sparse(const IT &thresh,
+                                               const id_t &pivot_id,
+                                               Desk *desk) const {
+  auto &d = desk->d;
+  const bool zeros_left = static_cast<IT>(0) <= thresh;
+  const uint32_t node_mark = d.sparse_mark;
+  const uint32_t side_mark = ++d.sparse_mark;
+  uint32_t *marks_p = &d.sparse_marks[0];
+  d.sparse->for_each_marked(
+      d.best_feat_idx, d.elem_id_p, d.n_samples, marks_p, node_mark,
+      [&](const float &value, const id_t &id) {
+        if ((value <= thresh) != zeros_left) marks_p[id] = side_mark;
+      });
+  id_t rw_idx = pivot_id;
+  for (size_t i = 0; i < pivot_id && rw_idx < d.n_samples;) {
+    if ((marks_p[d.elem_id_p[i]] == side_mark) == zeros_left) {
+      std::swap(d.elem_id_p[i], d.elem_id_p[rw_idx++]);
+    } else
+      i++;
   }
-  d.invalid_counts[d.node_id] = invalid_count;
-  d.need_sort = feat_idx != d.best_feat_idx;
 };
 
 void FastDecider::_make_node__postprocess(const IDataProvider &dprov,
@@ -140,10 +464,12 @@ void FastDecider::_make_node__postprocess(const IDataProvider &dprov,
       VLOG_IF(20, (d.node_id == LOG_FD_NID || LOG_FD_ALLN))
           << "Suggesting to create a split for feature " << d.best_feat_idx;
       d.make_to_leaf = false;
-      if (d.node_to_featsel_p->size() == 0) {
+      if (!d.node_to_thresh_v_p->is<std::vector<IT>>()) {
+        // The map is reserved before the first split as float map.
         VLOG_IF(20, (d.node_id == LOG_FD_NID || LOG_FD_ALLN))
             << "Initializing threshold map.";
-        d.node_to_thresh_v_p->set<std::vector<IT>>();
+        d.node_to_thresh_v_p->set<std::vector<IT>>(
+            d.node_to_featsel_p->size());
       }
       FASSERT(d.node_to_featsel_p->size() > d.node_id);
       d.node_to_featsel_p->at(d.node_id) = d.best_feat_idx;
@@ -151,7 +477,9 @@ void FastDecider::_make_node__postprocess(const IDataProvider &dprov,
       FASSERT(node_to_thresh.size() > d.node_id);
       node_to_thresh[d.node_id] = best_res.thresh;
       id_t rw_idx = pivot_id;
-      if (d.need_sort) {
+      if (d.sparse != nullptr) {
+        _make_node__partition_sparse(best_res.thresh, pivot_id, desk);
+      } else if (d.need_sort) {
         VLOG(27) << "Sorting samples.";
         const IT *fullfeat = dprov.get_feature(d.best_feat_idx)
                                  .get_unchecked<VecCMap<IT>>()
@@ -167,14 +495,15 @@ void FastDecider::_make_node__postprocess(const IDataProvider &dprov,
       d.left_int.second = d.start_id + pivot_id;
       d.right_int.first = d.start_id + pivot_id;
       d.right_int.second = d.end_id;
-      FASSERT(d.invalid_counts.size() > d.node_id);
-      auto known_invalid = d.invalid_counts[d.node_id];
+      if (presort) _make_node__partition_presorted(desk);
+      threshold_optimizer->child_stats(best_res.left_stats, desk);
       d.left_id = desk->t.next_id_p->fetch_add(1);
       d.right_id = desk->t.next_id_p->fetch_add(1);
-      FASSERT(d.invalid_counts.size() > d.left_id);
-      d.invalid_counts[d.left_id] = known_invalid;
-      FASSERT(d.invalid_counts.size() > d.right_id);
-      d.invalid_counts[d.right_id] = known_invalid;
+      if (d.bins != nullptr)
+        d.hist_cache.add_children(d.node_id, d.left_id, d.right_id);
+      d.child_invalid.assign(d.feature_indices.begin(),
+                             d.feature_indices.begin() + d.invalid_count);
+      std::sort(d.child_invalid.begin(), d.child_invalid.end());
     }
   });
 }
@@ -183,6 +512,7 @@ void FastDecider::make_node(const TodoMark &todo_info,
                             const uint &min_samples_at_leaf,
                             const IDataProvider &data_provider, Desk *d) const {
   _make_node__checks(todo_info, data_provider, min_samples_at_leaf, d);
+  if (presort && todo_info.node_id == 0) _make_node__presort(data_provider, d);
   _make_node__opt(data_provider, d);
   _make_node__postprocess(data_provider, d);
 };
@@ -215,6 +545,34 @@ size_t FastDecider::get_data_dim() const {
   return data_dim;
 };
 
+NodeWork FastDecider::estimate_work(const size_t &n_samples,
+                                    const IDataProvider &dprov) const {
+  const double n = static_cast<double>(n_samples);
+  const double n_features = static_cast<double>(
+      n_valids_to_use == 0 ? dprov.get_feat_vec_dim() : n_valids_to_use);
+  const double sample_cost = threshold_optimizer->get_sample_cost(dprov);
+  const FeatureBins *bins = dprov.get_feature_bins();
+  if (bins != nullptr && bins->use_histogram(0, n_samples)) {
+    // Filling and scanning one histogram per feature.
+    const double n_bins = static_cast<double>(bins->get_max_bins());
+    return {0., n_features * (n + n_bins) * sample_cost};
+  }
+  if (presort) {
+    // Scanning and stably partitioning the sorted lists.
+    return {0., n_features * n * (sample_cost + 1.)};
+  }
+  if (subsample_min_samples > 0 && n_samples >= subsample_min_samples &&
+      n_samples > subsample_size) {
+    // Ranking the features on the subsample and refining the best one.
+    const double k = static_cast<double>(subsample_size);
+    return {n_features * k * std::log2(std::max(k, 2.)) +
+                n * std::log2(std::max(n, 2.)),
+            (n_features * k + n) * sample_cost};
+  }
+  return {n_features * n * std::log2(std::max(n, 2.)),
+          n_features * n * sample_cost};
+};
+
 std::shared_ptr<IThreshOpt> FastDecider::get_threshopt() const {
   return threshold_optimizer;
 };
@@ -230,7 +588,11 @@ bool FastDecider::operator==(const IDecider &rhs) const {
     bool eq_sfeatsel = node_to_featsel == rhs_c->node_to_featsel;
     bool eq_snts = node_to_thresh_v == rhs_c->node_to_thresh_v;
     bool eq_ddim = data_dim == rhs_c->data_dim;
-    return eq_valid && eq_scale && eq_opt && eq_sfeatsel && eq_snts && eq_ddim;
+    bool eq_presort = presort == rhs_c->presort;
+    bool eq_subsample = subsample_min_samples == rhs_c->subsample_min_samples &&
+                        subsample_size == rhs_c->subsample_size;
+    return eq_valid && eq_scale && eq_opt && eq_sfeatsel && eq_snts &&
+           eq_ddim && eq_presort && eq_subsample;
   }
 };
 
@@ -1,9 +1,20 @@
 #include <forpy/deciders/idecider.h>
 
+#include <algorithm>
+#include <cmath>
+
 namespace forpy {
 
   IDecider::~IDecider() {};
 
   IDecider::IDecider() {};
 
+  NodeWork IDecider::estimate_work(const size_t &n_samples,
+                                   const IDataProvider &data_provider) const {
+    const double n = static_cast<double>(n_samples);
+    const double n_features =
+        static_cast<double>(data_provider.get_feat_vec_dim());
+    return {n_features * n * std::log2(std::max(n, 2.)), n_features * n};
+  };
+
 } //namespace forpy
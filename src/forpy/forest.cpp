@@ -1,5 +1,8 @@
 #include "../../include/forpy/forest.h"
+#include <forpy/codegen.h>
 #include <forpy/leafs/regressionleaf.h>
+#include <forpy/threshold_optimizers/extraclassopt.h>
+#include <forpy/threshold_optimizers/extraregopt.h>
 #include <forpy/threshold_optimizers/regression_opt.h>
 #include "../../include/forpy/util/sampling.h"
 
@@ -81,6 +84,246 @@ Forest::Forest(std::string filename) {
   }
 };  // namespace forpy
 
+Data<Mat> Forest::predict(const Data<MatCRef> &data_v, const int &num_threads,
+                          const bool &use_fast_prediction_if_available,
+                          const bool &predict_proba) {
+  if (num_threads < 0)
+    throw ForpyException("The number of threads must be >=0!");
+  const size_t n_threads =
+      num_threads == 0
+          ? std::max<size_t>(1, std::thread::hardware_concurrency())
+          : static_cast<size_t>(num_threads);
+  const size_t n_trees = trees.size();
+  Vec<float> tree_weights(n_trees);
+  for (size_t tree_idx = 0; tree_idx < n_trees; ++tree_idx) {
+    tree_weights(tree_idx) = trees[tree_idx]->get_weight();
+    if (use_fast_prediction_if_available &&
+        trees[tree_idx]->fast_tree.get() == nullptr &&
+        dynamic_cast<FastDecider const *>(
+            trees[tree_idx]->decider.get()) != nullptr)
+      trees[tree_idx]->enable_fast_prediction();
+  }
+  const ILeaf *lm = trees[0]->leaf_manager.get();
+  Data<Mat> result_v;
+  data_v.match(
+      [&](const auto &data) {
+        if (static_cast<size_t>(data.cols()) != get_input_data_dimensions())
+          throw ForpyException("Wrong array shape! Expecting " +
+                               std::to_string(get_input_data_dimensions()) +
+                               " columns!");
+        const size_t n_rows = static_cast<size_t>(data.rows());
+        const size_t acc_cols =
+            lm->get_accumulator_columns(n_trees, predict_proba);
+        // Tile the work over (row block x tree group). Additional tree
+        // groups are only introduced if there are too few row blocks to keep
+        // all threads busy (small batches), since each tree group requires
+        // its own accumulator.
+        const size_t n_tiles_wanted =
+            n_threads == 1 ? 1 : n_threads * PREDICT_CHUNKS_PER_THREAD;
+        const size_t n_row_blocks = std::min<size_t>(
+            n_rows,
+            std::max<size_t>(n_tiles_wanted,
+                             (n_rows + FOREST_PREDICT_BLOCK_ROWS - 1) /
+                                 FOREST_PREDICT_BLOCK_ROWS));
+        const size_t n_tree_groups =
+            n_row_blocks == 0
+                ? 1
+                : std::min<size_t>(
+                      n_trees,
+                      (n_tiles_wanted + n_row_blocks - 1) / n_row_blocks);
+        VLOG(9) << "Predicting " << n_rows << " rows with " << n_trees
+                << " trees in " << n_row_blocks << " row blocks and "
+                << n_tree_groups << " tree groups.";
+        std::vector<Mat<float>> accumulators(
+            n_tree_groups, Mat<float>::Zero(n_rows, acc_cols));
+        auto predict_tile = [&](const size_t &row_block,
+                                const size_t &tree_group) {
+          const size_t start = n_rows * row_block / n_row_blocks;
+          const size_t end = n_rows * (row_block + 1) / n_row_blocks;
+          const size_t tree_start = n_trees * tree_group / n_tree_groups;
+          const size_t tree_end = n_trees * (tree_group + 1) / n_tree_groups;
+          float *acc_p = accumulators[tree_group].data();
+          std::vector<id_t> leaf_ids(end - start);
+          for (size_t tree_idx = tree_start; tree_idx < tree_end; ++tree_idx) {
+            const Tree *tree = trees[tree_idx].get();
+            const ILeaf *tree_lm = tree->leaf_manager.get();
+            const float &weight = tree_weights(tree_idx);
+            tree->predict_leaf_ids(data_v, start, end, &leaf_ids[0]);
+            for (size_t row_idx = start; row_idx < end; ++row_idx)
+              tree_lm->accumulate_result(leaf_ids[row_idx - start], tree_idx,
+                                         weight, acc_p + row_idx * acc_cols,
+                                         predict_proba);
+          }
+        };
+        if (n_threads == 1 || n_row_blocks * n_tree_groups <= 1) {
+          for (size_t row_block = 0; row_block < n_row_blocks; ++row_block)
+            for (size_t tree_group = 0; tree_group < n_tree_groups;
+                 ++tree_group)
+              predict_tile(row_block, tree_group);
+        } else {
+          PredictionPool::getInstance().run(
+              n_threads, n_row_blocks * n_tree_groups,
+              [&](const size_t &tile_idx) {
+                predict_tile(tile_idx / n_tree_groups,
+                             tile_idx % n_tree_groups);
+              });
+        }
+        // Reduce once.
+        for (size_t tree_group = 1; tree_group < n_tree_groups; ++tree_group)
+          accumulators[0] += accumulators[tree_group];
+        auto restype_v = lm->get_result_type(predict_proba, false);
+        restype_v.match(
+            [&](const auto &restype) {
+              typedef typename get_core<decltype(restype.data())>::type RT;
+              result_v.set<Mat<RT>>(Mat<RT>::Zero(
+                  n_rows,
+                  lm->get_result_columns(n_trees, predict_proba, false)));
+              Data<MatRef> dref =
+                  MatRef<RT>(result_v.get_unchecked<Mat<RT>>());
+              lm->finalize_result(accumulators[0], dref, n_trees,
+                                  tree_weights, predict_proba);
+            },
+            [](const Empty &) { throw EmptyException(); });
+      },
+      [](const Empty &) { throw EmptyException(); });
+  return result_v;
+};
+
+Data<Mat> Forest::predict_sparse(const SparseMat &data, const int &num_threads,
+                                 const bool &predict_proba) {
+  return predict_sparse_rows(data, [&](const Data<MatCRef> &block) {
+    return predict(block, num_threads, true, predict_proba);
+  });
+};
+
+Mat<uint> Forest::apply(const Data<MatCRef> &data_v,
+                        const int &num_threads) {
+  if (num_threads < 0)
+    throw ForpyException("The number of threads must be >=0!");
+  const size_t n_threads =
+      num_threads == 0
+          ? std::max<size_t>(1, std::thread::hardware_concurrency())
+          : static_cast<size_t>(num_threads);
+  const size_t n_trees = trees.size();
+  for (auto &tree : trees)
+    if (tree->fast_tree.get() == nullptr &&
+        dynamic_cast<FastDecider const *>(tree->decider.get()) != nullptr)
+      tree->enable_fast_prediction();
+  Mat<uint> result;
+  data_v.match(
+      [&](const auto &data) {
+        if (static_cast<size_t>(data.cols()) != get_input_data_dimensions())
+          throw ForpyException("Wrong array shape! Expecting " +
+                               std::to_string(get_input_data_dimensions()) +
+                               " columns!");
+        const size_t n_rows = static_cast<size_t>(data.rows());
+        result.resize(n_rows, n_trees);
+        // Every block writes its own result rows.
+        auto apply_block = [&](const size_t &start, const size_t &end) {
+          std::vector<id_t> leaf_ids(end - start);
+          for (size_t tree_idx = 0; tree_idx < n_trees; ++tree_idx) {
+            trees[tree_idx]->predict_leaf_ids(data_v, start, end,
+                                              leaf_ids.data());
+            for (size_t row_idx = start; row_idx < end; ++row_idx)
+              result(row_idx, tree_idx) =
+                  static_cast<uint>(leaf_ids[row_idx - start]);
+          }
+        };
+        const size_t n_blocks = std::min<size_t>(
+            n_rows,
+            std::max<size_t>(n_threads == 1
+                                 ? 1
+                                 : n_threads * PREDICT_CHUNKS_PER_THREAD,
+                             (n_rows + FOREST_PREDICT_BLOCK_ROWS - 1) /
+                                 FOREST_PREDICT_BLOCK_ROWS));
+        if (n_threads == 1 || n_blocks <= 1) {
+          for (size_t block = 0; block < n_blocks; ++block)
+            apply_block(n_rows * block / n_blocks,
+                        n_rows * (block + 1) / n_blocks);
+        } else {
+          PredictionPool::getInstance().run(
+              n_threads, n_blocks, [&](const size_t &block) {
+                apply_block(n_rows * block / n_blocks,
+                            n_rows * (block + 1) / n_blocks);
+              });
+        }
+      },
+      [](const Empty &) { throw EmptyException(); });
+  return result;
+};
+
+std::tuple<Vec<uint>, Vec<size_t>, size_t> Forest::apply_csr(
+    const Data<MatCRef> &data_v, const int &num_threads) {
+  const Mat<uint> leaf_ids = apply(data_v, num_threads);
+  const size_t n_trees = trees.size();
+  const size_t n_rows = static_cast<size_t>(leaf_ids.rows());
+  // The column of every leaf, numbered per tree in node id order.
+  std::vector<std::vector<uint>> leaf_columns(n_trees);
+  size_t n_cols = 0;
+  for (size_t tree_idx = 0; tree_idx < n_trees; ++tree_idx) {
+    const auto &tree = trees[tree_idx]->tree;
+    leaf_columns[tree_idx].resize(tree.size(), 0);
+    for (size_t node_id = 0; node_id < tree.size(); ++node_id)
+      if (tree[node_id].first == 0 || tree[node_id].second == 0)
+        leaf_columns[tree_idx][node_id] = static_cast<uint>(n_cols++);
+  }
+  Vec<uint> indices(n_rows * n_trees);
+  Vec<size_t> indptr(n_rows + 1);
+  for (size_t row_idx = 0; row_idx < n_rows; ++row_idx) {
+    indptr(row_idx) = row_idx * n_trees;
+    for (size_t tree_idx = 0; tree_idx < n_trees; ++tree_idx)
+      indices(row_idx * n_trees + tree_idx) =
+          leaf_columns[tree_idx][leaf_ids(row_idx, tree_idx)];
+  }
+  indptr(n_rows) = n_rows * n_trees;
+  return std::make_tuple(indices, indptr, n_cols);
+};
+
+void Forest::enable_fast_prediction(const std::string &engine) {
+  if (engine != "tree" && engine != "bitvector")
+    throw ForpyException("Unknown prediction engine: " + engine +
+                         " (use `tree` or `bitvector`)!");
+  bitvector_forest.reset();
+  // Batches are always predicted tree by tree.
+  for (auto &tree : trees)
+    if (tree->fast_tree.get() == nullptr) tree->enable_fast_prediction();
+  if (engine == "bitvector") {
+    for (const auto &tree : trees)
+      if (dynamic_cast<FastDecider const *>(tree->decider.get()) == nullptr)
+        throw ForpyException(
+            "The bitvector engine can only be used with threshold deciders.");
+    const auto *dec0 =
+        dynamic_cast<FastDecider const *>(trees[0]->decider.get());
+    dec0->get_maps().second->match(
+        [&](const auto &threshold_map0) {
+          typedef typename std::remove_const<
+              typename std::remove_reference<decltype(
+                  *threshold_map0.data())>::type>::type thresh_t;
+          BitvectorForest<thresh_t> bvf(get_input_data_dimensions());
+          for (const auto &tree : trees) {
+            auto maps = dynamic_cast<FastDecider const *>(tree->decider.get())
+                            ->get_maps();
+            if (!maps.second->template is<std::vector<thresh_t>>())
+              throw ForpyException(
+                  "All trees must use the same threshold type for the "
+                  "bitvector engine!");
+            bvf.add_tree(tree->tree, *(maps.first),
+                         maps.second->template get_unchecked<
+                             std::vector<thresh_t>>());
+          }
+          bvf.finalize();
+          VLOG(9) << "Built bitvector engine for " << bvf.get_n_trees()
+                  << " trees (" << bvf.get_n_fallback_trees()
+                  << " with more than " << BITVECTOR_MAX_LEAFS << " leafs).";
+          this->bitvector_forest =
+              std::make_unique<BitvectorForestV>(std::move(bvf));
+        },
+        [](const Empty &) {
+          throw ForpyException("Received empty threshold map!");
+        });
+  }
+};
+
 Forest *Forest::fit(const Data<MatCRef> &data_v,
                     const Data<MatCRef> &annotations_v, const size_t &n_threads,
                     const bool &bootstrap, const std::vector<float> &weights) {
@@ -193,6 +436,7 @@ Forest *Forest::fit_dprov(const std::shared_ptr<IDataProvider> &fdata_provider,
     if (trees[i]->is_initialized_for_training)
       throw ForpyException("At least one of the trees has been fitted before!");
     trees[i]->is_initialized_for_training = true;
+    trees[i]->layout = ENodeLayout::Training;
     auto sample_ids = std::make_shared<std::vector<id_t>>(
         tree_provs[i]->get_initial_sample_list());
     TodoMark mark(sample_ids, interv_t(0, sample_ids->size()),
@@ -230,6 +474,20 @@ void Forest::save(const std::string &filename) const {
   fstream.close();
 }
 
+void Forest::export_cpp(const std::string &filename, const ECodegenMode &mode,
+                        const std::string &name) const {
+  std::vector<const Tree *> tree_ptrs;
+  for (const auto &tree : trees) tree_ptrs.push_back(tree.get());
+  const auto tree_weights = get_tree_weights();
+  const std::string code = generate_cpp(
+      tree_ptrs,
+      Eigen::Map<const Vec<float>>(tree_weights.data(), tree_weights.size()),
+      mode, name);
+  std::ofstream fstream(filename);
+  if (!fstream) throw ForpyException("Could not write to file: " + filename);
+  fstream << code;
+};
+
 ClassificationForest::ClassificationForest(
     const size_t &n_trees, const uint &max_depth,
     const uint &min_samples_at_leaf, const uint &min_samples_at_node,
@@ -276,4 +534,50 @@ RegressionForest::RegressionForest(
              {"store_variance", false},
              {"summarize", false}} {};
 
+ExtraTreesClassifier::ExtraTreesClassifier(
+    const size_t &n_trees, const uint &max_depth,
+    const uint &min_samples_at_leaf, const uint &min_samples_at_node,
+    const uint &n_valid_features_to_use, const bool &autoscale_valid_features,
+    const uint &random_seed, const size_t &n_thresholds,
+    const float &gain_threshold)
+    : Forest(n_trees, max_depth, min_samples_at_leaf, min_samples_at_node,
+             std::make_shared<FastDecider>(
+                 std::make_shared<ExtraClassOpt>(n_thresholds, gain_threshold),
+                 n_valid_features_to_use, autoscale_valid_features),
+             std::make_shared<ClassificationLeaf>(), random_seed),
+      params{{"n_trees", n_trees},
+             {"max_depth", max_depth},
+             {"min_samples_at_leaf", min_samples_at_leaf},
+             {"min_samples_at_node", min_samples_at_node},
+             {"n_valid_features_to_use", n_valid_features_to_use},
+             {"autoscale_valid_features", autoscale_valid_features},
+             {"random_seed", random_seed},
+             {"n_thresholds", n_thresholds},
+             {"gain_threshold", gain_threshold}} {};
+
+ExtraTreesRegressor::ExtraTreesRegressor(
+    const size_t &n_trees, const uint &max_depth,
+    const uint &min_samples_at_leaf, const uint &min_samples_at_node,
+    const uint &n_valid_features_to_use, const bool &autoscale_valid_features,
+    const uint &random_seed, const size_t &n_thresholds,
+    const float &gain_threshold, const bool &store_variance,
+    const bool &summarize)
+    : Forest(n_trees, max_depth, min_samples_at_leaf, min_samples_at_node,
+             std::make_shared<FastDecider>(
+                 std::make_shared<ExtraRegOpt>(n_thresholds, gain_threshold),
+                 n_valid_features_to_use, autoscale_valid_features),
+             std::make_shared<RegressionLeaf>(store_variance, summarize),
+             random_seed),
+      params{{"n_trees", n_trees},
+             {"max_depth", max_depth},
+             {"min_samples_at_leaf", min_samples_at_leaf},
+             {"min_samples_at_node", min_samples_at_node},
+             {"n_valid_features_to_use", n_valid_features_to_use},
+             {"autoscale_valid_features", autoscale_valid_features},
+             {"random_seed", random_seed},
+             {"n_thresholds", n_thresholds},
+             {"gain_threshold", gain_threshold},
+             {"store_variance", store_variance},
+             {"summarize", summarize}} {};
+
 }  // namespace forpy
@@ -1,3 +1,4 @@
+#include <forpy/codegen.h>
 #include <forpy/leafs/classificationleaf.h>
 #include <forpy/threshold_optimizers/classification_opt.h>
 
@@ -75,7 +76,13 @@ void ClassificationLeaf::make_leaf(const TodoMark &todo_info,
   const uint *annot_p = desk->d.class_annot_p;
   const float *weights_p = desk->d.weights_p;
   float total = 0.f;
-  if (weights_p == nullptr) {
+  if (todo_info.stats.size() == n_classes) {
+    // The class weights are known from the split of the parent.
+    for (size_t i = 0; i < n_classes; ++i) {
+      dist[i] = static_cast<float>(todo_info.stats[i]);
+      total += dist[i];
+    }
+  } else if (weights_p == nullptr) {
     for (size_t i = todo_info.interv.first; i < todo_info.interv.second; ++i) {
       const size_t class_ = annot_p[elem_list_p[i]];
       total += 1.f;
@@ -138,10 +145,11 @@ void ClassificationLeaf::get_result(const id_t &node_id, Data<MatRef> &target_v,
     if (class_transl_ptr == nullptr || for_forest)
       target = stored_distributions[node_id].transpose();
     else {
-      target = Mat<float>::Zero(target.rows(), 1);
-      const auto &res_comp = stored_distributions[node_id].transpose();
-      for (size_t idx = 0; idx < static_cast<size_t>(res_comp.rows()); ++idx) {
-        target(class_transl_ptr->at(idx), 0) = res_comp(idx);
+      // The target is a result row.
+      target.setZero();
+      const auto &res_comp = stored_distributions[node_id];
+      for (size_t idx = 0; idx < static_cast<size_t>(res_comp.size()); ++idx) {
+        target(0, class_transl_ptr->at(idx)) = res_comp(idx);
       }
     }
   } else {
@@ -208,6 +216,95 @@ void ClassificationLeaf::get_result(const std::vector<Data<Mat>> &leaf_results,
       [](Empty &) { throw EmptyException(); });
 };
 
+size_t ClassificationLeaf::get_accumulator_columns(
+    const size_t &n_trees, const bool & /*predict_proba*/) const {
+  return get_result_columns(n_trees, false, true);
+};
+
+void ClassificationLeaf::accumulate_result(const id_t &node_id,
+                                           const size_t & /*tree_idx*/,
+                                           const float &weight, float *acc_row,
+                                           const bool & /*predict_proba*/) const {
+  if (node_id >= stored_distributions.size())
+    throw ForpyException("No leaf stored for node id " +
+                         std::to_string(node_id));
+  const float *dist_p = stored_distributions[node_id].data();
+  for (size_t cls_idx = 0; cls_idx < n_classes; ++cls_idx)
+    acc_row[cls_idx] += weight * dist_p[cls_idx];
+};
+
+void ClassificationLeaf::finalize_result(const MatCRef<float> &accumulator,
+                                         Data<MatRef> &target_v,
+                                         const size_t &n_trees,
+                                         const Vec<float> & /*weights*/,
+                                         const bool &predict_proba) const {
+  target_v.match(
+      [&](auto &target) {
+        const float n_trees_f = static_cast<float>(n_trees);
+        for (size_t sidx = 0; sidx < static_cast<size_t>(accumulator.rows());
+             ++sidx) {
+          if (predict_proba) {
+            for (size_t didx = 0;
+                 didx < static_cast<size_t>(accumulator.cols()); ++didx)
+              target(sidx, class_transl_ptr == nullptr
+                               ? didx
+                               : class_transl_ptr->at(didx)) =
+                  accumulator(sidx, didx) / n_trees_f;
+          } else {
+            int transl_cls;
+            accumulator.row(sidx).maxCoeff(&transl_cls);
+            if (class_transl_ptr != nullptr)
+              target(sidx, 0) = class_transl_ptr->at(transl_cls);
+            else
+              target(sidx, 0) = transl_cls;
+          }
+        }
+      },
+      [](Empty &) { throw EmptyException(); });
+};
+
+void ClassificationLeaf::finalize_one(const float *acc,
+                                      const size_t &n_trees,
+                                      const float & /*weight_sum*/,
+                                      const bool &predict_proba,
+                                      float *out) const {
+  if (predict_proba) {
+    const float n_trees_f = static_cast<float>(n_trees);
+    if (class_transl_ptr == nullptr) {
+      for (size_t cls_idx = 0; cls_idx < n_classes; ++cls_idx)
+        out[cls_idx] = acc[cls_idx] / n_trees_f;
+    } else {
+      std::fill_n(out, true_max_class + 1, 0.f);
+      for (size_t cls_idx = 0; cls_idx < n_classes; ++cls_idx)
+        out[class_transl_ptr->at(cls_idx)] = acc[cls_idx] / n_trees_f;
+    }
+  } else {
+    // The first maximum wins, as in finalize_result.
+    size_t best = 0;
+    for (size_t cls_idx = 1; cls_idx < n_classes; ++cls_idx)
+      if (acc[cls_idx] > acc[best]) best = cls_idx;
+    out[0] = static_cast<float>(
+        class_transl_ptr == nullptr ? best : class_transl_ptr->at(best));
+  }
+};
+
+std::string ClassificationLeaf::get_export_finalizer(
+    const size_t & /*n_trees*/, const Vec<float> & /*weights*/) const {
+  if (n_classes == 0)
+    throw ForpyException("This leaf has not been initialized yet!");
+  // Like Eigen's maxCoeff, the first maximum wins.
+  std::string code =
+      "  unsigned int best = 0;\n"
+      "  for (unsigned int cls = 1; cls < detail::n_acc; ++cls)\n"
+      "    if (acc[cls] > acc[best]) best = cls;\n";
+  if (class_transl_ptr == nullptr) return code + "  out[0] = best;\n";
+  code += "  const result_t labels[] = {";
+  for (size_t cls_idx = 0; cls_idx < class_transl_ptr->size(); ++cls_idx)
+    code += (cls_idx == 0 ? "" : ", ") +
+            cpp_literal(class_transl_ptr->at(cls_idx));
+  return code + "};\n  out[0] = labels[best];\n";
+};
+
 bool ClassificationLeaf::operator==(const ILeaf &rhs) const {
   const auto *rhs_c = dynamic_cast<ClassificationLeaf const *>(&rhs);
   if (rhs_c == nullptr)
@@ -1,3 +1,4 @@
+#include <forpy/codegen.h>
 #include <forpy/leafs/regressionleaf.h>
 
 namespace forpy {
@@ -29,6 +30,15 @@ void RegressionLeaf::make_leaf(const TodoMark &todo_info,
     desk->l.leaf_regression_map_p->at(node_id) =
         Mat<float>::Zero(data_provider.get_annot_vec_dim(), 1);
   float *res_dta = desk->l.leaf_regression_map_p->at(node_id).data();
+  if (!store_variance && data_provider.get_weights() == nullptr &&
+      todo_info.stats.size() == annot_dim + 2) {
+    // The annotation sums are known from the split of the parent (see
+    // RegressionOpt::child_stats).
+    for (size_t didx = 0; didx < annot_dim; ++didx)
+      res_dta[didx] = static_cast<float>(todo_info.stats[didx] /
+                                         todo_info.stats[annot_dim]);
+    return;
+  }
   full_annotation_v.match(
       [&](const auto &annotations) {
         typedef typename get_core<decltype(annotations.data()[0])>::type AT;
@@ -140,6 +150,81 @@ void RegressionLeaf::get_result(const std::vector<Data<Mat>> &leaf_results,
       [](Empty &) { throw EmptyException(); });
 };  // namespace forpy
 
+void RegressionLeaf::accumulate_result(const id_t &node_id,
+                                       const size_t &tree_idx,
+                                       const float &weight, float *acc_row,
+                                       const bool &predict_proba) const {
+  if (annot_dim == 0)
+    throw ForpyException("This leaf has not been initialized yet!");
+  const float *res = leaf_regression_map[node_id].data();
+  if (predict_proba && summarize) {
+    for (size_t dim_idx = 0; dim_idx < annot_dim; ++dim_idx) {
+      acc_row[dim_idx * 2] += weight * res[dim_idx * 2];
+      acc_row[dim_idx * 2 + 1] +=
+          weight * (res[dim_idx * 2] * res[dim_idx * 2] + res[dim_idx * 2 + 1]);
+    }
+  } else if (predict_proba) {
+    // The tree results are concatenated, not fused.
+    float *tree_acc = acc_row + tree_idx * 2 * annot_dim;
+    for (size_t didx = 0; didx < 2 * annot_dim; ++didx)
+      tree_acc[didx] += res[didx];
+  } else {
+    // Like the fusion of stored tree results, the means are summed
+    // unweighted and normalized by the sum of weights.
+    const size_t stride = store_variance ? 2 : 1;
+    for (size_t dim_idx = 0; dim_idx < annot_dim; ++dim_idx)
+      acc_row[dim_idx] += res[dim_idx * stride];
+  }
+};
+
+void RegressionLeaf::finalize_result(const MatCRef<float> &accumulator,
+                                     Data<MatRef> &target_v,
+                                     const size_t &n_trees,
+                                     const Vec<float> &weights,
+                                     const bool &predict_proba) const {
+  auto &target = target_v.get<MatRef<float>>();
+  if (predict_proba && !summarize) {
+    target = accumulator;
+    return;
+  }
+  target = accumulator / (weights.rows() == 0 ? static_cast<float>(n_trees)
+                                              : weights.sum());
+  if (predict_proba) {
+    for (size_t dim_idx = 0; dim_idx < annot_dim; ++dim_idx) {
+      target.block(0, 2 * dim_idx + 1, target.rows(), 1) -=
+          (target.block(0, 2 * dim_idx, target.rows(), 1).array() *
+           target.block(0, 2 * dim_idx, target.rows(), 1).array())
+              .matrix();
+    }
+  }
+};
+
+void RegressionLeaf::finalize_one(const float *acc, const size_t &n_trees,
+                                  const float &weight_sum,
+                                  const bool &predict_proba,
+                                  float *out) const {
+  if (predict_proba && !summarize) {
+    std::copy_n(acc, n_trees * 2 * annot_dim, out);
+    return;
+  }
+  const size_t n_cols = predict_proba ? 2 * annot_dim : annot_dim;
+  for (size_t col = 0; col < n_cols; ++col) out[col] = acc[col] / weight_sum;
+  if (predict_proba)
+    for (size_t dim_idx = 0; dim_idx < annot_dim; ++dim_idx)
+      out[2 * dim_idx + 1] -= out[2 * dim_idx] * out[2 * dim_idx];
+};
+
+std::string RegressionLeaf::get_export_finalizer(
+    const size_t &n_trees, const Vec<float> &weights) const {
+  if (annot_dim == 0)
+    throw ForpyException("This leaf has not been initialized yet!");
+  const float denom =
+      weights.rows() == 0 ? static_cast<float>(n_trees) : weights.sum();
+  return "  for (unsigned int dim = 0; dim < n_outputs; ++dim)\n"
+         "    out[dim] = acc[dim] / " +
+         cpp_literal(denom) + ";\n";
+};
+
 bool RegressionLeaf::operator==(const ILeaf &rhs) const {
   const auto *rhs_c = dynamic_cast<RegressionLeaf const *>(&rhs);
   if (rhs_c == nullptr)
@@ -1,5 +1,6 @@
 #include <forpy/threshold_optimizers/classification_opt.h>
 #include <forpy/types.h>
+#include <forpy/util/sort_ids.h>
 
 #include <skasort.hpp>
 
@@ -164,16 +165,9 @@ inline void ClassificationOpt::optimize__sort(DeciderDesk &d) const {
     DLOG_IF(INFO,
             DLOG_COPT_V >= 4 && (d.node_id == LOG_COPT_NID || LOG_COPT_ALLN))
         << "Sorting...";
-    id_t *elem_ids_sorted_p = d.elem_ids_sorted_p;
-    ska_sort(sort_perm_p, sort_perm_p + n_samples,
-             [&](const size_t &i1) { return feat_p[i1]; });
-    for (size_t w_idx = 0; w_idx < n_samples; ++w_idx) {
-      size_t elem_id = sort_perm_p[w_idx];
-      size_t sample_id = elem_id_p[elem_id];
-      elem_ids_sorted_p[w_idx] = sample_id;
-      feat_p[w_idx] = full_feat_p[sample_id];
-    }
-    std::copy(elem_ids_sorted_p, elem_ids_sorted_p + n_samples, elem_id_p);
+    // Counting sort for uint8_t features.
+    sort_ids_by_feature(feat_p, elem_id_p, n_samples, full_feat_p, sort_perm_p,
+                        d.elem_ids_sorted_p);
   }
   DLOG_IF(INFO,
           DLOG_COPT_V >= 1 && (d.node_id == LOG_COPT_NID || LOG_COPT_ALLN))
@@ -188,7 +182,8 @@ inline SplitOptRes<IT> &ClassificationOpt::optimize__setup(
     d.opt_res_v = SplitOptRes<IT>{.split_idx = 0,
                                   .thresh = std::numeric_limits<IT>::lowest(),
                                   .gain = 0.f,
-                                  .valid = false};
+                                  .valid = false,
+                                  .left_stats = {}};
   SplitOptRes<IT> &ret_res = d.opt_res_v.get_unchecked<SplitOptRes<IT>>();
   ret_res.valid = false;
   return ret_res;
@@ -200,8 +195,11 @@ inline std::unique_ptr<std::vector<IT>> ClassificationOpt::optimize__thresholds(
   if (n_thresholds == 0) {
     return nullptr;
   } else {
-    IT maxval = desk->d.feat_p[desk->d.n_samples - 1];  // TODO fix.
-    IT minval = desk->d.feat_p[0];
+    // The sorted feature values of the node.
+    const auto &feat_vec =
+        desk->d.class_feat_values.get_unchecked<std::vector<IT>>();
+    IT maxval = feat_vec[desk->d.n_samples - 1];
+    IT minval = feat_vec[0];
     id_t n_thresholds_capped = std::min<size_t>(
         n_thresholds, std::ceil((maxval - minval) / CLASSOPT_EPS));
     n_thresholds_capped =
@@ -314,7 +312,9 @@ void ClassificationOpt::optimize(Desk *desk) const {
         break;
       }
       if (n_thresholds > 0)
-        while (current_val > *feat_val_it) ++feat_val_it;
+        while (feat_val_it != thresholds->end() &&
+               current_val > *feat_val_it)
+          ++feat_val_it;
     }
     if (ret_res.valid) {
       ret_res.thresh =
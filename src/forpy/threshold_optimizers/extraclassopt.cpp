@@ -0,0 +1,141 @@
+#include <forpy/threshold_optimizers/extraclassopt.h>
+#include <forpy/types.h>
+#include <forpy/util/gather.h>
+
+namespace forpy {
+
+ExtraClassOpt::ExtraClassOpt(const size_t &n_thresholds,
+                             const float &gain_threshold)
+    : FastClassOpt(n_thresholds, gain_threshold) {
+  if (n_thresholds == 0)
+    throw ForpyException("The ExtraClassOpt requires n_thresholds > 0!");
+};
+
+template <typename IT>
+inline void ExtraClassOpt::optimize__extra(Desk *desk) const {
+  DeciderDesk &d = desk->d;
+  if (!d.opt_res_v.is<SplitOptRes<IT>>())
+    d.opt_res_v = SplitOptRes<IT>{.split_idx = 0,
+                                  .thresh = std::numeric_limits<IT>::lowest(),
+                                  .gain = 0.f,
+                                  .valid = false,
+                                  .left_stats = {}};
+  SplitOptRes<IT> &ret_res = d.opt_res_v.get_unchecked<SplitOptRes<IT>>();
+  ret_res.valid = false;
+  IT *feat_p = &d.class_feat_values.get_unchecked<std::vector<IT>>()[0];
+  const IT *full_feat_p = d.full_feat_p_v.get_unchecked<const IT *>();
+  const id_t *elem_id_p = d.elem_id_p;
+  const size_t n_samples = d.n_samples;
+  gather(full_feat_p, elem_id_p, n_samples, feat_p, d.prefetch);
+  IT minval = feat_p[0], maxval = feat_p[0];
+  for (size_t i = 1; i < n_samples; ++i) {
+    minval = std::min(minval, feat_p[i]);
+    maxval = std::max(maxval, feat_p[i]);
+  }
+  if (maxval - minval <= CLASSOPT_EPS) {
+    DLOG_IF(INFO, DLOG_FCOPT_V >= 1 &&
+                      (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+        << "Not optimizing because min and max features are too close!";
+    return;
+  }
+  size_t n_thresholds_capped = std::min<size_t>(
+      n_thresholds, std::ceil((maxval - minval) / CLASSOPT_EPS));
+  n_thresholds_capped = std::min<size_t>(n_thresholds_capped, n_samples);
+  std::vector<IT> thresholds(n_thresholds_capped);
+  std::uniform_real_distribution<float> udist(minval, maxval);
+  for (size_t i = 0; i < n_thresholds_capped; ++i)
+    thresholds[i] = static_cast<IT>(udist(desk->r.random_engine));
+  std::sort(thresholds.begin(), thresholds.end());
+  // Per interval between thresholds: the class weights and the sample count.
+  // A sample is left of all thresholds at or above its interval.
+  const size_t stride = n_classes + 1;
+  const size_t n_intervals = n_thresholds_capped + 1;
+  d.hist_sums.assign((n_intervals + 1) * stride, 0.);
+  double *hist = &d.hist_sums[0];
+  const uint *anp = d.class_annot_p;
+  const float *weights_p = d.weights_p;
+  const auto add_sample = [&](const size_t &i, const size_t &interval) {
+    const id_t elem_id = elem_id_p[i];
+    double *bin_p = hist + interval * stride;
+    bin_p[anp[elem_id]] += weights_p == nullptr ? 1. : weights_p[elem_id];
+    bin_p[n_classes] += 1.;
+  };
+  if (n_thresholds_capped == 1) {
+    const IT thresh = thresholds[0];
+    for (size_t i = 0; i < n_samples; ++i) add_sample(i, feat_p[i] > thresh);
+  } else {
+    for (size_t i = 0; i < n_samples; ++i)
+      add_sample(i, std::lower_bound(thresholds.begin(), thresholds.end(),
+                                     feat_p[i]) -
+                        thresholds.begin());
+  }
+  double full_w = 0., sqsum = 0.;
+  for (size_t i = 0; i < n_classes; ++i) {
+    full_w += d.full_stats[i];
+    sqsum += d.full_stats[i] * d.full_stats[i];
+  }
+  const double fullentropy = 1. - sqsum / (full_w * full_w);
+  const size_t msal = d.min_samples_at_leaf;
+  double *lsp = hist + n_intervals * stride;
+  double left_w = 0.;
+  size_t left_count = 0;
+  for (size_t thresh_idx = 0; thresh_idx < n_thresholds_capped;
+       ++thresh_idx) {
+    const double *bin_p = hist + thresh_idx * stride;
+    // Equal thresholds give the same split.
+    if (thresh_idx > 0 && bin_p[n_classes] == 0.) continue;
+    for (size_t i = 0; i < n_classes; ++i) {
+      lsp[i] += bin_p[i];
+      left_w += bin_p[i];
+    }
+    left_count += static_cast<size_t>(bin_p[n_classes]);
+    if (left_count < msal) continue;
+    if (n_samples - left_count < msal) break;
+    const double right_w = full_w - left_w;
+    if (left_w <= 0. || right_w <= 0.) continue;
+    double lssq = 0., rssq = 0.;
+    for (size_t i = 0; i < n_classes; ++i) {
+      const double right = d.full_stats[i] - lsp[i];
+      lssq += lsp[i] * lsp[i];
+      rssq += right * right;
+    }
+    const float current_gain = static_cast<float>(
+        fullentropy - left_w / full_w * (1. - lssq / (left_w * left_w)) -
+        right_w / full_w * (1. - rssq / (right_w * right_w)));
+    ret_res.valid = true;
+    if (current_gain > ret_res.gain
+#ifndef FORPY_SKLEARN_COMPAT
+                           + GAIN_EPS
+#endif
+    ) {
+      ret_res.gain = current_gain;
+      ret_res.split_idx = left_count;
+      ret_res.thresh = thresholds[thresh_idx];
+      ret_res.left_stats.assign(lsp, lsp + n_classes);
+    }
+  }
+  DLOG_IF(INFO, ret_res.valid && DLOG_FCOPT_V >= 1 &&
+                    (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+      << "Random threshold optimized without sorting. Samples left: "
+      << ret_res.split_idx << ", threshold: " << std::setprecision(17)
+      << ret_res.thresh << ".";
+};
+
+void ExtraClassOpt::optimize(Desk *desk) const {
+  desk->d.class_feat_values.match([&](const auto &class_feats) {
+    typedef typename get_core<decltype(class_feats.data())>::type IT;
+    this->optimize__extra<IT>(desk);
+  });
+};
+
+bool ExtraClassOpt::operator==(const IThreshOpt &rhs) const {
+  const auto *rhs_c = dynamic_cast<ExtraClassOpt const *>(&rhs);
+  if (rhs_c == nullptr) {
+    return false;
+  } else {
+    bool eq_thresh = n_thresholds == rhs_c->n_thresholds;
+    bool eq_gaint = gain_threshold == rhs_c->gain_threshold;
+    return eq_thresh && eq_gaint;
+  }
+};
+}  // namespace forpy
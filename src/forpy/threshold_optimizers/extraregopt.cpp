@@ -0,0 +1,133 @@
+#include <forpy/threshold_optimizers/extraregopt.h>
+#include <forpy/types.h>
+#include <forpy/util/gather.h>
+
+namespace forpy {
+
+ExtraRegOpt::ExtraRegOpt(const size_t &n_thresholds,
+                         const float &gain_threshold)
+    : RegressionOpt(n_thresholds, gain_threshold) {
+  if (n_thresholds == 0)
+    throw ForpyException("The ExtraRegOpt requires n_thresholds > 0!");
+};
+
+void ExtraRegOpt::optimize(Desk *desk) const {
+  DeciderDesk &d = desk->d;
+  if (!d.opt_res_v.is<SplitOptRes<float>>())
+    d.opt_res_v =
+        SplitOptRes<float>{.split_idx = 0,
+                           .thresh = std::numeric_limits<float>::lowest(),
+                           .gain = 0.f,
+                           .valid = false,
+                           .left_stats = {}};
+  SplitOptRes<float> &ret_res = d.opt_res_v.get_unchecked<SplitOptRes<float>>();
+  ret_res.valid = false;
+  float *feat_p = d.feat_p;
+  const float *full_feat_p = d.full_feat_p_v.get_unchecked<const float *>();
+  const id_t *elem_id_p = d.elem_id_p;
+  const size_t n_samples = d.n_samples;
+  gather(full_feat_p, elem_id_p, n_samples, feat_p, d.prefetch);
+  float minval = feat_p[0], maxval = feat_p[0];
+  for (size_t i = 1; i < n_samples; ++i) {
+    minval = std::min(minval, feat_p[i]);
+    maxval = std::max(maxval, feat_p[i]);
+  }
+  if (maxval - minval <= REGOPT_EPS) {
+    DLOG_IF(INFO,
+            DLOG_ROPT_V >= 1 && (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
+        << "Not optimizing because min and max features are too close!";
+    return;
+  }
+  size_t n_thresholds_capped = std::min<size_t>(
+      n_thresholds, std::ceil((maxval - minval) / REGOPT_EPS));
+  n_thresholds_capped = std::min<size_t>(n_thresholds_capped, n_samples);
+  std::vector<float> thresholds(n_thresholds_capped);
+  std::uniform_real_distribution<float> udist(minval, maxval);
+  for (size_t i = 0; i < n_thresholds_capped; ++i)
+    thresholds[i] = udist(desk->r.random_engine);
+  std::sort(thresholds.begin(), thresholds.end());
+  // Per interval between thresholds: the weighted annotation sums, the weight
+  // and the sample count (see ExtraClassOpt).
+  const size_t ad = d.annot_dim;
+  const size_t stride = ad + 2;
+  const size_t n_intervals = n_thresholds_capped + 1;
+  d.hist_sums.assign((n_intervals + 1) * stride, 0.);
+  double *hist = &d.hist_sums[0];
+  const float *anp = d.annot_p;
+  const size_t annot_os = d.annot_os;
+  const float *weights_p = d.weights_p;
+  const auto add_sample = [&](const size_t &i, const size_t &interval) {
+    const id_t elem_id = elem_id_p[i];
+    const float *Cp = anp + elem_id * annot_os;
+    const double weight = weights_p == nullptr ? 1. : weights_p[elem_id];
+    double *bin_p = hist + interval * stride;
+    for (size_t j = 0; j < ad; ++j) bin_p[j] += weight * Cp[j];
+    bin_p[ad] += weight;
+    bin_p[ad + 1] += 1.;
+  };
+  if (n_thresholds_capped == 1) {
+    const float thresh = thresholds[0];
+    for (size_t i = 0; i < n_samples; ++i) add_sample(i, feat_p[i] > thresh);
+  } else {
+    for (size_t i = 0; i < n_samples; ++i)
+      add_sample(i, std::lower_bound(thresholds.begin(), thresholds.end(),
+                                     feat_p[i]) -
+                        thresholds.begin());
+  }
+  const double *fsp = &d.full_stats[0];
+  const double full_w = fsp[ad];
+  double maxproxy = 0.;
+  for (size_t j = 0; j < ad; ++j) maxproxy += fsp[j] * fsp[j];
+  maxproxy /= full_w;
+  const size_t msal = d.min_samples_at_leaf;
+  double *lsp = hist + n_intervals * stride;
+  size_t left_count = 0;
+  for (size_t thresh_idx = 0; thresh_idx < n_thresholds_capped;
+       ++thresh_idx) {
+    const double *bin_p = hist + thresh_idx * stride;
+    // Equal thresholds give the same split.
+    if (thresh_idx > 0 && bin_p[ad + 1] == 0.) continue;
+    for (size_t j = 0; j <= ad; ++j) lsp[j] += bin_p[j];
+    left_count += static_cast<size_t>(bin_p[ad + 1]);
+    if (left_count < msal) continue;
+    if (n_samples - left_count < msal) break;
+    const double left_w = lsp[ad];
+    const double right_w = full_w - left_w;
+    if (left_w <= 0. || right_w <= 0.) continue;
+    double proxy_impurity_left = 0., proxy_impurity_right = 0.;
+    for (size_t j = 0; j < ad; ++j) {
+      proxy_impurity_left += lsp[j] * lsp[j];
+      proxy_impurity_right += (fsp[j] - lsp[j]) * (fsp[j] - lsp[j]);
+    }
+    const float current_gain = static_cast<float>(
+        proxy_impurity_left / left_w + proxy_impurity_right / right_w -
+        maxproxy);
+    ret_res.valid = true;
+    if (current_gain > ret_res.gain
+#ifndef FORPY_SKLEARN_COMPAT
+                           + GAIN_EPS
+#endif
+    ) {
+      ret_res.gain = current_gain;
+      ret_res.split_idx = left_count;
+      ret_res.thresh = thresholds[thresh_idx];
+    }
+  }
+  DLOG_IF(INFO, ret_res.valid && DLOG_ROPT_V >= 1 &&
+                    (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
+      << "Random threshold optimized without sorting. Samples left: "
+      << ret_res.split_idx << ", threshold: " << std::setprecision(17)
+      << ret_res.thresh << ".";
+};
+
+bool ExtraRegOpt::operator==(const IThreshOpt &rhs) const {
+  const auto *rhs_c = dynamic_cast<ExtraRegOpt const *>(&rhs);
+  if (rhs_c == nullptr) {
+    return false;
+  } else {
+    bool eq_thresh = n_thresholds == rhs_c->n_thresholds;
+    bool eq_gaint = gain_threshold == rhs_c->gain_threshold;
+    return eq_thresh && eq_gaint;
+  }
+};
+}  // namespace forpy
@@ -1,5 +1,7 @@
 #include <forpy/threshold_optimizers/fastclassopt.h>
 #include <forpy/types.h>
+#include <forpy/util/gather.h>
+#include <forpy/util/sort_ids.h>
 
 #include <skasort.hpp>
 
@@ -22,19 +24,26 @@ void FastClassOpt::full_entropy(const IDataProvider &dprov, Desk *desk) const {
       [&](const MatCRef<uint> &annot_mat) {
         d->annot_os = annot_mat.outerStride();
         d->class_annot_p = annot_mat.data();
+        if (d->node_stats != nullptr && d->node_stats->size() == n_classes) {
+          d->full_stats = *d->node_stats;
+        } else {
+          d->full_stats.assign(n_classes, 0.);
+          const uint *cap = d->class_annot_p;
+          const size_t *eip = d->elem_id_p;
+          double *fsp = &(d->full_stats[0]);
+          if (weights_p != nullptr)
+            for (size_t i = 0; i < d->n_samples; ++i)
+              fsp[cap[eip[i]]] += weights_p[eip[i]];
+          else
+            for (size_t i = 0; i < d->n_samples; ++i) fsp[cap[eip[i]]]++;
+        }
         d->full_sum.resize(n_classes);
-        std::fill(d->full_sum.begin(), d->full_sum.end(), 0.f);
         d->full_sum_p = &(d->full_sum[0]);
-        const uint *cap = d->class_annot_p;
-        const size_t *eip = d->elem_id_p;
-        float *fsp = d->full_sum_p;
-        if (weights_p != nullptr)
-          for (size_t i = 0; i < d->n_samples; ++i)
-            fsp[cap[eip[i]]] += weights_p[eip[i]];
-        else
-          for (size_t i = 0; i < d->n_samples; ++i) fsp[cap[eip[i]]]++;
         float full_w = 0.f;
-        for (size_t i = 0; i < n_classes; ++i) full_w += fsp[i];
+        for (size_t i = 0; i < n_classes; ++i) {
+          d->full_sum_p[i] = static_cast<float>(d->full_stats[i]);
+          full_w += d->full_sum_p[i];
+        }
         d->full_w = full_w;
       },
       [&](const auto &) { throw EmptyException(); });
@@ -56,14 +65,20 @@ void FastClassOpt::full_entropy(const IDataProvider &dprov, Desk *desk) const {
     d->elem_ids_sorted_p = &(d->elem_ids_sorted[0]);
     std::iota(d->sort_perm.begin(), d->sort_perm.end(), 0);
   }
-  const auto &feat_v = dprov.get_feature(0);
-  feat_v.match([&](const auto &feat) {
-    typedef typename get_core<decltype(feat.data())>::type IT;
-    if (!d->class_feat_values.is<std::vector<IT>>())
-      d->class_feat_values.set<std::vector<IT>>(d->n_samples);
-    auto &feat_vec = d->class_feat_values.get_unchecked<std::vector<IT>>();
-    feat_vec.resize(d->n_samples);
-  });
+  if (dprov.get_sparse_features() != nullptr) {
+    // Only the value type is used, see optimize__sparse.
+    if (!d->class_feat_values.is<std::vector<float>>())
+      d->class_feat_values.set<std::vector<float>>();
+  } else {
+    const auto &feat_v = dprov.get_feature(0);
+    feat_v.match([&](const auto &feat) {
+      typedef typename get_core<decltype(feat.data())>::type IT;
+      if (!d->class_feat_values.is<std::vector<IT>>())
+        d->class_feat_values.set<std::vector<IT>>(d->n_samples);
+      auto &feat_vec = d->class_feat_values.get_unchecked<std::vector<IT>>();
+      feat_vec.resize(d->n_samples);
+    });
+  }
   d->left_sum_vec.resize(n_classes);
   d->left_sum_p = &(d->left_sum_vec[0]);
 };
@@ -77,22 +92,14 @@ inline void FastClassOpt::optimize__sort(DeciderDesk &d) const {
           .get_unchecked<const IT *>();  // See above, but for all samples.
   size_t *elem_id_p = d.elem_id_p;
   const size_t n_samples = d.n_samples;
-  for (size_t i = 0; i < d.n_samples; ++i)
-    feat_p[i] = full_feat_p[elem_id_p[i]];
+  gather(full_feat_p, elem_id_p, n_samples, feat_p, d.prefetch);
   if (!d.presorted) {
     DLOG_IF(INFO,
             DLOG_FCOPT_V >= 4 && (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
         << "Sorting...";
-    id_t *elem_ids_sorted_p = d.elem_ids_sorted_p;
-    ska_sort(sort_perm_p, sort_perm_p + n_samples,
-             [&](const size_t &i1) { return feat_p[i1]; });
-    for (size_t w_idx = 0; w_idx < n_samples; ++w_idx) {
-      size_t elem_id = sort_perm_p[w_idx];
-      size_t sample_id = elem_id_p[elem_id];
-      elem_ids_sorted_p[w_idx] = sample_id;
-      feat_p[w_idx] = full_feat_p[sample_id];
-    }
-    std::copy(elem_ids_sorted_p, elem_ids_sorted_p + n_samples, elem_id_p);
+    // Counting sort for uint8_t features.
+    sort_ids_by_feature(feat_p, elem_id_p, n_samples, full_feat_p, sort_perm_p,
+                        d.elem_ids_sorted_p);
   }
   DLOG_IF(INFO,
           DLOG_FCOPT_V >= 1 && (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
@@ -106,7 +113,8 @@ inline SplitOptRes<IT> &FastClassOpt::optimize__setup(DeciderDesk &d) const {
     d.opt_res_v = SplitOptRes<IT>{.split_idx = 0,
                                   .thresh = std::numeric_limits<IT>::lowest(),
                                   .gain = 0.f,
-                                  .valid = false};
+                                  .valid = false,
+                                  .left_stats = {}};
   SplitOptRes<IT> &ret_res = d.opt_res_v.get_unchecked<SplitOptRes<IT>>();
   ret_res.valid = false;
   return ret_res;
@@ -118,8 +126,11 @@ inline std::unique_ptr<std::vector<IT>> FastClassOpt::optimize__thresholds(
   if (n_thresholds == 0) {
     return nullptr;
   } else {
-    IT maxval = desk->d.feat_p[desk->d.n_samples - 1];  // TODO fix.
-    IT minval = desk->d.feat_p[0];
+    // The sorted feature values of the node.
+    const auto &feat_vec =
+        desk->d.class_feat_values.get_unchecked<std::vector<IT>>();
+    IT maxval = feat_vec[desk->d.n_samples - 1];
+    IT minval = feat_vec[0];
     id_t n_thresholds_capped = std::min<size_t>(
         n_thresholds, std::ceil((maxval - minval) / CLASSOPT_EPS));
     n_thresholds_capped =
@@ -134,10 +145,424 @@ inline std::unique_ptr<std::vector<IT>> FastClassOpt::optimize__thresholds(
   }
 };
 
+template <typename IT>
+inline void FastClassOpt::optimize__histogram(DeciderDesk &d) const {
+  SplitOptRes<IT> &ret_res = this->optimize__setup<IT>(d);
+  const FeatureBins &bins = *d.bins;
+  const size_t n_bins = bins.get_n_bins(d.feat_idx);
+  if (n_bins < 2) return;
+  // Per bin: the class weights and the sample count.
+  const size_t stride = n_classes + 1;
+  bool derived;
+  double *hist = d.hist_cache.get(d.node_id, d.n_samples, d.feat_idx,
+                                  n_bins * stride, &derived);
+  if (!derived) {
+    const uint8_t *codes = bins.get_codes(d.feat_idx);
+    const id_t *elem_id_p = d.elem_id_p;
+    const uint *anp = d.class_annot_p;
+    const float *weights_p = d.weights_p;
+    for (size_t i = 0; i < d.n_samples; ++i) {
+      const id_t elem_id = elem_id_p[i];
+      double *bin_p = hist + codes[elem_id] * stride;
+      bin_p[anp[elem_id]] += weights_p == nullptr ? 1. : weights_p[elem_id];
+      bin_p[n_classes] += 1.;
+    }
+  }
+  d.hist_sums.assign(2 * stride, 0.);
+  double *lsp = &d.hist_sums[0];
+  double *fsp = lsp + stride;
+  for (size_t bin = 0; bin < n_bins; ++bin)
+    for (size_t i = 0; i < stride; ++i) fsp[i] += hist[bin * stride + i];
+  double full_w = 0., sqsum = 0.;
+  for (size_t i = 0; i < n_classes; ++i) {
+    full_w += fsp[i];
+    sqsum += fsp[i] * fsp[i];
+  }
+  const double fullentropy = 1. - sqsum / (full_w * full_w);
+  const size_t msal = d.min_samples_at_leaf;
+  double left_w = 0.;
+  size_t left_count = 0;
+  for (size_t bin = 0; bin < n_bins - 1; ++bin) {
+    const double *bin_p = hist + bin * stride;
+    if (bin_p[n_classes] == 0.) continue;
+    for (size_t i = 0; i < n_classes; ++i) {
+      lsp[i] += bin_p[i];
+      left_w += bin_p[i];
+    }
+    left_count += static_cast<size_t>(bin_p[n_classes]);
+    if (left_count < msal) continue;
+    if (d.n_samples - left_count < msal) break;
+    const double right_w = full_w - left_w;
+    if (left_w <= 0. || right_w <= 0.) continue;
+    double lssq = 0., rssq = 0.;
+    for (size_t i = 0; i < n_classes; ++i) {
+      lssq += lsp[i] * lsp[i];
+      rssq += (fsp[i] - lsp[i]) * (fsp[i] - lsp[i]);
+    }
+    const float current_gain = static_cast<float>(
+        fullentropy - left_w / full_w * (1. - lssq / (left_w * left_w)) -
+        right_w / full_w * (1. - rssq / (right_w * right_w)));
+    ret_res.valid = true;
+    if (current_gain > ret_res.gain
+#ifndef FORPY_SKLEARN_COMPAT
+                           + GAIN_EPS
+#endif
+    ) {
+      ret_res.gain = current_gain;
+      ret_res.split_idx = left_count;
+      ret_res.thresh = static_cast<IT>(bins.get_edge(d.feat_idx, bin));
+      ret_res.left_stats.assign(lsp, lsp + n_classes);
+    }
+  }
+  DLOG_IF(INFO, ret_res.valid && DLOG_FCOPT_V >= 1 &&
+                    (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+      << "Histogram threshold optimized (" << (derived ? "derived" : "built")
+      << "). Samples left: " << ret_res.split_idx
+      << ", threshold: " << std::setprecision(17) << ret_res.thresh << ".";
+};
+
+/**
+ * The sorted nonzero values with the zero block at its rank form the
+ * sequence that is swept. Only boundaries between values that differ by
+ * more than CLASSOPT_EPS are split candidates, as in the dense sweep.
+ */
+inline void FastClassOpt::optimize__sparse(DeciderDesk &d) const {
+  SplitOptRes<float> &ret_res = this->optimize__setup<float>(d);
+  auto &nonzeros = d.sparse_values;
+  nonzeros.clear();
+  d.sparse->for_each_marked(
+      d.feat_idx, d.elem_id_p, d.n_samples, &d.sparse_marks[0], d.sparse_mark,
+      [&nonzeros](const float &value, const id_t &id) {
+        nonzeros.emplace_back(value, id);
+      });
+  ska_sort(nonzeros.begin(), nonzeros.end(),
+           [](const std::pair<float, id_t> &entry) { return entry.first; });
+  const size_t n_samples = d.n_samples;
+  const size_t n_nonzeros = nonzeros.size();
+  const size_t n_zeros = n_samples - n_nonzeros;
+  const uint *anp = d.class_annot_p;
+  const float *weights_p = d.weights_p;
+  // The class weights of the left side and of the zero block.
+  d.hist_sums.assign(2 * n_classes, 0.);
+  double *lsp = &d.hist_sums[0];
+  double *zsp = lsp + n_classes;
+  double full_w = 0., fullsqsum = 0.;
+  for (size_t i = 0; i < n_classes; ++i) {
+    full_w += d.full_sum_p[i];
+    fullsqsum += static_cast<double>(d.full_sum_p[i]) * d.full_sum_p[i];
+  }
+  if (n_zeros > 0) {
+    for (size_t i = 0; i < n_classes; ++i) zsp[i] = d.full_sum_p[i];
+    for (const auto &entry : nonzeros)
+      zsp[anp[entry.second]] -=
+          weights_p == nullptr ? 1. : weights_p[entry.second];
+  }
+  const size_t zero_pos =
+      std::lower_bound(nonzeros.begin(), nonzeros.end(), 0.f,
+                       [](const std::pair<float, id_t> &entry,
+                          const float &val) { return entry.first < val; }) -
+      nonzeros.begin();
+  const size_t n_entries = n_nonzeros + (n_zeros > 0 ? 1 : 0);
+  const auto value_at = [&](const size_t &pos) {
+    if (n_zeros == 0 || pos < zero_pos) return nonzeros[pos].first;
+    if (pos == zero_pos) return 0.f;
+    return nonzeros[pos - 1].first;
+  };
+  if (n_entries == 0 ||
+      value_at(n_entries - 1) - value_at(0) <= CLASSOPT_EPS) {
+    DLOG_IF(INFO, DLOG_FCOPT_V >= 1 &&
+                      (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+        << "Not optimizing because min and max features are too close!";
+    return;
+  }
+  const double fullentropy = 1. - fullsqsum / (full_w * full_w);
+  const size_t msal = d.min_samples_at_leaf;
+  double left_w = 0.;
+  size_t left_count = 0;
+  for (size_t pos = 0; pos < n_entries - 1; ++pos) {
+    if (n_zeros > 0 && pos == zero_pos) {
+      for (size_t i = 0; i < n_classes; ++i) {
+        lsp[i] += zsp[i];
+        left_w += zsp[i];
+      }
+      left_count += n_zeros;
+    } else {
+      const id_t id = nonzeros[pos - (n_zeros > 0 && pos > zero_pos)].second;
+      const double weight = weights_p == nullptr ? 1. : weights_p[id];
+      lsp[anp[id]] += weight;
+      left_w += weight;
+      left_count++;
+    }
+    const float current_val = value_at(pos), next_val = value_at(pos + 1);
+    if (next_val <= current_val + CLASSOPT_EPS) continue;
+    if (left_count < msal) continue;
+    if (n_samples - left_count < msal) break;
+    const double right_w = full_w - left_w;
+    if (left_w <= 0. || right_w <= 0.) continue;
+    double lssq = 0., rssq = 0.;
+    for (size_t i = 0; i < n_classes; ++i) {
+      const double right = d.full_sum_p[i] - lsp[i];
+      lssq += lsp[i] * lsp[i];
+      rssq += right * right;
+    }
+    const float current_gain = static_cast<float>(
+        fullentropy - left_w / full_w * (1. - lssq / (left_w * left_w)) -
+        right_w / full_w * (1. - rssq / (right_w * right_w)));
+    ret_res.valid = true;
+    if (current_gain > ret_res.gain
+#ifndef FORPY_SKLEARN_COMPAT
+                           + GAIN_EPS
+#endif
+    ) {
+      ret_res.gain = current_gain;
+      ret_res.split_idx = left_count;
+      ret_res.thresh = (current_val + next_val) / 2.f;
+      // Deal with numerical instabilities.
+      if (ret_res.thresh == next_val) ret_res.thresh = current_val;
+      ret_res.left_stats.assign(lsp, lsp + n_classes);
+    }
+  }
+  DLOG_IF(INFO, ret_res.valid && DLOG_FCOPT_V >= 1 &&
+                    (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+      << "Sparse threshold optimized (" << n_nonzeros << " of " << n_samples
+      << " nonzero). Samples left: " << ret_res.split_idx
+      << ", threshold: " << std::setprecision(17) << ret_res.thresh << ".";
+};
+
+void FastClassOpt::fill_histograms(const IDataProvider &dprov,
+                                   const size_t &feat_idx,
+                                   const uint32_t *slots,
+                                   double *const *hists) const {
+  const FeatureBins *bins = dprov.get_feature_bins();
+  if (bins == nullptr)
+    throw ForpyException("The data provider has no feature bins!");
+  const uint8_t *codes = bins->get_codes(feat_idx);
+  const uint *anp =
+      dprov.get_annotations().get_unchecked<MatCRef<uint>>().data();
+  const auto &weights_ptr = dprov.get_weights();
+  const float *weights_p =
+      weights_ptr != nullptr ? &(weights_ptr->at(0)) : nullptr;
+  const size_t stride = n_classes + 1;
+  const size_t n_samples = bins->get_n_samples();
+  for (size_t i = 0; i < n_samples; ++i) {
+    if (slots[i] == FEATURE_BINS_NO_SLOT) continue;
+    double *bin_p = hists[slots[i]] + codes[i] * stride;
+    bin_p[anp[i]] += weights_p == nullptr ? 1. : weights_p[i];
+    bin_p[n_classes] += 1.;
+  }
+};
+
+template <typename IT, size_t NC, bool WEIGHTED>
+inline void FastClassOpt::optimize__scan(
+    DeciderDesk &d, IT *feat_p, SplitOptRes<IT> &ret_res,
+    const std::vector<IT> *thresholds) const {
+  const size_t n_cls = NC > 0 ? NC : n_classes;
+  typename std::vector<IT>::const_iterator feat_val_it;
+  if (n_thresholds > 0) feat_val_it = thresholds->begin();
+  id_t *elem_id_p = d.elem_id_p;  // The element IDs are global. The pointer
+  // points to the first one relevant for this node.
+  const size_t n_samples = d.n_samples;
+  // With a fixed number of classes, the left class sums are a local array
+  // that does not alias any desk memory.
+  float local_lsp[NC > 0 ? NC : 1];
+  float *lsp = NC > 0 ? local_lsp : d.left_sum_p;
+  std::fill(lsp, lsp + n_cls, 0.f);
+  float left_w = 0.f;
+  float const *weights_p = d.weights_p;
+  const float full_w = d.full_w;
+  float current_gain;
+  IT last_val = std::numeric_limits<IT>::lowest(), current_val = 0;
+  const uint *last_ant, *current_ant;
+  IT maxval = feat_p[d.n_samples - 1];
+  float *fsp = &d.full_sum[0];
+  DLOG_IF(INFO,
+          DLOG_FCOPT_V >= 1 && (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+      << "fsp[0]: " << fsp[0] << ", fsp[1]: " << fsp[1];
+  float lssq = 0.f, rssq = 0.f;
+  double dlssq = 0., drssq = 0.;
+  float ent_left, ent_right;
+  // As long as we have <5000 unweighted samples, tracking the sum of squares
+  // in float works reliably wrt. numerics. Otherwise, they are tracked in
+  // double and recomputed every `resync` updates, which bounds the drift.
+  // Without weights, the tracked sums are exact (see the class doc). With
+  // weights, the float sum of squares of the right side is the difference of
+  // two large sums, so that the last samples of a feature got imprecise gains.
+  const bool float_ssq = !WEIGHTED && n_samples < 5000;
+  const size_t resync = std::max(IMPURITY_RESYNC_INTERVAL, n_cls);
+  size_t since_resync = 0;
+  const auto resync_ssq = [&]() {
+    dlssq = 0.;
+    drssq = 0.;
+    for (size_t i = 0; i < n_cls; ++i) {
+      double tmp = static_cast<double>(lsp[i]);
+      dlssq += tmp * tmp;
+      tmp = static_cast<double>(fsp[i] - lsp[i]);
+      drssq += tmp * tmp;
+    }
+  };
+  if (float_ssq)
+    for (size_t i = 0; i < n_cls; ++i) rssq += (fsp[i] * fsp[i]);
+  else
+    resync_ssq();
+  DLOG_IF(INFO,
+          DLOG_FCOPT_V >= 1 && (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+      << "rssq: " << std::setprecision(17) << rssq;
+  const size_t msal = d.min_samples_at_leaf;
+  const uint *anp = d.class_annot_p;
+  float new_val;
+  float current_weight, last_weight;
+  FASSERT(d.min_samples_at_leaf > 0);
+  for (size_t index = 0;
+       index < n_samples - msal + 1 &&
+       (n_thresholds == 0 || feat_val_it != thresholds->end());
+       ++index, left_w += current_weight, last_weight = current_weight,
+              last_val = current_val, last_ant = current_ant) {
+    if (full_w - left_w <= 0.f) break;
+    current_val = feat_p[index];
+    current_ant = anp + elem_id_p[index];
+    current_weight = WEIGHTED ? weights_p[elem_id_p[index]] : 1.f;
+    DLOG_IF(INFO, DLOG_FCOPT_V >= 3 &&
+                      (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+        << "Current val: " << std::setprecision(17) << current_val
+        << ", current ant: " << current_ant[0]
+        << ", current weight: " << current_weight;
+    if (index > 0) {
+      float old_val = lsp[last_ant[0]];
+      lsp[last_ant[0]] += last_weight;
+      DLOG_IF(INFO, DLOG_FCOPT_V >= 7 &&
+                        (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+          << "Updating weight for class " << last_ant[0] << " with weight "
+          << last_weight << " to " << lsp[last_ant[0]];
+      if (float_ssq) {
+        new_val = old_val + last_weight;
+        lssq = lssq - old_val * old_val + new_val * new_val;
+        old_val = fsp[last_ant[0]] - old_val;
+        new_val = old_val - last_weight;
+        rssq = rssq - old_val * old_val + new_val * new_val;
+      } else if (++since_resync == resync) {
+        resync_ssq();
+        since_resync = 0;
+      } else {
+        // The same float values as in the recomputation, so that the
+        // updates telescope.
+        const double old_left = old_val, new_left = lsp[last_ant[0]];
+        const double old_right = fsp[last_ant[0]] - old_val;
+        const double new_right = fsp[last_ant[0]] - lsp[last_ant[0]];
+        dlssq += new_left * new_left - old_left * old_left;
+        drssq += new_right * new_right - old_right * old_right;
+      }
+      DLOG_IF(INFO, DLOG_FCOPT_V >= 4 &&
+                        (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+          << "Feature delta: " << current_val - last_val;
+      if (current_val <= last_val + CLASSOPT_EPS) continue;
+      // Check if gain calculation is necessary.
+      if ((n_thresholds == 0 ||
+           (current_val >= *feat_val_it && last_val < *feat_val_it)) &&
+          index >= msal) {
+        if (!float_ssq) {
+          ent_left = 1.f - dlssq / (left_w * left_w);
+          ent_right = 1.f - drssq / ((full_w - left_w) * (full_w - left_w));
+        } else {
+          ent_left = 1.f - lssq / (left_w * left_w);
+          ent_right = 1.f - rssq / ((full_w - left_w) * (full_w - left_w));
+        }
+        FASSERT(ent_right >= -0.01 && ent_right <= 1.01);
+        DLOG_IF(INFO, DLOG_FCOPT_V >= 5 &&
+                          (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+            << "Left entropy: " << ent_left
+            << ", right entropy: " << ent_right << ", lssq: " << lssq
+            << ", rssq: " << rssq << ", dlssq: " << dlssq
+            << ", drssq: " << drssq << ", full_w: " << full_w
+            << ", left_w: " << left_w;
+        current_gain = d.fullentropy - left_w / full_w * ent_left -
+                       (full_w - left_w) / full_w * ent_right;
+        DLOG_IF(INFO, DLOG_FCOPT_V >= 5 &&
+                          (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+            << "gain: " << current_gain;
+        DLOG_IF(INFO, DLOG_FCOPT_V >= 4 &&
+                          (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+            << "Left sum[0]: " << lsp[0] << ", left sum[1]: " << lsp[1];
+        ret_res.valid = true;
+        if (current_gain > ret_res.gain
+#ifndef FORPY_SKLEARN_COMPAT
+                               + GAIN_EPS
+#endif
+        ) {
+          DLOG_IF(INFO, DLOG_FCOPT_V >= 2 &&
+                            (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+              << "New best gain: " << current_gain
+              << ", (best former: " << ret_res.gain << ").";
+          ret_res.gain = current_gain;
+          ret_res.split_idx = index;
+          // Without weights, the float sums are exact counts (< 2^24).
+          if (!WEIGHTED && n_samples < (1 << 24))
+            ret_res.left_stats.assign(lsp, lsp + n_cls);
+          else
+            ret_res.left_stats.clear();
+        }
+      }
+    }
+    if (maxval <= current_val + CLASSOPT_EPS) {
+      DLOG_IF(INFO, DLOG_FCOPT_V >= 1 &&
+                        (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+          << "Stopping optimization at index " << index
+          << " because difference (" << maxval - current_val << ") to max ("
+          << maxval << ") is less than " << CLASSOPT_EPS << ".";
+      break;
+    }
+    if (n_thresholds > 0)
+      while (feat_val_it != thresholds->end() && current_val > *feat_val_it)
+        ++feat_val_it;
+  }
+  if (ret_res.valid) {
+    ret_res.thresh =
+        (feat_p[ret_res.split_idx] + feat_p[ret_res.split_idx - 1]) / 2.f;
+    if (ret_res.thresh ==
+        feat_p[ret_res.split_idx])  // Deal with numerical instabilities.
+      ret_res.thresh = feat_p[ret_res.split_idx - 1];
+    DLOG_IF(INFO, DLOG_FCOPT_V >= 1 &&
+                      (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
+        << "Threshold optimized. Best split index: " << ret_res.split_idx
+        << ", threshold: " << std::setprecision(17) << ret_res.thresh
+        << ", samples left: " << ret_res.split_idx
+        << ", samples right: " << n_samples - ret_res.split_idx << ".";
+  }
+};
+
+template <typename IT, bool WEIGHTED>
+inline void FastClassOpt::optimize__dispatch(
+    DeciderDesk &d, IT *feat_p, SplitOptRes<IT> &ret_res,
+    const std::vector<IT> *thresholds) const {
+  switch (n_classes) {
+    case 2:
+      this->optimize__scan<IT, 2, WEIGHTED>(d, feat_p, ret_res, thresholds);
+      break;
+    case 3:
+      this->optimize__scan<IT, 3, WEIGHTED>(d, feat_p, ret_res, thresholds);
+      break;
+    case 4:
+      this->optimize__scan<IT, 4, WEIGHTED>(d, feat_p, ret_res, thresholds);
+      break;
+    case 8:
+      this->optimize__scan<IT, 8, WEIGHTED>(d, feat_p, ret_res, thresholds);
+      break;
+    default:
+      this->optimize__scan<IT, 0, WEIGHTED>(d, feat_p, ret_res, thresholds);
+  }
+};
+
 void FastClassOpt::optimize(Desk *desk) const {
   DeciderDesk &d = desk->d;  // Solely for convenience.
+  if (d.sparse != nullptr) {
+    this->optimize__sparse(d);
+    return;
+  }
   d.class_feat_values.match([&](auto &class_feats) {
     typedef typename get_core<decltype(class_feats.data())>::type IT;
+    if (d.bins != nullptr && d.bins->use_histogram(d.feat_idx, d.n_samples)) {
+      this->optimize__histogram<IT>(d);
+      return;
+    }
     IT *feat_p = &class_feats[0];
     SplitOptRes<IT> &ret_res = this->optimize__setup<IT>(d);
     this->optimize__sort<IT>(d);
@@ -150,151 +575,46 @@ void FastClassOpt::optimize(Desk *desk) const {
     }
     std::unique_ptr<std::vector<IT>> thresholds =
         this->optimize__thresholds<IT>(desk);
-    typename std::vector<IT>::const_iterator feat_val_it;
-    if (n_thresholds > 0) feat_val_it = thresholds->begin();
-    id_t *elem_id_p = d.elem_id_p;  // The element IDs are global. The pointer
-    // points to the first one relevant for this node.
-    std::fill(d.left_sum_p, d.left_sum_p + n_classes, 0.f);
-    float left_w = 0.f;
-    float const *weights_p = d.weights_p;
-    const float full_w = d.full_w;
-    float current_gain;
-    IT last_val = std::numeric_limits<IT>::lowest(), current_val = 0;
-    const uint *last_ant, *current_ant;
-    IT maxval = feat_p[d.n_samples - 1];
-    float *lsp = d.left_sum_p;
-    float *fsp = &d.full_sum[0];
-    DLOG_IF(INFO,
-            DLOG_FCOPT_V >= 1 && (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
-        << "fsp[0]: " << fsp[0] << ", fsp[1]: " << fsp[1];
-    float lssq = 0.f, rssq = 0.f;
-    double dlssq = 0., drssq = 0.;
-    float ent_left, ent_right;
-    // As long as we have <5000 samples, tracking the sum of squares works
-    // reliably wrt. numerics. If there are more, always do the live
-    // calculation.
-    if (n_samples < 5000)
-      for (size_t i = 0; i < n_classes; ++i) rssq += (fsp[i] * fsp[i]);
-    DLOG_IF(INFO,
-            DLOG_FCOPT_V >= 1 && (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
-        << "rssq: " << std::setprecision(17) << rssq;
-    const size_t msal = d.min_samples_at_leaf;
-    const uint *anp = d.class_annot_p;
-    float new_val;
-    float current_weight, last_weight;
-    FASSERT(d.min_samples_at_leaf > 0);
-    for (size_t index = 0;
-         index < n_samples - msal + 1 &&
-         (n_thresholds == 0 || feat_val_it != thresholds->end());
-         ++index, left_w += current_weight, last_weight = current_weight,
-                last_val = current_val, last_ant = current_ant) {
-      if (full_w - left_w <= 0.f) break;
-      current_val = feat_p[index];
-      current_ant = anp + elem_id_p[index];
-      current_weight = weights_p == nullptr ? 1.f : weights_p[elem_id_p[index]];
-      DLOG_IF(INFO, DLOG_FCOPT_V >= 3 &&
-                        (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
-          << "Current val: " << std::setprecision(17) << current_val
-          << ", current ant: " << current_ant[0]
-          << ", current weight: " << current_weight;
-      if (index > 0) {
-        float old_val = lsp[last_ant[0]];
-        lsp[last_ant[0]] += last_weight;
-        DLOG_IF(INFO, DLOG_FCOPT_V >= 7 &&
-                          (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
-            << "Updating weight for class " << last_ant[0] << " with weight "
-            << last_weight << " to " << lsp[last_ant[0]];
-        if (n_samples < 5000) {
-          new_val = old_val + last_weight;
-          lssq = lssq - old_val * old_val + new_val * new_val;
-          old_val = fsp[last_ant[0]] - old_val;
-          new_val = old_val - last_weight;
-          rssq = rssq - old_val * old_val + new_val * new_val;
-        }
-        DLOG_IF(INFO, DLOG_FCOPT_V >= 4 &&
-                          (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
-            << "Feature delta: " << current_val - last_val;
-        if (current_val <= last_val + CLASSOPT_EPS) continue;
-        // Check if gain calculation is necessary.
-        if ((n_thresholds == 0 ||
-             (current_val >= *feat_val_it && last_val < *feat_val_it)) &&
-            index >= msal) {
-          if (n_samples >= 5000) {
-            dlssq = 0.;
-            for (size_t i = 0; i < n_classes; ++i) {
-              // DLOG(INFO) << "lsp[i]: " << lsp[i];
-              double tmp = static_cast<double>(lsp[i]);
-              dlssq += tmp * tmp;
-            }
-            ent_left = 1.f - dlssq / (left_w * left_w);
-            drssq = 0.;
-            for (size_t i = 0; i < n_classes; ++i) {
-              double tmp = static_cast<double>(fsp[i] - lsp[i]);
-              drssq += tmp * tmp;
-            }
-            ent_right = 1.f - drssq / ((full_w - left_w) * (full_w - left_w));
-          } else {
-            ent_left = 1.f - lssq / (left_w * left_w);
-            ent_right = 1.f - rssq / ((full_w - left_w) * (full_w - left_w));
-          }
-          FASSERT(ent_right >= -0.01 && ent_right <= 1.01);
-          DLOG_IF(INFO, DLOG_FCOPT_V >= 5 &&
-                            (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
-              << "Left entropy: " << ent_left
-              << ", right entropy: " << ent_right << ", lssq: " << lssq
-              << ", rssq: " << rssq << ", dlssq: " << dlssq
-              << ", drssq: " << drssq << ", full_w: " << full_w
-              << ", left_w: " << left_w;
-          current_gain = d.fullentropy - left_w / full_w * ent_left -
-                         (full_w - left_w) / full_w * ent_right;
-          DLOG_IF(INFO, DLOG_FCOPT_V >= 5 &&
-                            (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
-              << "gain: " << current_gain;
-          DLOG_IF(INFO, DLOG_FCOPT_V >= 4 &&
-                            (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
-              << "Left sum[0]: " << lsp[0] << ", left sum[1]: " << lsp[1];
-          ret_res.valid = true;
-          if (current_gain > ret_res.gain
-#ifndef FORPY_SKLEARN_COMPAT
-                                 + GAIN_EPS
-#endif
-          ) {
-            DLOG_IF(INFO, DLOG_FCOPT_V >= 2 &&
-                              (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
-                << "New best gain: " << current_gain
-                << ", (best former: " << ret_res.gain << ").";
-            ret_res.gain = current_gain;
-            ret_res.split_idx = index;
-          }
-        }
-      }
-      if (maxval <= current_val + CLASSOPT_EPS) {
-        DLOG_IF(INFO, DLOG_FCOPT_V >= 1 &&
-                          (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
-            << "Stopping optimization at index " << index
-            << " because difference (" << maxval - current_val << ") to max ("
-            << maxval << ") is less than " << CLASSOPT_EPS << ".";
-        break;
-      }
-      if (n_thresholds > 0)
-        while (current_val > *feat_val_it) ++feat_val_it;
-    }
-    if (ret_res.valid) {
-      ret_res.thresh =
-          (feat_p[ret_res.split_idx] + feat_p[ret_res.split_idx - 1]) / 2.f;
-      if (ret_res.thresh ==
-          feat_p[ret_res.split_idx])  // Deal with numerical instabilities.
-        ret_res.thresh = feat_p[ret_res.split_idx - 1];
-      DLOG_IF(INFO, DLOG_FCOPT_V >= 1 &&
-                        (d.node_id == LOG_FCOPT_NID || LOG_FCOPT_ALLN))
-          << "Threshold optimized. Best split index: " << ret_res.split_idx
-          << ", threshold: " << std::setprecision(17) << ret_res.thresh
-          << ", samples left: " << ret_res.split_idx
-          << ", samples right: " << n_samples - ret_res.split_idx << ".";
-    }
+    const std::vector<IT> *thresholds_p = thresholds.get();
+    // Dispatch once per node to a kernel without runtime branches on the
+    // weights and with a fixed number of classes where possible.
+    if (d.weights_p == nullptr)
+      this->optimize__dispatch<IT, false>(d, feat_p, ret_res, thresholds_p);
+    else
+      this->optimize__dispatch<IT, true>(d, feat_p, ret_res, thresholds_p);
   });
 };
 
+void FastClassOpt::child_stats(const std::vector<double> &split_left_stats,
+                               Desk *desk) const {
+  DeciderDesk &d = desk->d;
+  const size_t n_left = d.left_int.second - d.left_int.first;
+  std::vector<double> *direct = &d.left_stats, *derived = &d.right_stats;
+  if (split_left_stats.size() == n_classes) {
+    d.left_stats = split_left_stats;
+  } else {
+    // Sum up the smaller child, the other one is the difference.
+    const id_t *ids_p = d.elem_id_p;
+    size_t n_direct = n_left;
+    if (n_left > d.n_samples - n_left) {
+      std::swap(direct, derived);
+      ids_p += n_left;
+      n_direct = d.n_samples - n_left;
+    }
+    direct->assign(n_classes, 0.);
+    double *dsp = &((*direct)[0]);
+    const uint *cap = d.class_annot_p;
+    if (d.weights_p != nullptr)
+      for (size_t i = 0; i < n_direct; ++i)
+        dsp[cap[ids_p[i]]] += d.weights_p[ids_p[i]];
+    else
+      for (size_t i = 0; i < n_direct; ++i) dsp[cap[ids_p[i]]]++;
+  }
+  derived->resize(n_classes);
+  for (size_t i = 0; i < n_classes; ++i)
+    (*derived)[i] = std::max(0., d.full_stats[i] - (*direct)[i]);
+};
+
 bool FastClassOpt::operator==(const IThreshOpt &rhs) const {
   const auto *rhs_c = dynamic_cast<FastClassOpt const *>(&rhs);
   if (rhs_c == nullptr) {
@@ -1,5 +1,6 @@
 #include <forpy/threshold_optimizers/regression_opt.h>
 #include <forpy/types.h>
+#include <forpy/util/gather.h>
 
 #include <skasort.hpp>
 
@@ -63,51 +64,76 @@ void RegressionOpt::full_entropy(const IDataProvider &dprov, Desk *desk) const {
   DLOG(INFO) << "weights_p: " << weights_p;
   DLOG_IF(INFO, weights_p != nullptr) << "weights_p[0]: " << weights_p[0];
   DLOG_IF(INFO, weights_p != nullptr) << "weights_p[1]: " << weights_p[1];
-  float trace = 0.f;  // Important to use a local cache variable here instead of
-  // a reference (speed!).
-  float full_w = 0.f;
-  d->full_sum.resize(d->annot_dim);
-  std::fill(d->full_sum.begin(), d->full_sum.end(), 0.f);
-  d->full_sum_p = &(d->full_sum[0]);
   const size_t ad = d->annot_dim;
-  float *fsp = d->full_sum_p;
-  const size_t *eip = d->elem_id_p;
-  const size_t annot_os = d->annot_os;
-  const float *annot_p = d->annot_p;
-  const size_t n_samples = d->n_samples;
-  if (weights_p == nullptr) {
-    full_w = static_cast<float>(n_samples);
-    for (size_t i = 0; i < n_samples; ++i) {
-      const float *Cp = annot_p + eip[i] * annot_os;
-      for (size_t j = 0; j < ad;) {
-        trace += *Cp * *Cp;
-        fsp[j++] += *(Cp++);
-      }
-    }
+  if (d->node_stats != nullptr && d->node_stats->size() == ad + 2) {
+    d->full_stats = *d->node_stats;
   } else {
-    for (size_t i = 0; i < n_samples; ++i) {
-      const float *Cp = annot_p + eip[i] * annot_os;
-      float current_weight = weights_p[eip[i]];
-      full_w += current_weight;
-      for (size_t j = 0; j < ad;) {
-        float w_y = current_weight * *Cp;
-        fsp[j++] += w_y;
-        trace += w_y * *(Cp++);
+    d->full_stats.assign(ad + 2, 0.);
+    double trace = 0.;  // Important to use a local cache variable here
+    // instead of a reference (speed!).
+    double full_w = 0.;
+    double *fsp = &(d->full_stats[0]);
+    const size_t *eip = d->elem_id_p;
+    const size_t annot_os = d->annot_os;
+    const float *annot_p = d->annot_p;
+    const size_t n_samples = d->n_samples;
+    if (weights_p == nullptr) {
+      full_w = static_cast<double>(n_samples);
+      for (size_t i = 0; i < n_samples; ++i) {
+        const float *Cp = annot_p + eip[i] * annot_os;
+        for (size_t j = 0; j < ad;) {
+          trace += static_cast<double>(*Cp) * *Cp;
+          fsp[j++] += *(Cp++);
+        }
+      }
+    } else {
+      for (size_t i = 0; i < n_samples; ++i) {
+        const float *Cp = annot_p + eip[i] * annot_os;
+        const double current_weight = weights_p[eip[i]];
+        full_w += current_weight;
+        for (size_t j = 0; j < ad;) {
+          const double w_y = current_weight * *Cp;
+          fsp[j++] += w_y;
+          trace += w_y * *(Cp++);
+        }
       }
     }
+    fsp[ad] = full_w;
+    fsp[ad + 1] = trace;
   }
   d->weights_p = weights_p;
-  d->full_w = full_w;
-  float maxproxy = 0.f;  // Important for efficiency (see above).
-  for (size_t idx = 0; idx < ad; ++idx) maxproxy += fsp[idx] * fsp[idx];
-  maxproxy /= full_w;
-  trace -= maxproxy;
-  trace /= full_w;
-  d->maxproxy = maxproxy;
-  d->fullentropy = trace;
+  const double *fstp = &(d->full_stats[0]);
+  d->full_sum.resize(ad);
+  d->full_sum_p = &(d->full_sum[0]);
+  double maxproxy = 0.;
+  for (size_t idx = 0; idx < ad; ++idx) {
+    d->full_sum_p[idx] = static_cast<float>(fstp[idx]);
+    maxproxy += fstp[idx] * fstp[idx];
+  }
+  maxproxy /= fstp[ad];
+  d->full_w = static_cast<float>(fstp[ad]);
+  d->maxproxy = static_cast<float>(maxproxy);
+  d->fullentropy = static_cast<float>((fstp[ad + 1] - maxproxy) / fstp[ad]);
+  if (ad >= REGOPT_INCREMENTAL_MIN_DIM) {
+    // The per sample terms of the incremental impurity updates.
+    if (d->annot_dots.size() < 2 * static_cast<size_t>(annot_mat.rows()))
+      d->annot_dots.resize(2 * annot_mat.rows());
+    double *dots_p = &(d->annot_dots[0]);
+    for (size_t i = 0; i < d->n_samples; ++i) {
+      const id_t sample_id = d->elem_id_p[i];
+      const float *Cp = d->annot_p + sample_id * d->annot_os;
+      double fy = 0., yy = 0.;
+      for (size_t j = 0; j < ad; ++j) {
+        fy += fstp[j] * Cp[j];
+        yy += static_cast<double>(Cp[j]) * Cp[j];
+      }
+      dots_p[2 * sample_id] = fy;
+      dots_p[2 * sample_id + 1] = yy;
+    }
+  }
   // Use the trace of the diagonal of the covariance matrix.
   VLOG(57) << "Full variance proxy calculation done. Sum[0]: "
-           << d->full_sum_p[0] << ", full proxy: " << maxproxy;
+           << d->full_sum_p[0] << ", full proxy: " << d->maxproxy;
   if (d->sort_perm.size() != d->n_samples) {
     d->sort_perm.resize(d->n_samples);
     d->sort_perm_p = &(d->sort_perm[0]);
@@ -129,8 +155,7 @@ inline void RegressionOpt::optimize__sort(DeciderDesk &d) const {
           .get_unchecked<const float *>();  // See above, but for all samples.
   size_t *elem_id_p = d.elem_id_p;
   const size_t n_samples = d.n_samples;
-  for (size_t i = 0; i < d.n_samples; ++i)
-    feat_p[i] = full_feat_p[elem_id_p[i]];
+  gather(full_feat_p, elem_id_p, n_samples, feat_p, d.prefetch);
   if (!d.presorted) {
     DLOG_IF(INFO,
             DLOG_ROPT_V >= 4 && (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
@@ -159,7 +184,8 @@ inline SplitOptRes<float> &RegressionOpt::optimize__setup(
         SplitOptRes<float>{.split_idx = 0,
                            .thresh = std::numeric_limits<float>::lowest(),
                            .gain = 0.f,
-                           .valid = false};
+                           .valid = false,
+                           .left_stats = {}};
   SplitOptRes<float> &ret_res = d.opt_res_v.get_unchecked<SplitOptRes<float>>();
   ret_res.valid = false;
   return ret_res;
@@ -186,24 +212,119 @@ inline std::unique_ptr<std::vector<float>> RegressionOpt::optimize__thresholds(
   }
 };
 
-void RegressionOpt::optimize(Desk *desk) const {
-  DeciderDesk &d = desk->d;  // Solely for convenience.
+inline void RegressionOpt::optimize__histogram(DeciderDesk &d) const {
   SplitOptRes<float> &ret_res = this->optimize__setup(d);
-  this->optimize__sort(d);
-  float *feat_p = d.feat_p;  // The analyzed feature, only samples at this node.
-  size_t n_samples = d.n_samples;
-  if (feat_p[n_samples - 1] - feat_p[0] <= REGOPT_EPS) {
-    DLOG_IF(INFO,
-            DLOG_ROPT_V >= 1 && (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
-        << "Not optimizing because min and max features are too close!";
-    return;
+  const FeatureBins &bins = *d.bins;
+  const size_t n_bins = bins.get_n_bins(d.feat_idx);
+  if (n_bins < 2) return;
+  // Per bin: the weighted annotation sums, the weight and the sample count.
+  const size_t ad = d.annot_dim;
+  const size_t stride = ad + 2;
+  bool derived;
+  double *hist = d.hist_cache.get(d.node_id, d.n_samples, d.feat_idx,
+                                  n_bins * stride, &derived);
+  if (!derived) {
+    const uint8_t *codes = bins.get_codes(d.feat_idx);
+    const id_t *elem_id_p = d.elem_id_p;
+    const float *anp = d.annot_p;
+    const size_t annot_os = d.annot_os;
+    const float *weights_p = d.weights_p;
+    for (size_t i = 0; i < d.n_samples; ++i) {
+      const id_t elem_id = elem_id_p[i];
+      const float *Cp = anp + elem_id * annot_os;
+      const double weight = weights_p == nullptr ? 1. : weights_p[elem_id];
+      double *bin_p = hist + codes[elem_id] * stride;
+      for (size_t j = 0; j < ad; ++j) bin_p[j] += weight * Cp[j];
+      bin_p[ad] += weight;
+      bin_p[ad + 1] += 1.;
+    }
   }
-  std::unique_ptr<std::vector<float>> thresholds = this->optimize__thresholds(desk);
+  d.hist_sums.assign(2 * stride, 0.);
+  double *lsp = &d.hist_sums[0];
+  double *fsp = lsp + stride;
+  for (size_t bin = 0; bin < n_bins; ++bin)
+    for (size_t j = 0; j < stride; ++j) fsp[j] += hist[bin * stride + j];
+  const double full_w = fsp[ad];
+  double maxproxy = 0.;
+  for (size_t j = 0; j < ad; ++j) maxproxy += fsp[j] * fsp[j];
+  maxproxy /= full_w;
+  const size_t msal = d.min_samples_at_leaf;
+  size_t left_count = 0;
+  for (size_t bin = 0; bin < n_bins - 1; ++bin) {
+    const double *bin_p = hist + bin * stride;
+    if (bin_p[ad + 1] == 0.) continue;
+    for (size_t j = 0; j <= ad; ++j) lsp[j] += bin_p[j];
+    left_count += static_cast<size_t>(bin_p[ad + 1]);
+    if (left_count < msal) continue;
+    if (d.n_samples - left_count < msal) break;
+    const double left_w = lsp[ad];
+    const double right_w = full_w - left_w;
+    if (left_w <= 0. || right_w <= 0.) continue;
+    double proxy_impurity_left = 0., proxy_impurity_right = 0.;
+    for (size_t j = 0; j < ad; ++j) {
+      proxy_impurity_left += lsp[j] * lsp[j];
+      proxy_impurity_right += (fsp[j] - lsp[j]) * (fsp[j] - lsp[j]);
+    }
+    const float current_gain = static_cast<float>(
+        proxy_impurity_left / left_w + proxy_impurity_right / right_w -
+        maxproxy);
+    ret_res.valid = true;
+    if (current_gain > ret_res.gain
+#ifndef FORPY_SKLEARN_COMPAT
+                           + GAIN_EPS
+#endif
+    ) {
+      ret_res.gain = current_gain;
+      ret_res.split_idx = left_count;
+      ret_res.thresh = static_cast<float>(bins.get_edge(d.feat_idx, bin));
+    }
+  }
+  DLOG_IF(INFO, ret_res.valid && DLOG_ROPT_V >= 1 &&
+                    (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
+      << "Histogram threshold optimized (" << (derived ? "derived" : "built")
+      << "). Samples left: " << ret_res.split_idx
+      << ", threshold: " << std::setprecision(17) << ret_res.thresh << ".";
+};
+
+void RegressionOpt::fill_histograms(const IDataProvider &dprov,
+                                    const size_t &feat_idx,
+                                    const uint32_t *slots,
+                                    double *const *hists) const {
+  const FeatureBins *bins = dprov.get_feature_bins();
+  if (bins == nullptr)
+    throw ForpyException("The data provider has no feature bins!");
+  const uint8_t *codes = bins->get_codes(feat_idx);
+  const auto &annot_mat =
+      dprov.get_annotations().get_unchecked<MatCRef<float>>();
+  const float *anp = annot_mat.data();
+  const size_t annot_os = annot_mat.outerStride();
+  const auto &weights_ptr = dprov.get_weights();
+  const float *weights_p =
+      weights_ptr != nullptr ? &(weights_ptr->at(0)) : nullptr;
+  const size_t ad = dprov.get_annot_vec_dim();
+  const size_t stride = ad + 2;
+  const size_t n_samples = bins->get_n_samples();
+  for (size_t i = 0; i < n_samples; ++i) {
+    if (slots[i] == FEATURE_BINS_NO_SLOT) continue;
+    const float *Cp = anp + i * annot_os;
+    const double weight = weights_p == nullptr ? 1. : weights_p[i];
+    double *bin_p = hists[slots[i]] + codes[i] * stride;
+    for (size_t j = 0; j < ad; ++j) bin_p[j] += weight * Cp[j];
+    bin_p[ad] += weight;
+    bin_p[ad + 1] += 1.;
+  }
+};
+
+template <size_t AD, bool WEIGHTED>
+inline void RegressionOpt::optimize__scan(
+    DeciderDesk &d, SplitOptRes<float> &ret_res,
+    const std::vector<float> *thresholds) const {
+  float *feat_p = d.feat_p;
+  const size_t n_samples = d.n_samples;
   std::vector<float>::const_iterator feat_val_it;
   if (n_thresholds > 0) feat_val_it = thresholds->begin();
   id_t *elem_id_p = d.elem_id_p;  // The element IDs are global. The pointer
   // points to the first one relevant for this node.
-  std::fill(d.left_sum_p, d.left_sum_p + d.annot_dim, 0.f);
   float left_w = 0.f;
   float const *weights_p = d.weights_p;
   const float full_w = d.full_w;
@@ -211,14 +332,42 @@ void RegressionOpt::optimize(Desk *desk) const {
   float last_val = std::numeric_limits<float>::lowest(), current_val = 0.f;
   const float *last_ant, *current_ant;
   float maxval = d.feat_p[d.n_samples - 1];
-  const size_t ad = d.annot_dim;
-  float *lsp = d.left_sum_p;
+  const size_t ad = AD > 0 ? AD : d.annot_dim;
+  // With a fixed annotation dimension, the left sums are a local array that
+  // the compiler can keep in registers.
+  float local_lsp[AD > 0 ? AD : 1];
+  float *lsp = AD > 0 ? local_lsp : d.left_sum_p;
+  std::fill(lsp, lsp + ad, 0.f);
   const float *fsp = d.full_sum_p;
   const size_t msal = d.min_samples_at_leaf;
   const float *anp = d.annot_p;
   const size_t annot_os = d.annot_os;
   const float maxproxy = d.maxproxy;
   float current_weight, last_weight;
+  // For many annotation dimensions, the squared norms of the left and right
+  // sums are tracked incrementally in double precision.
+  const bool incremental = AD == 0 && ad >= REGOPT_INCREMENTAL_MIN_DIM;
+  const size_t resync = std::max(IMPURITY_RESYNC_INTERVAL, ad);
+  size_t since_resync = 0;
+  double *dlsp = nullptr;
+  const double *dots_p = nullptr, *fstp = nullptr;
+  double dleft_w = 0., dproxy_left = 0., dproxy_right = 0., dmaxproxy = 0.;
+  const auto resync_proxies = [&]() {
+    dproxy_left = dproxy_right = 0.;
+    for (size_t idx = 0; idx < ad; ++idx) {
+      dproxy_left += dlsp[idx] * dlsp[idx];
+      const double rval = fstp[idx] - dlsp[idx];
+      dproxy_right += rval * rval;
+    }
+  };
+  if (incremental) {
+    d.left_dsum_vec.assign(ad, 0.);
+    dlsp = &d.left_dsum_vec[0];
+    dots_p = &d.annot_dots[0];
+    fstp = &d.full_stats[0];
+    resync_proxies();
+    dmaxproxy = dproxy_right / fstp[ad];
+  }
   FASSERT(d.min_samples_at_leaf > 0);
   for (size_t index = 0;
        index < n_samples - msal + 1 &&
@@ -228,18 +377,38 @@ void RegressionOpt::optimize(Desk *desk) const {
     if (full_w - left_w <= 0.f) break;
     current_val = feat_p[index];
     current_ant = anp + elem_id_p[index] * annot_os;
-    current_weight = weights_p == nullptr ? 1.f : weights_p[elem_id_p[index]];
+    current_weight = WEIGHTED ? weights_p[elem_id_p[index]] : 1.f;
     DLOG_IF(INFO,
             DLOG_ROPT_V >= 3 && (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
         << "Current val: " << std::setprecision(17) << current_val
         << ", current ant [0]: " << current_ant[0]
         << ", current weight: " << current_weight;
     if (index > 0) {
-      for (size_t idx = 0; idx < ad; ++idx) {
-        DLOG_IF(INFO, DLOG_ROPT_V >= 4 &&
-                          (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
-            << "Left sum [" << idx << "] += " << last_ant[idx];
-        lsp[idx] += last_weight * last_ant[idx];
+      if (incremental) {
+        const id_t last_id = elem_id_p[index - 1];
+        const double w = last_weight;
+        double ly = 0.;
+        for (size_t idx = 0; idx < ad; ++idx) {
+          ly += dlsp[idx] * last_ant[idx];
+          dlsp[idx] += w * last_ant[idx];
+        }
+        dleft_w += w;
+        if (++since_resync == resync) {
+          resync_proxies();
+          since_resync = 0;
+        } else {
+          // |l + w y|^2 and |f - l - w y|^2 from |l|^2 and |f - l|^2.
+          const double yy = dots_p[2 * last_id + 1];
+          dproxy_left += w * (2. * ly + w * yy);
+          dproxy_right += w * (w * yy - 2. * (dots_p[2 * last_id] - ly));
+        }
+      } else {
+        for (size_t idx = 0; idx < ad; ++idx) {
+          DLOG_IF(INFO, DLOG_ROPT_V >= 4 &&
+                            (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
+              << "Left sum [" << idx << "] += " << last_ant[idx];
+          lsp[idx] += last_weight * last_ant[idx];
+        }
       }
       DLOG_IF(INFO,
               DLOG_ROPT_V >= 4 && (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
@@ -250,27 +419,32 @@ void RegressionOpt::optimize(Desk *desk) const {
            (current_val >= *feat_val_it && last_val < *feat_val_it)) &&
           index >= msal) {
         current_gain = 0.f;
-        float proxy_impurity_left = 0., proxy_impurity_right = 0.;
-        for (size_t idx = 0; idx < ad; ++idx) {
-          proxy_impurity_left += lsp[idx] * lsp[idx];
-          float rval = fsp[idx] - lsp[idx];
-          proxy_impurity_right += rval * rval;
+        if (incremental) {
+          current_gain = static_cast<float>(dproxy_left / dleft_w +
+                                            dproxy_right / (fstp[ad] - dleft_w) -
+                                            dmaxproxy);
+        } else {
+          float proxy_impurity_left = 0., proxy_impurity_right = 0.;
+          for (size_t idx = 0; idx < ad; ++idx) {
+            proxy_impurity_left += lsp[idx] * lsp[idx];
+            float rval = fsp[idx] - lsp[idx];
+            proxy_impurity_right += rval * rval;
+          }
+          DLOG_IF(INFO, DLOG_ROPT_V >= 4 &&
+                            (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
+              << "Left sum[0]: " << lsp[0]
+              << ", right sum[0]: " << fsp[0] - lsp[0];
+          DLOG_IF(INFO, DLOG_ROPT_V >= 4 &&
+                            (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
+              << "proxy left: " << proxy_impurity_left
+              << ", proxy right: " << proxy_impurity_right;
+          float current_proxy = proxy_impurity_left / left_w +
+                                proxy_impurity_right / (full_w - left_w);
+          current_gain = current_proxy - maxproxy;
         }
-        DLOG_IF(INFO, DLOG_ROPT_V >= 4 &&
-                          (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
-            << "Left sum[0]: " << lsp[0]
-            << ", right sum[0]: " << fsp[0] - lsp[0];
-        DLOG_IF(INFO, DLOG_ROPT_V >= 4 &&
-                          (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
-            << "proxy left: " << proxy_impurity_left
-            << ", proxy right: " << proxy_impurity_right;
-        float current_proxy = proxy_impurity_left / left_w +
-                              proxy_impurity_right / (full_w - left_w);
-        current_gain = current_proxy - maxproxy;
         DLOG_IF(INFO, DLOG_ROPT_V >= 3 &&
                           (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
-            << "Current proxy: " << current_proxy
-            << ", current gain: " << current_gain
+            << "Current gain: " << current_gain
             << ", current best: " << ret_res.gain;
         ret_res.valid = true;
         if (current_gain > ret_res.gain
@@ -296,7 +470,8 @@ void RegressionOpt::optimize(Desk *desk) const {
       break;
     }
     if (n_thresholds > 0)
-      while (current_val > *feat_val_it) ++feat_val_it;
+      while (feat_val_it != thresholds->end() && current_val > *feat_val_it)
+        ++feat_val_it;
   }
   if (ret_res.valid) {
     ret_res.thresh =
@@ -313,6 +488,98 @@ void RegressionOpt::optimize(Desk *desk) const {
   }
 };
 
+template <bool WEIGHTED>
+inline void RegressionOpt::optimize__dispatch(
+    DeciderDesk &d, SplitOptRes<float> &ret_res,
+    const std::vector<float> *thresholds) const {
+  switch (d.annot_dim) {
+    case 1:
+      this->optimize__scan<1, WEIGHTED>(d, ret_res, thresholds);
+      break;
+    case 2:
+      this->optimize__scan<2, WEIGHTED>(d, ret_res, thresholds);
+      break;
+    case 3:
+      this->optimize__scan<3, WEIGHTED>(d, ret_res, thresholds);
+      break;
+    case 4:
+      this->optimize__scan<4, WEIGHTED>(d, ret_res, thresholds);
+      break;
+    default:
+      this->optimize__scan<0, WEIGHTED>(d, ret_res, thresholds);
+  }
+};
+
+void RegressionOpt::optimize(Desk *desk) const {
+  DeciderDesk &d = desk->d;  // Solely for convenience.
+  if (d.bins != nullptr && d.bins->use_histogram(d.feat_idx, d.n_samples)) {
+    this->optimize__histogram(d);
+    return;
+  }
+  SplitOptRes<float> &ret_res = this->optimize__setup(d);
+  this->optimize__sort(d);
+  float *feat_p = d.feat_p;  // The analyzed feature, only samples at this node.
+  size_t n_samples = d.n_samples;
+  if (feat_p[n_samples - 1] - feat_p[0] <= REGOPT_EPS) {
+    DLOG_IF(INFO,
+            DLOG_ROPT_V >= 1 && (d.node_id == LOG_ROPT_NID || LOG_ROPT_ALLN))
+        << "Not optimizing because min and max features are too close!";
+    return;
+  }
+  std::unique_ptr<std::vector<float>> thresholds = this->optimize__thresholds(desk);
+  // Dispatch once per node to a kernel without runtime branches on the
+  // weights and with a fixed annotation dimension where possible.
+  if (d.weights_p == nullptr)
+    this->optimize__dispatch<false>(d, ret_res, thresholds.get());
+  else
+    this->optimize__dispatch<true>(d, ret_res, thresholds.get());
+};
+
+/**
+ * The annotations are accumulated in double precision: the derived
+ * statistics of the larger child inherit the absolute error of the node
+ * statistics, which would otherwise grow relative to the shrinking sums over
+ * the levels.
+ */
+void RegressionOpt::child_stats(
+    const std::vector<double> & /*split_left_stats*/, Desk *desk) const {
+  DeciderDesk &d = desk->d;
+  const size_t ad = d.annot_dim;
+  const size_t n_left = d.left_int.second - d.left_int.first;
+  // Sum up the smaller child, the other one is the difference.
+  std::vector<double> *direct = &d.left_stats, *derived = &d.right_stats;
+  const id_t *ids_p = d.elem_id_p;
+  size_t n_direct = n_left;
+  if (n_left > d.n_samples - n_left) {
+    std::swap(direct, derived);
+    ids_p += n_left;
+    n_direct = d.n_samples - n_left;
+  }
+  direct->assign(ad + 2, 0.);
+  double *dsp = &((*direct)[0]);
+  double weight = 0., trace = 0.;
+  const float *annot_p = d.annot_p;
+  const size_t annot_os = d.annot_os;
+  const float *weights_p = d.weights_p;
+  for (size_t i = 0; i < n_direct; ++i) {
+    const float *Cp = annot_p + ids_p[i] * annot_os;
+    const double current_weight =
+        weights_p == nullptr ? 1. : weights_p[ids_p[i]];
+    weight += current_weight;
+    for (size_t j = 0; j < ad; ++j) {
+      const double w_y = current_weight * Cp[j];
+      dsp[j] += w_y;
+      trace += w_y * Cp[j];
+    }
+  }
+  dsp[ad] = weight;
+  dsp[ad + 1] = trace;
+  derived->resize(ad + 2);
+  for (size_t j = 0; j < ad; ++j) (*derived)[j] = d.full_stats[j] - dsp[j];
+  (*derived)[ad] = std::max(0., d.full_stats[ad] - weight);
+  (*derived)[ad + 1] = std::max(0., d.full_stats[ad + 1] - trace);
+};
+
 bool RegressionOpt::operator==(const IThreshOpt &rhs) const {
   const auto *rhs_c = dynamic_cast<RegressionOpt const *>(&rhs);
   if (rhs_c == nullptr) {
@@ -1,3 +1,5 @@
+#include <forpy/codegen.h>
+#include <forpy/data_providers/fastdprov.h>
 #include <forpy/deciders/fastdecider.h>
 #include <forpy/leafs/classificationleaf.h>
 #include <forpy/leafs/regressionleaf.h>
@@ -5,14 +7,25 @@
 #include <forpy/threshold_optimizers/regression_opt.h>
 #include <forpy/tree.h>
 #include <forpy/util/exponentials.h>
+#include <forpy/util/gather.h>
 #include <forpy/util/serialization/stl/atomic.h>
 #include <forpy/util/serialization/stl/random.h>
 #include <forpy/util/serialization/variant.h>
 #include <forpy/util/threading/ctpl.h>
 #include <cereal/types/utility.hpp>
 
+#include <chrono>
+
 namespace forpy {
 
+namespace {
+/** A unique id for every training run (see HistogramCache::claim). */
+size_t next_training_run() {
+  static std::atomic<size_t> training_runs(0);
+  return ++training_runs;
+}
+}  // namespace
+
 Tree::Tree(const uint &max_depth, const uint &min_samples_at_leaf,
            const uint &min_samples_at_node,
            const std::shared_ptr<IDecider> &decider,
@@ -27,7 +40,8 @@ Tree::Tree(const uint &max_depth, const uint &min_samples_at_leaf,
       leaf_manager(leaf_manager),
       tree(0),
       next_id(0),
-      random_seed(random_seed) {
+      random_seed(random_seed),
+      layout(ENodeLayout::Training) {
   if (max_depth == 0) throw ForpyException("The max depth must be >0!");
   if (min_samples_at_leaf == 0)
     throw ForpyException("The minimum number of samples at leafs must be >0!");
@@ -51,7 +65,7 @@ Tree::Tree(const uint &max_depth, const uint &min_samples_at_leaf,
   if (random_seed == 0) throw ForpyException("Random seed must be > 0!");
 };
 
-Tree::Tree(std::string filename) {
+Tree::Tree(std::string filename) : layout(ENodeLayout::Training) {
   std::ifstream fstream(filename);
   std::stringstream sstream;
   if (fstream) {
@@ -88,6 +102,15 @@ void Tree::make_node(const IDataProvider *data_provider, Desk *desk) {
     throw ForpyException("Tried to process a node where none was left.");
   auto mark = std::move(d.marks.back());
   d.marks.pop_back();
+  const size_t n_mark = mark.interv.second - mark.interv.first;
+  if (local_copy_samples > 0 && !d.is_local && d.may_spawn &&
+      n_mark <= local_copy_samples && n_mark >= min_samples_at_node &&
+      !decider->uses_global_sample_ids() &&
+      data_provider->get_sparse_features() == nullptr) {
+    make_subtree_local(mark, *data_provider, desk);
+    return;
+  }
+  ++d.task_nodes;
   VLOG(10) << "Processing node with id " << mark.node_id << " at depth "
            << mark.depth << " with samples starting from " << mark.interv.first
            << " to " << mark.interv.second << " ("
@@ -106,6 +129,12 @@ void Tree::make_node(const IDataProvider *data_provider, Desk *desk) {
     make_to_leaf = true;
   } else {
     VLOG(11) << "Optimizing decision node...";
+    d.task_estimate += NodeCostModel::get().seconds(
+        decider->estimate_work(n_samples, *data_provider));
+    desk->d.left_stats.clear();
+    desk->d.right_stats.clear();
+    desk->d.child_invalid.clear();
+    setup_node(mark, desk);
     decider->make_node(mark, min_samples_at_leaf, *data_provider, desk);
     make_to_leaf = desk->d.make_to_leaf;
   }
@@ -121,51 +150,146 @@ void Tree::make_node(const IDataProvider *data_provider, Desk *desk) {
             this->min_samples_at_leaf);
     FASSERT((desk->d.right_int.second - desk->d.right_int.first >=
              this->min_samples_at_leaf));
-    // Right child.
-    d.tree_p->at(mark.node_id).second = desk->d.right_id;
+    d.tree_p->at(mark.node_id) = {desk->d.left_id, desk->d.right_id};
+    TodoMark mark_left(mark.sample_ids, desk->d.left_int, desk->d.left_id,
+                       mark.depth + 1);
     TodoMark mark_right(mark.sample_ids, desk->d.right_int, desk->d.right_id,
                         mark.depth + 1);
-    if (desk->d.right_int.second - desk->d.right_int.first <
-            min_samples_at_node ||
-        mark_right.depth >= max_depth) {
-      leaf_manager->make_leaf(mark_right, *data_provider, desk);
-      d.stored_in_leafs->operator+=(desk->d.right_int.second -
-                                    desk->d.right_int.first);
-    } else {
-      if (tc.get_idle() > 0 &&
-          (desk->d.right_int.second - desk->d.right_int.first) *
-                  sqrt(desk->d.annot_dim) * desk->d.input_dim >
-              7000) {
-        std::unique_lock<std::mutex> lck(fut_mtx);
-        futures.emplace_back(tc.push_move(&Tree::DFS_and_store, this,
-                                          std::move(mark_right), data_provider,
-                                          ECompletionLevel::Complete));
-      } else {
-        d.marks.emplace_back(std::move(mark_right));
+    // The statistics of the children are known from the split, if the
+    // threshold optimizer provides them.
+    mark_left.stats.swap(desk->d.left_stats);
+    mark_right.stats.swap(desk->d.right_stats);
+    mark_left.invalid_features = desk->d.child_invalid;
+    mark_right.invalid_features.swap(desk->d.child_invalid);
+    TodoMark *children[2] = {&mark_left, &mark_right};
+    // Children that are no leafs are either processed next by this thread
+    // (depth first) or spawned as a task if a thread is idle. The more
+    // expensive child is spawned if its subtree is worth a task, so that the
+    // idle thread gets as much work as possible, and the other child is kept
+    // if it is not or if both are.
+    const bool may_spawn = d.may_spawn && !d.is_local && tc.get_num() > 1 &&
+                           tc.get_idle() > 0;
+    bool is_node[2];
+    double estimate[2] = {0., 0.};
+    for (size_t i = 0; i < 2; ++i) {
+      const size_t n_child =
+          children[i]->interv.second - children[i]->interv.first;
+      is_node[i] =
+          n_child >= min_samples_at_node && children[i]->depth < max_depth;
+      if (!is_node[i]) {
+        leaf_manager->make_leaf(*children[i], *data_provider, desk);
+        d.stored_in_leafs->operator+=(n_child);
+      } else if (may_spawn) {
+        estimate[i] =
+            estimate_subtree(n_child, children[i]->depth, *data_provider);
       }
     }
-    // Left child.
-    d.tree_p->at(mark.node_id).first = desk->d.left_id;
-    TodoMark mark_left(mark.sample_ids, desk->d.left_int, desk->d.left_id,
-                       mark.depth + 1);
-    if (desk->d.left_int.second - desk->d.left_int.first <
-            min_samples_at_node ||
-        mark_left.depth >= max_depth) {
-      leaf_manager->make_leaf(mark_left, *data_provider, desk);
-      d.stored_in_leafs->operator+=(desk->d.left_int.second -
-                                    desk->d.left_int.first);
-    } else {
-      if (false && tc.get_idle() > 0) {
-        std::unique_lock<std::mutex> lck(fut_mtx);
-        futures.emplace_back(tc.push_move(&Tree::DFS_and_store, this,
-                                          std::move(mark_left), data_provider,
-                                          ECompletionLevel::Complete));
-
-      } else {
-        d.marks.emplace_back(std::move(mark_left));
-      }
+    const size_t costly = estimate[1] > estimate[0] ? 1 : 0;
+    const bool spawn = may_spawn && is_node[costly] &&
+                       NodeCostModel::get().worth_task(estimate[costly]);
+    if (spawn) {
+      ++d.task_spawned;
+      std::unique_lock<std::mutex> lck(fut_mtx);
+      futures.emplace_back(tc.push_move(&Tree::DFS_and_store, this,
+                                        std::move(*children[costly]),
+                                        data_provider,
+                                        ECompletionLevel::Complete));
     }
+    // The left child comes first.
+    for (size_t i = 2; i-- > 0;)
+      if (is_node[i] && !(spawn && i == costly))
+        d.marks.emplace_back(std::move(*children[i]));
+  }
+};
+
+/**
+ * The copies are made once per subtree, so every sample is copied once per
+ * tree, and the buffers of the desk keep their capacity for the next subtree.
+ * The subtree is processed with the same desk and in the same order as
+ * without the copies, so the resulting tree is the same.
+ */
+void Tree::make_subtree_local(const TodoMark &mark, const IDataProvider &dprov,
+                              Desk *desk) {
+  auto &t = desk->t;
+  const size_t n = mark.interv.second - mark.interv.first;
+  id_t *ids = &(mark.sample_ids->at(mark.interv.first));
+  VLOG(11) << "Copying the " << n << " samples of node " << mark.node_id
+           << " for local training.";
+  const size_t n_features = dprov.get_feat_vec_dim();
+  Data<MatCRef> data, annotations;
+  dprov.get_feature(0).match(
+      [](const Empty &) { throw EmptyException(); },
+      [&](const auto &feat0) {
+        typedef typename get_core<decltype(feat0.data())>::type IT;
+        if (!t.local_data.is<Mat<IT>>() ||
+            static_cast<size_t>(t.local_data.get_unchecked<Mat<IT>>().cols()) <
+                n ||
+            static_cast<size_t>(t.local_data.get_unchecked<Mat<IT>>().rows()) !=
+                n_features)
+          t.local_data.set<Mat<IT>>(n_features, n);
+        auto &buf = t.local_data.get_unchecked<Mat<IT>>();
+        for (size_t feat_idx = 0; feat_idx < n_features; ++feat_idx)
+          gather(dprov.get_feature(feat_idx)
+                     .get_unchecked<VecCMap<IT>>()
+                     .data(),
+                 ids, n, buf.data() + feat_idx * buf.outerStride(), true);
+        data.set<MatCRef<IT>>(buf.leftCols(n));
+      });
+  dprov.get_annotations().match(
+      [](const Empty &) { throw EmptyException(); },
+      [&](const auto &annots) {
+        typedef typename get_core<decltype(annots.data())>::type AT;
+        const size_t annot_dim = annots.cols();
+        if (!t.local_annotations.is<Mat<AT>>() ||
+            static_cast<size_t>(
+                t.local_annotations.get_unchecked<Mat<AT>>().rows()) < n ||
+            static_cast<size_t>(
+                t.local_annotations.get_unchecked<Mat<AT>>().cols()) !=
+                annot_dim)
+          t.local_annotations.set<Mat<AT>>(n, annot_dim);
+        auto &buf = t.local_annotations.get_unchecked<Mat<AT>>();
+        for (size_t i = 0; i < n; ++i)
+          std::copy_n(annots.data() + ids[i] * annots.outerStride(), annot_dim,
+                      buf.data() + i * buf.outerStride());
+        annotations.set<MatCRef<AT>>(buf.topRows(n));
+      });
+  std::shared_ptr<const std::vector<float>> weights;
+  const auto global_weights = dprov.get_weights();
+  if (global_weights != nullptr) {
+    if (t.local_weights == nullptr)
+      t.local_weights = std::make_shared<std::vector<float>>();
+    t.local_weights->resize(n);
+    gather(global_weights->data(), ids, n, t.local_weights->data(), true);
+    weights = t.local_weights;
+  }
+  std::shared_ptr<const FeatureBins> bins;
+  if (dprov.get_feature_bins() != nullptr) {
+    if (t.local_bins == nullptr) t.local_bins = std::make_shared<FeatureBins>();
+    t.local_bins->assign_subset(*dprov.get_feature_bins(), ids, n);
+    bins = t.local_bins;
   }
+  if (t.local_ids == nullptr)
+    t.local_ids = std::make_shared<std::vector<id_t>>();
+  t.local_ids->resize(n);
+  std::iota(t.local_ids->begin(), t.local_ids->end(), 0);
+  t.global_ids.assign(ids, ids + n);
+  const FastDProv local(data, annotations, weights, bins);
+  // Train the subtree with a fresh mark stack and without spawning tasks,
+  // since the copies belong to this desk.
+  std::vector<TodoMark> outer_marks;
+  std::swap(outer_marks, t.marks);
+  t.marks.emplace_back(t.local_ids, interv_t(0, n), mark.node_id, mark.depth);
+  t.marks.back().stats = mark.stats;
+  t.marks.back().invalid_features = mark.invalid_features;
+  t.local_offset = mark.interv.first;
+  t.is_local = true;
+  desk->d.prefetch = false;
+  while (!t.marks.empty()) make_node(&local, desk);
+  t.is_local = false;
+  desk->d.prefetch = true;
+  std::swap(outer_marks, t.marks);
+  const id_t *local_ids_p = t.local_ids->data();
+  for (size_t i = 0; i < n; ++i) ids[i] = t.global_ids[local_ids_p[i]];
 };
 
 void Tree::DFS(const IDataProvider *data_provider,
@@ -190,12 +314,18 @@ void Tree::DFS(const IDataProvider *data_provider,
   }
 };
 
-void Tree::DFS_and_store(Desk *d, TodoMark &mark, const IDataProvider *dprov,
-                         const ECompletionLevel &comp) {
-  VLOG(3) << "Starting DFSnstore task in thread " << d->thread_id
-          << " with system id " << std::this_thread::get_id();
-  VLOG(3) << "Processing node with node id " << mark.node_id << " at depth "
-          << mark.depth << " for tree " << this;
+double Tree::estimate_subtree(const size_t &n_samples, const size_t &depth,
+                              const IDataProvider &dprov) const {
+  const auto &model = NodeCostModel::get();
+  double seconds = 0., n_nodes = 1., n = static_cast<double>(n_samples);
+  for (size_t level = depth; level < max_depth && n >= min_samples_at_node;
+       ++level, n /= 2., n_nodes *= 2.)
+    seconds += n_nodes * model.seconds(decider->estimate_work(
+                             static_cast<size_t>(n), dprov));
+  return seconds;
+}
+
+void Tree::setup_desk(Desk *d) {
   const auto &maps = decider->get_maps();
   d->setup(
       &stored_in_leafs, &next_id, &tree,
@@ -205,19 +335,55 @@ void Tree::DFS_and_store(Desk *d, TodoMark &mark, const IDataProvider *dprov,
           maps.second),
       const_cast<std::vector<Mat<float>> *>(leaf_manager->get_map()),
       random_seed);
-  d->r.random_engine.seed(d->r.seed + mark.node_id);
-  d->t.tree_p->push_back({0, 0});
+  d->d.hist_cache.claim(training_run);
+}
+
+/**
+ * The random engine is seeded with the position of the node, which is
+ * independent of the scheduling, and ties are sorted from the initial order.
+ * In a local subtree, the positions are those of the global sample ids.
+ */
+void Tree::setup_node(const TodoMark &mark, Desk *d) const {
+  const size_t first =
+      mark.interv.first + (d->t.is_local ? d->t.local_offset : 0);
+  d->r.random_engine.seed(
+      d->r.seed + static_cast<uint>(mark.depth * n_positions + first));
+  d->d.sort_perm.clear();
+}
+
+void Tree::DFS_and_store(Desk *d, TodoMark &mark, const IDataProvider *dprov,
+                         const ECompletionLevel &comp) {
+  const auto start = std::chrono::steady_clock::now();
+  VLOG(3) << "Starting DFSnstore task in thread " << d->thread_id
+          << " with system id " << std::this_thread::get_id();
+  VLOG(3) << "Processing node with node id " << mark.node_id << " at depth "
+          << mark.depth << " for tree " << this;
+  setup_desk(d);
+  TaskStats stats;
+  stats.node_id = mark.node_id;
+  stats.depth = mark.depth;
+  stats.n_samples = mark.interv.second - mark.interv.first;
+  stats.thread_id = d->thread_id;
   d->t.marks.push_back(std::move(mark));
   DFS(dprov, comp, d);
+  stats.n_nodes = d->t.task_nodes;
+  stats.n_spawned = d->t.task_spawned;
+  stats.estimated_s = d->t.task_estimate;
+  stats.actual_s = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  {
+    std::unique_lock<std::mutex> lck(fut_mtx);
+    task_stats.push_back(stats);
+  }
   d->reset();
 }
 
-void Tree::parallel_DFS(Desk * /*d*/, TodoMark &mark,
-                        IDataProvider *data_provider, const bool &finalize) {
-  auto &tc = ThreadControl::getInstance();
-  VLOG(3) << "Initializing parallel DFS with " << tc.get_num()
-          << " threads for the tree at " << this;
-  const size_t &n_samples = data_provider->get_n_samples();
+void Tree::reserve_nodes(const IDataProvider &dprov) {
+  training_run = next_training_run();
+  task_stats.clear();
+  const size_t &n_samples = dprov.get_n_samples();
+  n_positions = n_samples;
   // Total number of nodes in a full binary tree with 'n_samples' leaf nodes: 2
   // * n_samples - 1. Total number of nodes in a full binary tree with depth
   // 'max_depth': 2 ^ (max_depth + 1) - 1.
@@ -238,6 +404,20 @@ void Tree::parallel_DFS(Desk * /*d*/, TodoMark &mark,
   tree.resize(upper_bound);
   decider->ensure_capacity(upper_bound);
   leaf_manager->ensure_capacity(upper_bound);
+}
+
+void Tree::finalize_nodes() {
+  tree.resize(next_id);
+  decider->finalize_capacity(next_id);
+  leaf_manager->finalize_capacity(next_id);
+}
+
+void Tree::parallel_DFS(Desk * /*d*/, TodoMark &mark,
+                        IDataProvider *data_provider, const bool &finalize) {
+  auto &tc = ThreadControl::getInstance();
+  VLOG(3) << "Initializing parallel DFS with " << tc.get_num()
+          << " threads for the tree at " << this;
+  reserve_nodes(*data_provider);
   std::future<void> fut_store =
       tc.push_move(&Tree::DFS_and_store, this, std::move(mark), data_provider,
                    ECompletionLevel::Complete);
@@ -251,10 +431,180 @@ void Tree::parallel_DFS(Desk * /*d*/, TodoMark &mark,
         futures.pop_back();
       }
     }
-    tree.resize(next_id);
-    decider->finalize_capacity(next_id);
-    leaf_manager->finalize_capacity(next_id);
+    finalize_nodes();
+  }
+}
+
+bool Tree::BFS(const ECompletionLevel &completion) {
+  if (bfs_dprov == nullptr)
+    throw ForpyException(
+        "There is no breadth first training to continue. Call fit with "
+        "search type BFS and complete_dfs set to false first.");
+  switch (completion) {
+    case ECompletionLevel::Node: {
+      std::vector<TodoMark> node;
+      node.push_back(std::move(bfs_marks.front()));
+      bfs_marks.erase(bfs_marks.begin());
+      std::vector<std::vector<std::vector<double>>> no_hists(1);
+      BFS_nodes(&node, 0, 1, &no_hists);
+      if (bfs_marks.empty()) bfs_marks.swap(bfs_next);
+      break;
+    }
+    case ECompletionLevel::Level:
+      BFS_level();
+      break;
+    case ECompletionLevel::Complete:
+      while (!bfs_marks.empty()) BFS_level();
+      break;
+    default:
+      throw ForpyException("Unknown completion level used for BFS.");
+  }
+  if (!bfs_marks.empty()) return false;
+  finalize_nodes();
+  bfs_dprov.reset();
+  return true;
+}
+
+void Tree::BFS_level() {
+  std::vector<TodoMark> level;
+  level.swap(bfs_marks);
+  VLOG(3) << "Processing " << level.size() << " nodes at depth "
+          << (level.empty() ? 0 : level[0].depth) << " for tree " << this;
+  size_t start = 0, end;
+  while (start < level.size()) {
+    auto hists = BFS_histograms(level, start, &end);
+    BFS_nodes(&level, start, end, &hists);
+    start = end;
+  }
+  bfs_marks.swap(bfs_next);
+}
+
+std::vector<std::vector<std::vector<double>>> Tree::BFS_histograms(
+    const std::vector<TodoMark> &level, const size_t &start, size_t *end) {
+  const IDataProvider &dprov = *bfs_dprov;
+  const FeatureBins *bins = dprov.get_feature_bins();
+  const auto threshopt = decider->get_threshopt();
+  const size_t stride = threshopt->get_histogram_stride(dprov);
+  std::vector<std::vector<std::vector<double>>> hists;
+  if (bins == nullptr || stride == 0 || !decider->evaluates_all_features()) {
+    *end = level.size();
+    hists.resize(level.size() - start);
+    return hists;
+  }
+  const size_t n_features = dprov.get_feat_vec_dim();
+  size_t node_values = 0;
+  for (size_t feat_idx = 0; feat_idx < n_features; ++feat_idx)
+    node_values += bins->get_n_bins(feat_idx) * stride;
+  // Smaller nodes are optimized exactly for some features; their samples are
+  // gathered per node.
+  const size_t min_samples =
+      FEATURE_BINS_MIN_SAMPLES_PER_BIN * bins->get_max_bins();
+  std::vector<uint32_t> slots(bins->get_n_samples(), FEATURE_BINS_NO_SLOT);
+  size_t n_values = 0, idx = start;
+  bool unique = true;
+  for (; idx < level.size() && unique; ++idx) {
+    const TodoMark &mark = level[idx];
+    if (mark.interv.second - mark.interv.first < min_samples) {
+      hists.emplace_back();
+      continue;
+    }
+    if (n_values > 0 && n_values + node_values > TREE_BFS_MAX_HISTOGRAM_VALUES)
+      break;
+    n_values += node_values;
+    const uint32_t slot = static_cast<uint32_t>(hists.size());
+    hists.emplace_back(n_features);
+    for (size_t feat_idx = 0; feat_idx < n_features; ++feat_idx)
+      hists.back()[feat_idx].assign(bins->get_n_bins(feat_idx) * stride, 0.);
+    const id_t *ids = &(*mark.sample_ids)[0];
+    for (id_t i = mark.interv.first; i < mark.interv.second && unique; ++i) {
+      // A sample drawn more than once (bootstrapping) has one slot only.
+      unique = slots[ids[i]] == FEATURE_BINS_NO_SLOT;
+      slots[ids[i]] = slot;
+    }
   }
+  if (!unique) {
+    *end = level.size();
+    hists.clear();
+    hists.resize(level.size() - start);
+    return hists;
+  }
+  *end = idx;
+  if (n_values == 0) return hists;
+  // One sequential pass over the codes of each feature for all nodes.
+  std::atomic<size_t> next_feature(0);
+  auto fill = [&](Desk * /*d*/) {
+    std::vector<double *> hist_ps(hists.size(), nullptr);
+    for (size_t feat_idx; (feat_idx = next_feature++) < n_features;) {
+      for (size_t slot = 0; slot < hists.size(); ++slot)
+        if (!hists[slot].empty()) hist_ps[slot] = &hists[slot][feat_idx][0];
+      threshopt->fill_histograms(dprov, feat_idx, &slots[0], &hist_ps[0]);
+    }
+  };
+  auto &tc = ThreadControl::getInstance();
+  std::vector<std::future<void>> fill_futures;
+  for (size_t i = 0; i < std::min(tc.get_num(), n_features); ++i)
+    fill_futures.emplace_back(tc.push(fill));
+  for (auto &fut : fill_futures) fut.wait();
+  for (auto &fut : fill_futures) fut.get();
+  return hists;
+}
+
+void Tree::BFS_nodes(std::vector<TodoMark> *level, const size_t &start,
+                     const size_t &end,
+                     std::vector<std::vector<std::vector<double>>> *hists) {
+  const IDataProvider *dprov = bfs_dprov.get();
+  const size_t n_nodes = end - start;
+  std::vector<std::vector<TodoMark>> children(n_nodes);
+  std::atomic<size_t> next_node(0);
+  auto process = [&](Desk *d) {
+    const auto task_start = std::chrono::steady_clock::now();
+    setup_desk(d);
+    d->t.may_spawn = false;
+    TaskStats stats;
+    for (size_t i; (i = next_node++) < n_nodes;) {
+      TodoMark &mark = (*level)[start + i];
+      const size_t n_samples = mark.interv.second - mark.interv.first;
+      if (d->t.task_nodes == 0) {
+        stats.node_id = mark.node_id;
+        stats.depth = mark.depth;
+        stats.n_samples = n_samples;
+      }
+      // No histograms are derived from nodes that happen to have been
+      // processed by this desk (see setup_node for the other desk state).
+      d->d.hist_cache.clear();
+      auto &node_hists = (*hists)[i];
+      for (size_t feat_idx = 0; feat_idx < node_hists.size(); ++feat_idx)
+        d->d.hist_cache.put(mark.node_id, n_samples, feat_idx,
+                            std::move(node_hists[feat_idx]));
+      d->t.marks.push_back(std::move(mark));
+      make_node(dprov, d);
+      // The right child is marked first.
+      for (auto child = d->t.marks.rbegin(); child != d->t.marks.rend();
+           ++child)
+        children[i].push_back(std::move(*child));
+      d->t.marks.clear();
+    }
+    if (d->t.task_nodes > 0) {
+      stats.thread_id = d->thread_id;
+      stats.n_nodes = d->t.task_nodes;
+      stats.n_spawned = 0;
+      stats.estimated_s = d->t.task_estimate;
+      stats.actual_s = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - task_start)
+                           .count();
+      std::unique_lock<std::mutex> lck(fut_mtx);
+      task_stats.push_back(stats);
+    }
+    d->reset();
+  };
+  auto &tc = ThreadControl::getInstance();
+  std::vector<std::future<void>> node_futures;
+  for (size_t i = 0; i < std::min(tc.get_num(), n_nodes); ++i)
+    node_futures.emplace_back(tc.push(process));
+  for (auto &fut : node_futures) fut.wait();
+  for (auto &fut : node_futures) fut.get();
+  for (auto &node_children : children)
+    for (auto &child : node_children) bfs_next.push_back(std::move(child));
 }
 
 size_t Tree::get_depth() const {
@@ -293,7 +643,8 @@ size_t Tree::get_depth() const {
 
 Tree *Tree::fit(const Data<MatCRef> &data_v, const Data<MatCRef> &annotations_v,
                 const size_t &n_threads, const bool &complete_dfs,
-                const std::vector<float> &weights) {
+                const std::vector<float> &weights,
+                const ESearchType &search_type) {
   ThreadControl::getInstance().set_num(n_threads);
 #ifdef WITHGPERFTOOLS
   ProfilerStart("forpy.profile.log");
@@ -322,14 +673,14 @@ Tree *Tree::fit(const Data<MatCRef> &data_v, const Data<MatCRef> &annotations_v,
                     weights.size() == 0
                         ? nullptr
                         : std::make_shared<std::vector<float>>(weights));
-                this->fit_dprov(data_provider, complete_dfs);
+                this->fit_dprov(data_provider, complete_dfs, search_type);
               } else {
                 auto data_provider = std::make_shared<FastDProv>(
                     data_v, annotations_v,
                     weights.size() == 0
                         ? nullptr
                         : std::make_shared<std::vector<float>>(weights));
-                this->fit_dprov(data_provider, complete_dfs);
+                this->fit_dprov(data_provider, complete_dfs, search_type);
               }
             },
             [&](const Empty &) { throw EmptyException(); });
@@ -342,7 +693,8 @@ Tree *Tree::fit(const Data<MatCRef> &data_v, const Data<MatCRef> &annotations_v,
 }
 
 Tree *Tree::fit_dprov(std::shared_ptr<IDataProvider> data_provider,
-                      const bool &complete_dfs) {
+                      const bool &complete_dfs,
+                      const ESearchType &search_type) {
   auto &tc = ThreadControl::getInstance();
   if (tc.get_num() == 0) tc.set_num(1);
   // Checks.
@@ -370,7 +722,16 @@ Tree *Tree::fit_dprov(std::shared_ptr<IDataProvider> data_provider,
   FASSERT(sample_ids->size() > 0);
   TodoMark mark(sample_ids, interv_t(0, sample_ids->size()), next_id++, 0);
   is_initialized_for_training = true;
-  if (complete_dfs) this->parallel_DFS(nullptr, mark, data_provider.get());
+  // The nodes are created in training order.
+  layout = ENodeLayout::Training;
+  if (search_type == ESearchType::BFS) {
+    reserve_nodes(*data_provider);
+    bfs_dprov = data_provider;
+    bfs_marks.push_back(std::move(mark));
+    if (complete_dfs) this->BFS(ECompletionLevel::Complete);
+  } else if (complete_dfs) {
+    this->parallel_DFS(nullptr, mark, data_provider.get());
+  }
   return this;
 };
 
@@ -388,12 +749,32 @@ id_t Tree::predict_leaf(const Data<MatCRef> &data, const id_t &start_node,
   }
 };
 
+void Tree::predict_leaf_ids(const Data<MatCRef> &data_v, const size_t &start,
+                            const size_t &end, id_t *leaf_ids) const {
+  data_v.match(
+      [&](const auto &data) {
+        typedef typename get_core<decltype(data.data())>::type IT;
+        if (fast_tree.get() != nullptr) {
+          fast_tree->match([&](const auto &ftree) {
+            ftree.predict_leaf_ids(data.data() + start * data.outerStride(),
+                                   data.outerStride(), end - start, leaf_ids);
+          });
+        } else {
+          Data<MatCRef> in_v;
+          for (size_t i = start; i < end; ++i) {
+            in_v.set<MatCRef<IT>>(data.row(i));
+            leaf_ids[i - start] = this->predict_leaf(in_v);
+          }
+        }
+      },
+      [](const Empty &) { throw EmptyException(); });
+};
+
 Data<Mat> Tree::predict(const Data<MatCRef> &data_v, const int &num_threads,
                         const bool &use_fast_prediction_if_available,
                         const bool &predict_proba, const bool &for_forest) {
-  if (num_threads == 0)
+  if (num_threads <= 0)
     throw ForpyException("The number of threads must be >0!");
-  if (num_threads != 1) throw ForpyException("Unimplemented!");
   Data<Mat> result_v;
   data_v.match(
       [&](const auto &data) {
@@ -417,35 +798,54 @@ Data<Mat> Tree::predict(const Data<MatCRef> &data_v, const int &num_threads,
                     dynamic_cast<FastDecider const *>(this->decider.get());
                 if (dec != nullptr) this->enable_fast_prediction();
               }
-              Data<MatCRef> in_v;
-              Data<MatRef> out_v;
-              if (fast_tree.get() != nullptr) {
-                VLOG(9) << "Using fast tree for predictions.";
-                fast_tree->match([&](const auto &ftree) {
-                  for (size_t i = 0; i < static_cast<size_t>(data.rows());
-                       ++i) {
-                    size_t node_id = 0;
-                    while (std::get<2>(ftree[node_id]) != 0) {
-                      if (data(i, std::get<0>(ftree[node_id])) <=
-                          std::get<1>(ftree[node_id]))
-                        node_id = std::get<2>(ftree[node_id]);
-                      else
-                        node_id = std::get<3>(ftree[node_id]);
+              // Every row is processed independently and written to its own
+              // result row, so row ranges can be handled by different threads
+              // without any synchronization.
+              auto predict_rows = [&](const size_t &start, const size_t &end) {
+                Data<MatCRef> in_v;
+                Data<MatRef> out_v;
+                if (fast_tree.get() != nullptr) {
+                  id_t leaf_ids[FAST_BATCH_ROWS];
+                  fast_tree->match([&](const auto &ftree) {
+                    for (size_t i = start; i < end; i += FAST_BATCH_ROWS) {
+                      const size_t n_batch =
+                          std::min<size_t>(FAST_BATCH_ROWS, end - i);
+                      ftree.predict_leaf_ids(
+                          data.data() + i * data.outerStride(),
+                          data.outerStride(), n_batch, leaf_ids);
+                      for (size_t j = 0; j < n_batch; ++j) {
+                        out_v.set<MatRef<RT>>(result.row(i + j));
+                        this->leaf_manager->get_result(
+                            leaf_ids[j], out_v, predict_proba, for_forest);
+                      }
                     }
+                  });
+                } else {
+                  for (size_t i = start; i < end; ++i) {
                     in_v.set<MatCRef<IT>>(data.row(i));
                     out_v.set<MatRef<RT>>(result.row(i));
-                    this->leaf_manager->get_result(node_id, out_v,
-                                                   predict_proba, for_forest);
+                    this->leaf_manager->get_result(this->predict_leaf(in_v),
+                                                   out_v, predict_proba,
+                                                   for_forest);
                   }
-                });
-              } else {
-                for (size_t i = 0; i < static_cast<size_t>(data.rows()); ++i) {
-                  in_v.set<MatCRef<IT>>(data.row(i));
-                  out_v.set<MatRef<RT>>(result.row(i));
-                  this->leaf_manager->get_result(this->predict_leaf(in_v),
-                                                 out_v, predict_proba,
-                                                 for_forest);
                 }
+              };
+              const size_t n_rows = static_cast<size_t>(data.rows());
+              const size_t n_chunks = std::min<size_t>(
+                  n_rows, static_cast<size_t>(num_threads) *
+                              PREDICT_CHUNKS_PER_THREAD);
+              if (fast_tree.get() != nullptr)
+                VLOG(9) << "Using fast tree for predictions.";
+              if (num_threads == 1 || n_chunks <= 1) {
+                predict_rows(0, n_rows);
+              } else {
+                VLOG(9) << "Predicting " << n_rows << " rows in " << n_chunks
+                        << " chunks with " << num_threads << " threads.";
+                PredictionPool::getInstance().run(
+                    num_threads, n_chunks, [&](const size_t &chunk_idx) {
+                      predict_rows(n_rows * chunk_idx / n_chunks,
+                                   n_rows * (chunk_idx + 1) / n_chunks);
+                    });
               }
             },
             [](const Empty &) {});
@@ -460,7 +860,58 @@ Data<Mat> Tree::predict_proba(const Data<MatCRef> &data_v,
   return predict(data_v, num_threads, use_fast_prediction_if_available, true);
 };
 
+Data<Mat> Tree::predict_sparse(const SparseMat &data, const int &num_threads,
+                               const bool &predict_proba) {
+  return predict_sparse_rows(data, [&](const Data<MatCRef> &block) {
+    return predict(block, num_threads, true, predict_proba);
+  });
+};
+
+Mat<uint> Tree::apply(const Data<MatCRef> &data_v, const int &num_threads) {
+  if (num_threads <= 0)
+    throw ForpyException("The number of threads must be >0!");
+  Mat<uint> result;
+  data_v.match(
+      [&](const auto &data) {
+        if (static_cast<size_t>(data.cols()) != this->decider->get_data_dim())
+          throw ForpyException("Wrong array shape! Expecting " +
+                               std::to_string(this->decider->get_data_dim()) +
+                               " columns!");
+        if (fast_tree.get() == nullptr &&
+            dynamic_cast<FastDecider const *>(this->decider.get()) != nullptr)
+          this->enable_fast_prediction();
+        const size_t n_rows = static_cast<size_t>(data.rows());
+        result.resize(n_rows, 1);
+        auto apply_rows = [&](const size_t &start, const size_t &end) {
+          std::vector<id_t> leaf_ids(end - start);
+          this->predict_leaf_ids(data_v, start, end, leaf_ids.data());
+          for (size_t i = start; i < end; ++i)
+            result(i, 0) = static_cast<uint>(leaf_ids[i - start]);
+        };
+        const size_t n_chunks = std::min<size_t>(
+            n_rows,
+            static_cast<size_t>(num_threads) * PREDICT_CHUNKS_PER_THREAD);
+        if (num_threads == 1 || n_chunks <= 1) {
+          apply_rows(0, n_rows);
+        } else {
+          PredictionPool::getInstance().run(
+              num_threads, n_chunks, [&](const size_t &chunk_idx) {
+                apply_rows(n_rows * chunk_idx / n_chunks,
+                           n_rows * (chunk_idx + 1) / n_chunks);
+              });
+        }
+      },
+      [](const Empty &) { throw EmptyException(); });
+  return result;
+};
+
 void Tree::enable_fast_prediction() {
+  if (fast_tree.get() != nullptr)
+    throw ForpyException("This tree has been unpacked before!");
+  this->fast_tree = make_fast_tree();
+};
+
+std::unique_ptr<FastTreeV> Tree::make_fast_tree() const {
   // Check that the tree is trained.
   if (!this->is_initialized_for_training && this->tree.size() > 0)
     throw ForpyException("Trying to unpack an untrained tree.");
@@ -469,46 +920,101 @@ void Tree::enable_fast_prediction() {
   if (dec == nullptr)
     throw ForpyException(
         "Unpacking can only be done with a threshold decider.");
-  if (fast_tree.get() != nullptr)
-    throw ForpyException("This tree has been unpacked before!");
   // Everything ok, start unpacking.
   auto maps = dec->get_maps();
   const auto &tree_map = *(maps.first);
   const auto &threshold_map_v = *(maps.second);
   VLOG(9) << "Unpacking " << tree.size() << " nodes for fast prediction.";
+  std::unique_ptr<FastTreeV> result;
   threshold_map_v.match(
       [&](const auto &threshold_map) {
-        this->fast_tree = std::make_unique<mu::variant<
-            std::vector<std::tuple<size_t, float, size_t, size_t>>,
-            std::vector<std::tuple<size_t, double, size_t, size_t>>,
-            std::vector<std::tuple<size_t, uint32_t, size_t, size_t>>,
-            std::vector<std::tuple<size_t, uint8_t, size_t, size_t>>>>();
         typedef
             typename std::remove_const<typename std::remove_reference<decltype(
                 *threshold_map.data())>::type>::type thresh_t;
         FASSERT(tree_map.size() == threshold_map.size());
-        // Find the maximum node id in the tree map.
-        this->fast_tree
-            ->set<std::vector<std::tuple<size_t, thresh_t, size_t, size_t>>>(
-                tree.size(),
-                std::make_tuple(0, static_cast<thresh_t>(0), 0, 0));
-        auto &ftree = fast_tree->get_unchecked<
-            std::vector<std::tuple<size_t, thresh_t, size_t, size_t>>>();
-        for (size_t node_id = 0; node_id < tree.size(); ++node_id) {
-          const auto &node_id_pair = tree[node_id];
-          if (node_id_pair.first == 0 || node_id_pair.second == 0) {
-            // Leaf. Leave zeros.
-            continue;
-          }
-          ftree[node_id] =
-              std::make_tuple(tree_map.at(node_id), threshold_map.at(node_id),
-                              node_id_pair.first, node_id_pair.second);
-        }
+        result = std::make_unique<FastTreeV>(FastTree<thresh_t>(
+            tree, tree_map, threshold_map, layout != ENodeLayout::Training));
       },
       [](const Empty &) {
         throw ForpyException("Received empty threshold map!");
       });
   VLOG(9) << "Unpacking done.";
+  return result;
+};
+
+void Tree::relayout(const ENodeLayout &layout, const size_t &bfs_levels,
+                    const size_t &block_depth) {
+  if (!this->is_initialized_for_training)
+    throw ForpyException("Only trained trees can be relayouted.");
+  if (layout == ENodeLayout::Training)
+    throw ForpyException("The training node order can not be restored.");
+  if (block_depth == 0) throw ForpyException("block_depth must be >0!");
+  const size_t n_nodes = tree.size();
+  const id_t unassigned = std::numeric_limits<id_t>::max();
+  std::vector<id_t> new_ids(n_nodes, unassigned);
+  new_ids[0] = 0;
+  id_t next_new_id = 1;
+  auto is_inner = [this](const id_t &node_id) {
+    return tree[node_id].first != 0 && tree[node_id].second != 0;
+  };
+  // Assigns the children of a node as a pair to keep siblings adjacent.
+  auto place_children = [&](const id_t &node_id) {
+    new_ids[tree[node_id].first] = next_new_id++;
+    new_ids[tree[node_id].second] = next_new_id++;
+  };
+  // Places the children of all nodes in `level` for up to `depth` levels in
+  // breadth first order. Returns the inner nodes of the last level.
+  auto place_levels = [&](std::vector<id_t> level, const size_t &depth) {
+    std::vector<id_t> next_level;
+    for (size_t depth_idx = 0; depth_idx < depth && !level.empty();
+         ++depth_idx) {
+      next_level.clear();
+      for (const auto &node_id : level) {
+        if (!is_inner(node_id)) continue;
+        place_children(node_id);
+        next_level.push_back(tree[node_id].first);
+        next_level.push_back(tree[node_id].second);
+      }
+      level.swap(next_level);
+    }
+    std::vector<id_t> frontier;
+    for (const auto &node_id : level)
+      if (is_inner(node_id)) frontier.push_back(node_id);
+    return frontier;
+  };
+  if (layout == ENodeLayout::BreadthFirst) {
+    place_levels({0}, std::numeric_limits<size_t>::max());
+  } else {
+    // Blocks are laid out depth first, so that every subtree below the
+    // breadth first levels is stored contiguously.
+    std::vector<id_t> block_roots = place_levels({0}, bfs_levels);
+    std::reverse(block_roots.begin(), block_roots.end());
+    while (!block_roots.empty()) {
+      const id_t block_root = block_roots.back();
+      block_roots.pop_back();
+      std::vector<id_t> sub_roots = place_levels({block_root}, block_depth);
+      block_roots.insert(block_roots.end(), sub_roots.rbegin(),
+                         sub_roots.rend());
+    }
+  }
+  // Nodes that are not reachable from the root keep their relative order.
+  for (auto &new_id : new_ids)
+    if (new_id == unassigned) new_id = next_new_id++;
+  VLOG(9) << "Relayouting " << n_nodes << " nodes.";
+  std::vector<std::pair<id_t, id_t>> new_tree(n_nodes, {0, 0});
+  for (size_t node_id = 0; node_id < n_nodes; ++node_id) {
+    if (is_inner(node_id))
+      new_tree[new_ids[node_id]] = {new_ids[tree[node_id].first],
+                                    new_ids[tree[node_id].second]};
+  }
+  tree.swap(new_tree);
+  decider->permute_nodes(new_ids);
+  leaf_manager->permute_nodes(new_ids);
+  this->layout = layout;
+  if (fast_tree.get() != nullptr) {
+    fast_tree.reset();
+    enable_fast_prediction();
+  }
 };
 
 bool Tree::operator==(Tree const &rhs) const {
@@ -522,8 +1028,10 @@ bool Tree::operator==(Tree const &rhs) const {
   bool eq_tree = tree == rhs.tree;
   bool eq_nud = next_id == rhs.next_id;
   bool eq_rand = random_seed == rhs.random_seed;
+  bool eq_layout = layout == rhs.layout;
   return (eq_depth && eq_init && eq_min_samples && eq_min_samples_leaf &&
-          eq_weight && eq_dec && eq_lm && eq_tree && eq_nud && eq_rand);
+          eq_weight && eq_dec && eq_lm && eq_tree && eq_nud && eq_rand &&
+          eq_layout);
 }
 
 void Tree::save(const std::string &filename) const {
@@ -547,6 +1055,14 @@ void Tree::save(const std::string &filename) const {
   fstream.close();
 }  // namespace forpy
 
+void Tree::export_cpp(const std::string &filename, const ECodegenMode &mode,
+                      const std::string &name) const {
+  const std::string code = generate_cpp({this}, Vec<float>(), mode, name);
+  std::ofstream fstream(filename);
+  if (!fstream) throw ForpyException("Could not write to file: " + filename);
+  fstream << code;
+};
+
 ClassificationTree::ClassificationTree(
     const uint &max_depth, const uint &min_samples_at_leaf,
     const uint &min_samples_at_node, const uint &n_valid_features_to_use,
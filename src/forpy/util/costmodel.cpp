@@ -0,0 +1,97 @@
+#include <forpy/util/costmodel.h>
+#include <forpy/util/threading/ctpl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace forpy {
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+inline double since(const Clock::time_point &start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/** The fastest of `n_reps` runs of `f` in seconds. */
+template <typename F>
+double fastest(const size_t &n_reps, F &&f) {
+  double best = std::numeric_limits<double>::max();
+  for (size_t rep = 0; rep < n_reps; ++rep) {
+    const auto start = Clock::now();
+    f(rep);
+    best = std::min(best, since(start));
+  }
+  return best;
+}
+}  // namespace
+
+NodeCostModel::NodeCostModel(const double &s_per_compare,
+                             const double &s_per_scan, const double &s_per_task)
+    : s_per_compare(s_per_compare),
+      s_per_scan(s_per_scan),
+      s_per_task(s_per_task) {
+  if (s_per_compare <= 0. || s_per_scan <= 0. || s_per_task <= 0.)
+    throw ForpyException("The cost model constants must be positive!");
+}
+
+const NodeCostModel &NodeCostModel::get() {
+  static const NodeCostModel model = calibrate();
+  return model;
+}
+
+NodeCostModel NodeCostModel::calibrate() {
+  const size_t n_samples = 1 << 12, n_reps = 5;
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<float> dist;
+  std::vector<float> values(n_samples);
+  for (auto &value : values) value = dist(gen);
+  // Sorting values with their sample ids, as the threshold optimizers do.
+  std::vector<std::pair<float, id_t>> pairs(n_samples);
+  const double sort_s = fastest(n_reps, [&](const size_t &rep) {
+    for (size_t i = 0; i < n_samples; ++i)
+      pairs[i] = {values[(i * (2 * rep + 1)) % n_samples],
+                  static_cast<id_t>(i)};
+    std::sort(pairs.begin(), pairs.end());
+  });
+  // Accumulating weighted class counts along the sorted samples.
+  std::vector<uint> classes(n_samples);
+  for (size_t i = 0; i < n_samples; ++i) classes[i] = gen() % 8;
+  std::vector<double> counts(8);
+  volatile double sink = 0.;
+  const double scan_s = fastest(n_reps, [&](const size_t & /*rep*/) {
+    std::fill(counts.begin(), counts.end(), 0.);
+    for (const auto &pair : pairs)
+      counts[classes[pair.second]] += static_cast<double>(pair.first);
+    sink = sink + counts[0];
+  });
+  // The round trip of a task to a sleeping thread.
+  double task_s;
+  {
+    threading::thread_pool pool(1);
+    pool.push([](Desk *) {}).wait();
+    const size_t n_tasks = 32;
+    const auto start = Clock::now();
+    for (size_t i = 0; i < n_tasks; ++i) pool.push([](Desk *) {}).wait();
+    task_s = since(start) / static_cast<double>(n_tasks);
+  }
+  const double n_log_n =
+      static_cast<double>(n_samples) * std::log2(static_cast<double>(n_samples));
+  // Guard against clock resolution.
+  const double min_s = 1E-12;
+  NodeCostModel model(std::max(min_s, sort_s / n_log_n),
+                      std::max(min_s, scan_s / n_samples),
+                      std::max(min_s, task_s));
+  VLOG(1) << "Calibrated the node cost model: "
+          << model.s_per_compare * 1E9 << "ns per compare, "
+          << model.s_per_scan * 1E9 << "ns per scanned sample, "
+          << model.s_per_task * 1E6 << "us per task.";
+  return model;
+}
+
+}  // namespace forpy
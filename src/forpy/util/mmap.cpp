@@ -0,0 +1,76 @@
+#include <forpy/util/mmap.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace forpy {
+
+MappedFile::MappedFile(const std::string &filename)
+    : filename(filename), data_p(nullptr), length(0) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw ForpyException("Could not open `" + filename +
+                         "`: " + std::strerror(errno) + "!");
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    const int error = errno;
+    close(fd);
+    throw ForpyException("Could not stat `" + filename +
+                         "`: " + std::strerror(error) + "!");
+  }
+  length = static_cast<size_t>(file_stat.st_size);
+  if (length == 0) {
+    close(fd);
+    throw ForpyException("Tried to map the empty file `" + filename + "`!");
+  }
+  void *mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping keeps its own reference to the file.
+  close(fd);
+  if (mapped == MAP_FAILED)
+    throw ForpyException("Could not map `" + filename +
+                         "`: " + std::strerror(errno) + "!");
+  data_p = static_cast<const char *>(mapped);
+  VLOG(22) << "Mapped " << length << " bytes of `" << filename << "`.";
+};
+
+MappedFile::~MappedFile() {
+  if (data_p != nullptr) munmap(const_cast<char *>(data_p), length);
+};
+
+void MappedFile::advise(const EAccessPattern &pattern, const size_t &offset,
+                        const size_t &n_bytes) const {
+  if (offset >= length || n_bytes == 0) return;
+  int advice;
+  switch (pattern) {
+    case EAccessPattern::Normal:
+      advice = MADV_NORMAL;
+      break;
+    case EAccessPattern::Sequential:
+      advice = MADV_SEQUENTIAL;
+      break;
+    case EAccessPattern::Random:
+      advice = MADV_RANDOM;
+      break;
+    case EAccessPattern::WillNeed:
+      advice = MADV_WILLNEED;
+      break;
+    default:
+      throw ForpyException("Unknown access pattern.");
+  }
+  // madvise requires page aligned addresses.
+  const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const size_t start = offset / page * page;
+  const size_t end = std::min(length, offset + n_bytes);
+  // Only a hint, failures are not critical.
+  if (madvise(const_cast<char *>(data_p) + start, end - start, advice) != 0)
+    VLOG(5) << "madvise failed for `" << filename
+            << "`: " << std::strerror(errno);
+};
+
+}  // namespace forpy
@@ -0,0 +1,116 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <forpy/forest.h>
+#include <forpy/types.h>
+
+// Counts the heap allocations of a thread while an AllocationCounter exists
+// on it. The replacement applies to this test binary only (see
+// test/CMakeLists.txt), so that the other tests allocate as usual.
+namespace {
+thread_local bool count_allocations = false;
+thread_local size_t n_allocations = 0;
+
+struct AllocationCounter {
+  AllocationCounter() {
+    n_allocations = 0;
+    count_allocations = true;
+  };
+  ~AllocationCounter() { count_allocations = false; };
+  size_t get() const { return n_allocations; };
+};
+
+void *counted_alloc(size_t size) {
+  if (count_allocations) n_allocations++;
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+}  // namespace
+
+void *operator new(size_t size) { return counted_alloc(size); }
+void *operator new[](size_t size) { return counted_alloc(size); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+
+// Test objects.
+using forpy::ClassificationForest;
+using forpy::Forest;
+using forpy::Mat;
+using forpy::MatCRef;
+using forpy::RegressionForest;
+
+namespace {
+
+const size_t N_FEATURES = 8;
+
+Mat<float> random_data(const size_t &n_rows, const unsigned int &seed) {
+  std::mt19937 gen(seed);
+  std::normal_distribution<float> dist;
+  Mat<float> data(n_rows, N_FEATURES);
+  for (Eigen::Index i = 0; i < data.size(); ++i) data.data()[i] = dist(gen);
+  return data;
+};
+
+/** Checks that predict_one does not allocate after its first call. */
+void check_no_allocations(Forest *forest, const std::string &engine) {
+  const Mat<float> test_data = random_data(100, 2);
+  forest->enable_fast_prediction(engine);
+  for (const bool predict_proba : {false, true}) {
+    size_t n_cols = 0;
+    forest->predict(MatCRef<float>(test_data), 1, true, predict_proba)
+        .match([&](const auto &res) { n_cols = res.cols(); },
+               [](const forpy::Empty &) { FAIL(); });
+    std::vector<float> out(n_cols);
+    forest->predict_one(test_data.data(), out.data(), predict_proba);
+    for (Eigen::Index row = 0; row < test_data.rows(); ++row) {
+      size_t n_allocs;
+      {
+        AllocationCounter counter;
+        forest->predict_one(test_data.data() + row * N_FEATURES, out.data(),
+                            predict_proba);
+        n_allocs = counter.get();
+      }
+      EXPECT_EQ(n_allocs, 0);
+    }
+  }
+  forest->disable_fast_prediction();
+};
+
+TEST(ForestPredictOne, ClassificationAllocationFree) {
+  const Mat<float> data = random_data(1000, 1);
+  const Mat<float> data_t = data.transpose();
+  Mat<uint> annot(data.rows(), 1);
+  for (Eigen::Index i = 0; i < data.rows(); ++i)
+    annot(i, 0) = data(i, 0) + data(i, 1) > 0.f ? 4 : (data(i, 2) > 0.f ? 2 : 0);
+  ClassificationForest forest(8, 10);
+  forest.fit(MatCRef<float>(data_t), MatCRef<uint>(annot));
+  for (const std::string engine : {"tree", "bitvector"})
+    check_no_allocations(&forest, engine);
+};
+
+TEST(ForestPredictOne, RegressionAllocationFree) {
+  const Mat<float> data = random_data(1000, 1);
+  const Mat<float> data_t = data.transpose();
+  Mat<float> annot(data.rows(), 2);
+  for (Eigen::Index i = 0; i < data.rows(); ++i) {
+    annot(i, 0) = data(i, 0) * data(i, 1);
+    annot(i, 1) = data(i, 3);
+  }
+  for (const bool summarize : {false, true}) {
+    RegressionForest forest(8, 10, 1, 2, 0, false, 1, 0, 1E-7f, true,
+                            summarize);
+    forest.fit(MatCRef<float>(data_t), MatCRef<float>(annot));
+    check_no_allocations(&forest, "tree");
+  }
+};
+
+}  // namespace
@@ -0,0 +1,118 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <forpy/data_providers/data_providers.h>
+#include <forpy/deciders/deciders.h>
+#include <forpy/leafs/leafs.h>
+#include <forpy/threshold_optimizers/threshold_optimizers.h>
+#include <forpy/tree.h>
+#include <forpy/util/threading/ctpl.h>
+
+#include "./setup.h"
+
+// Test objects.
+using forpy::ECompletionLevel;
+using forpy::ESearchType;
+using forpy::Mat;
+using forpy::MatCRef;
+using forpy::Tree;
+
+namespace {
+
+template <typename T>
+Mat<T> predict(Tree *tree, const Problem &test) {
+  return tree->predict(MatCRef<float>(test.data)).get<Mat<T>>();
+};
+
+TEST(BFS, MatchesDFS) {
+  const Problem train(20000, 1), test(2000, 2);
+  auto &tc = forpy::ThreadControl::getInstance();
+  // The depth first references are trained with one thread, so that they
+  // do not depend on which thread builds a node (see HistogramCache).
+  tc.set_num(1);
+  const auto dfs = make_tree(false, 6);
+  dfs->fit_dprov(make_dprov(train, false, false, 64));
+  const auto rdfs = make_tree(true, 6);
+  rdfs->fit_dprov(make_dprov(train, true, false, 64));
+  tc.set_num(3);
+  // The level histograms hold the same sample counts as the per node
+  // histograms, so classification trees match exactly.
+  const auto bfs = make_tree(false, 6);
+  bfs->fit_dprov(make_dprov(train, false, false, 64), true, ESearchType::BFS);
+  EXPECT_EQ(dfs->get_n_nodes(), bfs->get_n_nodes());
+  EXPECT_EQ(predict<uint>(dfs.get(), test), predict<uint>(bfs.get(), test));
+  // Regression histograms only differ by rounding.
+  const auto rbfs = make_tree(true, 6);
+  rbfs->fit_dprov(make_dprov(train, true, false, 64), true, ESearchType::BFS);
+  const float mse_dfs = mse(rdfs.get(), test);
+  EXPECT_NEAR(mse(rbfs.get(), test), mse_dfs, 0.01f * mse_dfs);
+  // Without bins, nodes are optimized one by one.
+  const auto exact = make_tree(false);
+  exact->fit_dprov(make_dprov(train, false, false, 0), true, ESearchType::BFS);
+  EXPECT_EQ(predict<uint>(exact.get(), train), train.classes);
+};
+
+TEST(BFS, Stepwise) {
+  const Problem train(3000, 3);
+  forpy::ThreadControl::getInstance().set_num(1);
+  const auto dprov = make_dprov(train, false, false, 32);
+  const auto complete = make_tree(false, 12);
+  complete->fit_dprov(dprov, true, ESearchType::BFS);
+  EXPECT_THROW(complete->BFS(), forpy::ForpyException);
+  const auto levels = make_tree(false, 12);
+  levels->fit_dprov(dprov, false, ESearchType::BFS);
+  size_t n_levels = 0;
+  do {
+    EXPECT_EQ(levels->get_bfs_depth(), n_levels);
+    ++n_levels;
+  } while (!levels->BFS(ECompletionLevel::Level));
+  // Nodes at the maximum depth may be marked and become leafs.
+  EXPECT_GE(n_levels, complete->get_depth());
+  EXPECT_LE(n_levels, complete->get_depth() + 1);
+  EXPECT_TRUE(*levels == *complete);
+  const auto nodes = make_tree(false, 12);
+  nodes->fit_dprov(dprov, false, ESearchType::BFS);
+  for (size_t i = 0; i < 10; ++i)
+    EXPECT_FALSE(nodes->BFS(ECompletionLevel::Node));
+  EXPECT_TRUE(nodes->BFS(ECompletionLevel::Complete));
+  EXPECT_TRUE(*nodes == *complete);
+};
+
+TEST(BFS, IndependentOfThreads) {
+  const Problem train(5000, 4), test(1000, 5);
+  std::vector<Mat<uint>> results;
+  for (const size_t n_threads : {1, 4}) {
+    forpy::ThreadControl::getInstance().set_num(n_threads);
+    // Random candidate features.
+    const auto tree = make_tree(false, std::numeric_limits<uint>::max(), 3);
+    tree->fit_dprov(make_dprov(train, false, false, 0), true, ESearchType::BFS);
+    results.push_back(predict<uint>(tree.get(), test));
+  }
+  EXPECT_EQ(results[0], results[1]);
+};
+
+TEST(BFS, DISABLED_Speed) {
+  const Problem train(1000000, 6);
+  forpy::ThreadControl::getInstance().set_num(0);
+  for (const auto search : {ESearchType::DFS, ESearchType::BFS}) {
+    const auto tree = make_tree(false, 12);
+    const auto dprov = make_dprov(train, false, false, 255);
+    const auto start = std::chrono::steady_clock::now();
+    tree->fit_dprov(dprov, true, search);
+    std::cerr << "[          ] "
+              << (search == ESearchType::DFS ? "DFS" : "BFS") << ": "
+              << std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count()
+              << "s, " << tree->get_n_nodes() << " nodes" << std::endl;
+  }
+};
+
+}  // namespace
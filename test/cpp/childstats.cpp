@@ -0,0 +1,101 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <forpy/data_providers/data_providers.h>
+#include <forpy/deciders/deciders.h>
+#include <forpy/leafs/leafs.h>
+#include <forpy/threshold_optimizers/threshold_optimizers.h>
+#include <forpy/tree.h>
+#include <forpy/util/threading/ctpl.h>
+
+#include "./setup.h"
+
+// Test objects.
+using forpy::Data;
+using forpy::FastDProv;
+using forpy::Mat;
+using forpy::MatCRef;
+
+namespace {
+
+TEST(ChildStats, Leafs) {
+  // The leafs are made from the statistics passed on from the splits. They
+  // must match the samples that arrive at them.
+  Problem problem(4000, 1, 5, 3, 2);
+  // With an offset, the sums must be precise.
+  problem.values.col(0).array() += 100.f;
+  forpy::ThreadControl::getInstance().set_num(1);
+  for (const bool regression : {false, true})
+    for (const bool weighted : {false, true})
+      for (const size_t n_bins : {0, 32})
+        for (const uint depth : {3, 8}) {
+          const auto tree = make_tree(regression, depth);
+          tree->fit_dprov(make_dprov(problem, regression, weighted, n_bins));
+          const Data<MatCRef> data = MatCRef<float>(problem.data);
+          const Mat<uint> leafs = tree->apply(data);
+          // Per leaf: the (weighted) class sums or the annotation sums.
+          std::map<uint, std::vector<double>> sums;
+          for (Eigen::Index i = 0; i < leafs.rows(); ++i) {
+            auto &leaf_sums = sums[leafs(i, 0)];
+            leaf_sums.resize(regression ? 3 : 4, 0.);
+            if (regression) {
+              // The regression leafs do not use the weights.
+              leaf_sums[0] += problem.values(i, 0);
+              leaf_sums[1] += problem.values(i, 1);
+              leaf_sums[2] += 1.;
+            } else {
+              const double weight = weighted ? (*problem.weights)[i] : 1.;
+              leaf_sums[problem.classes(i, 0)] += weight;
+              leaf_sums[3] += weight;
+            }
+          }
+          const Mat<float> pred =
+              regression ? tree->predict(data).get<Mat<float>>()
+                         : tree->predict_proba(data).get<Mat<float>>();
+          for (Eigen::Index i = 0; i < leafs.rows(); ++i) {
+            const auto &leaf_sums = sums[leafs(i, 0)];
+            const double total = leaf_sums.back();
+            for (Eigen::Index j = 0; j < pred.cols(); ++j)
+              EXPECT_NEAR(pred(i, j), leaf_sums[j] / total,
+                          2E-6 * std::max(1., std::abs(leaf_sums[j] / total)))
+                  << "regression: " << regression << ", weighted: " << weighted
+                  << ", bins: " << n_bins << ", depth: " << depth;
+          }
+        }
+};
+
+TEST(ChildStats, PureNodes) {
+  // Pure nodes are detected from the derived statistics, also with an offset
+  // of the annotations.
+  Mat<float> data(2000, 2), values(2000, 1);
+  std::mt19937 gen(2);
+  std::normal_distribution<float> dist;
+  for (Eigen::Index i = 0; i < data.rows(); ++i) {
+    data(i, 0) = dist(gen);
+    data(i, 1) = dist(gen);
+    values(i, 0) = 10.f + (data(i, 0) > 0.3f ? 0.5f : 0.f) +
+                   (data(i, 1) > -0.2f ? 0.25f : 0.f);
+  }
+  const Mat<float> data_t = data.transpose();
+  forpy::ThreadControl::getInstance().set_num(1);
+  for (const bool weighted : {false, true}) {
+    std::shared_ptr<std::vector<float>> weights;
+    if (weighted)
+      weights = std::make_shared<std::vector<float>>(2000, 0.75f);
+    const auto tree = make_tree(true);
+    tree->fit_dprov(std::make_shared<FastDProv>(
+        Data<MatCRef>(MatCRef<float>(data_t)),
+        Data<MatCRef>(MatCRef<float>(values)), weights));
+    // Three splits, four leafs.
+    EXPECT_EQ(tree->get_n_nodes(), 7);
+    EXPECT_EQ(tree->predict(MatCRef<float>(data)).get<Mat<float>>(), values);
+  }
+};
+
+}  // namespace
@@ -0,0 +1,143 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <forpy/compiledforest.h>
+#include <forpy/forest.h>
+#include <forpy/leafs/leafs.h>
+#include <forpy/tree.h>
+
+// Test objects.
+using forpy::ClassificationForest;
+using forpy::CompiledForest;
+using forpy::CompiledTree;
+using forpy::Data;
+using forpy::Mat;
+using forpy::MatCRef;
+using forpy::RegressionForest;
+using forpy::Tree;
+
+namespace {
+
+Mat<float> random_data(const size_t &n_rows, const unsigned int &seed) {
+  std::mt19937 gen(seed);
+  std::normal_distribution<float> dist;
+  Mat<float> data(n_rows, 6);
+  for (Eigen::Index i = 0; i < data.size(); ++i) data.data()[i] = dist(gen);
+  return data;
+};
+
+/** Checks that two results have the same type and (almost) the same values. */
+void expect_same(const Data<Mat> &result_v, const Data<Mat> &expected_v) {
+  ASSERT_EQ(result_v.which(), expected_v.which());
+  result_v.match(
+      [&](const auto &result) {
+        typedef typename forpy::get_core<decltype(result.data())>::type RT;
+        const auto &expected = expected_v.get<Mat<RT>>();
+        ASSERT_EQ(result.rows(), expected.rows());
+        ASSERT_EQ(result.cols(), expected.cols());
+        for (Eigen::Index i = 0; i < result.size(); ++i) {
+          const float value = static_cast<float>(expected.data()[i]);
+          EXPECT_NEAR(static_cast<float>(result.data()[i]), value,
+                      1E-5f * (1.f + std::abs(value)));
+        }
+      },
+      [](const forpy::Empty &) { FAIL(); });
+};
+
+TEST(CompiledForest, MatchesForest) {
+  const Mat<float> data = random_data(800, 1);
+  const Mat<float> data_t = data.transpose();
+  const Mat<float> test_data = random_data(300, 2);
+  const Data<MatCRef> test_v = MatCRef<float>(test_data);
+  Mat<uint> classes(data.rows(), 1);
+  Mat<float> values(data.rows(), 2);
+  for (Eigen::Index i = 0; i < data.rows(); ++i) {
+    classes(i, 0) = data(i, 0) > 0.3f ? 3 : (data(i, 1) > 0.f ? 1 : 6);
+    values(i, 0) = data(i, 2) * data(i, 3);
+    values(i, 1) = data(i, 4);
+  }
+  ClassificationForest cforest(6, 8);
+  cforest.fit(MatCRef<float>(data_t), MatCRef<uint>(classes));
+  cforest.get_trees()[2]->set_weight(2.5f);
+  RegressionForest rforest(6, 8, 1, 2, 0, false, 1, 0, 1E-7f, true, false);
+  rforest.fit(MatCRef<float>(data_t), MatCRef<float>(values));
+  rforest.get_trees()[1]->set_weight(0.5f);
+  for (forpy::Forest *forest :
+       std::vector<forpy::Forest *>{&cforest, &rforest}) {
+    const CompiledForest compiled(*forest);
+    EXPECT_EQ(compiled.get_n_trees(), 6);
+    for (const bool predict_proba : {false, true}) {
+      SCOPED_TRACE(predict_proba);
+      expect_same(compiled.predict(test_v, predict_proba),
+                  forest->predict(test_v, 1, true, predict_proba));
+      SCOPED_TRACE("tree");
+      const CompiledTree ctree(*forest->get_trees()[0]);
+      expect_same(ctree.predict(test_v, predict_proba),
+                  forest->get_trees()[0]->predict(test_v, 1, true,
+                                                  predict_proba));
+    }
+  }
+};
+
+TEST(CompiledForest, IndependentOfOriginalLeafs) {
+  const Mat<float> data = random_data(500, 5);
+  const Mat<float> data_t = data.transpose();
+  const Mat<float> test_data = random_data(200, 6);
+  const Data<MatCRef> test_v = MatCRef<float>(test_data);
+  Mat<uint> classes(data.rows(), 1), other_classes(data.rows(), 1);
+  for (Eigen::Index i = 0; i < data.rows(); ++i) {
+    classes(i, 0) = data(i, 0) > 0.f ? 1 : 0;
+    other_classes(i, 0) = data(i, 1) > 0.f ? 1 : 0;
+  }
+  // Both trees store their leafs with the same leaf manager.
+  const auto leaf_manager = std::make_shared<forpy::ClassificationLeaf>();
+  Tree tree(10, 1, 2, nullptr, leaf_manager);
+  tree.fit(MatCRef<float>(data_t), MatCRef<uint>(classes), 1);
+  const CompiledTree compiled(tree);
+  const Data<Mat> expected = compiled.predict(test_v, true);
+  const Mat<uint> expected_classes =
+      compiled.predict(test_v).get<Mat<uint>>();
+  Tree other(10, 1, 2, nullptr, leaf_manager);
+  other.fit(MatCRef<float>(data_t), MatCRef<uint>(other_classes), 1);
+  expect_same(compiled.predict(test_v, true), expected);
+  EXPECT_EQ(compiled.predict(test_v).get<Mat<uint>>(), expected_classes);
+};
+
+TEST(CompiledForest, ConcurrentPrediction) {
+  const Mat<float> data = random_data(2000, 3);
+  const Mat<float> data_t = data.transpose();
+  Mat<uint> classes(data.rows(), 1);
+  for (Eigen::Index i = 0; i < data.rows(); ++i)
+    classes(i, 0) = data(i, 0) + data(i, 5) > 0.f ? 1 : 0;
+  ClassificationForest forest(10, 12);
+  forest.fit(MatCRef<float>(data_t), MatCRef<uint>(classes));
+  const Mat<float> test_data = random_data(500, 4);
+  const Data<MatCRef> test_v = MatCRef<float>(test_data);
+  const Mat<uint> expected = forest.predict(test_v).get<Mat<uint>>();
+  const CompiledForest compiled(forest);
+  std::vector<int> n_wrong(8, 0);
+  std::vector<std::thread> threads;
+  for (size_t thread_idx = 0; thread_idx < n_wrong.size(); ++thread_idx) {
+    threads.emplace_back([&, thread_idx]() {
+      for (size_t run = 0; run < 5; ++run) {
+        const auto result = compiled.predict(test_v).get<Mat<uint>>();
+        n_wrong[thread_idx] += (result.array() != expected.array()).count();
+        float out;
+        for (Eigen::Index row = 0; row < test_data.rows(); ++row) {
+          compiled.predict_one(test_data.data() + row * 6, &out);
+          n_wrong[thread_idx] +=
+              static_cast<uint>(out) != expected(row, 0) ? 1 : 0;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) thread.join();
+  for (const auto &wrong : n_wrong) EXPECT_EQ(wrong, 0);
+};
+
+}  // namespace
@@ -0,0 +1,112 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <limits>
+#include <iostream>
+#include <vector>
+
+#include <forpy/data_providers/data_providers.h>
+#include <forpy/deciders/deciders.h>
+#include <forpy/forest.h>
+#include <forpy/leafs/leafs.h>
+#include <forpy/threshold_optimizers/threshold_optimizers.h>
+#include <forpy/tree.h>
+#include <forpy/util/threading/ctpl.h>
+
+#include "./setup.h"
+
+// Test objects.
+using forpy::Data;
+using forpy::FastDecider;
+using forpy::Mat;
+using forpy::MatCRef;
+using forpy::Tree;
+
+namespace {
+
+/** A tree with the sort-free or the sorting optimizer and 2 features. */
+std::shared_ptr<Tree> make_extra_tree(
+    const bool &regression, const bool &extra, const size_t &n_thresholds,
+    const uint &max_depth = std::numeric_limits<uint>::max()) {
+  std::shared_ptr<forpy::IThreshOpt> opt;
+  if (regression && extra)
+    opt = std::make_shared<forpy::ExtraRegOpt>(n_thresholds);
+  else if (regression)
+    opt = std::make_shared<forpy::RegressionOpt>(n_thresholds);
+  else if (extra)
+    opt = std::make_shared<forpy::ExtraClassOpt>(n_thresholds);
+  else
+    opt = std::make_shared<forpy::FastClassOpt>(n_thresholds);
+  return make_tree(std::make_shared<FastDecider>(opt, 2), regression,
+                   max_depth);
+};
+
+TEST(ExtraTrees, MatchRandomThresholds) {
+  // The sort-free optimizer draws the same thresholds as the sorting one with
+  // n_thresholds > 0 and chooses the same splits, so the trees are the same.
+  // This only holds without weights, where the float class weights of the
+  // sorting scan are exact counts (otherwise near ties of the gains are
+  // broken differently), and up to a moderate depth, since in the tiny
+  // feature ranges of deep nodes a drawn threshold may round to a feature
+  // value, which the sorting scan skips.
+  const Problem problem(2000, 1, 5, 3, 2);
+  forpy::ThreadControl::getInstance().set_num(1);
+  for (const size_t n_thresholds : {1, 5}) {
+    std::vector<std::shared_ptr<Tree>> trees;
+    for (const bool extra : {false, true}) {
+      trees.push_back(make_extra_tree(false, extra, n_thresholds, 12));
+      trees.back()->fit_dprov(make_dprov(problem, false));
+    }
+    EXPECT_EQ(trees[0]->get_n_nodes(), trees[1]->get_n_nodes())
+        << "n_thresholds: " << n_thresholds;
+    const Data<MatCRef> data_v = MatCRef<float>(problem.data);
+    EXPECT_EQ(trees[0]->predict(data_v).get<Mat<uint>>(),
+              trees[1]->predict(data_v).get<Mat<uint>>())
+        << "n_thresholds: " << n_thresholds;
+  }
+};
+
+TEST(ExtraTrees, Forests) {
+  // The forests generalize about as well as the ones with optimal splits.
+  const Problem problem(3000, 2, 5, 3, 2);
+  const Problem test(1000, 3, 5, 3, 2);
+  forpy::ExtraTreesClassifier extra_classifier(10);
+  forpy::ClassificationForest classifier(10);
+  std::vector<float> accuracies;
+  for (forpy::Forest *forest :
+       std::vector<forpy::Forest *>{&extra_classifier, &classifier}) {
+    forest->fit(MatCRef<float>(problem.data_t), annotations(problem, false));
+    accuracies.push_back(accuracy(forest, test));
+  }
+  EXPECT_GT(accuracies[0], 0.95f * accuracies[1]);
+  forpy::ExtraTreesRegressor extra_regressor(10);
+  forpy::RegressionForest regressor(10);
+  std::vector<float> mses;
+  for (forpy::Forest *forest :
+       std::vector<forpy::Forest *>{&extra_regressor, &regressor}) {
+    forest->fit(MatCRef<float>(problem.data_t), annotations(problem, true));
+    mses.push_back(mse(forest, test));
+  }
+  EXPECT_LT(mses[0], 1.2f * mses[1]);
+};
+
+TEST(ExtraTrees, DISABLED_Speed) {
+  const Problem problem(500000, 4, 16, 3, 2);
+  forpy::ThreadControl::getInstance().set_num(1);
+  for (const bool regression : {false, true})
+    for (const bool extra : {false, true}) {
+      const auto tree = make_extra_tree(regression, extra, 1);
+      const auto dprov = make_dprov(problem, regression);
+      const auto start = std::chrono::steady_clock::now();
+      tree->fit_dprov(dprov);
+      const double seconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+      std::cerr << "[          ] " << (regression ? "regression" : "classes")
+                << (extra ? ", sort-free" : ", sorting") << ": " << seconds
+                << "s, " << tree->get_n_nodes() << " nodes" << std::endl;
+    }
+};
+
+}  // namespace
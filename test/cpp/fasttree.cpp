@@ -0,0 +1,149 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <forpy/fasttree.h>
+#include <forpy/types.h>
+
+#include "./timeit.h"
+
+// Test objects.
+using forpy::FAST_BATCH_ROWS;
+using forpy::FastTree;
+
+namespace {
+using forpy::id_t;
+
+/** A random tree with max_depth levels; node ids are assigned depth first. */
+template <typename T>
+struct RandomTree {
+  std::vector<std::pair<id_t, id_t>> tree;
+  std::vector<size_t> features;
+  std::vector<T> thresholds;
+
+  RandomTree(const size_t &max_depth, const size_t &n_features,
+             const unsigned int &seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<size_t> feat_dist(0, n_features - 1);
+    std::uniform_int_distribution<int> thresh_dist(0, 255);
+    std::uniform_real_distribution<float> stop_dist(0.f, 1.f);
+    std::vector<std::pair<id_t, size_t>> stack{{0, 0}};
+    tree.emplace_back(0, 0);
+    features.push_back(0);
+    thresholds.push_back(static_cast<T>(0));
+    while (!stack.empty()) {
+      const id_t node_id = stack.back().first;
+      const size_t depth = stack.back().second;
+      stack.pop_back();
+      if (depth == max_depth || (depth > 2 && stop_dist(gen) < 0.05f))
+        continue;
+      const id_t left = tree.size();
+      tree[node_id] = {left, left + 1};
+      features[node_id] = feat_dist(gen);
+      thresholds[node_id] = static_cast<T>(thresh_dist(gen));
+      for (size_t child = 0; child < 2; ++child) {
+        tree.emplace_back(0, 0);
+        features.push_back(0);
+        thresholds.push_back(static_cast<T>(0));
+      }
+      stack.emplace_back(left + 1, depth + 1);
+      stack.emplace_back(left, depth + 1);
+    }
+  };
+
+  FastTree<T> get_fast_tree() const {
+    return FastTree<T>(tree, features, thresholds);
+  };
+};
+
+template <typename T>
+std::vector<T> random_data(const size_t &n_rows, const size_t &n_features,
+                           const unsigned int &seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> dist(0, 255);
+  std::vector<T> data(n_rows * n_features);
+  for (auto &val : data) val = static_cast<T>(dist(gen));
+  if (std::numeric_limits<T>::has_quiet_NaN)
+    for (size_t i = 0; i < data.size(); i += 97)
+      data[i] = std::numeric_limits<T>::quiet_NaN();
+  return data;
+};
+
+template <typename T>
+class FastTreeTest : public ::testing::Test {};
+typedef ::testing::Types<float, double, uint, uint8_t> ThresholdTypes;
+TYPED_TEST_CASE(FastTreeTest, ThresholdTypes);
+
+TYPED_TEST(FastTreeTest, BatchMatchesSingleRow) {
+  const size_t n_features = 13;
+  const size_t n_rows = 3 * FAST_BATCH_ROWS + 5;
+  for (unsigned int seed = 0; seed < 5; ++seed) {
+    const auto rtree = RandomTree<TypeParam>(10, n_features, seed);
+    const FastTree<TypeParam> ftree = rtree.get_fast_tree();
+    const auto data = random_data<TypeParam>(n_rows, n_features, seed + 1);
+    std::vector<id_t> batch_ids(n_rows);
+    ftree.predict_leaf_ids(data.data(), n_features, n_rows, batch_ids.data());
+    for (size_t i = 0; i < n_rows; ++i)
+      EXPECT_EQ(ftree.predict_leaf(data.data() + i * n_features),
+                batch_ids[i]);
+  }
+};
+
+template <typename T>
+struct batch_timer : public Utility::ITimefunc {
+  batch_timer(const FastTree<T> &ftree, const std::vector<T> &data,
+              const size_t &n_features, const bool &batched)
+      : ftree(ftree),
+        data(data),
+        n_features(n_features),
+        n_rows(data.size() / n_features),
+        batched(batched),
+        ids(n_rows) {}
+  int operator()() {
+    if (batched) {
+      ftree.predict_leaf_ids(data.data(), n_features, n_rows, ids.data());
+    } else {
+      for (size_t i = 0; i < n_rows; ++i)
+        ids[i] = ftree.predict_leaf(data.data() + i * n_features);
+    }
+    return static_cast<int>(ids[n_rows / 2]);
+  }
+
+  const FastTree<T> &ftree;
+  const std::vector<T> &data;
+  size_t n_features, n_rows;
+  bool batched;
+  std::vector<id_t> ids;
+};
+
+template <typename T>
+void time_batch(const std::string &name) {
+  const size_t n_features = 32;
+  const auto rtree = RandomTree<T>(12, n_features, 1);
+  const FastTree<T> ftree = rtree.get_fast_tree();
+  const auto data = random_data<T>(100000, n_features, 2);
+  for (const bool batched : {false, true}) {
+    auto timer = batch_timer<T>(ftree, data, n_features, batched);
+    const float time_ns =
+        Utility::timeit<std::chrono::nanoseconds>(&timer, true, 3, 1);
+    std::cerr << "[          ] " << name << (batched ? " batched: " : " scalar: ")
+              << std::to_string(static_cast<double>(timer.n_rows) /
+                                time_ns * 1E9)
+              << " rows/s" << std::endl;
+  }
+};
+
+TEST(FastTreeBatch, DISABLED_Speed) {
+  time_batch<float>("float");
+  time_batch<uint8_t>("uint8");
+};
+
+}  // namespace
@@ -0,0 +1,168 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <forpy/data_providers/data_providers.h>
+#include <forpy/forest.h>
+#include <forpy/util/desk.h>
+#include <forpy/util/threading/ctpl.h>
+
+#include "./setup.h"
+
+// Test objects.
+using forpy::ClassificationForest;
+using forpy::FeatureBins;
+using forpy::HistogramCache;
+using forpy::Mat;
+using forpy::MatCRef;
+using forpy::RegressionForest;
+
+namespace {
+
+TEST(FeatureBins, CodesMatchEdges) {
+  const Problem problem(3000, 1);
+  Mat<float> low_card(problem.data_t);
+  for (Eigen::Index i = 0; i < low_card.cols(); ++i)
+    low_card(1, i) = static_cast<float>(i % 4);
+  const FeatureBins bins(MatCRef<float>(low_card), 32);
+  EXPECT_EQ(bins.get_n_bins(0), 32);
+  EXPECT_EQ(bins.get_n_bins(1), 4);
+  for (Eigen::Index feat_idx = 0; feat_idx < low_card.rows(); ++feat_idx) {
+    const uint8_t *codes = bins.get_codes(feat_idx);
+    for (Eigen::Index i = 0; i < low_card.cols(); ++i) {
+      ASSERT_LT(codes[i], bins.get_n_bins(feat_idx));
+      for (size_t bin = 0; bin + 1 < bins.get_n_bins(feat_idx); ++bin)
+        EXPECT_EQ(low_card(feat_idx, i) <= bins.get_edge(feat_idx, bin),
+                  codes[i] <= bin);
+    }
+  }
+  EXPECT_THROW(FeatureBins(MatCRef<float>(low_card), 257),
+               forpy::ForpyException);
+};
+
+TEST(HistogramCache, DerivesSecondChildren) {
+  // Builds a complete tree depth first over random bin codes, with the left
+  // child processed first as in Tree::fit. Every right child must be derived.
+  const size_t n_bins = 16, max_depth = 6;
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<size_t> code_dist(0, n_bins - 1);
+  std::bernoulli_distribution side_dist;
+  struct Node {
+    forpy::id_t id;
+    size_t depth;
+    std::vector<size_t> codes;
+    bool is_right;
+  };
+  Node root{0, 0, std::vector<size_t>(1 << 12), false};
+  for (auto &code : root.codes) code = code_dist(gen);
+  HistogramCache cache;
+  forpy::id_t next_id = 1;
+  size_t n_right = 0;
+  std::vector<Node> marks{root};
+  while (!marks.empty()) {
+    const Node node = std::move(marks.back());
+    marks.pop_back();
+    std::vector<double> expected(n_bins, 0.);
+    for (const auto &code : node.codes) expected[code] += 1.;
+    for (size_t feat_idx = 0; feat_idx < 2; ++feat_idx) {
+      bool derived;
+      double *hist =
+          cache.get(node.id, node.codes.size(), feat_idx, n_bins, &derived);
+      if (!derived)
+        for (const auto &code : node.codes) hist[code] += 1.;
+      EXPECT_EQ(derived, node.is_right) << "node " << node.id;
+      for (size_t bin = 0; bin < n_bins; ++bin)
+        EXPECT_EQ(hist[bin], expected[bin]);
+    }
+    if (node.is_right) ++n_right;
+    if (node.depth == max_depth) continue;
+    Node left{next_id++, node.depth + 1, {}, false};
+    Node right{next_id++, node.depth + 1, {}, true};
+    for (const auto &code : node.codes)
+      (side_dist(gen) ? left : right).codes.push_back(code);
+    cache.add_children(node.id, left.id, right.id);
+    marks.push_back(std::move(right));
+    marks.push_back(std::move(left));
+  }
+  EXPECT_EQ(n_right, (1u << max_depth) - 1);
+  EXPECT_EQ(cache.n_derived, 2 * n_right);
+  // Only the histograms of right leafs stay, which are evicted first.
+  for (const auto &entry : cache.entries) {
+    if (!entry.second.hists.empty()) {
+      EXPECT_TRUE(entry.second.finished());
+    }
+  }
+};
+
+TEST(HistogramSplits, MatchesExactQuality) {
+  const Problem train(6000, 2), test(2000, 3);
+  ClassificationForest cexact(8), chist(8);
+  cexact.fit_dprov(make_dprov(train, false, false, 0));
+  chist.fit_dprov(make_dprov(train, false, false, 255));
+  EXPECT_NEAR(accuracy(&chist, test), accuracy(&cexact, test), 0.02f);
+  // The bins hold at least n / n_bins samples, so unlike the exact
+  // optimization the histograms can not split off a few extreme samples.
+  // With deep trees, this may make them generalize slightly better.
+  RegressionForest rexact(8), rhist(8);
+  rexact.fit_dprov(make_dprov(train, true, false, 0));
+  rhist.fit_dprov(make_dprov(train, true, false, 255));
+  const float mse_exact = mse(&rexact, test);
+  EXPECT_NEAR(mse(&rhist, test), mse_exact, 0.1f * mse_exact);
+};
+
+TEST(HistogramSplits, IndependentOfScheduling) {
+  const Problem train(20000, 4), test(2000, 5);
+  auto &tc = forpy::ThreadControl::getInstance();
+  tc.set_num(1);
+  const auto serial = make_tree(false, 12, 2);
+  serial->fit_dprov(make_dprov(train, false, false, 64));
+  const Mat<uint> expected =
+      serial->predict(MatCRef<float>(test.data)).get<Mat<uint>>();
+  const auto rserial = make_tree(true, 12, 2);
+  rserial->fit_dprov(make_dprov(train, true, false, 64));
+  const float mse_serial = mse(rserial.get(), test);
+  tc.set_num(3);
+  for (size_t run = 0; run < 3; ++run) {
+    // Unweighted class counts are exact, so it does not matter whether the
+    // histograms of a node are derived or computed by another thread.
+    const auto tree = make_tree(false, 12, 2);
+    tree->fit_dprov(make_dprov(train, false, false, 64));
+    EXPECT_EQ(tree->get_n_nodes(), serial->get_n_nodes());
+    EXPECT_EQ(tree->predict(MatCRef<float>(test.data)).get<Mat<uint>>(),
+              expected);
+    // Regression histograms only differ by rounding.
+    const auto rtree = make_tree(true, 12, 2);
+    rtree->fit_dprov(make_dprov(train, true, false, 64));
+    EXPECT_NEAR(mse(rtree.get(), test), mse_serial, 0.01f * mse_serial);
+  }
+};
+
+TEST(HistogramSplits, DISABLED_Speed) {
+  const Problem train(200000, 4), test(20000, 5);
+  for (const bool regression : {false, true}) {
+    for (const size_t n_bins : {0, 255}) {
+      const auto forest = make_forest(regression, 4, 20);
+      const auto dprov = make_dprov(train, regression, false, n_bins);
+      const auto start = std::chrono::steady_clock::now();
+      forest->fit_dprov(dprov);
+      const double seconds =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                        start)
+              .count();
+      std::cerr << "[          ] "
+                << (regression ? "regression" : "classification")
+                << (n_bins == 0 ? " exact" : " histogram") << ": " << seconds
+                << "s, " << (regression ? "mse " : "accuracy ")
+                << (regression ? mse(forest.get(), test)
+                               : accuracy(forest.get(), test))
+                << std::endl;
+    }
+  }
+};
+
+}  // namespace
@@ -0,0 +1,117 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include <forpy/data_providers/data_providers.h>
+#include <forpy/deciders/deciders.h>
+#include <forpy/leafs/leafs.h>
+#include <forpy/threshold_optimizers/threshold_optimizers.h>
+#include <forpy/tree.h>
+#include <forpy/util/threading/ctpl.h>
+
+#include "./setup.h"
+
+// Test objects.
+
+namespace {
+
+/**
+ * The per sample statistics: one-hot weighted classes or weighted targets,
+ * each followed by the weight.
+ */
+std::vector<std::vector<double>> sample_stats(const Problem &problem,
+                                              const bool &regression,
+                                              const size_t &n_classes,
+                                              const bool &weighted) {
+  std::vector<std::vector<double>> stats(problem.data.rows());
+  for (Eigen::Index i = 0; i < problem.data.rows(); ++i) {
+    const double weight = weighted ? (*problem.weights)[i] : 1.;
+    if (regression) {
+      for (Eigen::Index j = 0; j < problem.values.cols(); ++j)
+        stats[i].push_back(weight * problem.values(i, j));
+    } else {
+      stats[i].assign(n_classes, 0.);
+      stats[i][problem.classes(i, 0)] = weight;
+    }
+    stats[i].push_back(weight);
+  }
+  return stats;
+};
+
+/// sum_l^2 / w_l + sum_r^2 / w_r in double precision.
+double proxy(const std::vector<double> &left, const std::vector<double> &full) {
+  const size_t dim = full.size() - 1;
+  double left_sq = 0., right_sq = 0.;
+  for (size_t j = 0; j < dim; ++j) {
+    left_sq += left[j] * left[j];
+    right_sq += (full[j] - left[j]) * (full[j] - left[j]);
+  }
+  return left_sq / left[dim] + right_sq / (full[dim] - left[dim]);
+};
+
+/**
+ * The best gain of all splits of all features and the gain of the split
+ * `feature <= thresh` by brute force (unnormalized, see proxy).
+ */
+std::pair<double, double> brute_force(
+    const Problem &problem, const std::vector<std::vector<double>> &stats,
+    const size_t &feature, const float &thresh) {
+  const size_t n = stats.size(), stride = stats[0].size();
+  std::vector<double> full(stride, 0.);
+  for (const auto &sample : stats)
+    for (size_t j = 0; j < stride; ++j) full[j] += sample[j];
+  double full_sq = 0.;
+  for (size_t j = 0; j + 1 < stride; ++j) full_sq += full[j] * full[j];
+  const double full_proxy = full_sq / full[stride - 1];
+  double best = std::numeric_limits<double>::lowest(), chosen = best;
+  for (Eigen::Index f = 0; f < problem.data.cols(); ++f) {
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return problem.data(a, f) < problem.data(b, f);
+    });
+    std::vector<double> left(stride, 0.);
+    for (size_t i = 0; i + 1 < n; ++i) {
+      for (size_t j = 0; j < stride; ++j) left[j] += stats[order[i]][j];
+      const float val = problem.data(order[i], f);
+      if (problem.data(order[i + 1], f) <= val) continue;
+      const double current = proxy(left, full) - full_proxy;
+      best = std::max(best, current);
+      if (static_cast<size_t>(f) == feature && val <= thresh &&
+          problem.data(order[i + 1], f) > thresh)
+        chosen = current;
+    }
+  }
+  return std::make_pair(best, chosen);
+};
+
+TEST(Incremental, RootSplits) {
+  // The root splits found with the incrementally tracked impurities must be
+  // optimal up to the float precision of the gains.
+  forpy::ThreadControl::getInstance().set_num(1);
+  const size_t n_classes = 40, annot_dim = 16;
+  Problem problem(6000, 1, 4, n_classes, annot_dim);
+  // The offset makes cancellation in the impurities visible.
+  problem.values.array() += 50.f;
+  for (const bool regression : {false, true})
+    for (const bool weighted : {false, true}) {
+      const auto tree = make_tree(regression, 1);
+      tree->fit_dprov(make_dprov(problem, regression, weighted));
+      ASSERT_EQ(tree->get_n_nodes(), 3);
+      const auto maps = tree->get_decider()->get_maps();
+      const size_t feature = maps.first->at(0);
+      const float thresh = maps.second->get<std::vector<float>>().at(0);
+      const auto gains = brute_force(
+          problem, sample_stats(problem, regression, n_classes, weighted),
+          feature, thresh);
+      EXPECT_NEAR(gains.second, gains.first, 1E-5 * gains.first)
+          << "regression: " << regression << ", weighted: " << weighted;
+    }
+};
+
+}  // namespace
@@ -0,0 +1,176 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include <forpy/data_providers/data_providers.h>
+#include <forpy/deciders/deciders.h>
+#include <forpy/leafs/leafs.h>
+#include <forpy/threshold_optimizers/threshold_optimizers.h>
+#include <forpy/tree.h>
+#include <forpy/util/threading/ctpl.h>
+
+#include "./setup.h"
+#include "./timeit.h"
+
+// Test objects.
+using forpy::FastDProv;
+
+namespace {
+
+/**
+ * The best gain of all splits of all features and the gain of the split
+ * `feature <= thresh` by brute force, in double precision and unnormalized:
+ * sum_l^2 / w_l + sum_r^2 / w_r - sum^2 / w.
+ */
+std::pair<double, double> brute_force(const Problem &problem,
+                                      const bool &regression,
+                                      const size_t &n_classes,
+                                      const bool &weighted,
+                                      const size_t &feature,
+                                      const float &thresh) {
+  const size_t n = problem.data.rows();
+  const size_t dim = regression ? problem.values.cols() : n_classes;
+  std::vector<std::vector<double>> stats(n, std::vector<double>(dim + 1, 0.));
+  std::vector<double> full(dim + 1, 0.);
+  for (size_t i = 0; i < n; ++i) {
+    const double weight = weighted ? (*problem.weights)[i] : 1.;
+    if (regression)
+      for (size_t j = 0; j < dim; ++j)
+        stats[i][j] = weight * problem.values(i, j);
+    else
+      stats[i][problem.classes(i, 0)] = weight;
+    stats[i][dim] = weight;
+    for (size_t j = 0; j <= dim; ++j) full[j] += stats[i][j];
+  }
+  const auto proxy = [&](const std::vector<double> &left) {
+    double left_sq = 0., right_sq = 0.;
+    for (size_t j = 0; j < dim; ++j) {
+      left_sq += left[j] * left[j];
+      right_sq += (full[j] - left[j]) * (full[j] - left[j]);
+    }
+    return left_sq / left[dim] + right_sq / (full[dim] - left[dim]);
+  };
+  double full_sq = 0.;
+  for (size_t j = 0; j < dim; ++j) full_sq += full[j] * full[j];
+  double best = std::numeric_limits<double>::lowest(), chosen = best;
+  for (Eigen::Index f = 0; f < problem.data.cols(); ++f) {
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return problem.data(a, f) < problem.data(b, f);
+    });
+    std::vector<double> left(dim + 1, 0.);
+    for (size_t i = 0; i + 1 < n; ++i) {
+      for (size_t j = 0; j <= dim; ++j) left[j] += stats[order[i]][j];
+      const float val = problem.data(order[i], f);
+      if (problem.data(order[i + 1], f) <= val) continue;
+      const double current = proxy(left) - full_sq / full[dim];
+      best = std::max(best, current);
+      if (static_cast<size_t>(f) == feature && val <= thresh &&
+          problem.data(order[i + 1], f) > thresh)
+        chosen = current;
+    }
+  }
+  return std::make_pair(best, chosen);
+};
+
+TEST(Kernels, MatchBruteForce) {
+  // Every specialized kernel and the generic ones next to them find the best
+  // root split up to the float precision of the gains.
+  forpy::ThreadControl::getInstance().set_num(1);
+  for (const bool regression : {false, true})
+    for (const size_t dim : {1, 2, 3, 4, 5, 8, 9}) {
+      if (!regression && dim == 1) continue;
+      const Problem problem(3000, dim, 3, regression ? 2 : dim,
+                            regression ? dim : 1);
+      for (const bool weighted : {false, true}) {
+        const auto tree = make_tree(regression, 1);
+        tree->fit_dprov(make_dprov(problem, regression, weighted));
+        ASSERT_EQ(tree->get_n_nodes(), 3);
+        const auto maps = tree->get_decider()->get_maps();
+        const auto gains = brute_force(
+            problem, regression, dim, weighted, maps.first->at(0),
+            maps.second->get<std::vector<float>>().at(0));
+        EXPECT_NEAR(gains.second, gains.first, 1E-4 * gains.first)
+            << "regression: " << regression << ", dim: " << dim
+            << ", weighted: " << weighted;
+      }
+    }
+};
+
+/** Scans one presorted feature of all samples (see IThreshOpt::optimize). */
+struct scan_timer : public Utility::ITimefunc {
+  scan_timer(const std::shared_ptr<forpy::IThreshOpt> &opt,
+             const std::shared_ptr<FastDProv> &dprov, const Problem &problem)
+      : opt(opt), dprov(dprov), desk(0), ids(problem.data.rows()) {
+    std::iota(ids.begin(), ids.end(), 0);
+    std::sort(ids.begin(), ids.end(), [&](size_t a, size_t b) {
+      return problem.data(a, 0) < problem.data(b, 0);
+    });
+    opt->check_annotations(dprov.get());
+    desk.setup(nullptr, nullptr, nullptr);
+    desk.d.n_samples = ids.size();
+    desk.d.input_dim = dprov->get_feat_vec_dim();
+    desk.d.annot_dim = dprov->get_annot_vec_dim();
+    desk.d.min_samples_at_leaf = 1;
+    desk.d.elem_id_p = &ids[0];
+    desk.d.node_id = 0;
+    desk.d.start_id = 0;
+    desk.d.end_id = ids.size();
+    desk.d.feat_idx = 0;
+    opt->full_entropy(*dprov, &desk);
+    desk.d.need_sort = false;
+    desk.d.presorted = true;
+    dprov->get_feature(0).match(
+        [&](const auto &feat_dta) { desk.d.full_feat_p_v = feat_dta.data(); });
+  }
+  int operator()() {
+    desk.d.opt_res_v.match([](auto &opt_res) {
+      opt_res.gain = 0.f;
+      opt_res.valid = false;
+    });
+    opt->optimize(&desk);
+    int split_idx = 0;
+    desk.d.opt_res_v.match(
+        [&](const auto &opt_res) { split_idx = opt_res.split_idx; });
+    return split_idx;
+  }
+
+  std::shared_ptr<forpy::IThreshOpt> opt;
+  std::shared_ptr<FastDProv> dprov;
+  forpy::Desk desk;
+  std::vector<forpy::id_t> ids;
+};
+
+TEST(Kernels, DISABLED_Speed) {
+  for (const bool regression : {false, true})
+    for (const size_t dim : {2, 3, 4, 5, 8}) {
+      const Problem problem(4000, 1, 2, regression ? 2 : dim,
+                            regression ? dim : 1);
+      for (const bool weighted : {false, true}) {
+        std::shared_ptr<forpy::IThreshOpt> opt;
+        if (regression)
+          opt = std::make_shared<forpy::RegressionOpt>();
+        else
+          opt = std::make_shared<forpy::FastClassOpt>();
+        scan_timer timer(opt, make_dprov(problem, regression, weighted),
+                         problem);
+        const float time_ns =
+            Utility::timeit<std::chrono::nanoseconds>(&timer, true, 3, 1);
+        std::cerr << "[          ] "
+                  << (regression ? "annotation dim " : "classes ") << dim
+                  << (weighted ? ", weighted" : "") << ": "
+                  << time_ns / problem.data.rows() << "ns per sample"
+                  << std::endl;
+      }
+    }
+};
+
+}  // namespace
@@ -0,0 +1,92 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <iostream>
+#include <limits>
+
+#include <forpy/data_providers/data_providers.h>
+#include <forpy/deciders/deciders.h>
+#include <forpy/leafs/leafs.h>
+#include <forpy/threshold_optimizers/threshold_optimizers.h>
+#include <forpy/tree.h>
+#include <forpy/util/threading/ctpl.h>
+
+#include "./setup.h"
+
+// Test objects.
+using forpy::Mat;
+using forpy::MatCRef;
+using forpy::Tree;
+
+namespace {
+
+/** A tree that trains the subtrees below local_copy_samples on copies. */
+std::shared_ptr<Tree> make_local_tree(const size_t &local_copy_samples,
+                                      const bool &regression,
+                                      const size_t &n_valid_features = 0,
+                                      const bool &presort = false) {
+  const auto tree = make_tree(regression, std::numeric_limits<uint>::max(),
+                              n_valid_features, presort);
+  tree->set_local_copy_samples(local_copy_samples);
+  return tree;
+};
+
+TEST(LocalCopy, MatchesGlobal) {
+  const Problem train(5000, 1, 8);
+  forpy::ThreadControl::getInstance().set_num(1);
+  for (const bool regression : {false, true})
+    for (const bool weighted : {false, true})
+      for (const size_t n_bins : {0, 32}) {
+        // Random candidate features, so that the features must be drawn in
+        // the same order, too.
+        const auto global = make_local_tree(0, regression, 3);
+        global->fit_dprov(make_dprov(train, regression, weighted, n_bins));
+        const auto local = make_local_tree(700, regression, 3);
+        EXPECT_EQ(local->get_local_copy_samples(), 700);
+        local->fit_dprov(make_dprov(train, regression, weighted, n_bins));
+        EXPECT_TRUE(*global == *local)
+            << "regression: " << regression << ", weighted: " << weighted
+            << ", bins: " << n_bins;
+      }
+  // The copy may cover the entire tree.
+  const auto global = make_local_tree(0, false);
+  global->fit_dprov(make_dprov(train, false, false, 0));
+  const auto local = make_local_tree(5000, false);
+  local->fit_dprov(make_dprov(train, false, false, 0));
+  EXPECT_TRUE(*global == *local);
+};
+
+TEST(LocalCopy, Threaded) {
+  const Problem train(20000, 2, 8);
+  forpy::ThreadControl::getInstance().set_num(4);
+  const auto tree = make_local_tree(1000, false);
+  tree->fit_dprov(make_dprov(train, false, false, 0));
+  EXPECT_EQ(tree->predict(MatCRef<float>(train.data)).get<Mat<uint>>(),
+            train.classes);
+  // Presorted deciders use global ids and ignore the setting.
+  const auto presorted = make_local_tree(1000, false, 0, true);
+  presorted->fit_dprov(make_dprov(train, false, false, 0));
+  EXPECT_EQ(presorted->predict(MatCRef<float>(train.data)).get<Mat<uint>>(),
+            train.classes);
+};
+
+TEST(LocalCopy, DISABLED_Speed) {
+  // 80MB of features, more than the last level cache.
+  const Problem train(2000000, 3, 10);
+  forpy::ThreadControl::getInstance().set_num(1);
+  for (const size_t local_copy_samples : {0, 100000}) {
+    const auto tree = make_local_tree(local_copy_samples, false, 3);
+    const auto dprov = make_dprov(train, false, false, 0);
+    const auto start = std::chrono::steady_clock::now();
+    tree->fit_dprov(dprov);
+    std::cerr << "[          ] local copies below " << local_copy_samples
+              << " samples: "
+              << std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count()
+              << "s, " << tree->get_n_nodes() << " nodes" << std::endl;
+  }
+};
+
+}  // namespace
@@ -0,0 +1,180 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <forpy/data_providers/data_providers.h>
+#include <forpy/deciders/deciders.h>
+#include <forpy/leafs/leafs.h>
+#include <forpy/threshold_optimizers/threshold_optimizers.h>
+#include <forpy/tree.h>
+#include <forpy/util/threading/ctpl.h>
+
+#include "./setup.h"
+
+// Test objects.
+using forpy::Data;
+using forpy::EAccessPattern;
+using forpy::Mat;
+using forpy::MatCRef;
+using forpy::MMapDProv;
+using forpy::VecCMap;
+
+namespace {
+
+/** A file in the working directory that is removed at the end of the test. */
+struct TempFile {
+  std::string name;
+  explicit TempFile(const std::string &suffix)
+      : name(std::string("forpy_mmapdprov_") +
+             testing::UnitTest::GetInstance()->current_test_info()->name() +
+             suffix){};
+  ~TempFile() { std::remove(name.c_str()); };
+};
+
+template <typename T>
+void write_raw(const std::string &filename, const Mat<T> &values,
+               const std::string &prefix = "") {
+  std::ofstream out(filename, std::ios::binary);
+  out << prefix;
+  out.write(reinterpret_cast<const char *>(values.data()),
+            values.size() * sizeof(T));
+};
+
+/** Writes a (version 1) `.npy` file. */
+void write_npy(const std::string &filename, const Mat<float> &values,
+               const bool &fortran_order = false) {
+  const std::string shape =
+      fortran_order ? std::to_string(values.cols()) + ", " +
+                          std::to_string(values.rows())
+                    : std::to_string(values.rows()) + ", " +
+                          std::to_string(values.cols());
+  std::string header = "{'descr': '<f4', 'fortran_order': " +
+                       std::string(fortran_order ? "True" : "False") +
+                       ", 'shape': (" + shape + "), }";
+  while ((10 + header.size() + 1) % 64 != 0) header += ' ';
+  header += '\n';
+  std::string prefix("\x93NUMPY\x01\x00", 8);
+  prefix += static_cast<char>(header.size() & 0xFF);
+  prefix += static_cast<char>(header.size() >> 8);
+  write_raw(filename, values, prefix + header);
+};
+
+TEST(MMapDProv, Npy) {
+  const Problem problem(500, 1, 4);
+  const Data<MatCRef> annotations = MatCRef<uint>(problem.classes);
+  for (const bool fortran_order : {false, true}) {
+    TempFile file(".npy");
+    write_npy(file.name, problem.data_t, fortran_order);
+    MMapDProv dprov(file.name, annotations, nullptr);
+    EXPECT_EQ(dprov.get_feat_vec_dim(), 4);
+    EXPECT_EQ(dprov.get_annot_vec_dim(), 1);
+    EXPECT_EQ(dprov.get_n_samples(), 500);
+    for (size_t feat_idx = 0; feat_idx < 4; ++feat_idx) {
+      const auto &feat = dprov.get_feature(feat_idx).get<VecCMap<float>>();
+      EXPECT_EQ(feat, problem.data_t.row(feat_idx));
+    }
+    dprov.advise(EAccessPattern::Random);
+    dprov.advise(EAccessPattern::WillNeed, 3);
+    EXPECT_THROW(dprov.advise(EAccessPattern::Normal, 4),
+                 forpy::ForpyException);
+  }
+};
+
+TEST(MMapDProv, NpySize) {
+  // The values must match the shape in the header.
+  const Problem problem(500, 1, 4);
+  const Data<MatCRef> annotations = MatCRef<uint>(problem.classes);
+  TempFile file(".npy");
+  write_npy(file.name, problem.data_t);
+  std::string contents;
+  {
+    std::ifstream in(file.name, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+  }
+  const size_t row_size = 4 * sizeof(float);
+  for (const auto &changed :
+       {contents.substr(0, contents.size() - row_size),
+        contents.substr(0, contents.size() - row_size / 2),
+        contents + std::string(row_size, '\0')}) {
+    std::ofstream(file.name, std::ios::binary) << changed;
+    try {
+      MMapDProv(file.name, annotations, nullptr);
+      ADD_FAILURE() << "Accepted a file of " << changed.size() << " bytes.";
+    } catch (const forpy::ForpyException &ex) {
+      EXPECT_NE(std::string(ex.what()).find("header"), std::string::npos)
+          << ex.what();
+    }
+  }
+};
+
+TEST(MMapDProv, Raw) {
+  const Problem problem(300, 1, 3);
+  const Data<MatCRef> annotations = MatCRef<uint>(problem.classes);
+  TempFile file(".raw");
+  const Mat<double> values = problem.data_t.cast<double>();
+  write_raw(file.name, values, std::string(16, 'x'));
+  MMapDProv dprov(file.name, "float64", 3, annotations, nullptr, 0, 16);
+  EXPECT_EQ(dprov.get_n_samples(), 300);
+  EXPECT_EQ(dprov.get_feature(2).get<VecCMap<double>>(), values.row(2));
+  // The sizes must fit.
+  EXPECT_THROW(MMapDProv(file.name, "float64", 3, annotations, nullptr),
+               forpy::ForpyException);
+  EXPECT_THROW(MMapDProv(file.name, "float64", 4, annotations, nullptr, 0, 16),
+               forpy::ForpyException);
+  EXPECT_THROW(MMapDProv(file.name, "float64", 2, annotations, nullptr, 0, 16),
+               forpy::ForpyException);
+  EXPECT_THROW(MMapDProv(file.name, "int16", 3, annotations, nullptr, 0, 16),
+               forpy::ForpyException);
+  EXPECT_THROW(MMapDProv(file.name, annotations, nullptr),
+               forpy::ForpyException);
+  EXPECT_THROW(MMapDProv(file.name + ".missing", annotations, nullptr),
+               forpy::ForpyException);
+  const auto weights = std::make_shared<std::vector<float>>(10, 1.f);
+  EXPECT_THROW(MMapDProv(file.name, "float64", 3, annotations, weights, 0, 16),
+               forpy::ForpyException);
+};
+
+TEST(MMapDProv, TreeProviders) {
+  const Problem problem(200, 1, 2);
+  const Data<MatCRef> annotations = MatCRef<uint>(problem.classes);
+  TempFile file(".npy");
+  write_npy(file.name, problem.data_t);
+  MMapDProv dprov(file.name, annotations, nullptr, 16);
+  forpy::usage_map_t usage_map;
+  usage_map.push_back({std::make_shared<std::vector<forpy::id_t>>(
+                           std::vector<forpy::id_t>{1, 5, 7}),
+                       nullptr});
+  const auto providers = dprov.create_tree_providers(usage_map);
+  ASSERT_EQ(providers.size(), 1);
+  EXPECT_EQ(providers[0]->get_n_samples(), 3);
+  EXPECT_EQ(providers[0]->get_feature_bins(), dprov.get_feature_bins());
+  // The mapping is shared, not copied.
+  EXPECT_EQ(providers[0]->get_feature(1).get<VecCMap<float>>().data(),
+            dprov.get_feature(1).get<VecCMap<float>>().data());
+  usage_map[0].first->push_back(200);
+  EXPECT_THROW(dprov.create_tree_providers(usage_map), forpy::ForpyException);
+};
+
+TEST(MMapDProv, MatchesFastDProv) {
+  const Problem problem(3000, 1, 5);
+  const Data<MatCRef> annotations = MatCRef<uint>(problem.classes);
+  TempFile file(".npy");
+  write_npy(file.name, problem.data_t);
+  forpy::ThreadControl::getInstance().set_num(1);
+  for (const size_t n_bins : {0, 32}) {
+    const auto in_memory = make_tree(false);
+    in_memory->fit_dprov(make_dprov(problem, false, false, n_bins));
+    const auto mapped = make_tree(false);
+    mapped->fit_dprov(
+        std::make_shared<MMapDProv>(file.name, annotations, nullptr, n_bins));
+    EXPECT_TRUE(*in_memory == *mapped) << "bins: " << n_bins;
+  }
+};
+
+}  // namespace
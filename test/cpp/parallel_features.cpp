@@ -0,0 +1,79 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <forpy/deciders/deciders.h>
+#include <forpy/leafs/leafs.h>
+#include <forpy/threshold_optimizers/threshold_optimizers.h>
+#include <forpy/tree.h>
+
+#include "./setup.h"
+
+// Test objects.
+using forpy::MatCRef;
+using forpy::Tree;
+
+namespace {
+
+/**
+ * The shared problem with 600 features. The feature that the targets depend
+ * on most is moved from the first position to the middle.
+ */
+const Eigen::Index IMPORTANT_FEATURE = 307;
+Problem wide_problem(const size_t &n_rows, const unsigned int &seed,
+                     const size_t &n_features) {
+  Problem problem(n_rows, seed, n_features);
+  problem.data.col(0).swap(problem.data.col(IMPORTANT_FEATURE));
+  problem.data_t = problem.data.transpose();
+  return problem;
+};
+
+std::shared_ptr<Tree> fit_tree(const Problem &problem, const uint &max_depth,
+                               const bool &regression, const bool &presort,
+                               const size_t &n_threads) {
+  const auto tree = make_tree(regression, max_depth, 0, presort);
+  tree->fit(MatCRef<float>(problem.data_t), annotations(problem, regression),
+            n_threads);
+  return tree;
+};
+
+TEST(ParallelFeatures, MatchesSerial) {
+  // 2000 samples * 600 features exceed FASTDECIDER_PARALLEL_MIN_WORK.
+  const Problem train(wide_problem(2000, 1, 600));
+  for (const bool regression : {false, true}) {
+    for (const bool presort : {false, true}) {
+      // Only the root is optimized, so the tree can not depend on the
+      // scheduling of child nodes.
+      const auto serial = fit_tree(train, 1, regression, presort, 1);
+      const auto parallel = fit_tree(train, 1, regression, presort, 4);
+      EXPECT_EQ(*serial->get_decider(), *parallel->get_decider());
+      EXPECT_EQ(serial->get_decider()->get_maps().first->at(0),
+                IMPORTANT_FEATURE);
+    }
+  }
+  // Deeper trees work as well.
+  const auto tree = fit_tree(train, 8, false, false, 4);
+  EXPECT_GT(tree->get_n_nodes(), 3);
+};
+
+TEST(ParallelFeatures, DISABLED_Speed) {
+  const Problem train(wide_problem(10000, 2, 2000));
+  for (const size_t n_threads : {size_t(1), size_t(0)}) {
+    const auto start = std::chrono::steady_clock::now();
+    fit_tree(train, 1, false, false, n_threads);
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+    std::cerr << "[          ] root split with "
+              << (n_threads == 0 ? std::thread::hardware_concurrency()
+                                 : n_threads)
+              << " thread(s): " << seconds << "s" << std::endl;
+  }
+};
+
+}  // namespace
@@ -0,0 +1,149 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <forpy/forest.h>
+#include <forpy/types.h>
+
+// Test objects.
+using forpy::ClassificationForest;
+using forpy::Data;
+using forpy::Forest;
+using forpy::Mat;
+using forpy::MatCRef;
+using forpy::RegressionForest;
+
+namespace {
+
+const size_t N_FEATURES = 8;
+
+Mat<float> random_data(const size_t &n_rows, const unsigned int &seed) {
+  std::mt19937 gen(seed);
+  std::normal_distribution<float> dist;
+  Mat<float> data(n_rows, N_FEATURES);
+  for (Eigen::Index i = 0; i < data.size(); ++i) data.data()[i] = dist(gen);
+  return data;
+};
+
+void fit_classification(Forest *forest) {
+  const Mat<float> data = random_data(1000, 1);
+  const Mat<float> data_t = data.transpose();
+  Mat<uint> annot(data.rows(), 1);
+  for (Eigen::Index i = 0; i < data.rows(); ++i)
+    annot(i, 0) = data(i, 0) + data(i, 1) > 0.f ? 4 : (data(i, 2) > 0.f ? 2 : 0);
+  forest->fit(MatCRef<float>(data_t), MatCRef<uint>(annot));
+};
+
+void fit_regression(Forest *forest) {
+  const Mat<float> data = random_data(1000, 1);
+  const Mat<float> data_t = data.transpose();
+  Mat<float> annot(data.rows(), 2);
+  for (Eigen::Index i = 0; i < data.rows(); ++i) {
+    annot(i, 0) = data(i, 0) * data(i, 1);
+    annot(i, 1) = data(i, 3);
+  }
+  forest->fit(MatCRef<float>(data_t), MatCRef<float>(annot));
+};
+
+/** Compares predict_one with predict. */
+void check_predict_one(Forest *forest, const bool &predict_proba,
+                       const std::string &engine) {
+  const Mat<float> test_data = random_data(100, 2);
+  forest->enable_fast_prediction(engine);
+  Mat<float> expected;
+  forest->predict(MatCRef<float>(test_data), 1, true, predict_proba)
+      .match([&](const auto &res) { expected = res.template cast<float>(); },
+             [](const forpy::Empty &) { FAIL(); });
+  std::vector<float> out(expected.cols());
+  for (Eigen::Index row = 0; row < test_data.rows(); ++row) {
+    forest->predict_one(test_data.data() + row * N_FEATURES, out.data(),
+                        predict_proba);
+    for (Eigen::Index col = 0; col < expected.cols(); ++col)
+      EXPECT_NEAR(out[col], expected(row, col),
+                  1E-5f * (1.f + std::abs(expected(row, col))));
+  }
+  forest->disable_fast_prediction();
+};
+
+TEST(ForestPredictOne, ClassificationMatchesPredict) {
+  ClassificationForest forest(8, 10);
+  fit_classification(&forest);
+  for (const std::string engine : {"tree", "bitvector"}) {
+    check_predict_one(&forest, false, engine);
+    check_predict_one(&forest, true, engine);
+  }
+  std::vector<float> out(1);
+  EXPECT_THROW(forest.predict_one(out.data(), out.data()),
+               forpy::ForpyException);
+};
+
+TEST(ForestPredictOne, RegressionMatchesPredict) {
+  for (const bool summarize : {false, true}) {
+    RegressionForest sforest(8, 10, 1, 2, 0, false, 1, 0, 1E-7f, true,
+                             summarize);
+    fit_regression(&sforest);
+    check_predict_one(&sforest, false, "tree");
+    check_predict_one(&sforest, true, "tree");
+  }
+  RegressionForest forest(8, 10);
+  fit_regression(&forest);
+  forest.enable_fast_prediction();
+  const Mat<float> test_data = random_data(10, 3);
+  const Mat<float> expected =
+      forest.get_trees()[0]
+          ->predict(MatCRef<float>(test_data))
+          .get<Mat<float>>();
+  std::vector<float> out(2);
+  for (Eigen::Index row = 0; row < test_data.rows(); ++row) {
+    forest.get_trees()[0]->predict_one(test_data.data() + row * N_FEATURES,
+                                       out.data());
+    EXPECT_FLOAT_EQ(out[0], expected(row, 0));
+    EXPECT_FLOAT_EQ(out[1], expected(row, 1));
+  }
+};
+
+/** Reports the p50 and p99 latency of the timed function in ns. */
+template <typename F>
+void report_latency(const std::string &name, const F &func) {
+  std::vector<double> latencies(20000);
+  for (size_t run = 0; run < latencies.size(); ++run) {
+    const auto start = std::chrono::steady_clock::now();
+    func(run);
+    latencies[run] = std::chrono::duration<double, std::nano>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  }
+  std::sort(latencies.begin(), latencies.end());
+  std::cerr << "[          ] " << name
+            << ": p50 " << latencies[latencies.size() / 2] << "ns, p99 "
+            << latencies[latencies.size() * 99 / 100] << "ns" << std::endl;
+};
+
+TEST(ForestPredictOne, DISABLED_Speed) {
+  ClassificationForest forest(20, 12);
+  fit_classification(&forest);
+  forest.enable_fast_prediction();
+  const Mat<float> test_data = random_data(1000, 4);
+  float out[1];
+  float checksum = 0.f;
+  report_latency("predict (1 row)", [&](const size_t &run) {
+    const size_t row = run % test_data.rows();
+    const auto res = forest.predict(
+        MatCRef<float>(test_data.block(row, 0, 1, N_FEATURES)));
+    checksum += static_cast<float>(res.get<Mat<uint>>()(0, 0));
+  });
+  report_latency("predict_one", [&](const size_t &run) {
+    forest.predict_one(test_data.data() + (run % test_data.rows()) * N_FEATURES,
+                       out);
+    checksum += out[0];
+  });
+  EXPECT_GE(checksum, 0.f);
+};
+
+}  // namespace
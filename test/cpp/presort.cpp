@@ -0,0 +1,79 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <forpy/data_providers/data_providers.h>
+#include <forpy/deciders/deciders.h>
+#include <forpy/leafs/leafs.h>
+#include <forpy/threshold_optimizers/threshold_optimizers.h>
+#include <forpy/tree.h>
+
+#include "./setup.h"
+
+// Test objects.
+using forpy::Tree;
+
+namespace {
+
+/** Repeated values in one of the features of the classes test ties. */
+Problem tied_problem(const size_t &n_rows, const unsigned int &seed) {
+  Problem problem(n_rows, seed);
+  problem.add_ties(2);
+  return problem;
+};
+
+std::shared_ptr<Tree> fit_tree(const Problem &problem, const bool &regression,
+                               const bool &presort) {
+  const auto tree = make_tree(regression, 20, 0, presort);
+  tree->fit_dprov(make_dprov(problem, regression));
+  return tree;
+};
+
+TEST(PresortedTraining, MatchesExact) {
+  const Problem train(tied_problem(3000, 1)), test(tied_problem(1000, 2));
+  // The exact optimization breaks near-ties depending on the sample order, so
+  // the trees are not identical, but equivalent.
+  const auto exact = fit_tree(train, false, false);
+  const auto presorted = fit_tree(train, false, true);
+  EXPECT_NEAR(static_cast<float>(presorted->get_n_nodes()),
+              static_cast<float>(exact->get_n_nodes()),
+              0.05f * exact->get_n_nodes());
+  EXPECT_NEAR(accuracy(presorted.get(), train), accuracy(exact.get(), train),
+              0.01f);
+  EXPECT_NEAR(accuracy(presorted.get(), test), accuracy(exact.get(), test),
+              0.03f);
+  const auto rexact = fit_tree(train, true, false);
+  const auto rpresorted = fit_tree(train, true, true);
+  EXPECT_LT(mse(rpresorted.get(), test), 1.1f * mse(rexact.get(), test));
+};
+
+TEST(PresortedTraining, DISABLED_Speed) {
+  const Problem train(tied_problem(200000, 3));
+  for (const bool regression : {false, true}) {
+    for (const bool presort : {false, true}) {
+      const auto start = std::chrono::steady_clock::now();
+      const auto tree = fit_tree(train, regression, presort);
+      const double seconds =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                        start)
+              .count();
+      std::cerr << "[          ] "
+                << (regression ? "regression" : "classification")
+                << (presort ? " presorted" : " exact") << ": " << seconds
+                << "s, " << tree->get_n_nodes() << " nodes";
+      if (presort)
+        std::cerr << ", sorted lists "
+                  << train.data.size() * sizeof(forpy::id_t) /
+                         (1 << 20)
+                  << "MB";
+      std::cerr << std::endl;
+    }
+  }
+};
+
+}  // namespace
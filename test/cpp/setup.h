@@ -4,7 +4,20 @@
 
 #include <cereal/archives/portable_binary.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
 #include <sstream>
+#include <vector>
+
+#include <forpy/data_providers/data_providers.h>
+#include <forpy/deciders/deciders.h>
+#include <forpy/forest.h>
+#include <forpy/leafs/leafs.h>
+#include <forpy/threshold_optimizers/threshold_optimizers.h>
+#include <forpy/tree.h>
 
 
 template <typename T>
@@ -22,6 +35,140 @@ std::shared_ptr<T> serialize_deserialize(std::shared_ptr<T> obj) {
   return restored;
 };
 
+/**
+ * \brief Random features with one sample per row and (noisy) targets.
+ *
+ * The features are standard normal. With a density below one, each value is
+ * zero with probability 1 - density and one tenth of the others is one, so
+ * that there are ties. The classes depend on the features 0, 1 and 2, the
+ * first target column on 0, 3 and 4 and the other columns on 0 and 1. With
+ * fewer features, the targets reuse the available ones. The weights are in
+ * [0.5, 2].
+ */
+struct Problem {
+  forpy::Mat<float> data, data_t;
+  forpy::Mat<uint> classes;
+  forpy::Mat<float> values;
+  std::shared_ptr<std::vector<float>> weights;
+
+  Problem(const size_t &n_rows, const unsigned int &seed,
+          const size_t &n_features = 10, const size_t &n_classes = 3,
+          const size_t &annot_dim = 1, const float &density = 1.f)
+      : data(n_rows, n_features),
+        classes(n_rows, 1),
+        values(n_rows, annot_dim),
+        weights(std::make_shared<std::vector<float>>(n_rows)) {
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> dist;
+    std::uniform_real_distribution<float> udist, wdist(0.5f, 2.f);
+    for (Eigen::Index i = 0; i < data.size(); ++i) {
+      if (density >= 1.f)
+        data.data()[i] = dist(gen);
+      else if (udist(gen) >= density)
+        data.data()[i] = 0.f;
+      else
+        data.data()[i] = udist(gen) < 0.1f ? 1.f : dist(gen);
+    }
+    const auto x = [&](const Eigen::Index &i, const Eigen::Index &j) {
+      return data(i, j % data.cols());
+    };
+    for (Eigen::Index i = 0; i < data.rows(); ++i) {
+      const float score = x(i, 0) + 0.5f * x(i, 1) * x(i, 2) + 0.3f * dist(gen);
+      classes(i, 0) = static_cast<uint>(
+          std::min(std::max(std::floor((score + 1.5f) / 3.f * n_classes), 0.f),
+                   static_cast<float>(n_classes - 1)));
+      values(i, 0) = std::sin(x(i, 0)) + x(i, 3) * x(i, 4) + 0.1f * dist(gen);
+      for (Eigen::Index j = 1; j < values.cols(); ++j)
+        values(i, j) =
+            std::sin(x(i, j % 2) * (1.f + j / 4.f)) + 0.1f * dist(gen);
+      (*weights)[i] = wdist(gen);
+    }
+    data_t = data.transpose();
+  };
+
+  /** \brief Rounds a feature to multiples of 0.5, so that it has many ties. */
+  void add_ties(const size_t &feat_idx) {
+    for (Eigen::Index i = 0; i < data.rows(); ++i)
+      data(i, feat_idx) = std::round(data(i, feat_idx) * 2.f) / 2.f;
+    data_t = data.transpose();
+  };
+};
+
+inline forpy::Data<forpy::MatCRef> annotations(const Problem &problem,
+                                               const bool &regression) {
+  if (regression) return forpy::MatCRef<float>(problem.values);
+  return forpy::MatCRef<uint>(problem.classes);
+};
+
+inline std::shared_ptr<forpy::FastDProv> make_dprov(
+    const Problem &problem, const bool &regression,
+    const bool &weighted = false, const size_t &n_bins = 0) {
+  return std::make_shared<forpy::FastDProv>(
+      forpy::Data<forpy::MatCRef>(forpy::MatCRef<float>(problem.data_t)),
+      annotations(problem, regression),
+      weighted ? problem.weights : nullptr, n_bins);
+};
+
+inline std::shared_ptr<forpy::ILeaf> make_leaf(const bool &regression) {
+  if (regression) return std::make_shared<forpy::RegressionLeaf>();
+  return std::make_shared<forpy::ClassificationLeaf>();
+};
+
+/** \brief A tree with one sample per leaf and the given decider. */
+inline std::shared_ptr<forpy::Tree> make_tree(
+    const std::shared_ptr<forpy::IDecider> &decider, const bool &regression,
+    const uint &max_depth = std::numeric_limits<uint>::max()) {
+  return std::make_shared<forpy::Tree>(max_depth, 1, 2, decider,
+                                       make_leaf(regression));
+};
+
+/**
+ * \brief A tree with a FastDecider using the FastClassOpt or the
+ * RegressionOpt.
+ */
+inline std::shared_ptr<forpy::Tree> make_tree(
+    const bool &regression,
+    const uint &max_depth = std::numeric_limits<uint>::max(),
+    const size_t &n_valid_features = 0, const bool &presort = false) {
+  std::shared_ptr<forpy::IThreshOpt> opt;
+  if (regression)
+    opt = std::make_shared<forpy::RegressionOpt>();
+  else
+    opt = std::make_shared<forpy::FastClassOpt>();
+  return make_tree(std::make_shared<forpy::FastDecider>(opt, n_valid_features,
+                                                        false, presort),
+                   regression, max_depth);
+};
+
+inline std::unique_ptr<forpy::Forest> make_forest(
+    const bool &regression, const size_t &n_trees,
+    const uint &max_depth = std::numeric_limits<uint>::max()) {
+  if (regression)
+    return std::unique_ptr<forpy::Forest>(
+        new forpy::RegressionForest(n_trees, max_depth));
+  return std::unique_ptr<forpy::Forest>(
+      new forpy::ClassificationForest(n_trees, max_depth));
+};
+
+/** \brief The fraction of correctly classified samples of a tree or forest. */
+template <typename M>
+float accuracy(M *model, const Problem &test) {
+  const forpy::Mat<uint> result =
+      model->predict(forpy::MatCRef<float>(test.data))
+          .template get<forpy::Mat<uint>>();
+  return static_cast<float>((result.array() == test.classes.array()).count()) /
+         static_cast<float>(result.rows());
+};
+
+/** \brief The mean squared error of a tree or forest. */
+template <typename M>
+float mse(M *model, const Problem &test) {
+  const forpy::Mat<float> result =
+      model->predict(forpy::MatCRef<float>(test.data))
+          .template get<forpy::Mat<float>>();
+  return (result - test.values).array().square().mean();
+};
+
 
 /**
  * \brief A fixture to test the gain measures.
@@ -0,0 +1,193 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <forpy/data_providers/data_providers.h>
+#include <forpy/deciders/deciders.h>
+#include <forpy/forest.h>
+#include <forpy/leafs/leafs.h>
+#include <forpy/threshold_optimizers/threshold_optimizers.h>
+#include <forpy/tree.h>
+#include <forpy/util/threading/ctpl.h>
+
+#include "./setup.h"
+
+// Test objects.
+using forpy::ClassificationForest;
+using forpy::Data;
+using forpy::FastDecider;
+using forpy::Mat;
+using forpy::MatCRef;
+using forpy::SparseDProv;
+using forpy::SparseMat;
+using forpy::Tree;
+
+namespace {
+
+/**
+ * The shared problem with the features in CSC and CSR format, too. The
+ * classes are a function of the features without noise, so that samples
+ * with equal (sparse) features have the same class.
+ */
+struct SparseProblem : Problem {
+  std::shared_ptr<const SparseMat> csc, csr;
+  SparseProblem(const size_t &n_rows, const unsigned int &seed,
+                const size_t &n_features, const float &density)
+      : Problem(n_rows, seed, n_features, 3, 1, density) {
+    std::vector<size_t> indptr(1, 0);
+    std::vector<forpy::id_t> indices;
+    std::vector<float> values;
+    for (Eigen::Index i = 0; i < data.rows(); ++i) {
+      for (Eigen::Index j = 0; j < data.cols(); ++j) {
+        if (data(i, j) == 0.f) continue;
+        indices.push_back(j);
+        values.push_back(data(i, j));
+      }
+      indptr.push_back(indices.size());
+      const float score = data(i, 0) - data(i, 1) + 0.5f * data(i, 2);
+      classes(i, 0) = score > 0.2f ? 2 : (score < -0.2f ? 0 : 1);
+    }
+    csr = std::make_shared<const SparseMat>(indptr, indices, values,
+                                            n_features);
+    csc = std::make_shared<const SparseMat>(csr->transpose());
+  };
+};
+
+TEST(SparseMat, Formats) {
+  // Unsorted indices are sorted.
+  const SparseMat csr({0, 2, 2, 3}, {2, 0, 1}, {1.f, 2.f, -3.f}, 4);
+  EXPECT_EQ(csr.get_n_outer(), 3);
+  EXPECT_EQ(csr.get_n_inner(), 4);
+  EXPECT_EQ(csr.get_indices(), (std::vector<forpy::id_t>{0, 2, 1}));
+  EXPECT_EQ(csr.get_values(), (std::vector<float>{2.f, 1.f, -3.f}));
+  const SparseMat csc = csr.transpose();
+  EXPECT_EQ(csc.get_n_outer(), 4);
+  EXPECT_EQ(csc.get_indptr(), (std::vector<size_t>{0, 1, 2, 3, 3}));
+  EXPECT_EQ(csc.get_indices(), (std::vector<forpy::id_t>{0, 2, 0}));
+  EXPECT_TRUE(csc.transpose() == csr);
+  Mat<float> dense = Mat<float>::Zero(3, 4);
+  csr.scatter_rows(0, 3, dense.data());
+  EXPECT_EQ(dense(0, 0), 2.f);
+  EXPECT_EQ(dense(0, 2), 1.f);
+  EXPECT_EQ(dense(2, 1), -3.f);
+  EXPECT_EQ(dense.sum(), 0.f);
+  EXPECT_THROW(SparseMat({0, 2}, {1, 1}, {1.f, 2.f}, 2),
+               forpy::ForpyException);
+  EXPECT_THROW(SparseMat({0, 1}, {2}, {1.f}, 2), forpy::ForpyException);
+  EXPECT_THROW(SparseMat({0, 2}, {0}, {1.f}, 2), forpy::ForpyException);
+  EXPECT_THROW(SparseMat({0, 1, 0}, {0}, {1.f}, 2), forpy::ForpyException);
+};
+
+TEST(SparseDProv, Checks) {
+  const SparseProblem problem(100, 1, 5, 0.3f);
+  const Data<MatCRef> annotations = MatCRef<uint>(problem.classes);
+  SparseDProv dprov(problem.csc, annotations, nullptr);
+  EXPECT_EQ(dprov.get_n_samples(), 100);
+  EXPECT_EQ(dprov.get_feat_vec_dim(), 5);
+  EXPECT_EQ(dprov.get_sparse_features(), problem.csc.get());
+  EXPECT_THROW(dprov.get_feature(0), forpy::ForpyException);
+  // The annotations must match the samples, not the features.
+  EXPECT_THROW(SparseDProv(problem.csr, annotations, nullptr),
+               forpy::ForpyException);
+  // Unsupported configurations.
+  const auto sprov =
+      std::make_shared<SparseDProv>(problem.csc, annotations, nullptr);
+  EXPECT_THROW(
+      Tree(10, 1, 2,
+           std::make_shared<FastDecider>(
+               std::make_shared<forpy::FastClassOpt>(), 0, false, true))
+          .fit_dprov(sprov),
+      forpy::ForpyException);
+  EXPECT_THROW(Tree(10, 1, 2,
+                    std::make_shared<FastDecider>(
+                        std::make_shared<forpy::FastClassOpt>(10)))
+                   .fit_dprov(sprov),
+               forpy::ForpyException);
+};
+
+TEST(SparseDProv, MatchesDense) {
+  forpy::ThreadControl::getInstance().set_num(1);
+  for (const float density : {0.05f, 0.3f, 1.f}) {
+    const SparseProblem problem(3000, 2, 8, density),
+        test(1000, 3, 8, density);
+    const Data<MatCRef> annotations = MatCRef<uint>(problem.classes);
+    for (const bool weighted : {false, true}) {
+      const auto weights = weighted ? problem.weights : nullptr;
+      // The node ids depend on the processing order, so the trees are
+      // compared by their predictions.
+      for (const uint depth : {1, 2, 3, 4}) {
+        const auto dense = make_tree(false, depth);
+        dense->fit_dprov(make_dprov(problem, false, weighted));
+        const auto sparse = make_tree(false, depth);
+        sparse->fit_dprov(
+            std::make_shared<SparseDProv>(problem.csc, annotations, weights));
+        EXPECT_EQ(dense->get_n_nodes(), sparse->get_n_nodes());
+        // The leafs sum the weights in different orders.
+        const auto dense_pred =
+            dense->predict_proba(Data<MatCRef>(MatCRef<float>(test.data)))
+                .get<Mat<float>>();
+        const auto sparse_pred =
+            sparse->predict_proba(Data<MatCRef>(MatCRef<float>(test.data)))
+                .get<Mat<float>>();
+        EXPECT_TRUE(dense_pred.isApprox(sparse_pred, 1E-5f))
+            << "density: " << density << ", weighted: " << weighted
+            << ", depth: " << depth;
+      }
+      // Perfect fit and the same predictions for CSR input.
+      const auto sparse = make_tree(false);
+      sparse->fit_dprov(
+          std::make_shared<SparseDProv>(problem.csc, annotations, weights));
+      const auto dense_pred =
+          sparse->predict(Data<MatCRef>(MatCRef<float>(problem.data)))
+              .get<Mat<uint>>();
+      EXPECT_EQ(dense_pred, problem.classes);
+      const auto sparse_pred =
+          sparse->predict_sparse(*problem.csr, 2).get<Mat<uint>>();
+      EXPECT_EQ(sparse_pred, dense_pred);
+    }
+  }
+};
+
+TEST(SparseDProv, Forest) {
+  const SparseProblem train(2000, 4, 20, 0.1f), test(500, 5, 20, 0.1f);
+  const Data<MatCRef> annotations = MatCRef<uint>(train.classes);
+  ClassificationForest forest(8);
+  forest.fit_dprov(
+      std::make_shared<SparseDProv>(train.csc, annotations, nullptr));
+  const auto dense_pred =
+      forest.predict_proba(Data<MatCRef>(MatCRef<float>(test.data)), 2)
+          .get<Mat<float>>();
+  const auto sparse_pred =
+      forest.predict_sparse(*test.csr, 2, true).get<Mat<float>>();
+  EXPECT_EQ(sparse_pred, dense_pred);
+  const auto classes = forest.predict_sparse(*test.csr).get<Mat<uint>>();
+  EXPECT_GT((classes.array() == test.classes.array()).cast<float>().mean(),
+            0.7f);
+};
+
+TEST(SparseDProv, DISABLED_Speed) {
+  const SparseProblem problem(200000, 6, 100, 0.01f);
+  const Data<MatCRef> annotations = MatCRef<uint>(problem.classes);
+  forpy::ThreadControl::getInstance().set_num(1);
+  for (const bool sparse : {false, true}) {
+    const auto tree = make_tree(false, 12);
+    std::shared_ptr<forpy::IDataProvider> dprov;
+    if (sparse)
+      dprov = std::make_shared<SparseDProv>(problem.csc, annotations, nullptr);
+    else
+      dprov = make_dprov(problem, false);
+    const auto start = std::chrono::steady_clock::now();
+    tree->fit_dprov(dprov);
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    std::cerr << "[          ] " << (sparse ? "sparse" : "dense") << ": "
+              << seconds << "s, " << tree->get_n_nodes() << " nodes"
+              << std::endl;
+  }
+};
+
+}  // namespace
@@ -0,0 +1,122 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <forpy/deciders/deciders.h>
+#include <forpy/leafs/leafs.h>
+#include <forpy/threshold_optimizers/threshold_optimizers.h>
+#include <forpy/tree.h>
+#include <forpy/util/costmodel.h>
+
+// Test objects.
+using forpy::FastDecider;
+using forpy::Mat;
+using forpy::MatCRef;
+using forpy::NodeCostModel;
+using forpy::NodeWork;
+using forpy::TaskStats;
+using forpy::Tree;
+
+namespace {
+
+/**
+ * Random data where the class mostly depends on the first feature. With
+ * `skew`, most samples end up in few deep branches.
+ */
+void make_problem(const size_t &n_samples, const size_t &n_features,
+                  const bool &skew, Mat<float> *data_t, Mat<uint> *classes) {
+  std::mt19937 gen(1);
+  std::normal_distribution<float> dist;
+  *data_t = Mat<float>(n_features, n_samples);
+  *classes = Mat<uint>(n_samples, 1);
+  for (Eigen::Index i = 0; i < data_t->size(); ++i)
+    data_t->data()[i] = dist(gen);
+  for (size_t i = 0; i < n_samples; ++i) {
+    float score = (*data_t)(0, i) + .5f * dist(gen);
+    if (skew) score = std::exp(2.f * score);
+    (*classes)(i, 0) = static_cast<uint>(std::min(9.f, std::abs(score) * 3.f));
+  }
+};
+
+std::shared_ptr<Tree> fit_tree(const Mat<float> &data_t,
+                               const Mat<uint> &classes,
+                               const size_t &n_threads) {
+  auto tree = std::make_shared<Tree>(
+      std::numeric_limits<uint>::max(), 1, 2,
+      std::make_shared<FastDecider>(std::make_shared<forpy::FastClassOpt>()),
+      std::make_shared<forpy::ClassificationLeaf>());
+  tree->fit(MatCRef<float>(data_t), MatCRef<uint>(classes), n_threads);
+  return tree;
+};
+
+TEST(NodeCostModel, Calibration) {
+  const auto &model = NodeCostModel::get();
+  EXPECT_GT(model.get_s_per_compare(), 0.);
+  EXPECT_GT(model.get_s_per_scan(), 0.);
+  EXPECT_GT(model.get_s_per_task(), 0.);
+  // A few samples are not worth a task, but a large node is.
+  EXPECT_FALSE(model.worth_task(model.seconds(NodeWork{10., 10.})));
+  EXPECT_TRUE(model.worth_task(model.seconds(NodeWork{1E9, 1E8})));
+  EXPECT_THROW(NodeCostModel(0., 1., 1.), forpy::ForpyException);
+};
+
+TEST(NodeCostModel, TaskStats) {
+  Mat<float> data_t;
+  Mat<uint> classes;
+  make_problem(20000, 10, false, &data_t, &classes);
+  for (const size_t n_threads : {1, 4}) {
+    const auto tree = fit_tree(data_t, classes, n_threads);
+    const auto &tasks = tree->get_task_stats();
+    size_t n_nodes = 0, n_spawned = 0;
+    for (const TaskStats &task : tasks) {
+      n_nodes += task.n_nodes;
+      n_spawned += task.n_spawned;
+      EXPECT_GT(task.actual_s, 0.);
+      EXPECT_GT(task.estimated_s, 0.);
+    }
+    // Every inner node is processed by exactly one task, leafs only if they
+    // have been marked as node first.
+    EXPECT_GE(n_nodes, (tree->get_n_nodes() - 1) / 2);
+    EXPECT_LE(n_nodes, tree->get_n_nodes());
+    EXPECT_EQ(tasks.size(), n_spawned + 1);
+    if (n_threads == 1) {
+      EXPECT_EQ(tasks.size(), 1);
+    } else {
+      EXPECT_GT(tasks.size(), 1);
+    }
+  }
+};
+
+TEST(NodeCostModel, DISABLED_Speed) {
+  for (const bool skew : {false, true}) {
+    Mat<float> data_t;
+    Mat<uint> classes;
+    make_problem(100000, 20, skew, &data_t, &classes);
+    const auto start = std::chrono::steady_clock::now();
+    const auto tree = fit_tree(data_t, classes, 4);
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+    double estimated = 0., actual = 0.;
+    std::map<int, double> busy;
+    for (const TaskStats &task : tree->get_task_stats()) {
+      estimated += task.estimated_s;
+      actual += task.actual_s;
+      busy[task.thread_id] += task.actual_s;
+    }
+    std::cerr << "[          ] " << (skew ? "skewed" : "balanced") << ": "
+              << seconds << "s, " << tree->get_task_stats().size()
+              << " tasks, estimated " << estimated << "s, measured " << actual
+              << "s; per thread:";
+    for (const auto &thread : busy) std::cerr << " " << thread.second << "s";
+    std::cerr << std::endl;
+  }
+};
+
+}  // namespace
@@ -0,0 +1,133 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <forpy/data_providers/data_providers.h>
+#include <forpy/deciders/deciders.h>
+#include <forpy/leafs/leafs.h>
+#include <forpy/threshold_optimizers/threshold_optimizers.h>
+#include <forpy/tree.h>
+#include <forpy/util/threading/ctpl.h>
+
+#include "./setup.h"
+
+// Test objects.
+using forpy::FastDecider;
+using forpy::Tree;
+
+namespace {
+
+std::shared_ptr<Tree> fit_tree(const Problem &problem, const bool &regression,
+                               const size_t &subsample_min_samples,
+                               const size_t &subsample_size,
+                               const uint &max_depth =
+                                   std::numeric_limits<uint>::max()) {
+  std::shared_ptr<forpy::IThreshOpt> opt;
+  if (regression)
+    opt = std::make_shared<forpy::RegressionOpt>();
+  else
+    opt = std::make_shared<forpy::FastClassOpt>();
+  const auto tree =
+      make_tree(std::make_shared<FastDecider>(opt, 0, false, false,
+                                              subsample_min_samples,
+                                              subsample_size),
+                regression, max_depth);
+  tree->fit_dprov(make_dprov(problem, regression));
+  return tree;
+};
+
+TEST(SubsampledSplits, NoSubsampleForSmallNodes) {
+  // Nodes that are not larger than the subsample are optimized exactly.
+  const Problem train(3000, 1), test(1000, 2);
+  forpy::ThreadControl::getInstance().set_num(1);
+  const auto exact = fit_tree(train, false, 0, 10000);
+  const auto subsampled = fit_tree(train, false, 1, 3000);
+  EXPECT_EQ(exact->get_n_nodes(), subsampled->get_n_nodes());
+  EXPECT_EQ(accuracy(exact.get(), test), accuracy(subsampled.get(), test));
+};
+
+TEST(SubsampledSplits, MatchesExact) {
+  // The features are chosen on subsamples of the large nodes, so the trees
+  // differ, but generalize about as well.
+  const Problem train(20000, 3), test(5000, 4);
+  forpy::ThreadControl::getInstance().set_num(1);
+  const auto exact = fit_tree(train, false, 0, 10000);
+  const auto subsampled = fit_tree(train, false, 2000, 1000);
+  EXPECT_NEAR(accuracy(subsampled.get(), test), accuracy(exact.get(), test),
+              0.03f);
+  const auto rexact = fit_tree(train, true, 0, 10000);
+  const auto rsubsampled = fit_tree(train, true, 2000, 1000);
+  EXPECT_LT(mse(rsubsampled.get(), test), 1.1f * mse(rexact.get(), test));
+};
+
+TEST(SubsampledSplits, LargeNodes) {
+  // Shallow trees, so that every split is chosen on a subsample of at most a
+  // tenth of the node. The quality must stay close to the exact splits.
+  const Problem train(50000, 9), test(10000, 10);
+  forpy::ThreadControl::getInstance().set_num(1);
+  for (const uint max_depth : {2, 4}) {
+    const auto exact = fit_tree(train, false, 0, 10000, max_depth);
+    const auto subsampled = fit_tree(train, false, 5000, 500, max_depth);
+    EXPECT_NEAR(accuracy(subsampled.get(), test), accuracy(exact.get(), test),
+                0.02f)
+        << "max depth: " << max_depth;
+    const auto rexact = fit_tree(train, true, 0, 10000, max_depth);
+    const auto rsubsampled = fit_tree(train, true, 5000, 500, max_depth);
+    EXPECT_LT(mse(rsubsampled.get(), test), 1.05f * mse(rexact.get(), test))
+        << "max depth: " << max_depth;
+  }
+};
+
+TEST(SubsampledSplits, SingleFeature) {
+  // With one feature, the parent partition leaves the samples of a node
+  // sorted. The subsample shuffles them, and the only candidate is refined on
+  // the full node, which must give the exact split.
+  const Problem train(20000, 7, 1), test(5000, 8, 1);
+  forpy::ThreadControl::getInstance().set_num(1);
+  for (const bool regression : {false, true}) {
+    const auto exact = fit_tree(train, regression, 0, 10000);
+    const auto subsampled = fit_tree(train, regression, 2000, 1000);
+    EXPECT_EQ(exact->get_n_nodes(), subsampled->get_n_nodes());
+    if (regression)
+      EXPECT_FLOAT_EQ(mse(exact.get(), test), mse(subsampled.get(), test));
+    else
+      EXPECT_EQ(accuracy(exact.get(), test),
+                accuracy(subsampled.get(), test));
+  }
+};
+
+TEST(SubsampledSplits, DISABLED_Speed) {
+  const Problem train(1000000, 5), test(100000, 6);
+  forpy::ThreadControl::getInstance().set_num(1);
+  for (const bool regression : {false, true}) {
+    for (const size_t subsample_size : {0, 100000, 20000, 5000}) {
+      const auto start = std::chrono::steady_clock::now();
+      const auto tree = fit_tree(train, regression,
+                                 subsample_size == 0 ? 0 : 4 * subsample_size,
+                                 subsample_size == 0 ? 10000 : subsample_size);
+      const double seconds =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                        start)
+              .count();
+      std::cerr << "[          ] "
+                << (regression ? "regression" : "classification") << ", ";
+      if (subsample_size == 0)
+        std::cerr << "exact";
+      else
+        std::cerr << "subsample " << subsample_size;
+      std::cerr << ": " << seconds << "s, " << tree->get_n_nodes()
+                << " nodes, test ";
+      if (regression)
+        std::cerr << "MSE " << mse(tree.get(), test);
+      else
+        std::cerr << "accuracy " << accuracy(tree.get(), test);
+      std::cerr << std::endl;
+    }
+  }
+};
+
+}  // namespace
@@ -0,0 +1,55 @@
+/* Author: Christoph Lassner. */
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <forpy/util/threading/ctpl.h>
+
+// Test objects.
+using forpy::PredictionPool;
+
+namespace {
+
+TEST(PredictionPool, ConcurrentRuns) {
+  // Callers with different numbers of threads share the pool; every chunk is
+  // processed exactly once and at most n_threads run at the same time.
+  const size_t n_chunks = 1000;
+  std::vector<std::thread> callers;
+  std::vector<std::atomic<int>> seen(6 * n_chunks);
+  std::vector<size_t> max_active(6, 0);
+  for (size_t caller = 0; caller < 6; ++caller)
+    callers.emplace_back([&, caller]() {
+      std::atomic<size_t> active(0), peak(0);
+      PredictionPool::getInstance().run(
+          caller + 1, n_chunks, [&](const size_t &chunk_idx) {
+            const size_t now = ++active;
+            size_t prev = peak;
+            while (prev < now && !peak.compare_exchange_weak(prev, now)) {
+            }
+            ++seen[caller * n_chunks + chunk_idx];
+            --active;
+          });
+      max_active[caller] = peak;
+    });
+  for (auto &caller : callers) caller.join();
+  for (size_t caller = 0; caller < 6; ++caller) {
+    EXPECT_LE(max_active[caller], caller + 1);
+    for (size_t i = 0; i < n_chunks; ++i)
+      ASSERT_EQ(seen[caller * n_chunks + i], 1) << caller << ", " << i;
+  }
+  // Exceptions are forwarded after all chunks finished.
+  std::atomic<size_t> done(0);
+  EXPECT_THROW(PredictionPool::getInstance().run(
+                   4, 100,
+                   [&](const size_t &chunk_idx) {
+                     if (chunk_idx == 10) throw std::runtime_error("chunk");
+                     ++done;
+                   }),
+               std::runtime_error);
+  EXPECT_LE(done, 99);
+};
+
+}  // namespace
@@ -156,6 +156,48 @@ class PredictionTestCase(unittest.TestCase):
             timeit.Timer(lambda: tree.predict(self.dta))
             .timeit(int(1E2)) / 1E2))
 
+    def test_relayout_deep(self):
+        """Test the effect of node relayouting on deep trees."""
+        import forpy
+        np.random.seed(1)
+        dta = np.random.normal(size=(100000, 10)).astype(np.float32)
+        annot = np.random.randint(0, 10, size=(100000, 1)).astype(np.uint32)
+        tree = forpy.ClassificationTree()
+        tree.fit(np.ascontiguousarray(dta.T), annot)
+        tree.enable_fast_prediction()
+        print("tree depth: ", tree.depth, "nodes: ", tree.n_nodes)
+        res_training = tree.predict(dta)
+        times = [
+            timeit.Timer(lambda: tree.predict(dta)).timeit(int(1E1)) / 1E1
+        ]
+        for layout in [
+                forpy.ENodeLayout.BreadthFirst,
+                forpy.ENodeLayout.SubtreeBlocked
+        ]:
+            tree.relayout(layout)
+            self.assertTrue(np.all(tree.predict(dta) == res_training))
+            times.append(
+                timeit.Timer(lambda: tree.predict(dta)).timeit(int(1E1)) / 1E1)
+        print("forpy prediction time (deep, training/bfs/blocked layout): " +
+              str(times))
+
+    def test_bitvector_forest(self):
+        """Compare the single sample latency of both engines (64 leafs)."""
+        import forpy
+        np.random.seed(1)
+        dta = np.random.normal(size=(5000, 20)).astype(np.float32)
+        annot = np.random.randint(0, 5, size=(5000, 1)).astype(np.uint32)
+        forest = forpy.ClassificationForest(n_trees=1000, max_depth=6)
+        forest.fit(np.ascontiguousarray(dta.T), annot)
+        out = np.zeros((5,), dtype=np.float32)
+        times = []
+        for engine in ["tree", "bitvector"]:
+            forest.enable_fast_prediction(engine=engine)
+            times.append(
+                timeit.Timer(lambda: forest.predict_one(dta[0], out, True))
+                .timeit(int(1E3)) / 1E3)
+        print("forpy predict_one time (1000 trees, 64 leafs, tree/bitvector): "
+              + str(times))
 
 if __name__ == "__main__":
     unittest.main()
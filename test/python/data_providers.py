@@ -2,7 +2,9 @@
 """Getting data into the framework properly."""
 # pylint: disable=no-member
 import os.path as path
+import shutil
 import sys
+import tempfile
 import unittest
 
 import numpy as np
@@ -33,6 +35,87 @@ class TestDataProviders(unittest.TestCase):
             self.assertEqual(res.shape[0], 10)
         _ = pdp.__repr__()
 
+    def test_histogram(self):
+        """Test histogram split optimization."""
+        import forpy
+        np.random.seed(1)
+        data = np.random.normal(size=(1000, 4)).astype(np.float32)
+        annot = (data[:, 0] + data[:, 1] > 0.).astype(np.uint32)
+        annot = annot.reshape((1000, 1))
+        data_t = np.ascontiguousarray(data.T)
+        self.assertFalse(forpy.FastDProv(data_t, annot).uses_histograms)
+        with self.assertRaises(RuntimeError):
+            forpy.FastDProv(data_t, annot, n_bins=300)
+        pdp = forpy.FastDProv(data_t, annot, n_bins=64)
+        self.assertTrue(pdp.uses_histograms)
+        tps = pdp.create_tree_providers([(range(10), [])])
+        self.assertTrue(tps[0].uses_histograms)
+        forest = forpy.ClassificationForest(n_trees=4)
+        forest.fit_dprov(pdp)
+        self.assertGreater((forest.predict(data) == annot).mean(), 0.95)
+
+    @unittest.skipIf(sys.platform == 'win32',
+                     'The MMapDProv is only available with POSIX mmap.')
+    def test_mmap(self):
+        """Test memory mapped data provider."""
+        import forpy
+        np.random.seed(2)
+        data = np.random.normal(size=(1000, 4)).astype(np.float32)
+        annot = (data[:, 0] + data[:, 1] > 0.).astype(np.uint32)
+        annot = annot.reshape((1000, 1))
+        tmpdir = tempfile.mkdtemp()
+        try:
+            # Feature-major either as C-ordered transpose or Fortran order.
+            fname = path.join(tmpdir, 'data.npy')
+            np.save(fname, np.asfortranarray(data))
+            mdp = forpy.MMapDProv(fname, annot)
+            self.assertEqual(mdp.feat_vec_dim, 4)
+            self.assertEqual(len(mdp.get_initial_sample_list()), 1000)
+            for feat_idx in range(4):
+                self.assertTrue(
+                    np.all(mdp.get_feature(feat_idx) == data[:, feat_idx]))
+            mdp.advise(forpy.EAccessPattern.Random)
+            tps = mdp.create_tree_providers([(range(10), [])])
+            self.assertEqual(len(tps[0].get_initial_sample_list()), 10)
+            rname = path.join(tmpdir, 'data.raw')
+            np.ascontiguousarray(data.T).tofile(rname)
+            rdp = forpy.MMapDProv(rname, 'float32', 4, annot, n_bins=32)
+            self.assertTrue(rdp.uses_histograms)
+            with self.assertRaises(RuntimeError):
+                forpy.MMapDProv(rname, 'float32', 3, annot)
+            forest = forpy.ClassificationForest(n_trees=4)
+            forest.fit_dprov(mdp)
+            self.assertGreater((forest.predict(data) == annot).mean(), 0.95)
+            del mdp, rdp, tps
+        finally:
+            shutil.rmtree(tmpdir)
+
+    def test_sparse(self):
+        """Test sparse data provider."""
+        import forpy
+        np.random.seed(3)
+        data = np.random.normal(size=(1000, 6)).astype(np.float32)
+        data[np.random.uniform(size=data.shape) > 0.2] = 0.
+        annot = (data[:, 0] - data[:, 1] > 0.).astype(np.uint32)
+        annot = annot.reshape((1000, 1))
+        # The arrays of a `scipy.sparse.csr_matrix`.
+        rows, cols = np.nonzero(data)
+        indptr = np.concatenate(([0], np.cumsum(np.bincount(rows,
+                                                            minlength=1000))))
+        csr = forpy.SparseMat(indptr, cols, data[rows, cols], 6)
+        csc = csr.transpose()
+        self.assertEqual(csc.n_outer, 6)
+        self.assertEqual(csc.nnz, len(rows))
+        sdp = forpy.SparseDProv(csc, annot)
+        self.assertEqual(sdp.feat_vec_dim, 6)
+        with self.assertRaises(RuntimeError):
+            forpy.SparseDProv(csr, annot)
+        forest = forpy.ClassificationForest(n_trees=4)
+        forest.fit_dprov(sdp)
+        self.assertTrue(np.all(forest.predict_sparse(csr) ==
+                               forest.predict(data)))
+        self.assertGreater((forest.predict(data) == annot).mean(), 0.95)
+
 
 if __name__ == '__main__':
     unittest.main()
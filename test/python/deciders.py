@@ -26,6 +26,24 @@ class TestDeciders(unittest.TestCase):
         td.__repr__()
         self.assertRaises(RuntimeError, lambda: td.decide(0, np.ones((3, 3))))
 
+    def test_presort(self):
+        """Test training with presorted sample lists."""
+        import forpy
+        np.random.seed(1)
+        data = np.random.normal(size=(500, 3)).astype(np.float32)
+        annot = (data[:, 0] > data[:, 1]).astype(np.uint32).reshape((500, 1))
+        self.assertFalse(forpy.FastDecider().presort)
+        preds = []
+        for presort in [False, True]:
+            td = forpy.FastDecider(forpy.FastClassOpt(), presort=presort)
+            self.assertEqual(td.presort, presort)
+            tree = forpy.Tree(decider_template=td,
+                              leaf_template=forpy.ClassificationLeaf())
+            tree.fit(data, annot)
+            preds.append(tree.predict(data))
+        for pred in preds:
+            self.assertTrue(np.all(pred == annot))
+
 
 if __name__ == '__main__':
     unittest.main()
@@ -97,6 +97,264 @@ class TestForest(unittest.TestCase):
                           lambda: forest.fit(self.dta_t, self.annot))
         self.assertRaises(RuntimeError, lambda: forest.fit_dprov(self.dprov))
 
+    def test_parallel_predict(self):
+        """Test multithreaded forest prediction."""
+        import forpy
+        dta = np.random.normal(size=(700, 5)).astype(np.float32)
+        annot = np.random.randint(0, 4, size=(700, 1)).astype(np.uint32)
+        annot_r = np.random.normal(size=(700, 2)).astype(np.float32)
+        dta_t = np.ascontiguousarray(dta.T)
+        forest = forpy.ClassificationForest(n_trees=7)
+        forest.fit(dta_t, annot)
+        res_st = forest.predict_proba(dta)
+        for n_threads in [2, 3, 0]:
+            self.assertTrue(
+                np.allclose(res_st, forest.predict_proba(
+                    dta, num_threads=n_threads)))
+            self.assertTrue(
+                np.all(
+                    np.argmax(res_st, axis=1) == forest.predict(
+                        dta, num_threads=n_threads).flat))
+        # Few rows, so that trees are split into groups.
+        self.assertTrue(
+            np.allclose(res_st[:3], forest.predict_proba(
+                dta[:3], num_threads=4)))
+        forest = forpy.RegressionForest(
+            n_trees=5, store_variance=True, summarize=True)
+        forest.fit(dta_t, annot_r)
+        self.assertTrue(
+            np.allclose(
+                forest.predict(dta), forest.predict(dta, num_threads=3)))
+        self.assertTrue(
+            np.allclose(
+                forest.predict_proba(dta),
+                forest.predict_proba(dta, num_threads=3),
+                atol=1E-6))
+        forest = forpy.RegressionForest(n_trees=5, store_variance=True)
+        forest.fit(dta_t, annot_r)
+        self.assertTrue(
+            np.all(
+                forest.predict_proba(dta) == forest.predict_proba(
+                    dta[:], num_threads=2)))
+
+    def test_bitvector_engine(self):
+        """Test the bitvector prediction engine."""
+        import forpy
+
+        def check_predict_one(forest, res, predict_proba=True):
+            out = np.zeros((res.shape[1],), dtype=np.float32)
+            for row_idx in range(test_dta.shape[0]):
+                forest.predict_one(test_dta[row_idx], out, predict_proba)
+                self.assertTrue(np.allclose(out, res[row_idx]))
+
+        dta = np.random.normal(size=(600, 6)).astype(np.float32)
+        annot = np.random.randint(0, 5, size=(600, 1)).astype(np.uint32)
+        dta_t = np.ascontiguousarray(dta.T)
+        test_dta = np.random.normal(size=(300, 6)).astype(np.float32)
+        test_dta[0, :] = np.nan
+        test_dta[1:, 2] = np.round(test_dta[1:, 2], 1)
+        # Shallow trees are evaluated with bitvectors, deep ones fall back to
+        # tree traversal.
+        for max_depth in [6, 30]:
+            forest = forpy.ClassificationForest(n_trees=8, max_depth=max_depth)
+            forest.fit(dta_t, annot)
+            res = forest.predict_proba(test_dta)
+            self.assertRaises(
+                RuntimeError,
+                lambda: forest.enable_fast_prediction(engine="unknown"))
+            forest.enable_fast_prediction(engine="bitvector")
+            check_predict_one(forest, res)
+            self.assertTrue(np.all(forest.predict_proba(test_dta) == res))
+            self.assertTrue(
+                np.allclose(
+                    forest.predict_proba(test_dta, num_threads=3), res))
+            forest.relayout()
+            check_predict_one(forest, res)
+            forest.disable_fast_prediction()
+            self.assertTrue(np.all(forest.predict_proba(test_dta) == res))
+        forest = forpy.RegressionForest(n_trees=4, max_depth=5)
+        forest.fit(dta_t, np.random.normal(size=(600, 2)).astype(np.float32))
+        res = forest.predict(test_dta)
+        forest.disable_fast_prediction()
+        forest.enable_fast_prediction("bitvector")
+        check_predict_one(forest, res, False)
+
+    def test_apply(self):
+        """Test the leaf id queries."""
+        import forpy
+        dta = np.random.normal(size=(500, 4)).astype(np.float32)
+        dta_t = np.ascontiguousarray(dta.T)
+        annot = np.random.randint(0, 3, size=(500, 1)).astype(np.uint32)
+        forest = forpy.ClassificationForest(n_trees=6, max_depth=7)
+        forest.fit(dta_t, annot)
+        test_dta = np.random.normal(size=(300, 4)).astype(np.float32)
+        leaf_ids = forest.apply(test_dta)
+        self.assertEqual(leaf_ids.shape, (300, 6))
+        for tree_idx, tree in enumerate(forest.trees):
+            self.assertTrue(
+                np.all(tree.apply(test_dta)[:, 0] == leaf_ids[:, tree_idx]))
+            tree_struct = tree.tree
+            for leaf_id in leaf_ids[:, tree_idx]:
+                self.assertEqual(tree_struct[leaf_id], (0, 0))
+        self.assertTrue(
+            np.all(forest.apply(test_dta, num_threads=3) == leaf_ids))
+        self.assertTrue(
+            np.all(forest.trees[0].apply(test_dta, num_threads=3)[:, 0] ==
+                   leaf_ids[:, 0]))
+        forest.enable_fast_prediction(engine="bitvector")
+        self.assertTrue(np.all(forest.apply(test_dta) == leaf_ids))
+        indices, indptr, n_cols = forest.apply_csr(test_dta, num_threads=2)
+        self.assertEqual(n_cols,
+                         sum((len(tree.tree) + 1) // 2 for tree in forest.trees))
+        self.assertTrue(np.all(indptr == np.arange(0, 301 * 6, 6)))
+        # Leaf columns are increasing with the node ids of each tree.
+        offset = 0
+        for tree_idx, tree in enumerate(forest.trees):
+            n_leafs = (len(tree.tree) + 1) // 2
+            cols = indices[tree_idx::6]
+            self.assertTrue(np.all((cols >= offset) & (cols < offset + n_leafs)))
+            order = np.argsort(leaf_ids[:, tree_idx], kind='stable')
+            self.assertTrue(np.all(np.diff(cols[order]) >= 0))
+            offset += n_leafs
+
+    def test_predict_one(self):
+        """Test the single sample prediction."""
+        import forpy
+        dta = np.random.normal(size=(400, 4)).astype(np.float32)
+        dta_t = np.ascontiguousarray(dta.T)
+        test_dta = np.random.normal(size=(30, 4)).astype(np.float32)
+        forest = forpy.ClassificationForest(n_trees=4, max_depth=6)
+        forest.fit(dta_t, np.random.choice(
+            [0, 2, 5], size=(400, 1)).astype(np.uint32))
+        with self.assertRaises(Exception):
+            forest.predict_one(test_dta[0], np.zeros((1,), dtype=np.float32))
+        forest.enable_fast_prediction()
+        classes = forest.predict(test_dta)
+        probas = forest.predict_proba(test_dta)
+        out = np.zeros((probas.shape[1],), dtype=np.float32)
+        for row_idx in range(test_dta.shape[0]):
+            forest.predict_one(test_dta[row_idx], out)
+            self.assertEqual(out[0], classes[row_idx, 0])
+            forest.predict_one(test_dta[row_idx], out, predict_proba=True)
+            self.assertTrue(np.allclose(out, probas[row_idx]))
+        with self.assertRaises(Exception):
+            forest.predict_one(test_dta[0], out[:1], predict_proba=True)
+        tree = forest.trees[0]
+        tree_res = tree.predict(test_dta)
+        for row_idx in range(test_dta.shape[0]):
+            tree.predict_one(test_dta[row_idx], out)
+            self.assertEqual(out[0], tree_res[row_idx, 0])
+
+    def test_compiled(self):
+        """Test the compiled forest with concurrent predictions."""
+        import forpy
+        import threading
+        dta = np.random.normal(size=(600, 4)).astype(np.float32)
+        dta_t = np.ascontiguousarray(dta.T)
+        test_dta = np.random.normal(size=(200, 4)).astype(np.float32)
+        forest = forpy.RegressionForest(n_trees=5, max_depth=8)
+        forest.fit(dta_t, np.random.normal(size=(600, 1)).astype(np.float32))
+        compiled = forpy.CompiledForest(forest)
+        self.assertEqual(compiled.n_trees, 5)
+        self.assertGreater(compiled.memory_size, 0)
+        expected = forest.predict(test_dta)
+        self.assertTrue(np.allclose(compiled.predict(test_dta), expected))
+        with self.assertRaises(Exception):
+            compiled.predict_proba(test_dta)
+        cforest = forpy.ClassificationForest(n_trees=5, max_depth=8)
+        cforest.fit(dta_t, np.random.choice(
+            [2, 3], size=(600, 1)).astype(np.uint32))
+        ccompiled = forpy.CompiledForest(cforest)
+        self.assertTrue(np.all(ccompiled.predict(test_dta) ==
+                               cforest.predict(test_dta)))
+        self.assertTrue(np.allclose(ccompiled.predict_proba(test_dta),
+                                    cforest.predict_proba(test_dta)))
+        out = np.zeros((1,), dtype=np.float32)
+        compiled.predict_one(test_dta[3], out)
+        self.assertTrue(np.allclose(out, expected[3]))
+        ctree = forpy.CompiledTree(forest.trees[0])
+        self.assertTrue(np.allclose(ctree.predict(test_dta),
+                                    forest.trees[0].predict(test_dta)))
+        results = [None] * 4
+
+        def predict(thread_idx):
+            results[thread_idx] = compiled.predict(test_dta)
+
+        threads = [threading.Thread(target=predict, args=(idx,))
+                   for idx in range(4)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        for result in results:
+            self.assertTrue(np.allclose(result, expected))
+
+    def test_export_cpp(self):
+        """Test the C++ code export."""
+        import forpy
+        import shutil
+        import subprocess
+        import tempfile
+        dta = np.random.normal(size=(400, 5)).astype(np.float32)
+        dta_t = np.ascontiguousarray(dta.T)
+        test_dta = np.random.normal(size=(50, 5)).astype(np.float32)
+        cforest = forpy.ClassificationForest(n_trees=5, max_depth=6)
+        cforest.fit(dta_t, np.random.choice(
+            [1, 4, 9], size=(400, 1)).astype(np.uint32))
+        rforest = forpy.RegressionForest(n_trees=5, max_depth=6)
+        rforest.fit(dta_t, np.random.normal(size=(400, 2)).astype(np.float32))
+        tmpdir = tempfile.mkdtemp()
+        try:
+            headers = []
+            for forest, kind in [(cforest, 'cls'), (rforest, 'reg')]:
+                for mode in [forpy.ECodegenMode.IfElse,
+                             forpy.ECodegenMode.Branchless]:
+                    name = '%s_%s' % (kind, str(mode).split('.')[-1].lower())
+                    fname = path.join(tmpdir, name + '.h')
+                    forest.export_cpp(fname, mode=mode, name=name)
+                    with open(fname, 'r') as fin:
+                        code = fin.read()
+                    self.assertIn('namespace %s {' % (name), code)
+                    self.assertNotIn('forpy/', code)
+                    headers.append((name, forest.predict(test_dta)))
+            self.assertRaises(
+                RuntimeError,
+                lambda: cforest.export_cpp(path.join(tmpdir, 'x.h'),
+                                           name='not valid'))
+            compiler = shutil.which('c++')
+            if compiler is None:
+                return
+            # Compile a program that prints the results of all exports.
+            prog = ['#include <iostream>']
+            prog += ['#include "%s.h"' % (name) for name, _ in headers]
+            prog += ['const float data[] = {%s};' % (', '.join(
+                repr(float(val)) + 'f' for val in test_dta.ravel()))]
+            prog += ['int main() {',
+                     '  std::cout.precision(9);',
+                     '  for (unsigned int i = 0; i < %d; ++i) {' % (
+                         test_dta.shape[0])]
+            for name, res in headers:
+                prog += ['    {',
+                         '      %s::result_t out[%d];' % (name, res.shape[1]),
+                         '      %s::predict(data + i * 5, out);' % (name)]
+                prog += ['      std::cout << out[%d] << " ";' % (col)
+                         for col in range(res.shape[1])]
+                prog += ['    }']
+            prog += ['    std::cout << std::endl;', '  }', '}']
+            with open(path.join(tmpdir, 'main.cpp'), 'w') as fout:
+                fout.write('\n'.join(prog))
+            subprocess.check_call([compiler, '-std=c++11', '-O1', '-o',
+                                   path.join(tmpdir, 'main'),
+                                   path.join(tmpdir, 'main.cpp')])
+            output = subprocess.check_output([path.join(tmpdir, 'main')])
+            gen_res = np.array([[float(val) for val in line.split()]
+                                for line in output.decode().splitlines()])
+            ref_res = np.hstack([res for _, res in headers])
+            self.assertTrue(np.allclose(gen_res, ref_res, rtol=1E-5,
+                                        atol=1E-6))
+        finally:
+            shutil.rmtree(tmpdir)
+
 
 if __name__ == '__main__':
     unittest.main()
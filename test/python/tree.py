@@ -1,6 +1,7 @@
 #!/usr/bin/env python
 """Test tree."""
 # pylint: disable=no-member, too-many-instance-attributes
+import os
 import os.path as path
 import sys
 import unittest
@@ -99,6 +100,117 @@ class TestTree(unittest.TestCase):
                           lambda: tree.fit(self.dta_t, self.annot))
         self.assertRaises(RuntimeError, lambda: tree.fit_dprov(self.dprov))
 
+    def test_parallel_predict(self):
+        """Test multithreaded tree prediction."""
+        import forpy
+        dta = np.random.normal(size=(500, 5)).astype(np.float32)
+        annot = np.random.randint(0, 4, size=(500, 1)).astype(np.uint32)
+        annot_r = np.random.normal(size=(500, 2)).astype(np.float32)
+        dta_t = np.ascontiguousarray(dta.T)
+        tree = forpy.ClassificationTree()
+        tree.fit(dta_t, annot)
+        self.assertTrue(
+            np.all(tree.predict(dta) == tree.predict(dta, num_threads=3)))
+        self.assertTrue(
+            np.all(
+                tree.predict_proba(dta) == tree.predict_proba(
+                    dta, num_threads=3)))
+        res_fast = tree.predict(dta)
+        tree.disable_fast_prediction()
+        res_slow = tree.predict(dta, use_fast_prediction_if_available=False)
+        self.assertTrue(np.all(res_fast == res_slow))
+        self.assertTrue(
+            np.all(res_slow == tree.predict(
+                dta, num_threads=2, use_fast_prediction_if_available=False)))
+        tree = forpy.RegressionTree()
+        tree.fit(dta_t, annot_r)
+        self.assertTrue(
+            np.all(tree.predict(dta) == tree.predict(dta, num_threads=4)))
+        self.assertRaises(RuntimeError,
+                          lambda: tree.predict(dta, num_threads=0))
+
+    def test_task_stats(self):
+        """Test the statistics of the training tasks."""
+        import forpy
+        dta = np.random.normal(size=(5000, 20)).astype(np.float32)
+        annot = np.random.randint(0, 4, size=(5000, 1)).astype(np.uint32)
+        dta_t = np.ascontiguousarray(dta.T)
+        tree = forpy.ClassificationTree()
+        tree.fit(dta_t, annot, n_threads=1)
+        self.assertEqual(len(tree.task_stats), 1)
+        task = tree.task_stats[0]
+        self.assertEqual(task['node_id'], 0)
+        self.assertEqual(task['n_samples'], 5000)
+        self.assertEqual(task['n_spawned'], 0)
+        self.assertGreaterEqual(task['n_nodes'], (tree.n_nodes - 1) // 2)
+        self.assertLessEqual(task['n_nodes'], tree.n_nodes)
+        self.assertGreater(task['estimated_s'], 0.)
+        self.assertGreater(task['actual_s'], 0.)
+        tree = forpy.ClassificationTree()
+        tree.fit(dta_t, annot, n_threads=3)
+        tasks = tree.task_stats
+        self.assertEqual(len(tasks), 1 + sum(t['n_spawned'] for t in tasks))
+        self.assertLessEqual(sum(t['n_nodes'] for t in tasks), tree.n_nodes)
+
+    def test_bfs(self):
+        """Test breadth first training."""
+        import forpy
+        dta = np.random.normal(size=(500, 5)).astype(np.float32)
+        annot = np.random.randint(0, 4, size=(500, 1)).astype(np.uint32)
+        dta_t = np.ascontiguousarray(dta.T)
+        tree = forpy.ClassificationTree()
+        tree.fit(dta_t, annot, search_type=forpy.ESearchType.BFS)
+        self.assertTrue(np.all(tree.predict(dta) == annot))
+        self.assertRaises(RuntimeError, tree.BFS)
+        tree = forpy.ClassificationTree()
+        tree.fit(dta_t, annot, complete_dfs=False,
+                 search_type=forpy.ESearchType.BFS)
+        self.assertFalse(tree.BFS())
+        self.assertEqual(tree.bfs_depth, 1)
+        self.assertTrue(tree.BFS(forpy.ECompletionLevel.Complete))
+        self.assertTrue(np.all(tree.predict(dta) == annot))
+
+    def test_relayout(self):
+        """Test node relayouting."""
+        import forpy
+        dta = np.random.normal(size=(500, 5)).astype(np.float32)
+        annot = np.random.randint(0, 4, size=(500, 1)).astype(np.uint32)
+        tree = forpy.ClassificationTree()
+        self.assertRaises(RuntimeError, tree.relayout)
+        tree.fit(np.ascontiguousarray(dta.T), annot)
+        res = tree.predict_proba(dta)
+        n_nodes = tree.n_nodes
+        self.assertEqual(tree.layout, forpy.ENodeLayout.Training)
+        self.assertRaises(RuntimeError,
+                          lambda: tree.relayout(forpy.ENodeLayout.Training))
+        tree.relayout(forpy.ENodeLayout.BreadthFirst)
+        self.assertEqual(tree.layout, forpy.ENodeLayout.BreadthFirst)
+        self.assertEqual(tree.n_nodes, n_nodes)
+        self.assertTrue(np.all(tree.predict_proba(dta) == res))
+        tree.relayout(bfs_levels=2, block_depth=2)
+        self.assertEqual(tree.layout, forpy.ENodeLayout.SubtreeBlocked)
+        self.assertTrue(np.all(tree.predict_proba(dta) == res))
+        # Siblings are adjacent.
+        for left, right in tree.tree:
+            self.assertTrue(left == 0 or right == left + 1)
+        tree.disable_fast_prediction()
+        self.assertTrue(
+            np.all(
+                tree.predict_proba(
+                    dta, use_fast_prediction_if_available=False) == res))
+        tree.save("relayout_test.json")
+        tree2 = forpy.ClassificationTree("relayout_test.json")
+        os.remove("relayout_test.json")
+        self.assertEqual(tree2.layout, forpy.ENodeLayout.SubtreeBlocked)
+        self.assertTrue(np.all(tree2.predict_proba(dta) == res))
+        tree = forpy.RegressionTree()
+        tree.fit(
+            np.ascontiguousarray(dta.T),
+            np.random.normal(size=(500, 2)).astype(np.float32))
+        res = tree.predict(dta)
+        tree.relayout()
+        self.assertTrue(np.all(tree.predict(dta) == res))
+
 
 if __name__ == '__main__':
     unittest.main()